@@ -1,24 +1,78 @@
 #pragma once
+#include <cstdint>
 #include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
 #include <vector>
 #include "../lexer/lexer.h"
 
 namespace ast {
 
+// every node of an Ast is allocated in its arena and freed with it, so
+// nodes only hold plain pointers to each other
+template <typename T>
+using list = std::pmr::vector<T*>;
 
 enum class AstKind : uint64_t {
 	SelectKind = 0,
 	CreateTableKind,
 	InsertKind,
+	CreateIndexKind,
+	CopyKind,
 };
 
 enum class expressionKind : uint64_t {
-	literalKind = 0
+	literalKind = 0,
+	placeholderKind,
+	binaryKind,
+	callKind,
+};
+
+// literalType says which typed value a literal expression carries
+enum class literalType : uint8_t {
+	// noLiteral is every expression that is not a numeric or string
+	// literal, and numbers too large for both INT and a double
+	noLiteral = 0,
+	intLiteral,
+	floatLiteral,
+	textLiteral,
+};
+
+struct expression;
+
+// binaryExpression is a op b, where op is a comparison, AND, OR or ||
+struct binaryExpression {
+	expression* a;
+	expression* b;
+	nicolassql::token op;
+};
+
+// callExpression is function(argument), as in SUM(amount), argument being
+// null for COUNT(*)
+struct callExpression {
+	nicolassql::token function;
+	expression* argument;
 };
 
 struct expression {
+	// literal is the placeholder token itself for placeholderKind, the
+	// function name for callKind and null for binaryKind, and for INT
+	// values the log replays, which come converted without a token
 	nicolassql::token* literal;
 	expressionKind kind;
+	// placeholder is the 1-based number of the parameter a placeholderKind
+	// expression stands for, assigned by parser::prepare
+	uint16_t placeholder = 0;
+	binaryExpression* binary = nullptr;
+	// the parser converts a literal once, so consumers read intValue,
+	// floatValue or text, by type, instead of the token. text has the
+	// doubled quotes of the literal undone.
+	literalType type = literalType::noLiteral;
+	int64_t intValue = 0;
+	double floatValue = 0;
+	std::string_view text;
+	callExpression* call = nullptr;
 };
 
 struct columnDefinition {
@@ -28,28 +82,83 @@ struct columnDefinition {
 
 struct CreateTableStatement {
 	nicolassql::token name;
-	std::unique_ptr<std::vector<std::unique_ptr<columnDefinition>>> cols;
+	list<columnDefinition>* cols;
+};
+
+// joinClause is JOIN table ON on
+struct joinClause {
+	nicolassql::token table;
+	expression* on;
 };
 
+// orderItem is an ORDER BY expression and its direction
+struct orderItem {
+	expression* expr;
+	bool descending = false;
+};
+
+// SelectStatement names columns by themselves or, in joins, qualified as
+// table.column, which the lexer makes a single identifier
 struct SelectStatement {
-	std::vector<std::unique_ptr<expression>> item;
+	list<expression> item;
 	nicolassql::token from;
+	// joins are the JOIN clauses after FROM, in order, or null when there
+	// are none
+	list<joinClause>* joins = nullptr;
+	// where is null when the statement has no WHERE clause
+	expression* where = nullptr;
+	// groupBy is null when the statement has no GROUP BY clause
+	list<expression>* groupBy = nullptr;
+	// orderBy is null when the statement has no ORDER BY clause
+	list<orderItem>* orderBy = nullptr;
+	// limit is null when the statement has no LIMIT clause
+	expression* limit = nullptr;
 };
 
+// InsertStatement is INSERT INTO table VALUES (...), (...), ... with the
+// rows of VALUES back to back in values, each values->size() / rows long
 struct InsertStatement {
 	nicolassql::token table;
-	std::unique_ptr<std::vector<std::unique_ptr<expression>>> values;
+	list<expression>* values;
+	uint64_t rows = 1;
+};
+
+// CreateIndexStatement is CREATE INDEX name ON table (column)
+struct CreateIndexStatement {
+	nicolassql::token name;
+	nicolassql::token table;
+	nicolassql::token column;
+};
+
+// CopyStatement is COPY table FROM 'file', file being the path of a CSV
+// file with the doubled quotes of the literal undone
+struct CopyStatement {
+	nicolassql::token table;
+	std::string_view file;
 };
 
 struct Statement {
-	SelectStatement* SelectStatement;
-	CreateTableStatement* CreateTableStatement;
-	InsertStatement* InsertStatement;
 	AstKind Kind;
+	ast::SelectStatement* SelectStatement;
+	ast::CreateTableStatement* CreateTableStatement;
+	ast::InsertStatement* InsertStatement;
+	ast::CreateIndexStatement* CreateIndexStatement = nullptr;
+	ast::CopyStatement* CopyStatement = nullptr;
 };
 
 struct Ast {
-	std::vector<std::unique_ptr<Statement>> Statements;
+	explicit Ast(std::shared_ptr<const std::string> source)
+		: Source(std::move(source)),
+		  Arena(std::make_unique<nicolassql::arena>()),
+		  Statements(Arena.get()) {}
+
+	// every token in Statements views into Source, Arena or one of
+	// ChunkArenas. Source is null when the Ast was parsed from a stream.
+	std::shared_ptr<const std::string> Source;
+	std::unique_ptr<nicolassql::arena> Arena;
+	// ChunkArenas hold the nodes built by the workers of a parallel parse
+	std::vector<std::unique_ptr<nicolassql::arena>> ChunkArenas;
+	list<Statement> Statements;
 };
 
 }
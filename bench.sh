@@ -0,0 +1,3 @@
+cmake -S . -B build-release -DCMAKE_BUILD_TYPE=Release &&
+cmake --build build-release --target nicolassql_bench &&
+./build-release/bench/nicolassql_bench "$@"
@@ -0,0 +1,174 @@
+#include <benchmark/benchmark.h>
+#include "workload.h"
+#include "../lexer/lexer.h"
+#include "../parser/parser.h"
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+
+using namespace nicolassql;
+
+// every heap allocation in the process is counted, so the benchmarks can
+// report how many a statement costs. The replacements stay out of line:
+// inlined, the compiler sees std::free release memory from operator new
+// and warns of a mismatch.
+static std::atomic<uint64_t> heapAllocations{0};
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+// scriptBytes is the size of every generated script, big enough that the
+// per-run setup is noise
+static constexpr size_t scriptBytes = 8 << 20;
+
+static const std::string& workload(workloadKind kind) {
+    static std::string scripts[workloadKinds.size()];
+    std::string& script = scripts[static_cast<size_t>(kind)];
+    if (script.empty()) {
+        script = generateWorkload(kind, scriptBytes);
+    }
+    return script;
+}
+
+static double peakRssMegabytes() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    // ru_maxrss is in kilobytes on Linux
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;
+}
+
+// report sets the counters every benchmark shares: tokens/s and
+// statements/s as rates, allocations per statement and peak RSS
+static void report(benchmark::State& state, const std::string& script, uint64_t tokens,
+        uint64_t statements, uint64_t allocations) {
+    int64_t iterations = static_cast<int64_t>(state.iterations());
+    state.SetBytesProcessed(iterations * static_cast<int64_t>(script.size()));
+    state.counters["tokens/s"] = benchmark::Counter(static_cast<double>(tokens * iterations),
+        benchmark::Counter::kIsRate);
+    if (statements != 0) {
+        state.counters["statements/s"] = benchmark::Counter(static_cast<double>(statements * iterations),
+            benchmark::Counter::kIsRate);
+        state.counters["allocs/statement"] = static_cast<double>(allocations) /
+            static_cast<double>(statements * iterations);
+    }
+    state.counters["peak_rss_mb"] = peakRssMegabytes();
+}
+
+static uint64_t countTokens(const std::string& script) {
+    arena storage;
+    auto [tokens, err] = lex(script, storage);
+    return tokens.size();
+}
+
+static void BM_Lex(benchmark::State& state) {
+    auto kind = static_cast<workloadKind>(state.range(0));
+    const std::string& script = workload(kind);
+    state.SetLabel(std::string(workloadName(kind)));
+
+    uint64_t tokens = 0;
+    uint64_t before = heapAllocations.load();
+    for (auto _ : state) {
+        arena storage;
+        auto [lexed, err] = lex(script, storage);
+        if (!err.empty()) {
+            state.SkipWithError(err.c_str());
+            break;
+        }
+        tokens = lexed.size();
+    }
+    report(state, script, tokens, 0, heapAllocations.load() - before);
+}
+
+static void BM_Parse(benchmark::State& state) {
+    auto kind = static_cast<workloadKind>(state.range(0));
+    auto script = std::make_shared<const std::string>(workload(kind));
+    state.SetLabel(std::string(workloadName(kind)));
+
+    uint64_t statements = 0;
+    uint64_t before = heapAllocations.load();
+    for (auto _ : state) {
+        auto [a, err] = parser::Parse(script);
+        if (!err.empty()) {
+            state.SkipWithError(err.c_str());
+            break;
+        }
+        statements = a->Statements.size();
+    }
+    uint64_t allocations = heapAllocations.load() - before;
+    report(state, *script, countTokens(*script), statements, allocations);
+}
+
+static void BM_ParseParallel(benchmark::State& state) {
+    auto kind = static_cast<workloadKind>(state.range(0));
+    auto script = std::make_shared<const std::string>(workload(kind));
+    state.SetLabel(std::string(workloadName(kind)));
+
+    uint64_t statements = 0;
+    uint64_t before = heapAllocations.load();
+    for (auto _ : state) {
+        auto [a, err] = parser::ParseParallel(script);
+        if (!err.empty()) {
+            state.SkipWithError(err.c_str());
+            break;
+        }
+        statements = a->Statements.size();
+    }
+    uint64_t allocations = heapAllocations.load() - before;
+    report(state, *script, countTokens(*script), statements, allocations);
+}
+
+// BM_ParseEach streams the script through a statementStream, the mode
+// with a constant memory footprint
+static void BM_ParseEach(benchmark::State& state) {
+    auto kind = static_cast<workloadKind>(state.range(0));
+    const std::string& script = workload(kind);
+    state.SetLabel(std::string(workloadName(kind)));
+
+    uint64_t statements = 0;
+    uint64_t before = heapAllocations.load();
+    for (auto _ : state) {
+        std::istringstream in(script);
+        statements = 0;
+        std::string err = parser::ParseEach(istreamReader(in), [&](const ast::Statement&) {
+            statements++;
+            return true;
+        });
+        if (!err.empty()) {
+            state.SkipWithError(err.c_str());
+            break;
+        }
+    }
+    uint64_t allocations = heapAllocations.load() - before;
+    report(state, script, countTokens(script), statements, allocations);
+}
+
+static void workloadArgs(benchmark::internal::Benchmark* b) {
+    for (workloadKind kind : workloadKinds) {
+        b->Arg(static_cast<int64_t>(kind));
+    }
+    b->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK(BM_Lex)->Apply(workloadArgs);
+BENCHMARK(BM_Parse)->Apply(workloadArgs);
+BENCHMARK(BM_ParseParallel)->Apply(workloadArgs)->UseRealTime();
+BENCHMARK(BM_ParseEach)->Apply(workloadArgs);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,135 @@
+#include "workload.h"
+#include <random>
+
+namespace nicolassql {
+
+namespace {
+
+void appendWord(std::string& out, std::mt19937& rng, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		out += static_cast<char>('a' + rng() % 26);
+	}
+}
+
+void wideCreateTable(std::string& out, std::mt19937& rng, uint64_t n) {
+	out += "CREATE TABLE wide";
+	out += std::to_string(n);
+	out += " (";
+	size_t columns = 200 + rng() % 200;
+	for (size_t i = 0; i < columns; i++) {
+		if (i != 0) {
+			out += ", ";
+		}
+		out += "Column_";
+		appendWord(out, rng, 4 + rng() % 8);
+		out += std::to_string(i);
+		out += rng() % 2 == 0 ? " INT" : " TEXT";
+	}
+	out += ");\n";
+}
+
+void longInsert(std::string& out, std::mt19937& rng, uint64_t n) {
+	out += "INSERT INTO measurements VALUES (";
+	out += std::to_string(n);
+	size_t values = 1000 + rng() % 3000;
+	for (size_t i = 0; i < values; i++) {
+		out += ", ";
+		switch (rng() % 4) {
+		case 0:
+			out += std::to_string(rng() % 1000);
+			out += '.';
+			out += std::to_string(rng() % 1000);
+			break;
+		case 1:
+			out += std::to_string(rng() % 100);
+			out += "e-";
+			out += std::to_string(rng() % 10);
+			break;
+		default:
+			out += std::to_string(rng());
+			break;
+		}
+	}
+	out += ");\n";
+}
+
+void manyStatements(std::string& out, std::mt19937& rng, uint64_t n) {
+	switch (n % 3) {
+	case 0:
+		out += "INSERT INTO users VALUES (";
+		out += std::to_string(n);
+		out += ", '";
+		appendWord(out, rng, 3 + rng() % 10);
+		out += "', ";
+		out += std::to_string(rng() % 100);
+		out += ");\n";
+		break;
+	case 1:
+		out += "SELECT id, name, age FROM users;\n";
+		break;
+	case 2:
+		out += "CREATE TABLE t";
+		out += std::to_string(n);
+		out += " (id INT, name TEXT);\n";
+		break;
+	}
+}
+
+void quoteHeavy(std::string& out, std::mt19937& rng, uint64_t n) {
+	out += "INSERT INTO documents VALUES (";
+	out += std::to_string(n);
+	out += ", \"Title ";
+	appendWord(out, rng, 8);
+	out += "\", '";
+	size_t words = 20 + rng() % 200;
+	for (size_t i = 0; i < words; i++) {
+		if (i != 0) {
+			out += rng() % 10 == 0 ? " it''s " : " ";
+		}
+		appendWord(out, rng, 1 + rng() % 12);
+	}
+	// semicolons and newlines inside literals must not end the statement
+	out += "; done\n'";
+	out += ");\n";
+}
+
+}
+
+std::string_view workloadName(workloadKind kind) {
+	switch (kind) {
+	case workloadKind::wideCreateTableWorkload:
+		return "wide_create_table";
+	case workloadKind::longInsertWorkload:
+		return "long_insert";
+	case workloadKind::manyStatementsWorkload:
+		return "many_statements";
+	case workloadKind::quoteHeavyWorkload:
+		return "quote_heavy";
+	}
+	return "unknown";
+}
+
+std::string generateWorkload(workloadKind kind, size_t bytes, uint32_t seed) {
+	std::mt19937 rng(seed);
+	std::string out;
+	out.reserve(bytes + 64 * 1024);
+	for (uint64_t n = 0; out.size() < bytes; n++) {
+		switch (kind) {
+		case workloadKind::wideCreateTableWorkload:
+			wideCreateTable(out, rng, n);
+			break;
+		case workloadKind::longInsertWorkload:
+			longInsert(out, rng, n);
+			break;
+		case workloadKind::manyStatementsWorkload:
+			manyStatements(out, rng, n);
+			break;
+		case workloadKind::quoteHeavyWorkload:
+			quoteHeavy(out, rng, n);
+			break;
+		}
+	}
+	return out;
+}
+
+}
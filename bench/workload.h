@@ -0,0 +1,35 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace nicolassql {
+
+// workloadKind names the shapes of script the benchmarks are run against,
+// each stressing a different part of the lexer and parser
+enum class workloadKind : unsigned int {
+	// CREATE TABLEs with hundreds of columns: keywords and identifiers
+	wideCreateTableWorkload = 0,
+	// INSERTs with thousands of values each: numbers and commas
+	longInsertWorkload,
+	// many short statements of every kind: per-statement overhead
+	manyStatementsWorkload,
+	// INSERTs of long quoted text full of escapes: string scanning
+	quoteHeavyWorkload,
+};
+
+constexpr std::array<workloadKind, 4> workloadKinds = {
+	workloadKind::wideCreateTableWorkload,
+	workloadKind::longInsertWorkload,
+	workloadKind::manyStatementsWorkload,
+	workloadKind::quoteHeavyWorkload,
+};
+
+std::string_view workloadName(workloadKind kind);
+
+// generateWorkload builds a script of kind about bytes long. The same kind,
+// size and seed always give the same script, so runs can be compared.
+std::string generateWorkload(workloadKind kind, size_t bytes, uint32_t seed = 1);
+
+}
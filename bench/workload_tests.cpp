@@ -0,0 +1,28 @@
+#include <gtest/gtest.h>
+#include "workload.h"
+#include "../parser/parser.h"
+
+using namespace nicolassql;
+
+TEST(WorkloadTest, EveryWorkloadParses) {
+    for (workloadKind kind : workloadKinds) {
+        std::string script = generateWorkload(kind, 256 * 1024);
+        EXPECT_GE(script.size(), 256u * 1024) << workloadName(kind);
+
+        auto [a, err] = parser::Parse(script);
+        ASSERT_TRUE(err.empty()) << workloadName(kind) << ": " << err;
+        EXPECT_GT(a->Statements.size(), 0u) << workloadName(kind);
+    }
+}
+
+TEST(WorkloadTest, SameSeedSameScript) {
+    for (workloadKind kind : workloadKinds) {
+        EXPECT_EQ(generateWorkload(kind, 64 * 1024, 3), generateWorkload(kind, 64 * 1024, 3));
+        EXPECT_NE(generateWorkload(kind, 64 * 1024, 3), generateWorkload(kind, 64 * 1024, 4));
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,441 @@
+#include "aggregate.h"
+#include "parallel.h"
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+namespace execution {
+
+namespace {
+
+// noText marks a TEXT MIN or MAX that has not seen a value yet
+constexpr uint64_t noText = std::numeric_limits<uint64_t>::max();
+
+// mergeBits is the number of partitions, as a power of two, the groups of
+// the workers are split into to be merged; enough for the partitions to
+// spread evenly over the threads
+constexpr unsigned mergeBits = 6;
+
+// groupTable is the groups one worker has found. Each group is a row of
+// width words in groups: its hash, its keys, the number of its rows and
+// then the state of each aggregate. INT keys and states are stored as
+// they are; TEXT ones are offsets into heap, where each value is its
+// length followed by its bytes. slots is the open addressing index into
+// the groups, group i being i+1 and 0 an empty slot.
+class groupTable {
+public:
+	groupTable(const std::vector<storage::columnType>& keyTypes, const std::vector<aggregate>& aggregates,
+			const std::vector<storage::columnType>& aggregateTypes)
+		: keyTypes(keyTypes), aggregates(aggregates), aggregateTypes(aggregateTypes),
+		width(keyTypes.size() + aggregates.size() + 2), slots(16, 0) {}
+
+	size_t size() const { return count; }
+	uint64_t* row(size_t group) { return groups.data() + group * width; }
+	const uint64_t* row(size_t group) const { return groups.data() + group * width; }
+
+	// rowsAt is the word holding the row count of a group row, stateAt the
+	// word holding the state of aggregate a
+	size_t rowsAt() const { return keyTypes.size() + 1; }
+	size_t stateAt(size_t a) const { return keyTypes.size() + 2 + a; }
+
+	std::string_view text(uint64_t offset) const {
+		uint32_t length = 0;
+		std::memcpy(&length, heap.data() + offset, sizeof(length));
+		return std::string_view(heap.data() + offset + sizeof(length), length);
+	}
+
+	uint64_t storeText(std::string_view value) {
+		uint64_t offset = heap.size();
+		uint32_t length = static_cast<uint32_t>(value.size());
+		heap.append(reinterpret_cast<const char*>(&length), sizeof(length));
+		heap.append(value);
+		return offset;
+	}
+
+	// find returns the group with the given hash that equal accepts, adding
+	// one whose keys init writes when there is none
+	template <typename Equal, typename Init>
+	size_t find(uint64_t hash, Equal equal, Init init) {
+		uint64_t mask = slots.size() - 1;
+		for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+			uint32_t id = slots[slot];
+			if (id == 0) {
+				size_t group = count++;
+				groups.resize(count * width);
+				uint64_t* r = row(group);
+				r[0] = hash;
+				init(r);
+				r[rowsAt()] = 0;
+				for (size_t a = 0; a < aggregates.size(); a++) {
+					r[stateAt(a)] = initialState(a);
+				}
+				slots[slot] = static_cast<uint32_t>(group + 1);
+				if (count * 2 > slots.size()) {
+					grow();
+				}
+				return group;
+			}
+			const uint64_t* r = row(id - 1);
+			if (r[0] == hash && equal(r)) {
+				return id - 1;
+			}
+		}
+	}
+
+	// add folds the rows of b into the groups
+	void add(const batch& b, const std::vector<size_t>& keys) {
+		size_t n = b.count;
+		hashes.assign(n, 0);
+		ids.resize(n);
+		std::hash<std::string_view> textHash;
+		for (size_t k = 0; k < keys.size(); k++) {
+			const columnVector& v = b.columns[keys[k]];
+			if (v.type == storage::columnType::intType) {
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = hashOf(hashes[i] ^ static_cast<uint64_t>(v.intAt(b.position(i))));
+				}
+			} else {
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = hashOf(hashes[i] ^ textHash(v.textAt(b.position(i))));
+				}
+			}
+		}
+
+		if (keys.empty()) {
+			if (count == 0) {
+				find(0, [](const uint64_t*) { return true; }, [](uint64_t*) {});
+			}
+			ids.assign(n, 0);
+			if (n == 0) {
+				return;
+			}
+		} else if (keys.size() == 1 && b.columns[keys[0]].type == storage::columnType::intType) {
+			// a single INT key, the common case, compares one word
+			const columnVector& v = b.columns[keys[0]];
+			for (size_t i = 0; i < n; i++) {
+				uint64_t key = static_cast<uint64_t>(v.intAt(b.position(i)));
+				ids[i] = static_cast<uint32_t>(find(hashes[i], [key](const uint64_t* r) { return r[1] == key; },
+					[key](uint64_t* r) { r[1] = key; }));
+			}
+		} else {
+			for (size_t i = 0; i < n; i++) {
+				size_t position = b.position(i);
+				auto equal = [&](const uint64_t* r) {
+					for (size_t k = 0; k < keys.size(); k++) {
+						const columnVector& v = b.columns[keys[k]];
+						bool same = v.type == storage::columnType::intType
+							? r[k + 1] == static_cast<uint64_t>(v.intAt(position))
+							: text(r[k + 1]) == v.textAt(position);
+						if (!same) {
+							return false;
+						}
+					}
+					return true;
+				};
+				auto init = [&](uint64_t* r) {
+					for (size_t k = 0; k < keys.size(); k++) {
+						const columnVector& v = b.columns[keys[k]];
+						r[k + 1] = v.type == storage::columnType::intType
+							? static_cast<uint64_t>(v.intAt(position))
+							: storeText(v.textAt(position));
+					}
+				};
+				ids[i] = static_cast<uint32_t>(find(hashes[i], equal, init));
+			}
+		}
+
+		// each aggregate is folded in a column at a time
+		uint64_t* rows = groups.data() + rowsAt();
+		for (size_t i = 0; i < n; i++) {
+			rows[ids[i] * width]++;
+		}
+		for (size_t a = 0; a < aggregates.size(); a++) {
+			if (aggregates[a].kind == aggregateKind::countKind) {
+				continue;
+			}
+			const columnVector& v = b.columns[aggregates[a].column];
+			uint64_t* states = groups.data() + stateAt(a);
+			if (v.type == storage::columnType::intType) {
+				// one loop per function, so that none branches on it per row
+				switch (aggregates[a].kind) {
+				case aggregateKind::minKind:
+					foldInts(b, v, states, [](uint64_t& s, int64_t value) {
+						s = static_cast<uint64_t>(std::min(static_cast<int64_t>(s), value));
+					});
+					break;
+				case aggregateKind::maxKind:
+					foldInts(b, v, states, [](uint64_t& s, int64_t value) {
+						s = static_cast<uint64_t>(std::max(static_cast<int64_t>(s), value));
+					});
+					break;
+				default:
+					foldInts(b, v, states, [](uint64_t& s, int64_t value) { s += static_cast<uint64_t>(value); });
+					break;
+				}
+			} else {
+				for (size_t i = 0; i < n; i++) {
+					foldText(a, states[ids[i] * width], v.textAt(b.position(i)));
+				}
+			}
+		}
+	}
+
+	// merge folds group g of other, a table of the same shape, into the
+	// groups
+	void merge(const groupTable& other, size_t g) {
+		const uint64_t* from = other.row(g);
+		auto equal = [&](const uint64_t* r) {
+			for (size_t k = 0; k < keyTypes.size(); k++) {
+				bool same = keyTypes[k] == storage::columnType::intType
+					? r[k + 1] == from[k + 1]
+					: text(r[k + 1]) == other.text(from[k + 1]);
+				if (!same) {
+					return false;
+				}
+			}
+			return true;
+		};
+		auto init = [&](uint64_t* r) {
+			for (size_t k = 0; k < keyTypes.size(); k++) {
+				r[k + 1] = keyTypes[k] == storage::columnType::intType ? from[k + 1] : storeText(other.text(from[k + 1]));
+			}
+		};
+		uint64_t* r = row(find(from[0], equal, init));
+
+		r[rowsAt()] += from[rowsAt()];
+		for (size_t a = 0; a < aggregates.size(); a++) {
+			uint64_t state = from[stateAt(a)];
+			if (aggregates[a].kind == aggregateKind::countKind) {
+				continue;
+			}
+			if (aggregateTypes[a] == storage::columnType::textType) {
+				if (state != noText) {
+					foldText(a, r[stateAt(a)], other.text(state));
+				}
+			} else if (aggregates[a].kind == aggregateKind::minKind || aggregates[a].kind == aggregateKind::maxKind) {
+				foldInt(a, r[stateAt(a)], static_cast<int64_t>(state));
+			} else {
+				r[stateAt(a)] += state;
+			}
+		}
+	}
+
+	// emit appends the groups to result, keys first and then aggregates
+	void emit(resultSet& result) const {
+		size_t nk = keyTypes.size();
+		for (size_t group = 0; group < count; group++) {
+			const uint64_t* r = row(group);
+			for (size_t k = 0; k < nk; k++) {
+				storage::column& col = result.columns[k];
+				if (keyTypes[k] == storage::columnType::intType) {
+					col.appendInt(static_cast<int64_t>(r[k + 1]));
+				} else {
+					col.appendText(text(r[k + 1]));
+				}
+			}
+
+			uint64_t rows = r[rowsAt()];
+			for (size_t a = 0; a < aggregates.size(); a++) {
+				storage::column& col = result.columns[nk + a];
+				uint64_t state = r[stateAt(a)];
+				switch (aggregates[a].kind) {
+				case aggregateKind::countKind:
+					col.appendInt(static_cast<int64_t>(rows));
+					break;
+				case aggregateKind::sumKind:
+					col.appendInt(static_cast<int64_t>(state));
+					break;
+				case aggregateKind::avgKind:
+					col.appendInt(rows == 0 ? 0 : static_cast<int64_t>(state) / static_cast<int64_t>(rows));
+					break;
+				case aggregateKind::minKind:
+				case aggregateKind::maxKind:
+					if (aggregateTypes[a] == storage::columnType::textType) {
+						col.appendText(state == noText ? std::string_view() : text(state));
+					} else {
+						col.appendInt(rows == 0 ? 0 : static_cast<int64_t>(state));
+					}
+					break;
+				}
+			}
+			result.rows++;
+		}
+	}
+
+private:
+	// foldInts folds value i of v into the state of the group of row i,
+	// states being the state of the first group
+	template <typename Fold>
+	void foldInts(const batch& b, const columnVector& v, uint64_t* states, Fold fold) const {
+		if (b.selection == nullptr && !v.constant) {
+			for (size_t i = 0; i < b.count; i++) {
+				fold(states[ids[i] * width], v.ints[i]);
+			}
+			return;
+		}
+		for (size_t i = 0; i < b.count; i++) {
+			fold(states[ids[i] * width], v.intAt(b.position(i)));
+		}
+	}
+
+	uint64_t initialState(size_t a) const {
+		if (aggregateTypes[a] == storage::columnType::textType) {
+			return noText;
+		}
+		switch (aggregates[a].kind) {
+		case aggregateKind::minKind:
+			return static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+		case aggregateKind::maxKind:
+			return static_cast<uint64_t>(std::numeric_limits<int64_t>::min());
+		default:
+			return 0;
+		}
+	}
+
+	void foldInt(size_t a, uint64_t& state, int64_t value) const {
+		switch (aggregates[a].kind) {
+		case aggregateKind::minKind:
+			state = static_cast<uint64_t>(std::min(static_cast<int64_t>(state), value));
+			break;
+		case aggregateKind::maxKind:
+			state = static_cast<uint64_t>(std::max(static_cast<int64_t>(state), value));
+			break;
+		default:
+			// sums wrap around rather than overflow
+			state += static_cast<uint64_t>(value);
+			break;
+		}
+	}
+
+	void foldText(size_t a, uint64_t& state, std::string_view value) {
+		bool replace = state == noText ||
+			(aggregates[a].kind == aggregateKind::minKind ? value < text(state) : value > text(state));
+		if (replace) {
+			state = storeText(value);
+		}
+	}
+
+	void grow() {
+		std::vector<uint32_t> bigger(slots.size() * 2, 0);
+		uint64_t mask = bigger.size() - 1;
+		for (size_t group = 0; group < count; group++) {
+			size_t slot = row(group)[0] & mask;
+			while (bigger[slot] != 0) {
+				slot = (slot + 1) & mask;
+			}
+			bigger[slot] = static_cast<uint32_t>(group + 1);
+		}
+		slots.swap(bigger);
+	}
+
+	const std::vector<storage::columnType>& keyTypes;
+	const std::vector<aggregate>& aggregates;
+	const std::vector<storage::columnType>& aggregateTypes;
+	size_t width;
+	std::vector<uint64_t> groups;
+	size_t count = 0;
+	std::vector<uint32_t> slots;
+	std::string heap;
+
+	// the hashes and groups of the rows of the batch being added
+	std::vector<uint64_t> hashes;
+	std::vector<uint32_t> ids;
+};
+
+}
+
+hashAggregate::hashAggregate(inputFactory input, std::vector<storage::columnType> inputSchema, size_t morsels,
+		std::vector<size_t> keys, std::vector<aggregate> aggregates, size_t threads)
+	: input(std::move(input)), inputSchema(std::move(inputSchema)), morsels(std::max<size_t>(1, morsels)),
+	keys(std::move(keys)), aggregates(std::move(aggregates)), threads(threads) {
+	std::vector<storage::columnType> types = schema();
+	for (storage::columnType type : types) {
+		result.columns.push_back(storage::column{.type = type});
+	}
+}
+
+std::vector<storage::columnType> hashAggregate::schema() const {
+	std::vector<storage::columnType> types;
+	for (size_t key : keys) {
+		types.push_back(inputSchema[key]);
+	}
+	for (const aggregate& a : aggregates) {
+		bool keepsType = a.kind == aggregateKind::minKind || a.kind == aggregateKind::maxKind;
+		types.push_back(keepsType ? inputSchema[a.column] : storage::columnType::intType);
+	}
+	return types;
+}
+
+void hashAggregate::run() {
+	std::vector<storage::columnType> keyTypes;
+	for (size_t key : keys) {
+		keyTypes.push_back(inputSchema[key]);
+	}
+	std::vector<storage::columnType> aggregateTypes;
+	for (const aggregate& a : aggregates) {
+		aggregateTypes.push_back(a.kind == aggregateKind::countKind ? storage::columnType::intType : inputSchema[a.column]);
+	}
+
+	size_t workers = threads == 0 ? availableThreads() : threads;
+	workers = std::min(workers, morsels);
+	std::vector<groupTable> local(workers, groupTable(keyTypes, aggregates, aggregateTypes));
+	std::atomic<size_t> nextMorsel{0};
+	runParallel(workers, [&](size_t t) {
+		batch b;
+		for (size_t m = nextMorsel++; m < morsels; m = nextMorsel++) {
+			std::unique_ptr<physicalOperator> in = input(m, morsels);
+			while (in->next(b)) {
+				local[t].add(b, keys);
+			}
+		}
+	});
+
+	if (workers == 1) {
+		if (keys.empty() && local[0].size() == 0) {
+			local[0].add(batch{}, keys);
+		}
+		local[0].emit(result);
+		return;
+	}
+
+	// every group of a partition is merged by the same worker, so no two
+	// workers touch the same final group
+	size_t parts = size_t{1} << mergeBits;
+	std::vector<std::vector<std::vector<uint32_t>>> split(workers, std::vector<std::vector<uint32_t>>(parts));
+	runParallel(workers, [&](size_t t) {
+		for (size_t group = 0; group < local[t].size(); group++) {
+			split[t][local[t].row(group)[0] >> (64 - mergeBits)].push_back(static_cast<uint32_t>(group));
+		}
+	});
+
+	std::vector<groupTable> merged(parts, groupTable(keyTypes, aggregates, aggregateTypes));
+	std::atomic<size_t> nextPart{0};
+	runParallel(workers, [&](size_t) {
+		for (size_t p = nextPart++; p < parts; p = nextPart++) {
+			for (size_t t = 0; t < workers; t++) {
+				for (uint32_t group : split[t][p]) {
+					merged[p].merge(local[t], group);
+				}
+			}
+		}
+	});
+
+	// the one group of a global aggregation is in partition 0
+	if (keys.empty() && merged[0].size() == 0) {
+		merged[0].add(batch{}, keys);
+	}
+	for (const groupTable& g : merged) {
+		g.emit(result);
+	}
+}
+
+bool hashAggregate::next(batch& out) {
+	if (!done) {
+		run();
+		done = true;
+	}
+	return emitBatch(result, position, out);
+}
+
+}
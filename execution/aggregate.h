@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "execution.h"
+
+namespace execution {
+
+// Hash aggregation runs in two phases. Workers take morsels of the input,
+// a share of its rows at a time, and fold each into a hash table of their
+// own: open addressing into one flat array of group rows, each the hash,
+// the keys and the aggregate states of a group side by side. The groups of
+// every worker are then split by the high bits of their hash, and each
+// partition is merged into the final groups by a single worker. No two
+// partitions share a group, so neither phase takes a lock.
+
+enum class aggregateKind : uint8_t {
+	countKind = 0,
+	sumKind,
+	minKind,
+	maxKind,
+	avgKind,
+};
+
+// aggregate is an aggregate function of an input column; COUNT ignores
+// column, as there are no NULLs to leave out
+struct aggregate {
+	aggregateKind kind;
+	size_t column = 0;
+};
+
+// hashAggregate groups the rows of its input on the key columns and emits
+// one row per group, in no particular order: the keys and then each
+// aggregate. Without keys every row is in the one group, which is emitted
+// even when there are no rows. The aggregates of no rows are 0, or empty
+// TEXT, and AVG is the INT quotient rounded towards zero.
+class hashAggregate : public physicalOperator {
+public:
+	// inputFactory makes the input of morsel part of parts, each morsel a
+	// share of the rows to aggregate
+	using inputFactory = std::function<std::unique_ptr<physicalOperator>(size_t part, size_t parts)>;
+
+	// inputSchema is the type of each column of the input; threads zero
+	// uses every core, but never more threads than there are morsels
+	hashAggregate(inputFactory input, std::vector<storage::columnType> inputSchema, size_t morsels,
+		std::vector<size_t> keys, std::vector<aggregate> aggregates, size_t threads = 0);
+	bool next(batch& out) override;
+	std::vector<storage::columnType> schema() const override;
+
+private:
+	// run aggregates the whole input into result
+	void run();
+
+	inputFactory input;
+	std::vector<storage::columnType> inputSchema;
+	size_t morsels;
+	std::vector<size_t> keys;
+	std::vector<aggregate> aggregates;
+	size_t threads;
+
+	bool done = false;
+	resultSet result;
+	size_t position = 0;
+};
+
+}
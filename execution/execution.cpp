@@ -0,0 +1,1346 @@
+#include "execution.h"
+#include "aggregate.h"
+#include "join.h"
+#include "sort.h"
+#include "../storage/btree.h"
+#include <algorithm>
+#include <charconv>
+#include <functional>
+
+namespace execution {
+
+using namespace nicolassql;
+
+namespace {
+
+// resolveColumn finds the column name refers to among the columns of
+// tables, numbered across the tables in order. name is a column of any of
+// the tables, unless it is ambiguous, or table.column.
+std::tuple<size_t, storage::columnType, std::string> resolveColumn(std::string_view name,
+		const std::vector<const storage::table*>& tables) {
+	if (tables.empty()) {
+		return {0, storage::columnType::intType, "Column " + std::string(name) + " needs a FROM table"};
+	}
+
+	std::string_view table;
+	std::string_view column = name;
+	if (size_t dot = name.find('.'); dot != std::string_view::npos) {
+		table = name.substr(0, dot);
+		column = name.substr(dot + 1);
+	}
+
+	bool tableFound = table.empty();
+	bool found = false;
+	size_t position = 0;
+	storage::columnType type = storage::columnType::intType;
+	size_t first = 0;
+	for (const storage::table* t : tables) {
+		if (table.empty() || t->name() == table) {
+			tableFound = true;
+			if (auto [index, ok] = t->columnIndex(column); ok) {
+				if (found) {
+					return {0, type, "Column " + std::string(name) + " is ambiguous"};
+				}
+				found = true;
+				position = first + index;
+				type = t->columns()[index].type;
+			}
+		}
+		first += t->columns().size();
+	}
+
+	if (!tableFound) {
+		return {0, type, "Table " + std::string(table) + " is not part of the query"};
+	}
+	if (!found) {
+		std::string where = !table.empty() ? std::string(table) : tables.size() == 1 ? tables[0]->name() : "";
+		if (where.empty()) {
+			return {0, type, "Column " + std::string(name) + " does not exist in any joined table"};
+		}
+		return {0, type, "Column " + std::string(column) + " does not exist in table " + where};
+	}
+	return {position, type, ""};
+}
+
+// resolveValue turns a literal or placeholder into a constant item, or
+// into an item reading the column of tables it names, column then being
+// its number as resolveColumn counts
+std::tuple<projection::item, std::string> resolveValue(const ast::expression& expr,
+		const std::vector<const storage::table*>& tables, const std::vector<token>& parameters) {
+	if (expr.kind == ast::expressionKind::callKind) {
+		return {projection::item{}, "Aggregates are only allowed in the select list"};
+	}
+
+	switch (expr.type) {
+	case ast::literalType::intLiteral:
+		return {projection::item{
+			.isConstant = true,
+			.type = storage::columnType::intType,
+			.intValue = expr.intValue,
+		}, ""};
+	case ast::literalType::textLiteral:
+		return {projection::item{
+			.isConstant = true,
+			.type = storage::columnType::textType,
+			.textValue = std::string(expr.text),
+		}, ""};
+	default:
+		break;
+	}
+
+	const token* value = expr.literal;
+	if (expr.kind == ast::expressionKind::placeholderKind) {
+		if (expr.placeholder == 0 || expr.placeholder > parameters.size()) {
+			return {projection::item{}, "Missing parameter " + std::string(expr.literal->value)};
+		}
+		value = &parameters[expr.placeholder - 1];
+	}
+
+	switch (value->kind) {
+	case tokenKind::identifierKind: {
+		auto [column, type, err] = resolveColumn(value->value, tables);
+		if (err != "") {
+			return {projection::item{}, err};
+		}
+		return {projection::item{
+			.isConstant = false,
+			.column = column,
+			.type = type,
+		}, ""};
+	}
+
+	case tokenKind::numericKind: {
+		int64_t n = 0;
+		const char* end = value->value.data() + value->value.size();
+		auto [stop, ec] = std::from_chars(value->value.data(), end, n);
+		if (ec != std::errc() || stop != end) {
+			return {projection::item{}, "Only INT numbers are supported, got " + std::string(value->value)};
+		}
+		return {projection::item{
+			.isConstant = true,
+			.type = storage::columnType::intType,
+			.intValue = n,
+		}, ""};
+	}
+
+	case tokenKind::stringKind:
+		return {projection::item{
+			.isConstant = true,
+			.type = storage::columnType::textType,
+			.textValue = std::string(value->value),
+		}, ""};
+
+	default:
+		return {projection::item{}, "Unsupported select item " + std::string(value->value)};
+	}
+}
+
+// resolveAggregate finds the aggregate function call names and the
+// column it aggregates; COUNT(*) has no column
+std::tuple<aggregateKind, projection::item, std::string> resolveAggregate(const ast::callExpression& call,
+		const std::vector<const storage::table*>& tables, const std::vector<token>& parameters) {
+	std::pair<std::string_view, aggregateKind> functions[] = {
+		{"count", aggregateKind::countKind},
+		{"sum", aggregateKind::sumKind},
+		{"min", aggregateKind::minKind},
+		{"max", aggregateKind::maxKind},
+		{"avg", aggregateKind::avgKind},
+	};
+	std::string name(call.function.value);
+	auto found = std::find_if(std::begin(functions), std::end(functions), [&](const auto& f) { return f.first == name; });
+	if (found == std::end(functions)) {
+		return {aggregateKind::countKind, projection::item{}, "Unknown function " + name};
+	}
+	aggregateKind kind = found->second;
+
+	if (call.argument == nullptr) {
+		if (kind != aggregateKind::countKind) {
+			return {kind, projection::item{}, "Only COUNT takes *"};
+		}
+		return {kind, projection::item{}, ""};
+	}
+
+	if (call.argument->kind != ast::expressionKind::literalKind) {
+		return {kind, projection::item{}, "Aggregate arguments must be columns"};
+	}
+	auto [argument, err] = resolveValue(*call.argument, tables, parameters);
+	if (err != "") {
+		return {kind, projection::item{}, err};
+	}
+	if (argument.isConstant) {
+		return {kind, projection::item{}, "Aggregate arguments must be columns"};
+	}
+	bool numeric = kind == aggregateKind::sumKind || kind == aggregateKind::avgKind;
+	if (numeric && argument.type != storage::columnType::intType) {
+		return {kind, projection::item{}, "Can not " + name + " TEXT column " + std::string(call.argument->literal->value)};
+	}
+	return {kind, std::move(argument), ""};
+}
+
+// compareOpFor maps a comparison operator token to its compareOp
+std::tuple<compareOp, bool> compareOpFor(const token& op) {
+	if (op.kind != tokenKind::symbolKind) {
+		return {compareOp::equalOp, false};
+	}
+
+	switch (op.id) {
+	case internedId(symbols, equalsSymbol):
+		return {compareOp::equalOp, true};
+	case internedId(symbols, neqSymbol):
+	case internedId(symbols, neqSymbol2):
+		return {compareOp::notEqualOp, true};
+	case internedId(symbols, ltSymbol):
+		return {compareOp::lessOp, true};
+	case internedId(symbols, lteSymbol):
+		return {compareOp::lessEqualOp, true};
+	case internedId(symbols, gtSymbol):
+		return {compareOp::greaterOp, true};
+	case internedId(symbols, gteSymbol):
+		return {compareOp::greaterEqualOp, true};
+	}
+	return {compareOp::equalOp, false};
+}
+
+// mirrored is the operator that gives the same result with the operands
+// swapped
+compareOp mirrored(compareOp op) {
+	switch (op) {
+	case compareOp::lessOp:
+		return compareOp::greaterOp;
+	case compareOp::lessEqualOp:
+		return compareOp::greaterEqualOp;
+	case compareOp::greaterOp:
+		return compareOp::lessOp;
+	case compareOp::greaterEqualOp:
+		return compareOp::lessEqualOp;
+	default:
+		return op;
+	}
+}
+
+template <typename T>
+bool compareValues(const T& a, const T& b, compareOp op) {
+	switch (op) {
+	case compareOp::equalOp:
+		return a == b;
+	case compareOp::notEqualOp:
+		return a != b;
+	case compareOp::lessOp:
+		return a < b;
+	case compareOp::lessEqualOp:
+		return a <= b;
+	case compareOp::greaterOp:
+		return a > b;
+	case compareOp::greaterEqualOp:
+		break;
+	}
+	return a >= b;
+}
+
+std::unique_ptr<predicate> constantPredicate(bool value) {
+	return std::make_unique<predicate>(predicate{
+		.kind = predicateKind::constantKind,
+		.value = value,
+	});
+}
+
+// compilePredicate turns a WHERE clause into a predicate over the columns
+// of tables, folding the parts that do not depend on the row into constants
+std::tuple<std::unique_ptr<predicate>, std::string> compilePredicate(const ast::expression& expr,
+		const std::vector<const storage::table*>& tables, const std::vector<token>& parameters) {
+	if (expr.kind != ast::expressionKind::binaryKind) {
+		return {nullptr, "WHERE needs a comparison, got " + std::string(expr.literal->value)};
+	}
+
+	const ast::binaryExpression& binary = *expr.binary;
+	bool isKeyword = binary.op.kind == tokenKind::keywordKind;
+	bool isAnd = isKeyword && binary.op.id == internedId(keywords, andKeyword);
+	bool isOr = isKeyword && binary.op.id == internedId(keywords, orKeyword);
+	if (isAnd || isOr) {
+		auto [a, errA] = compilePredicate(*binary.a, tables, parameters);
+		if (errA != "") {
+			return {nullptr, errA};
+		}
+		auto [b, errB] = compilePredicate(*binary.b, tables, parameters);
+		if (errB != "") {
+			return {nullptr, errB};
+		}
+
+		// a constant operand either decides the outcome or drops out
+		for (std::unique_ptr<predicate>* side : {&a, &b}) {
+			const predicate& p = **side;
+			if (p.kind != predicateKind::constantKind) {
+				continue;
+			}
+			if (p.value == isOr) {
+				return {constantPredicate(isOr), ""};
+			}
+			return {std::move(side == &a ? b : a), ""};
+		}
+
+		return {std::make_unique<predicate>(predicate{
+			.kind = isAnd ? predicateKind::andKind : predicateKind::orKind,
+			.a = std::move(a),
+			.b = std::move(b),
+		}), ""};
+	}
+
+	auto [op, ok] = compareOpFor(binary.op);
+	if (!ok) {
+		return {nullptr, "Unsupported WHERE operator " + std::string(binary.op.value)};
+	}
+	if (binary.a->kind == ast::expressionKind::binaryKind || binary.b->kind == ast::expressionKind::binaryKind) {
+		return {nullptr, "Comparisons need a column or a value on each side of " + std::string(binary.op.value)};
+	}
+
+	auto [left, errLeft] = resolveValue(*binary.a, tables, parameters);
+	if (errLeft != "") {
+		return {nullptr, errLeft};
+	}
+	auto [right, errRight] = resolveValue(*binary.b, tables, parameters);
+	if (errRight != "") {
+		return {nullptr, errRight};
+	}
+	if (left.type != right.type) {
+		return {nullptr, "Can not compare INT and TEXT with " + std::string(binary.op.value)};
+	}
+
+	if (left.isConstant && right.isConstant) {
+		bool value = left.type == storage::columnType::intType
+			? compareValues(left.intValue, right.intValue, op)
+			: compareValues(left.textValue, right.textValue, op);
+		return {constantPredicate(value), ""};
+	}
+
+	// the column goes first, so a constant is always the second operand
+	if (left.isConstant) {
+		std::swap(left, right);
+		op = mirrored(op);
+	}
+
+	return {std::make_unique<predicate>(predicate{
+		.kind = predicateKind::compareKind,
+		.op = op,
+		.type = left.type,
+		.column = left.column,
+		.constant = right.isConstant,
+		.otherColumn = right.column,
+		.intValue = right.intValue,
+		.textValue = std::move(right.textValue),
+	}), ""};
+}
+
+// fillBitmap sets the first count bits of bitmap to value
+void fillBitmap(uint64_t* bitmap, size_t count, bool value) {
+	for (size_t w = 0; w < bitmapWords(count); w++) {
+		bitmap[w] = value ? ~uint64_t{0} : 0;
+	}
+	if (value && count % 64 != 0) {
+		bitmap[count / 64] = (uint64_t{1} << (count % 64)) - 1;
+	}
+}
+
+// tighten narrows the lower or upper bound b to value when that excludes
+// more keys
+template <typename T, typename V>
+void tighten(storage::bound<T>& b, V value, bool inclusive, bool lower) {
+	if (!b.unbounded) {
+		bool wider = lower ? value < b.value : value > b.value;
+		if (wider || (value == b.value && inclusive)) {
+			return;
+		}
+	}
+	b.unbounded = false;
+	b.inclusive = inclusive;
+	b.value = value;
+}
+
+// conjuncts collects the comparisons p is the AND of
+void conjuncts(const predicate& p, std::vector<const predicate*>& out) {
+	if (p.kind == predicateKind::andKind) {
+		conjuncts(*p.a, out);
+		conjuncts(*p.b, out);
+	} else {
+		out.push_back(&p);
+	}
+}
+
+// indexLookup finds the rows of t that the comparisons of filter with
+// constants narrow an index of t down to. It returns false when no index
+// helps or the lookup finds more than limit rows.
+bool indexLookup(const storage::table& t, const predicate& filter, size_t limit, std::vector<uint64_t>& rows) {
+	std::vector<const predicate*> parts;
+	conjuncts(filter, parts);
+	for (const predicate* first : parts) {
+		if (first->kind != predicateKind::compareKind || !first->constant || first->op == compareOp::notEqualOp) {
+			continue;
+		}
+		const storage::tableIndex* index = t.indexOn(first->column);
+		if (index == nullptr) {
+			continue;
+		}
+
+		// every comparison of the column narrows the range
+		storage::keyRange range;
+		for (const predicate* p : parts) {
+			if (p->kind != predicateKind::compareKind || !p->constant || p->column != first->column) {
+				continue;
+			}
+			bool lower = p->op == compareOp::greaterOp || p->op == compareOp::greaterEqualOp || p->op == compareOp::equalOp;
+			bool upper = p->op == compareOp::lessOp || p->op == compareOp::lessEqualOp || p->op == compareOp::equalOp;
+			bool inclusive = p->op != compareOp::greaterOp && p->op != compareOp::lessOp;
+			if (p->type == storage::columnType::intType) {
+				if (lower) {
+					tighten(range.low, p->intValue, inclusive, true);
+				}
+				if (upper) {
+					tighten(range.high, p->intValue, inclusive, false);
+				}
+			} else {
+				std::string_view value = p->textValue;
+				if (lower) {
+					tighten(range.lowText, value, inclusive, true);
+				}
+				if (upper) {
+					tighten(range.highText, value, inclusive, false);
+				}
+			}
+		}
+		if (!index->lookup(range, limit, rows)) {
+			rows.clear();
+			return false;
+		}
+		return true;
+	}
+	return false;
+}
+
+// splitConjuncts moves the comparisons p is the AND of into out
+void splitConjuncts(std::unique_ptr<predicate> p, std::vector<std::unique_ptr<predicate>>& out) {
+	if (p->kind == predicateKind::andKind) {
+		splitConjuncts(std::move(p->a), out);
+		splitConjuncts(std::move(p->b), out);
+	} else {
+		out.push_back(std::move(p));
+	}
+}
+
+// forEachColumn calls fn on every column number p reads, which fn may
+// change
+template <typename F>
+void forEachColumn(predicate& p, F fn) {
+	switch (p.kind) {
+	case predicateKind::constantKind:
+		return;
+	case predicateKind::andKind:
+	case predicateKind::orKind:
+		forEachColumn(*p.a, fn);
+		forEachColumn(*p.b, fn);
+		return;
+	case predicateKind::compareKind:
+		fn(p.column);
+		if (!p.constant) {
+			fn(p.otherColumn);
+		}
+		return;
+	}
+}
+
+// zoneAllows returns whether some value of a chunk that zone sums up may
+// compare with constant as op asks
+template <typename T, typename V>
+bool zoneAllows(const storage::zoneMap<T>& zone, const V& constant, compareOp op) {
+	switch (op) {
+	case compareOp::equalOp:
+		return !(constant < zone.low) && !(zone.high < constant);
+	case compareOp::notEqualOp:
+		return zone.low < zone.high || !(zone.low == constant);
+	case compareOp::lessOp:
+		return zone.low < constant;
+	case compareOp::lessEqualOp:
+		return !(constant < zone.low);
+	case compareOp::greaterOp:
+		return constant < zone.high;
+	case compareOp::greaterEqualOp:
+		return !(zone.high < constant);
+	}
+	return true;
+}
+
+// chunkMayMatch returns whether some row of chunk chunk of t may satisfy
+// p, going by the zone maps of the columns p compares with constants
+bool chunkMayMatch(const predicate& p, const storage::table& t, size_t chunk) {
+	switch (p.kind) {
+	case predicateKind::constantKind:
+		return p.value;
+	case predicateKind::andKind:
+		return chunkMayMatch(*p.a, t, chunk) && chunkMayMatch(*p.b, t, chunk);
+	case predicateKind::orKind:
+		return chunkMayMatch(*p.a, t, chunk) || chunkMayMatch(*p.b, t, chunk);
+	case predicateKind::compareKind:
+		break;
+	}
+	if (!p.constant) {
+		return true;
+	}
+	const storage::column& col = t.columns()[p.column];
+	if (p.type == storage::columnType::intType) {
+		return zoneAllows(col.intZones[chunk], p.intValue, p.op);
+	}
+	return zoneAllows(col.textZones[chunk], std::string_view(p.textValue), p.op);
+}
+
+// gatherColumn copies the values of col at rows rowOf(0) to
+// rowOf(count-1) into d, back to back, and points v at them
+template <typename RowOf>
+void gatherColumn(const storage::column& col, size_t count, RowOf rowOf, decoded& d, columnVector& v) {
+	v.type = col.type;
+	v.constant = false;
+	if (col.type == storage::columnType::intType) {
+		d.ints.resize(std::max(d.ints.size(), count));
+		for (size_t i = 0; i < count; i++) {
+			d.ints[i] = col.intAt(rowOf(i));
+		}
+		v.ints = d.ints.data();
+		return;
+	}
+
+	d.chars.clear();
+	d.offsets.resize(count + 1);
+	d.offsets[0] = 0;
+	for (size_t i = 0; i < count; i++) {
+		d.chars.append(col.text(rowOf(i)));
+		d.offsets[i + 1] = d.chars.size();
+	}
+	v.offsets = d.offsets.data();
+	v.chars = d.chars.data();
+}
+
+// tableOf returns which of the tables whose columns start at firstColumns
+// column is a column of
+size_t tableOf(const std::vector<size_t>& firstColumns, size_t column) {
+	return static_cast<size_t>(std::upper_bound(firstColumns.begin(), firstColumns.end(), column) - firstColumns.begin()) - 1;
+}
+
+// rowsOf returns the rows of t that satisfy filter, or every row when
+// filter is null, in order
+std::vector<uint64_t> rowsOf(const storage::table& t, const predicate* filter) {
+	std::vector<uint64_t> rows;
+	if (filter == nullptr) {
+		rows.resize(t.rows());
+		for (size_t row = 0; row < rows.size(); row++) {
+			rows[row] = row;
+		}
+		return rows;
+	}
+	if (indexLookup(t, *filter, t.rows() / indexScanShare, rows)) {
+		std::sort(rows.begin(), rows.end());
+		std::vector<uint64_t> matching;
+		for (uint64_t row : rows) {
+			uint64_t word = 0;
+			evaluatePredicate(*filter, t, row, 1, &word);
+			if (word != 0) {
+				matching.push_back(row);
+			}
+		}
+		return matching;
+	}
+
+	std::array<uint64_t, bitmapWords(batchSize)> bitmap;
+	std::array<uint32_t, batchSize> selection;
+	for (size_t first = 0; first < t.rows(); first += batchSize) {
+		size_t count = std::min(batchSize, t.rows() - first);
+		evaluatePredicate(*filter, t, first, count, bitmap.data());
+		size_t selected = selectionFromBitmap(bitmap.data(), count, selection.data());
+		for (size_t i = 0; i < selected; i++) {
+			rows.push_back(first + selection[i]);
+		}
+	}
+	return rows;
+}
+
+// joinEntries pairs the value of column of t in each of rows, or its hash
+// for TEXT, with the position of the row in rows
+std::vector<joinEntry> joinEntries(const storage::table& t, size_t column, const std::vector<uint64_t>& rows) {
+	const storage::column& col = t.columns()[column];
+	std::vector<joinEntry> entries(rows.size());
+	if (col.type == storage::columnType::intType) {
+		for (size_t i = 0; i < rows.size(); i++) {
+			entries[i] = joinEntry{.key = static_cast<uint64_t>(col.intAt(rows[i])), .row = i};
+		}
+	} else {
+		std::hash<std::string_view> hash;
+		for (size_t i = 0; i < rows.size(); i++) {
+			entries[i] = joinEntry{.key = hash(col.text(rows[i])), .row = i};
+		}
+	}
+	return entries;
+}
+
+size_t countBits(const uint64_t* bitmap, size_t count) {
+	size_t n = 0;
+	for (size_t w = 0; w < bitmapWords(count); w++) {
+		n += __builtin_popcountll(bitmap[w]);
+	}
+	return n;
+}
+
+}
+
+void evaluatePredicate(const predicate& p, const storage::table& t, size_t first, size_t count, uint64_t* bitmap) {
+	switch (p.kind) {
+	case predicateKind::constantKind:
+		fillBitmap(bitmap, count, p.value);
+		return;
+
+	case predicateKind::andKind:
+	case predicateKind::orKind: {
+		bool isAnd = p.kind == predicateKind::andKind;
+		evaluatePredicate(*p.a, t, first, count, bitmap);
+		// the second operand is only read when it can change the outcome
+		size_t matches = countBits(bitmap, count);
+		if ((isAnd && matches == 0) || (!isAnd && matches == count)) {
+			return;
+		}
+
+		std::array<uint64_t, bitmapWords(batchSize)> other;
+		evaluatePredicate(*p.b, t, first, count, other.data());
+		for (size_t w = 0; w < bitmapWords(count); w++) {
+			bitmap[w] = isAnd ? bitmap[w] & other[w] : bitmap[w] | other[w];
+		}
+		return;
+	}
+
+	case predicateKind::compareKind:
+		break;
+	}
+
+	// rows that run past the end of a sealed chunk are compared a chunk at
+	// a time
+	const storage::column& col = t.columns()[p.column];
+	size_t sealed = col.sealedRows();
+	size_t chunkEnd = (first / storage::chunkRows + 1) * storage::chunkRows;
+	if (first < sealed && first + count > chunkEnd) {
+		size_t head = chunkEnd - first;
+		evaluatePredicate(p, t, first, head, bitmap);
+		std::array<uint64_t, bitmapWords(batchSize)> rest;
+		evaluatePredicate(p, t, chunkEnd, count - head, rest.data());
+		std::fill(bitmap + bitmapWords(head), bitmap + bitmapWords(count), 0);
+		for (size_t i = 0; i < count - head; i++) {
+			bitmap[(head + i) / 64] |= ((rest[i / 64] >> (i % 64)) & 1) << ((head + i) % 64);
+		}
+		return;
+	}
+
+	// a constant is compared with a sealed chunk as it is encoded
+	const storage::column& other = t.columns()[p.otherColumn];
+	bool inChunk = first < sealed;
+	if (p.type == storage::columnType::intType) {
+		if (p.constant && inChunk) {
+			compareChunkToConstant(col.intChunks[first / storage::chunkRows], first % storage::chunkRows, count, p.op,
+				p.intValue, bitmap);
+			return;
+		}
+		std::array<int64_t, batchSize> a;
+		const int64_t* values = col.readInts(first, count, a.data());
+		if (p.constant) {
+			compareIntsToConstant(values, count, p.op, p.intValue, bitmap);
+		} else {
+			std::array<int64_t, batchSize> b;
+			compareInts(values, other.readInts(first, count, b.data()), count, p.op, bitmap);
+		}
+		return;
+	}
+	if (p.constant && inChunk) {
+		compareTextChunkToConstant(col.textChunks[first / storage::chunkRows], first % storage::chunkRows, count, p.op,
+			p.textValue, bitmap);
+		return;
+	}
+
+	// other TEXT comparisons run a row at a time
+	for (size_t w = 0; w < bitmapWords(count); w++) {
+		uint64_t word = 0;
+		size_t rows = std::min<size_t>(64, count - w * 64);
+		for (size_t j = 0; j < rows; j++) {
+			size_t row = first + w * 64 + j;
+			std::string_view b = p.constant ? std::string_view(p.textValue) : other.text(row);
+			word |= static_cast<uint64_t>(compareValues(col.text(row), b, p.op)) << j;
+		}
+		bitmap[w] = word;
+	}
+}
+
+tableScan::tableScan(const storage::table& t, std::vector<size_t> columns, std::shared_ptr<const predicate> filter,
+		size_t firstRow, size_t endRow)
+	: source(t), columns(std::move(columns)), filter(std::move(filter)), row(firstRow),
+	endRow(std::min(endRow, t.rows())), buffers(this->columns.size()) {
+	for (decoded& d : buffers) {
+		d.ints.resize(batchSize);
+	}
+}
+
+bool tableScan::next(batch& out) {
+	size_t count = 0;
+	out.selection = nullptr;
+	while (true) {
+		if (row >= endRow) {
+			return false;
+		}
+		// a batch never runs past the end of a sealed chunk, so that its
+		// values are read from one chunk
+		size_t chunkEnd = (row / storage::chunkRows + 1) * storage::chunkRows;
+		count = std::min({batchSize, endRow - row, chunkEnd - row});
+		if (filter == nullptr) {
+			out.count = count;
+			break;
+		}
+		if (row / storage::chunkRows != checkedChunk) {
+			checkedChunk = row / storage::chunkRows;
+			bool skipped = !chunkMayMatch(*filter, source, checkedChunk);
+			source.countChunk(skipped);
+			if (skipped) {
+				row = std::min(endRow, chunkEnd);
+				continue;
+			}
+		}
+
+		evaluatePredicate(*filter, source, row, count, bitmap.data());
+		out.count = selectionFromBitmap(bitmap.data(), count, selection.data());
+		if (out.count == count) {
+			break;
+		}
+		if (out.count != 0) {
+			out.selection = selection.data();
+			break;
+		}
+		row += count;
+	}
+
+	out.columns.resize(columns.size());
+	if (out.selection != nullptr && out.count * sparseRatio <= count) {
+		// decoding every row for the few selected costs more than reading
+		// just those, which also drops the selection
+		uint64_t first = row;
+		const uint32_t* selected = out.selection;
+		for (size_t i = 0; i < columns.size(); i++) {
+			gatherColumn(source.columns()[columns[i]], out.count, [&](size_t j) { return first + selected[j]; },
+				buffers[i], out.columns[i]);
+		}
+		out.selection = nullptr;
+		row += count;
+		return true;
+	}
+	for (size_t i = 0; i < columns.size(); i++) {
+		const storage::column& col = source.columns()[columns[i]];
+		columnVector& v = out.columns[i];
+		decoded& d = buffers[i];
+		v.type = col.type;
+		v.constant = false;
+		if (col.type == storage::columnType::intType) {
+			v.ints = col.readInts(row, count, d.ints.data());
+		} else {
+			std::tie(v.offsets, v.chars) = col.readText(row, count, d.offsets, d.chars);
+		}
+	}
+
+	row += count;
+	return true;
+}
+
+std::vector<storage::columnType> tableScan::schema() const {
+	std::vector<storage::columnType> types;
+	types.reserve(columns.size());
+	for (size_t column : columns) {
+		types.push_back(source.columns()[column].type);
+	}
+	return types;
+}
+
+indexScan::indexScan(const storage::table& t, std::vector<size_t> columns, std::vector<uint64_t> rows,
+		std::shared_ptr<const predicate> filter)
+	: source(t), columns(std::move(columns)), rows(std::move(rows)), filter(std::move(filter)),
+	buffers(this->columns.size()) {
+	std::sort(this->rows.begin(), this->rows.end());
+}
+
+bool indexScan::next(batch& out) {
+	out.count = 0;
+	while (out.count == 0) {
+		if (position >= rows.size()) {
+			return false;
+		}
+		for (; position < rows.size() && out.count < batchSize; position++) {
+			uint64_t row = rows[position];
+			uint64_t word = 1;
+			if (filter != nullptr) {
+				evaluatePredicate(*filter, source, row, 1, &word);
+			}
+			if (word != 0) {
+				picked[out.count++] = row;
+			}
+		}
+	}
+
+	out.selection = nullptr;
+	out.columns.resize(columns.size());
+	for (size_t i = 0; i < columns.size(); i++) {
+		gatherColumn(source.columns()[columns[i]], out.count, [&](size_t j) { return picked[j]; }, buffers[i],
+			out.columns[i]);
+	}
+	return true;
+}
+
+std::vector<storage::columnType> indexScan::schema() const {
+	std::vector<storage::columnType> types;
+	types.reserve(columns.size());
+	for (size_t column : columns) {
+		types.push_back(source.columns()[column].type);
+	}
+	return types;
+}
+
+bool singleRow::next(batch& out) {
+	if (done) {
+		return false;
+	}
+	done = true;
+	out.count = 1;
+	out.columns.clear();
+	out.selection = nullptr;
+	return true;
+}
+
+projection::projection(std::unique_ptr<physicalOperator> child, std::vector<item> items)
+	: child(std::move(child)), items(std::move(items)) {
+	constantOffsets.resize(this->items.size());
+	for (size_t i = 0; i < this->items.size(); i++) {
+		constantOffsets[i] = {0, this->items[i].textValue.size()};
+	}
+}
+
+bool projection::next(batch& out) {
+	if (!child->next(input)) {
+		return false;
+	}
+
+	out.count = input.count;
+	out.selection = input.selection;
+	out.columns.resize(items.size());
+	for (size_t i = 0; i < items.size(); i++) {
+		const item& it = items[i];
+		if (!it.isConstant) {
+			out.columns[i] = input.columns[it.column];
+			continue;
+		}
+
+		columnVector& v = out.columns[i];
+		v.type = it.type;
+		v.constant = true;
+		v.ints = &it.intValue;
+		v.offsets = constantOffsets[i].data();
+		v.chars = it.textValue.data();
+	}
+	return true;
+}
+
+std::vector<storage::columnType> projection::schema() const {
+	std::vector<storage::columnType> types;
+	types.reserve(items.size());
+	for (const item& it : items) {
+		types.push_back(it.type);
+	}
+	return types;
+}
+
+void appendBatch(resultSet& result, const batch& b) {
+	for (size_t i = 0; i < b.columns.size(); i++) {
+		const columnVector& v = b.columns[i];
+		storage::column& col = result.columns[i];
+
+		if (v.type == storage::columnType::intType) {
+			if (v.constant) {
+				col.ints.append(b.count, v.ints[0]);
+			} else if (b.selection == nullptr) {
+				col.ints.append(v.ints, v.ints + b.count);
+			} else {
+				size_t start = col.ints.size();
+				col.ints.resize(start + b.count);
+				int64_t* ints = col.ints.data() + start;
+				for (size_t row = 0; row < b.count; row++) {
+					ints[row] = v.ints[b.selection[row]];
+				}
+			}
+			continue;
+		}
+
+		if (v.constant) {
+			for (size_t row = 0; row < b.count; row++) {
+				col.appendText(v.textAt(0));
+			}
+			continue;
+		}
+
+		if (b.selection != nullptr) {
+			for (size_t row = 0; row < b.count; row++) {
+				col.appendText(v.textAt(b.selection[row]));
+			}
+			continue;
+		}
+
+		// the batch's text is one contiguous range of the source buffer,
+		// copied at once; only the offsets are rebased row by row
+		uint64_t first = v.offsets[0];
+		uint64_t last = v.offsets[b.count];
+		uint64_t base = col.chars.size();
+		col.chars.append(v.chars + first, v.chars + last);
+
+		size_t start = col.offsets.size();
+		col.offsets.resize(start + b.count);
+		uint64_t* offsets = col.offsets.data() + start;
+		for (size_t row = 0; row < b.count; row++) {
+			offsets[row] = v.offsets[row + 1] - first + base;
+		}
+	}
+	result.rows += b.count;
+}
+
+bool emitBatch(const resultSet& result, size_t& position, batch& out) {
+	if (position >= result.rows) {
+		return false;
+	}
+
+	size_t count = std::min(batchSize, result.rows - position);
+	out.count = count;
+	out.selection = nullptr;
+	out.columns.resize(result.columns.size());
+	for (size_t i = 0; i < result.columns.size(); i++) {
+		const storage::column& col = result.columns[i];
+		columnVector& v = out.columns[i];
+		v.type = col.type;
+		v.constant = false;
+		if (col.type == storage::columnType::intType) {
+			v.ints = col.ints.data() + position;
+		} else {
+			v.offsets = col.offsets.data() + position;
+			v.chars = col.chars.data();
+		}
+	}
+	position += count;
+	return true;
+}
+
+bool limitRows::next(batch& out) {
+	if (left == 0 || !child->next(out)) {
+		return false;
+	}
+	out.count = std::min(out.count, left);
+	left -= out.count;
+	return true;
+}
+
+rowGather::rowGather(std::vector<const storage::table*> tables, std::shared_ptr<const std::vector<std::vector<uint64_t>>> rows,
+		std::vector<size_t> columns, size_t first, size_t end)
+	: rows(std::move(rows)), position(first) {
+	this->end = std::min(end, this->rows->empty() ? 0 : (*this->rows)[0].size());
+	for (size_t column : columns) {
+		size_t table = 0;
+		while (column >= tables[table]->columns().size()) {
+			column -= tables[table]->columns().size();
+			table++;
+		}
+		sources.push_back(source{.column = &tables[table]->columns()[column], .table = table});
+	}
+}
+
+bool rowGather::next(batch& out) {
+	if (position >= end) {
+		return false;
+	}
+
+	size_t count = std::min(batchSize, end - position);
+	out.count = count;
+	out.selection = nullptr;
+	out.columns.resize(sources.size());
+	for (size_t i = 0; i < sources.size(); i++) {
+		source& s = sources[i];
+		const uint64_t* picked = (*rows)[s.table].data() + position;
+		columnVector& v = out.columns[i];
+		v.type = s.column->type;
+		v.constant = false;
+		if (s.column->type == storage::columnType::intType) {
+			s.ints.resize(count);
+			for (size_t row = 0; row < count; row++) {
+				s.ints[row] = s.column->intAt(picked[row]);
+			}
+			v.ints = s.ints.data();
+			continue;
+		}
+
+		s.chars.clear();
+		s.offsets.resize(count + 1);
+		s.offsets[0] = 0;
+		for (size_t row = 0; row < count; row++) {
+			s.chars.append(s.column->text(picked[row]));
+			s.offsets[row + 1] = s.chars.size();
+		}
+		v.offsets = s.offsets.data();
+		v.chars = s.chars.data();
+	}
+	position += count;
+	return true;
+}
+
+std::vector<storage::columnType> rowGather::schema() const {
+	std::vector<storage::columnType> types;
+	types.reserve(sources.size());
+	for (const source& s : sources) {
+		types.push_back(s.column->type);
+	}
+	return types;
+}
+
+namespace {
+
+// joinRows finds the rows of tables that satisfy their filters and joins
+// them on the ON condition of each JOIN of stmt in turn. It returns, per
+// table, the rows the joined rows are made of.
+std::tuple<std::vector<std::vector<uint64_t>>, std::string> joinRows(const ast::SelectStatement& stmt,
+		const std::vector<const storage::table*>& tables, const std::vector<size_t>& firstColumns,
+		const std::vector<std::unique_ptr<predicate>>& filters, const std::vector<token>& parameters) {
+	std::vector<std::vector<uint64_t>> joined{rowsOf(*tables[0], filters[0].get())};
+	for (size_t k = 1; k < tables.size(); k++) {
+		const ast::joinClause& join = *(*stmt.joins)[k - 1];
+		std::vector<const storage::table*> visible(tables.begin(), tables.begin() + k + 1);
+		auto [on, err] = compilePredicate(*join.on, visible, parameters);
+		if (err != "") {
+			return {std::vector<std::vector<uint64_t>>{}, err};
+		}
+
+		// ON equates a column of the joined table with one of a table
+		// joined before it
+		bool equates = on->kind == predicateKind::compareKind && on->op == compareOp::equalOp && !on->constant &&
+			(tableOf(firstColumns, on->column) == k) != (tableOf(firstColumns, on->otherColumn) == k);
+		if (!equates) {
+			return {std::vector<std::vector<uint64_t>>{}, "JOIN " + std::string(join.table.value) +
+				" needs ON to equate one of its columns with a column of an earlier table"};
+		}
+		bool newFirst = tableOf(firstColumns, on->column) == k;
+		size_t newColumn = (newFirst ? on->column : on->otherColumn) - firstColumns[k];
+		size_t oldTable = tableOf(firstColumns, newFirst ? on->otherColumn : on->column);
+		size_t oldColumn = (newFirst ? on->otherColumn : on->column) - firstColumns[oldTable];
+
+		std::vector<uint64_t> rows = rowsOf(*tables[k], filters[k].get());
+		joinPairs pairs = radixJoin(joinEntries(*tables[oldTable], oldColumn, joined[oldTable]),
+			joinEntries(*tables[k], newColumn, rows));
+
+		// TEXT keys were matched on their hashes
+		if (on->type == storage::columnType::textType) {
+			const storage::column& a = tables[oldTable]->columns()[oldColumn];
+			const storage::column& b = tables[k]->columns()[newColumn];
+			size_t kept = 0;
+			for (size_t i = 0; i < pairs.left.size(); i++) {
+				if (a.text(joined[oldTable][pairs.left[i]]) == b.text(rows[pairs.right[i]])) {
+					pairs.left[kept] = pairs.left[i];
+					pairs.right[kept] = pairs.right[i];
+					kept++;
+				}
+			}
+			pairs.left.resize(kept);
+			pairs.right.resize(kept);
+		}
+
+		std::vector<std::vector<uint64_t>> next(k + 1, std::vector<uint64_t>(pairs.left.size()));
+		for (size_t i = 0; i < pairs.left.size(); i++) {
+			for (size_t j = 0; j < k; j++) {
+				next[j][i] = joined[j][pairs.left[i]];
+			}
+			next[k][i] = rows[pairs.right[i]];
+		}
+		joined = std::move(next);
+	}
+	return {std::move(joined), ""};
+}
+
+}
+
+std::tuple<std::unique_ptr<physicalOperator>, std::string> planSelect(const ast::SelectStatement& stmt,
+		const storage::catalog& c, const std::vector<token>& parameters) {
+	// the tables are FROM and then those joined, in order; their columns
+	// are numbered across them in the same order
+	std::vector<const storage::table*> tables;
+	std::vector<size_t> firstColumns;
+	size_t columns = 0;
+	if (!stmt.from.value.empty()) {
+		std::vector<std::string_view> names{stmt.from.value};
+		if (stmt.joins != nullptr) {
+			for (const ast::joinClause* join : *stmt.joins) {
+				names.push_back(join->table.value);
+			}
+		}
+		for (std::string_view name : names) {
+			const storage::table* t = c.find(name);
+			if (t == nullptr) {
+				return {nullptr, "Table " + std::string(name) + " does not exist"};
+			}
+			if (std::find(tables.begin(), tables.end(), t) != tables.end()) {
+				return {nullptr, "Table " + std::string(name) + " is joined more than once"};
+			}
+			tables.push_back(t);
+			firstColumns.push_back(columns);
+			columns += t->columns().size();
+		}
+	}
+	const storage::table* t = tables.empty() ? nullptr : tables[0];
+
+	std::unique_ptr<predicate> filter;
+	if (stmt.where != nullptr) {
+		auto [compiled, err] = compilePredicate(*stmt.where, tables, parameters);
+		if (err != "") {
+			return {nullptr, err};
+		}
+		filter = std::move(compiled);
+	}
+
+	bool hasLimit = stmt.limit != nullptr;
+	size_t limit = 0;
+	if (hasLimit) {
+		auto [it, err] = resolveValue(*stmt.limit, {}, parameters);
+		if (err != "" || !it.isConstant || it.type != storage::columnType::intType || it.intValue < 0) {
+			return {nullptr, "LIMIT needs a count of rows"};
+		}
+		limit = static_cast<size_t>(it.intValue);
+	}
+
+	// the scan only reads the columns the select list, GROUP BY and ORDER
+	// BY refer to, each once
+	std::vector<size_t> scanned;
+	auto scan = [&](size_t column) {
+		size_t position = 0;
+		while (position < scanned.size() && scanned[position] != column) {
+			position++;
+		}
+		if (position == scanned.size()) {
+			scanned.push_back(column);
+		}
+		return position;
+	};
+
+	// ORDER BY expressions that are not positions in the select list are
+	// planned as hidden items after it, which the sort drops
+	std::vector<const ast::expression*> itemExprs(stmt.item.begin(), stmt.item.end());
+	std::vector<sortKey> sortKeys;
+	if (stmt.orderBy != nullptr) {
+		for (const ast::orderItem* order : *stmt.orderBy) {
+			const ast::expression& expr = *order->expr;
+			if (expr.type == ast::literalType::intLiteral) {
+				if (expr.intValue < 1 || static_cast<uint64_t>(expr.intValue) > stmt.item.size()) {
+					return {nullptr, "ORDER BY position " + std::to_string(expr.intValue) + " is not in the select list"};
+				}
+				sortKeys.push_back(sortKey{.column = static_cast<size_t>(expr.intValue - 1), .descending = order->descending});
+				continue;
+			}
+			sortKeys.push_back(sortKey{.column = itemExprs.size(), .descending = order->descending});
+			itemExprs.push_back(&expr);
+		}
+	}
+
+	bool aggregating = stmt.groupBy != nullptr;
+	for (const ast::expression* expr : itemExprs) {
+		aggregating = aggregating || expr->kind == ast::expressionKind::callKind;
+	}
+
+	// keys are the scanned columns grouped on, in GROUP BY order
+	std::vector<size_t> keys;
+	if (stmt.groupBy != nullptr) {
+		for (const ast::expression* expr : *stmt.groupBy) {
+			if (expr->kind != ast::expressionKind::literalKind || expr->literal->kind != tokenKind::identifierKind) {
+				return {nullptr, "GROUP BY expressions must be columns"};
+			}
+			auto [it, err] = resolveValue(*expr, tables, parameters);
+			if (err != "") {
+				return {nullptr, err};
+			}
+			keys.push_back(scan(it.column));
+		}
+	}
+
+	// when aggregating, the items read the keys and then the aggregates
+	// of each group
+	std::vector<aggregate> aggregates;
+	std::vector<projection::item> items;
+	items.reserve(itemExprs.size());
+	for (const ast::expression* expr : itemExprs) {
+		if (expr->kind == ast::expressionKind::binaryKind) {
+			return {nullptr, "Unsupported select item " + std::string(expr->binary->op.value) + " expression"};
+		}
+
+		if (expr->kind == ast::expressionKind::callKind) {
+			auto [kind, argument, err] = resolveAggregate(*expr->call, tables, parameters);
+			if (err != "") {
+				return {nullptr, err};
+			}
+			bool keepsType = kind == aggregateKind::minKind || kind == aggregateKind::maxKind;
+			aggregates.push_back(aggregate{
+				.kind = kind,
+				.column = kind == aggregateKind::countKind ? 0 : scan(argument.column),
+			});
+			items.push_back(projection::item{
+				.isConstant = false,
+				.column = keys.size() + aggregates.size() - 1,
+				.type = keepsType ? argument.type : storage::columnType::intType,
+			});
+			continue;
+		}
+
+		auto [it, err] = resolveValue(*expr, tables, parameters);
+		if (err != "") {
+			return {nullptr, err};
+		}
+
+		if (!it.isConstant && aggregating) {
+			size_t key = 0;
+			while (key < keys.size() && scanned[keys[key]] != it.column) {
+				key++;
+			}
+			if (key == keys.size()) {
+				return {nullptr, "Column " + std::string(expr->literal->value) + " must be in GROUP BY or in an aggregate"};
+			}
+			it.column = key;
+		} else if (!it.isConstant) {
+			it.column = scan(it.column);
+		}
+		items.push_back(std::move(it));
+	}
+
+	// inputs makes the operator reading morsel part of parts of the rows
+	// the select list is computed from; only aggregation reads more than
+	// one morsel
+	bool alwaysTrue = filter == nullptr || (filter->kind == predicateKind::constantKind && filter->value);
+	hashAggregate::inputFactory inputs;
+	size_t morsels = 1;
+	if (tables.size() > 1) {
+		// each comparison of WHERE filters the rows of its table before
+		// they are joined
+		std::vector<std::unique_ptr<predicate>> filters(tables.size());
+		std::vector<std::unique_ptr<predicate>> parts;
+		if (!alwaysTrue) {
+			splitConjuncts(std::move(filter), parts);
+		}
+		for (std::unique_ptr<predicate>& part : parts) {
+			size_t owner = 0;
+			bool seen = false;
+			bool mixed = false;
+			forEachColumn(*part, [&](size_t column) {
+				size_t table = tableOf(firstColumns, column);
+				mixed = mixed || (seen && table != owner);
+				owner = table;
+				seen = true;
+			});
+			if (mixed) {
+				return {nullptr, "WHERE conditions of a join must each compare the columns of a single table"};
+			}
+			forEachColumn(*part, [&](size_t& column) { column -= firstColumns[owner]; });
+			if (filters[owner] != nullptr) {
+				part = std::make_unique<predicate>(predicate{
+					.kind = predicateKind::andKind,
+					.a = std::move(filters[owner]),
+					.b = std::move(part),
+				});
+			}
+			filters[owner] = std::move(part);
+		}
+
+		auto [rows, err] = joinRows(stmt, tables, firstColumns, filters, parameters);
+		if (err != "") {
+			return {nullptr, err};
+		}
+		auto joined = std::make_shared<const std::vector<std::vector<uint64_t>>>(std::move(rows));
+		size_t total = (*joined)[0].size();
+		morsels = std::max<size_t>(1, total / morselRows);
+		inputs = [tables, joined, scanned, total](size_t part, size_t parts) {
+			return std::make_unique<rowGather>(tables, joined, scanned, total * part / parts, total * (part + 1) / parts);
+		};
+	} else if (t == nullptr) {
+		// without a table every column reference failed above, so the
+		// filter folded into a constant
+		inputs = [alwaysTrue](size_t, size_t) { return std::make_unique<singleRow>(!alwaysTrue); };
+	} else if (std::vector<uint64_t> rows; !alwaysTrue && indexLookup(*t, *filter, t->rows() / indexScanShare, rows)) {
+		std::shared_ptr<const predicate> shared = std::move(filter);
+		inputs = [t, scanned, rows = std::move(rows), shared](size_t, size_t) {
+			return std::make_unique<indexScan>(*t, scanned, rows, shared);
+		};
+	} else {
+		std::shared_ptr<const predicate> shared = alwaysTrue ? nullptr : std::move(filter);
+		morsels = std::max<size_t>(1, t->rows() / morselRows);
+		inputs = [t, scanned, shared](size_t part, size_t parts) {
+			// parts start on chunk boundaries, so that each chunk's zone
+			// maps are checked by one scan
+			size_t chunks = (t->rows() + storage::chunkRows - 1) / storage::chunkRows;
+			size_t first = chunks * part / parts * storage::chunkRows;
+			size_t end = chunks * (part + 1) / parts * storage::chunkRows;
+			return std::make_unique<tableScan>(*t, scanned, shared, first, end);
+		};
+	}
+
+	std::unique_ptr<physicalOperator> plan;
+	if (!aggregating) {
+		plan = std::make_unique<projection>(inputs(0, 1), std::move(items));
+	} else {
+		std::vector<storage::columnType> inputSchema;
+		for (size_t column : scanned) {
+			size_t table = tableOf(firstColumns, column);
+			inputSchema.push_back(tables[table]->columns()[column - firstColumns[table]].type);
+		}
+		auto grouped = std::make_unique<hashAggregate>(std::move(inputs), std::move(inputSchema), morsels,
+			std::move(keys), std::move(aggregates));
+		plan = std::make_unique<projection>(std::move(grouped), std::move(items));
+	}
+
+	if (sortKeys.empty() && !hasLimit) {
+		return {std::move(plan), ""};
+	}
+	if (sortKeys.empty()) {
+		return {std::make_unique<limitRows>(std::move(plan), limit), ""};
+	}
+	if (hasLimit && limit <= topNLimit) {
+		return {std::make_unique<topN>(std::move(plan), std::move(sortKeys), stmt.item.size(), limit), ""};
+	}
+	plan = std::make_unique<sortRows>(std::move(plan), std::move(sortKeys), stmt.item.size());
+	if (hasLimit) {
+		plan = std::make_unique<limitRows>(std::move(plan), limit);
+	}
+	return {std::move(plan), ""};
+}
+
+std::tuple<resultSet, std::string> executeSelect(const ast::SelectStatement& stmt,
+		const storage::catalog& c, const std::vector<token>& parameters) {
+	auto [plan, err] = planSelect(stmt, c, parameters);
+	if (err != "") {
+		return {resultSet{}, err};
+	}
+
+	resultSet result;
+	std::vector<storage::columnType> types = plan->schema();
+	result.columns.reserve(types.size());
+	for (size_t i = 0; i < types.size(); i++) {
+		// aggregates are named after their call, as in sum(amount)
+		const ast::expression& item = *stmt.item[i];
+		std::string name(item.literal->value);
+		if (item.kind == ast::expressionKind::callKind) {
+			const ast::expression* argument = item.call->argument;
+			name += "(" + std::string(argument == nullptr ? "*" : argument->literal->value) + ")";
+		}
+		result.columns.push_back(storage::column{
+			.name = std::move(name),
+			.type = types[i],
+		});
+	}
+
+	batch b;
+	while (plan->next(b)) {
+		appendBatch(result, b);
+	}
+	return {std::move(result), ""};
+}
+
+}
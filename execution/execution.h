@@ -0,0 +1,285 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "../ast/ast.h"
+#include "../storage/storage.h"
+#include "filter.h"
+
+namespace execution {
+
+// batchSize is the number of rows operators pass to each other at a time:
+// large enough to spread the per-batch work thin, small enough for a
+// batch of a few columns to stay in cache
+constexpr size_t batchSize = 2048;
+static_assert(storage::chunkRows % batchSize == 0, "batches must not straddle sealed chunks");
+
+// decoded holds the values an operator decoded or gathered for the batch
+// it last emitted, one per column
+struct decoded {
+	std::vector<int64_t> ints;
+	std::vector<uint64_t> offsets;
+	std::string chars;
+};
+
+// columnVector is one column of a batch. Stored values are not copied:
+// ints and offsets point into the table column at the batch's first row,
+// or into the values of a sealed chunk, decoded when it is encoded.
+// A constant vector holds one value that stands for every row.
+struct columnVector {
+	storage::columnType type;
+	const int64_t* ints = nullptr;
+	// offsets has one more entry than the batch has rows, value i spanning
+	// chars + offsets[i] to chars + offsets[i+1]
+	const uint64_t* offsets = nullptr;
+	const char* chars = nullptr;
+	bool constant = false;
+
+	int64_t intAt(size_t row) const {
+		return ints[constant ? 0 : row];
+	}
+
+	std::string_view textAt(size_t row) const {
+		size_t i = constant ? 0 : row;
+		return std::string_view(chars + offsets[i], offsets[i+1] - offsets[i]);
+	}
+};
+
+// batch is count rows of columns. When selection is set only the rows it
+// lists are part of the batch: row i is at position selection[i] of each
+// column vector, the others having been filtered out.
+struct batch {
+	size_t count = 0;
+	std::vector<columnVector> columns;
+	const uint32_t* selection = nullptr;
+
+	size_t position(size_t row) const {
+		return selection == nullptr ? row : selection[row];
+	}
+};
+
+// physicalOperator is a step of an executable plan. next fills out with
+// the following batch and returns false once there are no rows left; the
+// batch is valid until the next call.
+class physicalOperator {
+public:
+	virtual ~physicalOperator() = default;
+	virtual bool next(batch& out) = 0;
+
+	// schema is the type of each column of the batches next produces
+	virtual std::vector<storage::columnType> schema() const = 0;
+};
+
+enum class predicateKind : uint8_t {
+	constantKind = 0,
+	compareKind,
+	andKind,
+	orKind,
+};
+
+// predicate is a WHERE clause compiled against a table. A comparison
+// reads column and compares it with otherColumn or, when against is
+// constant, with intValue or textValue.
+struct predicate {
+	predicateKind kind;
+	// value is the outcome of a constantKind predicate
+	bool value = false;
+
+	compareOp op = compareOp::equalOp;
+	storage::columnType type = storage::columnType::intType;
+	size_t column = 0;
+	bool constant = true;
+	size_t otherColumn = 0;
+	int64_t intValue = 0;
+	std::string textValue;
+
+	// the operands of andKind and orKind
+	std::unique_ptr<predicate> a;
+	std::unique_ptr<predicate> b;
+};
+
+// evaluatePredicate sets bit i of bitmap to whether row first+i of t
+// satisfies p, for count rows, count being at most batchSize
+void evaluatePredicate(const predicate& p, const storage::table& t, size_t first, size_t count, uint64_t* bitmap);
+
+// sparseRatio is how few of a window's rows a tableScan filter must keep
+// for them to be gathered: at most one in sparseRatio
+constexpr size_t sparseRatio = 16;
+
+// tableScan emits the given columns of a table batchSize rows at a time.
+// With a filter only the rows satisfying it are emitted: the filter reads
+// its columns straight from the table and the emitted batches carry a
+// selection, so filtered out rows are never copied and windows without
+// any matches are skipped. When at most one row in sparseRatio of a
+// window matches, those rows are gathered instead and the batch carries
+// no selection. A scan covers the rows from firstRow up to
+// endRow, so that several scans can share a table between threads. The
+// filter compares constants with sealed chunks as they are encoded, and
+// only the chunks of columns the scan emits are decoded. Before reading a
+// chunk a filtered scan checks the filter against the chunk's zone maps
+// and skips the chunk when they rule it out, counting the chunks it skips
+// and reads in the table's zoneStats.
+class tableScan : public physicalOperator {
+public:
+	tableScan(const storage::table& t, std::vector<size_t> columns, std::shared_ptr<const predicate> filter = nullptr,
+		size_t firstRow = 0, size_t endRow = SIZE_MAX);
+	bool next(batch& out) override;
+	std::vector<storage::columnType> schema() const override;
+
+private:
+	const storage::table& source;
+	std::vector<size_t> columns;
+	std::shared_ptr<const predicate> filter;
+	size_t row = 0;
+	size_t endRow = 0;
+	// checkedChunk is the chunk the zone maps were last checked for
+	size_t checkedChunk = SIZE_MAX;
+	std::array<uint64_t, bitmapWords(batchSize)> bitmap;
+	std::array<uint32_t, batchSize> selection;
+	std::vector<decoded> buffers;
+};
+
+// indexScan emits the given columns of the rows of a table an index
+// lookup found, in row order. The values of each batch's rows are gathered
+// into buffers of the operator; filter, the whole WHERE clause, is checked
+// again row by row, since the lookup only covers part of it.
+class indexScan : public physicalOperator {
+public:
+	indexScan(const storage::table& t, std::vector<size_t> columns, std::vector<uint64_t> rows,
+		std::shared_ptr<const predicate> filter = nullptr);
+	bool next(batch& out) override;
+	std::vector<storage::columnType> schema() const override;
+
+private:
+	const storage::table& source;
+	std::vector<size_t> columns;
+	std::vector<uint64_t> rows;
+	std::shared_ptr<const predicate> filter;
+	size_t position = 0;
+	std::array<uint64_t, batchSize> picked;
+	std::vector<decoded> buffers;
+};
+
+// rowGather emits the given columns of rows put together from several
+// tables, as a join finds them: row i is made of row rows[k][i] of each
+// tables[k]. Columns are numbered across the tables in order. Their values
+// are gathered into buffers of the operator a batch at a time. A gather
+// covers the joined rows from first up to end, which lets several gathers
+// share the rows.
+class rowGather : public physicalOperator {
+public:
+	rowGather(std::vector<const storage::table*> tables, std::shared_ptr<const std::vector<std::vector<uint64_t>>> rows,
+		std::vector<size_t> columns, size_t first = 0, size_t end = SIZE_MAX);
+	bool next(batch& out) override;
+	std::vector<storage::columnType> schema() const override;
+
+private:
+	// source is a column to emit, the table it comes from and the buffers
+	// its values are gathered into
+	struct source {
+		const storage::column* column;
+		size_t table;
+		std::vector<int64_t> ints;
+		std::vector<uint64_t> offsets;
+		std::string chars;
+	};
+
+	std::shared_ptr<const std::vector<std::vector<uint64_t>>> rows;
+	std::vector<source> sources;
+	size_t position = 0;
+	size_t end = 0;
+};
+
+// singleRow emits one row with no columns, the input of a SELECT without
+// FROM, or no rows at all when empty is set
+class singleRow : public physicalOperator {
+public:
+	explicit singleRow(bool empty = false) : done(empty) {}
+	bool next(batch& out) override;
+	std::vector<storage::columnType> schema() const override { return {}; }
+
+private:
+	bool done = false;
+};
+
+// projection reorders, repeats and drops the columns of its child's
+// batches and adds constant columns, all without touching the rows
+class projection : public physicalOperator {
+public:
+	// item is either a column of the child's batches or a constant
+	struct item {
+		bool isConstant;
+		size_t column;
+		storage::columnType type;
+		int64_t intValue;
+		std::string textValue;
+	};
+
+	projection(std::unique_ptr<physicalOperator> child, std::vector<item> items);
+	bool next(batch& out) override;
+	std::vector<storage::columnType> schema() const override;
+
+private:
+	std::unique_ptr<physicalOperator> child;
+	std::vector<item> items;
+	// constant vectors point into items and these offsets
+	std::vector<std::array<uint64_t, 2>> constantOffsets;
+	batch input;
+};
+
+// resultSet is a materialized query result, stored like a table
+struct resultSet {
+	std::vector<storage::column> columns;
+	size_t rows = 0;
+};
+
+// appendBatch appends the rows of b to result a whole vector at a time, or
+// gathers the selected rows when b has a selection
+void appendBatch(resultSet& result, const batch& b);
+
+// emitBatch fills out with views of the rows of result from position on,
+// up to batchSize of them, and advances position past them. It returns
+// false once there are none left.
+bool emitBatch(const resultSet& result, size_t& position, batch& out);
+
+// limitRows passes on the first limit rows of its child and then stops
+// pulling from it, so that the operators below do no further work
+class limitRows : public physicalOperator {
+public:
+	limitRows(std::unique_ptr<physicalOperator> child, size_t limit) : child(std::move(child)), left(limit) {}
+	bool next(batch& out) override;
+	std::vector<storage::columnType> schema() const override { return child->schema(); }
+
+private:
+	std::unique_ptr<physicalOperator> child;
+	size_t left;
+};
+
+// planSelect builds the operators that evaluate stmt against the tables
+// in c. Placeholders are resolved from parameters, $1 being parameters[0].
+// A WHERE clause whose top-level AND compares an indexed column with a
+// constant is answered with an index lookup, unless the lookup finds more
+// than one row in indexScanShare, when scanning the table is cheaper.
+// Joins filter each table by the comparisons of WHERE that read it, join
+// the rows left with a radixJoin per JOIN and gather the selected columns.
+// Aggregates and GROUP BY go to a hashAggregate, which splits its input
+// into morsels of morselRows rows. ORDER BY with a LIMIT of up to
+// topNLimit rows keeps the best rows in a topN heap; otherwise every row
+// is sorted. A LIMIT without ORDER BY stops the scan once it has enough.
+constexpr size_t indexScanShare = 8;
+constexpr size_t morselRows = size_t{1} << 16;
+constexpr size_t topNLimit = size_t{1} << 16;
+
+std::tuple<std::unique_ptr<physicalOperator>, std::string> planSelect(const ast::SelectStatement& stmt,
+	const storage::catalog& c, const std::vector<nicolassql::token>& parameters = {});
+
+// executeSelect plans stmt and runs it to completion
+std::tuple<resultSet, std::string> executeSelect(const ast::SelectStatement& stmt,
+	const storage::catalog& c, const std::vector<nicolassql::token>& parameters = {});
+
+}
@@ -0,0 +1,595 @@
+#include <benchmark/benchmark.h>
+#include "execution.h"
+#include "aggregate.h"
+#include "join.h"
+#include "sort.h"
+#include "../parser/parser.h"
+#include "../parser/prepare.h"
+#include "../lexer/scan.h"
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+
+using namespace execution;
+
+// eventsCatalog holds one table of rows rows, filled through the storage
+// API directly so setup does not dominate
+static std::unique_ptr<storage::catalog> eventsCatalog(size_t rows) {
+    auto c = std::make_unique<storage::catalog>();
+    auto [a, err] = parser::Parse("CREATE TABLE events (id INT, kind TEXT, score INT, note TEXT)");
+    auto [t, createErr] = c->createTable(*a->Statements[0]->CreateTableStatement);
+
+    std::mt19937 rng(5);
+    auto& cols = t->columns();
+    for (size_t i = 0; i < rows; i++) {
+        cols[0].appendInt(static_cast<int64_t>(i));
+        cols[1].appendText(i % 3 == 0 ? "click" : "view");
+        cols[2].appendInt(rng() % 1000);
+        cols[3].appendText("note " + std::to_string(rng() % 100000));
+    }
+    t->commitAppends();
+    return c;
+}
+
+static const char* projectionQuery = "SELECT note, id, score, kind FROM events";
+
+static void BM_ProjectVectorized(benchmark::State& state) {
+    size_t rows = static_cast<size_t>(state.range(0));
+    auto c = eventsCatalog(rows);
+    auto [a, err] = parser::Parse(projectionQuery);
+    for (auto _ : state) {
+        auto [result, execErr] = executeSelect(*a->Statements[0]->SelectStatement, *c);
+        if (!execErr.empty()) {
+            state.SkipWithError(execErr.c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(result.rows);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+}
+
+// the row-at-a-time baseline: a classic iterator that produces one row of
+// tagged values per virtual call, projected and appended value by value
+
+struct rowValue {
+    storage::columnType type;
+    int64_t intValue;
+    std::string_view textValue;
+};
+
+class rowOperator {
+public:
+    virtual ~rowOperator() = default;
+    virtual bool next(std::vector<rowValue>& row) = 0;
+};
+
+class rowScan : public rowOperator {
+public:
+    explicit rowScan(const storage::table& t) : source(t) {}
+
+    bool next(std::vector<rowValue>& row) override {
+        if (position >= source.rows()) {
+            return false;
+        }
+        row.clear();
+        for (const storage::column& col : source.columns()) {
+            if (col.type == storage::columnType::intType) {
+                row.push_back(rowValue{.type = col.type, .intValue = col.intAt(position)});
+            } else {
+                row.push_back(rowValue{.type = col.type, .textValue = col.text(position)});
+            }
+        }
+        position++;
+        return true;
+    }
+
+private:
+    const storage::table& source;
+    size_t position = 0;
+};
+
+class rowProjection : public rowOperator {
+public:
+    rowProjection(std::unique_ptr<rowOperator> child, std::vector<size_t> columns)
+        : child(std::move(child)), columns(std::move(columns)) {}
+
+    bool next(std::vector<rowValue>& row) override {
+        if (!child->next(input)) {
+            return false;
+        }
+        row.clear();
+        for (size_t column : columns) {
+            row.push_back(input[column]);
+        }
+        return true;
+    }
+
+private:
+    std::unique_ptr<rowOperator> child;
+    std::vector<size_t> columns;
+    std::vector<rowValue> input;
+};
+
+static void BM_ProjectRowAtATime(benchmark::State& state) {
+    size_t rows = static_cast<size_t>(state.range(0));
+    auto c = eventsCatalog(rows);
+    const storage::table& events = *c->find("events");
+    for (auto _ : state) {
+        rowProjection plan(std::make_unique<rowScan>(events), {3, 0, 2, 1});
+        resultSet result;
+        for (size_t column : {3, 0, 2, 1}) {
+            result.columns.push_back(storage::column{.type = events.columns()[column].type});
+        }
+
+        std::vector<rowValue> row;
+        while (plan.next(row)) {
+            for (size_t i = 0; i < row.size(); i++) {
+                if (row[i].type == storage::columnType::intType) {
+                    result.columns[i].appendInt(row[i].intValue);
+                } else {
+                    result.columns[i].appendText(row[i].textValue);
+                }
+            }
+            result.rows++;
+        }
+        benchmark::DoNotOptimize(result.rows);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+}
+
+// filterRows is big enough that the filtered column does not fit in any
+// cache, so a scan keeping up with memory shows the bandwidth
+static constexpr size_t filterRows = 16 << 20;
+
+// readingsCatalog holds readings(id INT, value INT) with value uniform in
+// [0, 1000), so WHERE value < n keeps n per mille of the rows
+static const storage::catalog& readingsCatalog() {
+    static std::unique_ptr<storage::catalog> c = [] {
+        auto c = std::make_unique<storage::catalog>();
+        auto [a, err] = parser::Parse("CREATE TABLE readings (id INT, value INT)");
+        auto [t, createErr] = c->createTable(*a->Statements[0]->CreateTableStatement);
+        t->reserve(filterRows);
+        std::mt19937 rng(9);
+        auto& cols = t->columns();
+        for (size_t i = 0; i < filterRows; i++) {
+            cols[0].appendInt(static_cast<int64_t>(i));
+            cols[1].appendInt(rng() % 1000);
+        }
+        t->commitAppends();
+        return c;
+    }();
+    return *c;
+}
+
+// BM_Filter runs SELECT id ... WHERE value < n at the scan level given by
+// its second argument; bytes/s counts the filtered column only
+static void BM_Filter(benchmark::State& state) {
+    const storage::catalog& c = readingsCatalog();
+    auto level = static_cast<nicolassql::scanLevel>(state.range(1));
+    if (level > nicolassql::bestScanLevel()) {
+        state.SkipWithError("scan level not supported by this CPU");
+        return;
+    }
+    nicolassql::setScanLevel(level);
+
+    auto [a, err] = parser::Parse("SELECT id FROM readings WHERE value < " + std::to_string(state.range(0)));
+    size_t matches = 0;
+    for (auto _ : state) {
+        auto [result, execErr] = executeSelect(*a->Statements[0]->SelectStatement, c);
+        if (!execErr.empty()) {
+            state.SkipWithError(execErr.c_str());
+            break;
+        }
+        matches = result.rows;
+    }
+    nicolassql::setScanLevel(nicolassql::bestScanLevel());
+
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(filterRows * sizeof(int64_t)));
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(filterRows));
+    state.counters["selectivity"] = static_cast<double>(matches) / filterRows;
+}
+
+// BM_SumColumn reads the same column once with nothing else to do, the
+// memory bandwidth the filter is measured against. The column is copied
+// out of its sealed chunks first, so the sum reads plain values.
+static void BM_SumColumn(benchmark::State& state) {
+    const storage::table& t = *readingsCatalog().find("readings");
+    std::vector<int64_t> values(t.rows());
+    for (size_t row = 0; row < t.rows(); row++) {
+        values[row] = t.columns()[1].intAt(row);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(std::accumulate(values.begin(), values.end(), int64_t{0}));
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(values.size() * sizeof(int64_t)));
+}
+
+static constexpr size_t lookupRows = 1 << 20;
+
+// accountsCatalog holds accounts(id INT, balance INT) with the ids
+// shuffled, indexed on id when indexed is set
+static const storage::catalog& accountsCatalog(bool indexed) {
+    static std::unique_ptr<storage::catalog> catalogs[2];
+    std::unique_ptr<storage::catalog>& c = catalogs[indexed];
+    if (c == nullptr) {
+        c = std::make_unique<storage::catalog>();
+        auto [a, err] = parser::Parse("CREATE TABLE accounts (id INT, balance INT); CREATE INDEX by_id ON accounts (id)");
+        auto [t, createErr] = c->createTable(*a->Statements[0]->CreateTableStatement);
+        t->reserve(lookupRows);
+        auto& cols = t->columns();
+        for (size_t i = 0; i < lookupRows; i++) {
+            cols[0].appendInt(static_cast<int64_t>(i * 7919 % lookupRows));
+            cols[1].appendInt(static_cast<int64_t>(i));
+        }
+        t->commitAppends();
+        if (indexed) {
+            c->createIndex(*a->Statements[1]->CreateIndexStatement);
+        }
+    }
+    return *c;
+}
+
+// BM_PointLookup runs SELECT ... WHERE id = $1 for random ids, answered by
+// the index on id when the argument is set and by a full scan otherwise
+static void BM_PointLookup(benchmark::State& state) {
+    const storage::catalog& c = accountsCatalog(state.range(0) != 0);
+    auto [prepared, err] = parser::prepare("SELECT id, balance FROM accounts WHERE id = ?");
+    std::mt19937 rng(3);
+    std::string id;
+    for (auto _ : state) {
+        id = std::to_string(rng() % lookupRows);
+        auto [bound, bindErr] = parser::bind(prepared, {parser::numericParameter(id)});
+        auto [result, execErr] = executeSelect(*bound.statement().SelectStatement, c, bound.parameters);
+        if (!execErr.empty() || result.rows != 1) {
+            state.SkipWithError(execErr.empty() ? "expected one row" : execErr.c_str());
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// BM_RadixJoin joins build_rows unique keys with probe_rows keys drawn
+// from them, the shape of a foreign key join, on the given threads. With
+// partitioned unset a single hash table holds the whole build side.
+static void BM_RadixJoin(benchmark::State& state) {
+    size_t buildRows = static_cast<size_t>(state.range(0));
+    size_t probeRows = static_cast<size_t>(state.range(1));
+    joinOptions opts{.threads = static_cast<size_t>(state.range(2))};
+    if (state.range(3) == 0) {
+        opts.cacheBytes = SIZE_MAX;
+    }
+
+    std::mt19937_64 rng(13);
+    std::vector<joinEntry> build(buildRows);
+    for (size_t i = 0; i < buildRows; i++) {
+        build[i] = joinEntry{.key = i * 0x9e3779b97f4a7c15ULL, .row = i};
+    }
+    std::vector<joinEntry> probe(probeRows);
+    for (size_t i = 0; i < probeRows; i++) {
+        probe[i] = joinEntry{.key = build[rng() % buildRows].key, .row = i};
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<joinEntry> left = build;
+        std::vector<joinEntry> right = probe;
+        state.ResumeTiming();
+        joinPairs pairs = radixJoin(std::move(left), std::move(right), opts);
+        if (pairs.left.size() != probeRows) {
+            state.SkipWithError("every probe row should match once");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(buildRows + probeRows));
+}
+
+// BM_JoinQuery runs a foreign key join through SQL: orders, ten times the
+// rows of users, each refer to one user
+static void BM_JoinQuery(benchmark::State& state) {
+    size_t users = static_cast<size_t>(state.range(0));
+    size_t orders = users * 10;
+    storage::catalog c;
+    auto [a, err] = parser::Parse("CREATE TABLE users (id INT, name TEXT); CREATE TABLE orders (user_id INT, amount INT);"
+                                  "SELECT name, amount FROM orders JOIN users ON user_id = users.id WHERE amount < 100");
+    auto [u, usersErr] = c.createTable(*a->Statements[0]->CreateTableStatement);
+    auto [o, ordersErr] = c.createTable(*a->Statements[1]->CreateTableStatement);
+    std::mt19937 rng(17);
+    for (size_t i = 0; i < users; i++) {
+        u->columns()[0].appendInt(static_cast<int64_t>(i));
+        u->columns()[1].appendText("user " + std::to_string(i));
+    }
+    for (size_t i = 0; i < orders; i++) {
+        o->columns()[0].appendInt(static_cast<int64_t>(rng() % users));
+        o->columns()[1].appendInt(rng() % 1000);
+    }
+    u->commitAppends();
+    o->commitAppends();
+
+    for (auto _ : state) {
+        auto [result, execErr] = executeSelect(*a->Statements[2]->SelectStatement, c);
+        if (!execErr.empty()) {
+            state.SkipWithError(execErr.c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(result.rows);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(users + orders));
+}
+
+// BM_HashAggregate runs COUNT, SUM and MAX over 16M rows grouped on keys
+// drawn from groups distinct values, on threads threads
+static void BM_HashAggregate(benchmark::State& state) {
+    size_t rows = 16 << 20;
+    size_t groups = static_cast<size_t>(state.range(0));
+    size_t threads = static_cast<size_t>(state.range(1));
+    // each group count gets a table of its own, built once, whose rows only
+    // differ from those of the others in how far their keys are folded
+    static storage::catalog c;
+    static std::map<size_t, storage::table*> tables;
+    storage::table*& t = tables[groups];
+    if (t == nullptr) {
+        auto [a, err] = parser::Parse("CREATE TABLE sales_" + std::to_string(groups) + " (store INT, amount INT);");
+        t = std::get<0>(c.createTable(*a->Statements[0]->CreateTableStatement));
+        std::mt19937_64 rng(19);
+        for (size_t i = 0; i < rows; i++) {
+            t->columns()[0].appendInt(static_cast<int64_t>((rng() >> 1) % groups));
+            t->columns()[1].appendInt(static_cast<int64_t>(rng() % 1000));
+        }
+        t->commitAppends();
+    }
+
+    size_t morsels = rows / morselRows;
+    auto input = [&](size_t part, size_t parts) {
+        return std::make_unique<tableScan>(*t, std::vector<size_t>{0, 1}, nullptr, rows * part / parts,
+            rows * (part + 1) / parts);
+    };
+    std::vector<aggregate> aggregates = {{aggregateKind::countKind}, {aggregateKind::sumKind, 1}, {aggregateKind::maxKind, 1}};
+    for (auto _ : state) {
+        hashAggregate agg(input, {storage::columnType::intType, storage::columnType::intType}, morsels, {0}, aggregates,
+            threads);
+        size_t found = 0;
+        batch b;
+        while (agg.next(b)) {
+            found += b.count;
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+}
+
+// BM_GroupByQuery runs a grouped aggregate through SQL over 4M orders of
+// customers distinct customers
+static void BM_GroupByQuery(benchmark::State& state) {
+    size_t customers = static_cast<size_t>(state.range(0));
+    size_t orders = 4 << 20;
+    storage::catalog c;
+    auto [a, err] = parser::Parse("CREATE TABLE orders (customer INT, amount INT);"
+                                  "SELECT customer, COUNT(*), SUM(amount), AVG(amount) FROM orders GROUP BY customer");
+    auto [o, createErr] = c.createTable(*a->Statements[0]->CreateTableStatement);
+    std::mt19937 rng(23);
+    for (size_t i = 0; i < orders; i++) {
+        o->columns()[0].appendInt(static_cast<int64_t>(rng() % customers));
+        o->columns()[1].appendInt(rng() % 1000);
+    }
+    o->commitAppends();
+
+    for (auto _ : state) {
+        auto [result, execErr] = executeSelect(*a->Statements[1]->SelectStatement, c);
+        if (!execErr.empty()) {
+            state.SkipWithError(execErr.c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(result.rows);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(orders));
+}
+
+// BM_RadixSort sorts 16M random keys with radixSort on threads threads,
+// or with std::stable_sort when threads is 0
+static void BM_RadixSort(benchmark::State& state) {
+    size_t rows = 16 << 20;
+    size_t threads = static_cast<size_t>(state.range(0));
+    std::mt19937_64 rng(37);
+    std::vector<sortEntry> entries(rows);
+    for (size_t i = 0; i < rows; i++) {
+        entries[i] = sortEntry{.key = rng(), .row = i};
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<sortEntry> sorted = entries;
+        state.ResumeTiming();
+        if (threads == 0) {
+            std::stable_sort(sorted.begin(), sorted.end(), [](const sortEntry& a, const sortEntry& b) { return a.key < b.key; });
+        } else {
+            radixSort(sorted, threads);
+        }
+        benchmark::DoNotOptimize(sorted.data());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+}
+
+// ordersCatalog holds 4M orders with a random INT amount and a TEXT
+// customer name
+static const storage::catalog& ordersCatalog() {
+    static storage::catalog c;
+    if (c.size() == 0) {
+        auto [a, err] = parser::Parse("CREATE TABLE orders (id INT, amount INT, customer TEXT);");
+        auto [t, createErr] = c.createTable(*a->Statements[0]->CreateTableStatement);
+        std::mt19937 rng(41);
+        for (size_t i = 0; i < (4 << 20); i++) {
+            t->columns()[0].appendInt(static_cast<int64_t>(i));
+            t->columns()[1].appendInt(rng() % 1000000);
+            t->columns()[2].appendText("customer " + std::to_string(rng() % 100000));
+        }
+        t->commitAppends();
+    }
+    return c;
+}
+
+// BM_OrderBy runs query over ordersCatalog: a top 50 through the heap or
+// through a full sort, full sorts on INT and TEXT keys, and LIMIT alone
+static void BM_OrderBy(benchmark::State& state) {
+    const char* queries[] = {
+        "SELECT id, amount FROM orders ORDER BY amount DESC LIMIT 50",
+        "SELECT id, amount FROM orders ORDER BY amount DESC LIMIT 100000",
+        "SELECT id, amount FROM orders ORDER BY amount",
+        "SELECT id, customer FROM orders ORDER BY customer, id",
+        "SELECT id, amount FROM orders LIMIT 50",
+        "SELECT id, customer FROM orders",
+        "SELECT id, customer FROM orders ORDER BY customer",
+    };
+    const storage::catalog& c = ordersCatalog();
+    auto [a, err] = parser::Parse(queries[state.range(0)]);
+    for (auto _ : state) {
+        auto [result, execErr] = executeSelect(*a->Statements[0]->SelectStatement, c);
+        if (!execErr.empty()) {
+            state.SkipWithError(execErr.c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(result.rows);
+    }
+    state.SetLabel(queries[state.range(0)]);
+}
+
+static constexpr size_t eventRows = 8 << 20;
+
+// encodedEventsCatalog holds events(id INT, value INT, status INT, kind TEXT):
+// ids in order, values below 1000, statuses in runs of about 10000 rows
+// and one of four kinds per row. The columns are sealed into encoded
+// chunks when sealed is set and kept plain, as columns never sealed are,
+// when it is not.
+static const storage::catalog& encodedEventsCatalog(bool sealed) {
+    static std::unique_ptr<storage::catalog> catalogs[2];
+    std::unique_ptr<storage::catalog>& c = catalogs[sealed];
+    if (c == nullptr) {
+        std::vector<storage::column> columns = {
+            {.name = "id", .type = storage::columnType::intType},
+            {.name = "value", .type = storage::columnType::intType},
+            {.name = "status", .type = storage::columnType::intType},
+            {.name = "kind", .type = storage::columnType::textType},
+        };
+        const char* kinds[] = {"view", "click", "scroll", "purchase"};
+        std::mt19937_64 rng(23);
+        int64_t status = 0;
+        for (size_t i = 0; i < eventRows; i++) {
+            if (rng() % 10000 == 0) {
+                status = static_cast<int64_t>(rng() % 16);
+            }
+            columns[0].appendInt(static_cast<int64_t>(i));
+            columns[1].appendInt(static_cast<int64_t>(rng() % 1000));
+            columns[2].appendInt(status);
+            columns[3].appendText(kinds[rng() % 4]);
+        }
+
+        c = std::make_unique<storage::catalog>();
+        if (!sealed) {
+            c->add(std::make_unique<storage::table>("events", std::move(columns), eventRows, 0, nullptr));
+            return *c;
+        }
+        auto [a, err] = parser::Parse("CREATE TABLE events (id INT, value INT, status INT, kind TEXT)");
+        auto [t, createErr] = c->createTable(*a->Statements[0]->CreateTableStatement);
+        t->columns() = std::move(columns);
+        t->commitAppends();
+    }
+    return *c;
+}
+
+// BM_EncodedScan runs a query over events stored plain or sealed; bytes/row
+// is what the table takes up per row
+static void BM_EncodedScan(benchmark::State& state) {
+    static const char* queries[] = {
+        "SELECT COUNT(*) FROM events WHERE value < 10",
+        "SELECT COUNT(*) FROM events WHERE status = 7",
+        "SELECT COUNT(*) FROM events WHERE kind = 'purchase'",
+        "SELECT id FROM events WHERE kind = 'purchase' AND value < 10",
+        "SELECT SUM(value), MAX(id) FROM events",
+    };
+    const storage::catalog& c = encodedEventsCatalog(state.range(0) != 0);
+    auto [a, err] = parser::Parse(queries[state.range(1)]);
+    for (auto _ : state) {
+        auto [result, execErr] = executeSelect(*a->Statements[0]->SelectStatement, c);
+        if (!execErr.empty()) {
+            state.SkipWithError(execErr.c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(result.rows);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(eventRows));
+    state.counters["bytes/row"] = static_cast<double>(c.find("events")->bytes()) / eventRows;
+    state.SetLabel(queries[state.range(1)]);
+}
+
+// BM_RangeScan runs range queries over the sealed events, whose ids rise
+// with the row like times do; chunks_skipped and chunks_read are what the
+// zone maps let each query skip and make it read
+static void BM_RangeScan(benchmark::State& state) {
+    static const char* queries[] = {
+        "SELECT COUNT(*), SUM(value) FROM events WHERE id >= 4000000 AND id < 4010000",
+        "SELECT COUNT(*), SUM(value) FROM events WHERE id >= 4000000 AND id < 4800000",
+        "SELECT id, value FROM events WHERE id < 1000 OR id > 8387000",
+        "SELECT COUNT(*), SUM(value) FROM events WHERE value < 10",
+    };
+    const storage::catalog& c = encodedEventsCatalog(true);
+    const storage::table& t = *c.find("events");
+    auto [a, err] = parser::Parse(queries[state.range(0)]);
+    storage::zoneStats before = t.zones();
+    for (auto _ : state) {
+        auto [result, execErr] = executeSelect(*a->Statements[0]->SelectStatement, c);
+        if (!execErr.empty()) {
+            state.SkipWithError(execErr.c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(result.rows);
+    }
+    storage::zoneStats after = t.zones();
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(eventRows));
+    state.counters["chunks_skipped"] = benchmark::Counter(static_cast<double>(after.chunksSkipped - before.chunksSkipped),
+        benchmark::Counter::kAvgIterations);
+    state.counters["chunks_read"] = benchmark::Counter(static_cast<double>(after.chunksRead - before.chunksRead),
+        benchmark::Counter::kAvgIterations);
+    state.SetLabel(queries[state.range(0)]);
+}
+
+static void filterArgs(benchmark::internal::Benchmark* b) {
+    for (int64_t perMille : {1, 100, 500, 990}) {
+        for (auto level : {nicolassql::scanLevel::scalarLevel, nicolassql::scanLevel::sse2Level,
+                nicolassql::scanLevel::avx2Level}) {
+            b->Args({perMille, static_cast<int64_t>(level)});
+        }
+    }
+    b->ArgNames({"per_mille", "level"});
+    b->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK(BM_ProjectVectorized)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ProjectRowAtATime)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Filter)->Apply(filterArgs);
+BENCHMARK(BM_SumColumn)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_PointLookup)->ArgName("indexed")->Arg(0)->Arg(1);
+// the 10M x 100M join needs about 5 GB of memory
+BENCHMARK(BM_RadixJoin)
+    ->ArgNames({"build_rows", "probe_rows", "threads", "partitioned"})
+    ->Args({1 << 20, 10 << 20, 1, 0})
+    ->Args({1 << 20, 10 << 20, 1, 1})
+    ->Args({1 << 20, 10 << 20, 4, 1})
+    ->Args({10 << 20, 100 << 20, 0, 1})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_JoinQuery)->ArgName("users")->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_HashAggregate)
+    ->ArgNames({"groups", "threads"})
+    ->ArgsProduct({{16, 1 << 20}, {1, 2, 4}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_RadixSort)->ArgName("threads")->Arg(0)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_OrderBy)->ArgName("query")->DenseRange(0, 6)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EncodedScan)
+    ->ArgNames({"sealed", "query"})
+    ->ArgsProduct({{0, 1}, {0, 1, 2, 3, 4}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RangeScan)->ArgName("query")->DenseRange(0, 3)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_GroupByQuery)->ArgName("customers")->Arg(16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
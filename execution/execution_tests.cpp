@@ -0,0 +1,875 @@
+#include <gtest/gtest.h>
+#include "execution.h"
+#include "aggregate.h"
+#include "join.h"
+#include "sort.h"
+#include "../parser/parser.h"
+#include "../parser/prepare.h"
+#include "../lexer/scan.h"
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <random>
+
+using namespace execution;
+using namespace nicolassql;
+
+// load runs the CREATE TABLE, CREATE INDEX and INSERT statements of
+// script against c
+static void load(storage::catalog& c, const std::string& script) {
+    auto [a, err] = parser::Parse(script);
+    ASSERT_TRUE(err.empty()) << err;
+    for (auto* stmt : a->Statements) {
+        if (stmt->Kind == ast::AstKind::CreateTableKind) {
+            ASSERT_EQ(std::get<1>(c.createTable(*stmt->CreateTableStatement)), "");
+        } else if (stmt->Kind == ast::AstKind::CreateIndexKind) {
+            ASSERT_EQ(std::get<1>(c.createIndex(*stmt->CreateIndexStatement)), "");
+        } else {
+            ASSERT_EQ(c.insert(*stmt->InsertStatement), "");
+        }
+    }
+}
+
+// rows renders the rows of a result as sorted lines, to compare them
+// regardless of order
+static std::vector<std::string> rows(const resultSet& result) {
+    std::vector<std::string> lines;
+    for (size_t row = 0; row < result.rows; row++) {
+        std::string line;
+        for (const storage::column& col : result.columns) {
+            line += col.type == storage::columnType::intType ? std::to_string(col.ints[row])
+                                                             : std::string(col.text(row));
+            line += "|";
+        }
+        lines.push_back(line);
+    }
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+static std::tuple<resultSet, std::string> select(const storage::catalog& c, const std::string& query,
+        const std::vector<token>& parameters = {}) {
+    auto [a, err] = parser::Parse(query);
+    if (!err.empty()) {
+        return {resultSet{}, err};
+    }
+    return executeSelect(*a->Statements[0]->SelectStatement, c, parameters);
+}
+
+TEST(ExecutionTest, ProjectsColumnsAcrossBatches) {
+    storage::catalog c;
+    std::string script = "CREATE TABLE users (id INT, name TEXT, age INT);";
+    size_t rows = batchSize * 2 + 17;
+    for (size_t i = 0; i < rows; i++) {
+        script += "INSERT INTO users VALUES (" + std::to_string(i) + ", 'user " + std::to_string(i) + "', " +
+            std::to_string(i % 90) + ");";
+    }
+    load(c, script);
+
+    auto [result, err] = select(c, "SELECT name, id, name, 7, 'it''s' FROM users");
+    ASSERT_TRUE(err.empty()) << err;
+    ASSERT_EQ(result.rows, rows);
+    ASSERT_EQ(result.columns.size(), 5u);
+    EXPECT_EQ(result.columns[0].name, "name");
+    EXPECT_EQ(result.columns[0].type, storage::columnType::textType);
+    EXPECT_EQ(result.columns[1].type, storage::columnType::intType);
+    EXPECT_EQ(result.columns[3].type, storage::columnType::intType);
+    EXPECT_EQ(result.columns[4].type, storage::columnType::textType);
+
+    for (size_t i = 0; i < rows; i++) {
+        ASSERT_EQ(result.columns[0].text(i), "user " + std::to_string(i)) << "row=" << i;
+        ASSERT_EQ(result.columns[1].ints[i], static_cast<int64_t>(i)) << "row=" << i;
+        ASSERT_EQ(result.columns[2].text(i), result.columns[0].text(i)) << "row=" << i;
+        ASSERT_EQ(result.columns[3].ints[i], 7) << "row=" << i;
+        ASSERT_EQ(result.columns[4].text(i), "it's") << "row=" << i;
+    }
+}
+
+TEST(ExecutionTest, SelectWithoutFromAndEmptyTables) {
+    storage::catalog c;
+    load(c, "CREATE TABLE empty (id INT)");
+
+    auto [constants, err] = select(c, "SELECT 1, 'one'");
+    ASSERT_TRUE(err.empty()) << err;
+    ASSERT_EQ(constants.rows, 1u);
+    EXPECT_EQ(constants.columns[0].ints[0], 1);
+    EXPECT_EQ(constants.columns[1].text(0), "one");
+
+    auto [none, err2] = select(c, "SELECT id FROM empty");
+    ASSERT_TRUE(err2.empty()) << err2;
+    EXPECT_EQ(none.rows, 0u);
+    ASSERT_EQ(none.columns.size(), 1u);
+    EXPECT_EQ(none.columns[0].type, storage::columnType::intType);
+}
+
+TEST(ExecutionTest, ResolvesParametersAndReportsErrors) {
+    storage::catalog c;
+    load(c, "CREATE TABLE users (id INT); INSERT INTO users VALUES (5)");
+
+    auto [prepared, err] = parser::prepare("SELECT id, ? FROM users");
+    ASSERT_TRUE(err.empty()) << err;
+    auto [bound, bindErr] = parser::bind(prepared, {parser::stringParameter("tag")});
+    ASSERT_TRUE(bindErr.empty()) << bindErr;
+    auto [result, execErr] = executeSelect(*bound.statement().SelectStatement, c, bound.parameters);
+    ASSERT_TRUE(execErr.empty()) << execErr;
+    EXPECT_EQ(result.columns[1].text(0), "tag");
+
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id FROM nobody")), "Table nobody does not exist");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT name FROM users")), "Column name does not exist in table users");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id")), "Column id needs a FROM table");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT 1.5 FROM users")), "Only INT numbers are supported, got 1.5");
+}
+
+TEST(FilterTest, KernelsAgreeAtEveryScanLevel) {
+    std::mt19937 rng(7);
+    std::vector<int64_t> a(1000), b(1000);
+    for (size_t i = 0; i < a.size(); i++) {
+        a[i] = static_cast<int64_t>(rng() % 21) - 10;
+        b[i] = static_cast<int64_t>(rng() % 21) - 10;
+    }
+    a[3] = INT64_MIN;
+    b[4] = INT64_MAX;
+
+    std::vector<compareOp> ops = {compareOp::equalOp, compareOp::notEqualOp, compareOp::lessOp,
+        compareOp::lessEqualOp, compareOp::greaterOp, compareOp::greaterEqualOp};
+    auto holds = [](int64_t x, int64_t y, compareOp op) {
+        switch (op) {
+        case compareOp::equalOp: return x == y;
+        case compareOp::notEqualOp: return x != y;
+        case compareOp::lessOp: return x < y;
+        case compareOp::lessEqualOp: return x <= y;
+        case compareOp::greaterOp: return x > y;
+        case compareOp::greaterEqualOp: return x >= y;
+        }
+        return false;
+    };
+
+    for (unsigned int level = 0; level <= static_cast<unsigned int>(bestScanLevel()); level++) {
+        setScanLevel(static_cast<scanLevel>(level));
+        for (compareOp op : ops) {
+            // counts that end inside a vector, a word and a batch
+            for (size_t count : {0, 1, 3, 64, 65, 130, 1000}) {
+                std::vector<uint64_t> toConstant(bitmapWords(count) + 1, ~uint64_t{0});
+                std::vector<uint64_t> toColumn(bitmapWords(count) + 1, ~uint64_t{0});
+                compareIntsToConstant(a.data(), count, op, 2, toConstant.data());
+                compareInts(a.data(), b.data(), count, op, toColumn.data());
+
+                std::vector<uint32_t> selection(count);
+                size_t selected = selectionFromBitmap(toConstant.data(), count, selection.data());
+                size_t expected = 0;
+                for (size_t i = 0; i < count; i++) {
+                    bool bit = (toConstant[i / 64] >> (i % 64)) & 1;
+                    ASSERT_EQ(holds(a[i], 2, op), bit) << "level=" << level << " count=" << count << " i=" << i;
+                    bit = (toColumn[i / 64] >> (i % 64)) & 1;
+                    ASSERT_EQ(holds(a[i], b[i], op), bit) << "level=" << level << " count=" << count << " i=" << i;
+                    if (holds(a[i], 2, op)) {
+                        ASSERT_EQ(selection[expected++], i);
+                    }
+                }
+                EXPECT_EQ(selected, expected);
+                // the kernels never write past the bitmap of count rows
+                EXPECT_EQ(toConstant.back(), ~uint64_t{0});
+            }
+        }
+    }
+    setScanLevel(bestScanLevel());
+}
+
+TEST(ExecutionTest, FiltersRowsWithWhere) {
+    storage::catalog c;
+    std::string script = "CREATE TABLE users (id INT, name TEXT, age INT);";
+    size_t rows = batchSize * 3 + 5;
+    for (size_t i = 0; i < rows; i++) {
+        script += "INSERT INTO users VALUES (" + std::to_string(i) + ", 'user " + std::to_string(i % 7) + "', " +
+            std::to_string(i % 90) + ");";
+    }
+    load(c, script);
+
+    struct Test { std::string where; std::function<bool(size_t)> keep; };
+    std::vector<Test> tests = {
+        {"id < 10", [](size_t i) { return i < 10; }},
+        {"10 > id", [](size_t i) { return i < 10; }},
+        {"id >= 5000 AND age <> 3", [](size_t i) { return i >= 5000 && i % 90 != 3; }},
+        {"age = 1 OR id <= 2 OR id = 6000", [](size_t i) { return i % 90 == 1 || i <= 2 || i == 6000; }},
+        {"(age = 1 OR age = 2) AND name = 'user 3'", [](size_t i) { return (i % 90 == 1 || i % 90 == 2) && i % 7 == 3; }},
+        {"name > 'user 4' AND id != age", [](size_t i) { return i % 7 > 4 && i != i % 90; }},
+        {"age < id", [](size_t i) { return i % 90 < i; }},
+        {"1 = 1 AND id = 3", [](size_t i) { return i == 3; }},
+        {"1 = 2 OR id = 4", [](size_t i) { return i == 4; }},
+        {"'a' = 'b' AND id > 0", [](size_t) { return false; }},
+        {"id > 100000", [](size_t) { return false; }},
+    };
+
+    for (unsigned int level = 0; level <= static_cast<unsigned int>(bestScanLevel()); level++) {
+        setScanLevel(static_cast<scanLevel>(level));
+        for (auto& t : tests) {
+            auto [result, err] = select(c, "SELECT id, name, 1 FROM users WHERE " + t.where);
+            ASSERT_TRUE(err.empty()) << err << " where=" << t.where;
+
+            std::vector<int64_t> expected;
+            for (size_t i = 0; i < rows; i++) {
+                if (t.keep(i)) {
+                    expected.push_back(static_cast<int64_t>(i));
+                }
+            }
+            ASSERT_EQ(result.rows, expected.size()) << "level=" << level << " where=" << t.where;
+            EXPECT_EQ(result.columns[0].ints, expected) << "level=" << level << " where=" << t.where;
+            for (size_t i = 0; i < result.rows; i++) {
+                ASSERT_EQ(result.columns[1].text(i), "user " + std::to_string(expected[i] % 7));
+                ASSERT_EQ(result.columns[2].ints[i], 1);
+            }
+        }
+    }
+    setScanLevel(bestScanLevel());
+}
+
+TEST(ExecutionTest, FiltersSealedChunks) {
+    // rows enough for two sealed chunks and a rest, each column suiting
+    // another encoding; the indexed copy answers through index scans
+    storage::catalog scanned;
+    storage::catalog indexed;
+    std::string schema = "CREATE TABLE events (id INT, state INT, wide INT, kind TEXT, note TEXT);";
+    load(scanned, schema);
+    load(indexed, schema + "CREATE INDEX by_id ON events (id)");
+    size_t rows = 2 * storage::chunkRows + 500;
+    const char* kinds[] = {"click", "view", "", "scroll"};
+    auto state = [](size_t i) { return static_cast<int64_t>(i / 5000) * 3 - 10; };
+    auto note = [&](size_t i) { return "n" + std::to_string(i * 7919 % rows); };
+    std::mt19937_64 rng(3);
+    std::vector<int64_t> wide(rows);
+    for (storage::catalog* c : {&scanned, &indexed}) {
+        storage::table* t = c->find("events");
+        for (size_t i = 0; i < rows; i++) {
+            wide[i] = static_cast<int64_t>(rng());
+            t->columns()[0].appendInt(static_cast<int64_t>(i));
+            t->columns()[1].appendInt(state(i));
+            t->columns()[2].appendInt(wide[i]);
+            t->columns()[3].appendText(kinds[i % 4]);
+            t->columns()[4].appendText(note(i));
+        }
+        ASSERT_EQ(t->commitAppends(), "");
+        rng.seed(3);
+    }
+    const storage::table& t = *scanned.find("events");
+    ASSERT_EQ(t.columns()[0].intChunks[0].kind, storage::encodingKind::frameKind);
+    ASSERT_EQ(t.columns()[1].intChunks[0].kind, storage::encodingKind::runKind);
+    ASSERT_EQ(t.columns()[2].intChunks[0].kind, storage::encodingKind::plainKind);
+    ASSERT_EQ(t.columns()[3].textChunks[0].kind, storage::encodingKind::dictionaryKind);
+    ASSERT_EQ(t.columns()[4].textChunks[0].kind, storage::encodingKind::plainKind);
+
+    struct Test { std::string where; std::function<bool(size_t)> keep; };
+    std::vector<Test> tests = {
+        {"id < 70000", [](size_t i) { return i < 70000; }},
+        {"id = 70000", [](size_t i) { return i == 70000; }},
+        {"id >= 65530 AND id < 65540", [](size_t i) { return i >= 65530 && i < 65540; }},
+        {"id > 1000000", [](size_t) { return false; }},
+        {"id <> 65536 AND id > 65530 AND id <= 65540", [](size_t i) { return i != 65536 && i > 65530 && i <= 65540; }},
+        {"state = 35", [&](size_t i) { return state(i) == 35; }},
+        {"state = 4", [](size_t) { return false; }},
+        {"state >= 0 AND state <= 20", [&](size_t i) { return state(i) >= 0 && state(i) <= 20; }},
+        {"state <> 2", [&](size_t i) { return state(i) != 2; }},
+        {"id < wide", [&](size_t i) { return static_cast<int64_t>(i) < wide[i]; }},
+        {"wide > 0 AND id > 131000", [&](size_t i) { return wide[i] > 0 && i > 131000; }},
+        {"kind = 'view'", [](size_t i) { return i % 4 == 1; }},
+        {"kind = 'zoom'", [](size_t) { return false; }},
+        {"kind <> 'zoom'", [](size_t) { return true; }},
+        {"kind > 'click' AND kind < 'view'", [](size_t i) { return i % 4 == 3; }},
+        {"kind <= 'd'", [](size_t i) { return i % 4 == 0 || i % 4 == 2; }},
+        {"kind > 'scroll'", [](size_t i) { return i % 4 == 1; }},
+        {"kind >= ''", [](size_t) { return true; }},
+        {"note = 'n12345'", [&](size_t i) { return note(i) == "n12345"; }},
+        {"note < 'n2' AND id < 1000", [&](size_t i) { return note(i) < "n2" && i < 1000; }},
+        {"kind = note", [](size_t) { return false; }},
+    };
+    for (storage::catalog* c : {&scanned, &indexed}) {
+        for (auto& test : tests) {
+            auto [result, err] = select(*c, "SELECT id, kind, note FROM events WHERE " + test.where);
+            ASSERT_TRUE(err.empty()) << err << " where=" << test.where;
+            std::vector<int64_t> expected;
+            for (size_t i = 0; i < rows; i++) {
+                if (test.keep(i)) {
+                    expected.push_back(static_cast<int64_t>(i));
+                }
+            }
+            ASSERT_EQ(result.rows, expected.size()) << "where=" << test.where;
+            EXPECT_EQ(result.columns[0].ints, expected) << "where=" << test.where;
+            for (size_t i = 0; i < result.rows; i++) {
+                ASSERT_EQ(result.columns[1].text(i), kinds[expected[i] % 4]);
+                ASSERT_EQ(result.columns[2].text(i), note(expected[i]));
+            }
+        }
+    }
+
+    // windows that straddle the end of a sealed chunk
+    tableScan scan(t, {0, 3}, nullptr, storage::chunkRows - 10, storage::chunkRows + 10);
+    std::vector<int64_t> ids;
+    batch b;
+    while (scan.next(b)) {
+        for (size_t i = 0; i < b.count; i++) {
+            ids.push_back(b.columns[0].intAt(b.position(i)));
+            EXPECT_EQ(b.columns[1].textAt(b.position(i)), kinds[ids.back() % 4]);
+        }
+    }
+    std::vector<int64_t> want(20);
+    std::iota(want.begin(), want.end(), static_cast<int64_t>(storage::chunkRows - 10));
+    EXPECT_EQ(ids, want);
+
+    predicate view{.kind = predicateKind::compareKind, .op = compareOp::equalOp, .type = storage::columnType::textType,
+        .column = 3, .textValue = "view"};
+    std::array<uint64_t, bitmapWords(batchSize)> bitmap;
+    evaluatePredicate(view, t, storage::chunkRows - 100, 300, bitmap.data());
+    for (size_t i = 0; i < 300; i++) {
+        ASSERT_EQ((bitmap[i / 64] >> (i % 64)) & 1, (storage::chunkRows - 100 + i) % 4 == 1) << i;
+    }
+}
+
+TEST(ExecutionTest, SkipsChunksByZoneMaps) {
+    // at rises with the row, as times do, so its chunks cover disjoint
+    // ranges; sensor is spread over every chunk
+    storage::catalog c;
+    load(c, "CREATE TABLE readings (at INT, sensor INT, site TEXT)");
+    storage::table& t = *c.find("readings");
+    size_t chunks = 5;
+    size_t rows = (chunks - 1) * storage::chunkRows + 1000;
+    auto site = [](size_t i) { return i < storage::chunkRows ? std::string("north") : "site" + std::to_string(i % 9); };
+    for (size_t i = 0; i < rows; i++) {
+        t.columns()[0].appendInt(static_cast<int64_t>(i * 10));
+        t.columns()[1].appendInt(static_cast<int64_t>(i * 7919 % 1000));
+        t.columns()[2].appendText(site(i));
+    }
+    ASSERT_EQ(t.commitAppends(), "");
+
+    struct Test { std::string where; std::function<bool(size_t)> keep; uint64_t skipped; };
+    int64_t second = static_cast<int64_t>(storage::chunkRows) * 10;
+    std::vector<Test> tests = {
+        {"at >= " + std::to_string(second) + " AND at < " + std::to_string(second + 500),
+            [&](size_t i) { return i >= storage::chunkRows && i < storage::chunkRows + 50; }, 4},
+        {"at = 20", [](size_t i) { return i == 2; }, 4},
+        {"at < 0", [](size_t) { return false; }, 5},
+        {"at > " + std::to_string(rows * 10), [](size_t) { return false; }, 5},
+        {"at <= 30 OR at >= " + std::to_string((rows - 2) * 10), [&](size_t i) { return i <= 3 || i >= rows - 2; }, 3},
+        {"sensor = 5", [](size_t i) { return i * 7919 % 1000 == 5; }, 0},
+        {"sensor = 5 AND at < 100", [](size_t i) { return i * 7919 % 1000 == 5 && i < 10; }, 4},
+        {"at < sensor", [](size_t i) { return i * 10 < i * 7919 % 1000; }, 0},
+        {"site = 'north'", [](size_t i) { return i < storage::chunkRows; }, 4},
+        {"site <> 'north'", [](size_t i) { return i >= storage::chunkRows; }, 1},
+        {"site > 'site8'", [](size_t) { return false; }, 5},
+    };
+    for (auto& test : tests) {
+        storage::zoneStats before = t.zones();
+        auto [result, err] = select(c, "SELECT at FROM readings WHERE " + test.where);
+        ASSERT_TRUE(err.empty()) << err << " where=" << test.where;
+        storage::zoneStats after = t.zones();
+        std::vector<int64_t> expected;
+        for (size_t i = 0; i < rows; i++) {
+            if (test.keep(i)) {
+                expected.push_back(static_cast<int64_t>(i * 10));
+            }
+        }
+        EXPECT_EQ(result.columns[0].ints, expected) << "where=" << test.where;
+        EXPECT_EQ(after.chunksSkipped - before.chunksSkipped, test.skipped) << "where=" << test.where;
+        EXPECT_EQ(after.chunksRead - before.chunksRead, chunks - test.skipped) << "where=" << test.where;
+    }
+
+    // zone maps cover the rows of the last chunk appended after it filled
+    // partly, so it is read along with the first; scans without a filter
+    // count nothing
+    storage::zoneStats before = t.zones();
+    t.columns()[0].appendInt(1);
+    t.columns()[1].appendInt(0);
+    t.columns()[2].appendText("late");
+    ASSERT_EQ(t.commitAppends(), "");
+    auto [late, err] = select(c, "SELECT site FROM readings WHERE at = 1");
+    ASSERT_TRUE(err.empty()) << err;
+    ASSERT_EQ(late.rows, 1u);
+    EXPECT_EQ(late.columns[0].text(0), "late");
+    EXPECT_EQ(t.zones().chunksRead - before.chunksRead, 2u);
+    EXPECT_EQ(t.zones().chunksSkipped - before.chunksSkipped, chunks - 2);
+    ASSERT_EQ(std::get<1>(select(c, "SELECT at FROM readings")), "");
+    EXPECT_EQ(t.zones().chunksRead - before.chunksRead, 2u);
+}
+
+TEST(ExecutionTest, IndexLookupsMatchScans) {
+    // the same rows twice, once with indexes: answers must not differ
+    storage::catalog scanned;
+    storage::catalog indexed;
+    std::string script = "CREATE TABLE users (id INT, name TEXT, age INT);";
+    size_t rows = batchSize * 3 + 5;
+    for (size_t i = 0; i < rows; i++) {
+        script += "INSERT INTO users VALUES (" + std::to_string(i * 7919 % rows) + ", 'user " +
+            std::to_string(i % 500) + "', " + std::to_string(i % 90) + ");";
+    }
+    load(scanned, script);
+    load(indexed, script + "CREATE INDEX by_id ON users (id); CREATE INDEX by_name ON users (name)");
+
+    std::vector<std::string> tests = {
+        "id = 17",
+        "17 = id",
+        "id = 100000",
+        "id >= 10 AND id < 40",
+        "id > 10 AND id <= 40 AND age <> 3",
+        "id > 30 AND id < 20",
+        "id < 500 AND id >= 495 AND id > 496",
+        "name = 'user 42'",
+        "name >= 'user 40' AND name < 'user 41' AND id < 3000",
+        "name = 'user 1' OR id = 3",
+        "id <> 5",
+        "age = 3 AND id < 100",
+        "id >= 0",
+    };
+    for (const std::string& where : tests) {
+        std::string query = "SELECT id, name, age FROM users WHERE " + where;
+        auto [want, wantErr] = select(scanned, query);
+        auto [got, gotErr] = select(indexed, query);
+        ASSERT_EQ(wantErr, "") << where;
+        ASSERT_EQ(gotErr, "") << where;
+        ASSERT_EQ(got.rows, want.rows) << where;
+        EXPECT_EQ(got.columns[0].ints, want.columns[0].ints) << where;
+        EXPECT_EQ(got.columns[1].chars, want.columns[1].chars) << where;
+        EXPECT_EQ(got.columns[2].ints, want.columns[2].ints) << where;
+    }
+}
+
+TEST(ExecutionTest, WhereParametersConstantsAndErrors) {
+    storage::catalog c;
+    load(c, "CREATE TABLE users (id INT, name TEXT); INSERT INTO users VALUES (5, 'ann');"
+            "INSERT INTO users VALUES (6, 'bob')");
+
+    auto [prepared, err] = parser::prepare("SELECT name FROM users WHERE id > ? AND name <> ?");
+    ASSERT_TRUE(err.empty()) << err;
+    auto [bound, bindErr] = parser::bind(prepared, {parser::numericParameter("4"), parser::stringParameter("bob")});
+    ASSERT_TRUE(bindErr.empty()) << bindErr;
+    auto [result, execErr] = executeSelect(*bound.statement().SelectStatement, c, bound.parameters);
+    ASSERT_TRUE(execErr.empty()) << execErr;
+    ASSERT_EQ(result.rows, 1u);
+    EXPECT_EQ(result.columns[0].text(0), "ann");
+
+    // bound text is compared as given, quotes and all, while a literal's
+    // doubled quotes stand for one
+    auto [insert, insertErr] = parser::prepare("INSERT INTO users VALUES (?, ?)");
+    ASSERT_TRUE(insertErr.empty()) << insertErr;
+    auto [lookup, lookupErr] = parser::prepare("SELECT id, name FROM users WHERE name = ?");
+    ASSERT_TRUE(lookupErr.empty()) << lookupErr;
+    std::vector<std::pair<const char*, int64_t>> quoted = {{"O'Brien", 7}, {"it''s", 8}};
+    for (auto [name, id] : quoted) {
+        auto [row, rowErr] = parser::bind(insert, {parser::numericParameter(std::to_string(id)), parser::stringParameter(name)});
+        ASSERT_TRUE(rowErr.empty()) << rowErr;
+        ASSERT_EQ(c.insert(*row.statement().InsertStatement, row.parameters), "");
+    }
+    for (auto [name, id] : quoted) {
+        auto [query, queryErr] = parser::bind(lookup, {parser::stringParameter(name)});
+        ASSERT_TRUE(queryErr.empty()) << queryErr;
+        auto [found, foundErr] = executeSelect(*query.statement().SelectStatement, c, query.parameters);
+        ASSERT_TRUE(foundErr.empty()) << foundErr;
+        ASSERT_EQ(found.rows, 1u) << name;
+        EXPECT_EQ(found.columns[0].ints[0], id);
+        EXPECT_EQ(found.columns[1].text(0), name);
+    }
+    EXPECT_EQ(rows(std::get<0>(select(c, "SELECT id FROM users WHERE name = 'O''Brien'"))), std::vector<std::string>{"7|"});
+    EXPECT_EQ(rows(std::get<0>(select(c, "SELECT id FROM users WHERE name = 'it''s'"))), std::vector<std::string>{});
+
+    EXPECT_EQ(std::get<0>(select(c, "SELECT 1 WHERE 1 < 2")).rows, 1u);
+    EXPECT_EQ(std::get<0>(select(c, "SELECT 1 WHERE 'b' < 'a'")).rows, 0u);
+
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id FROM users WHERE id")), "WHERE needs a comparison, got id");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id FROM users WHERE id = 'x'")), "Can not compare INT and TEXT with =");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id FROM users WHERE age = 1")), "Column age does not exist in table users");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id FROM users WHERE name || name = 'x'")),
+        "Comparisons need a column or a value on each side of =");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id FROM users WHERE name || name")), "Unsupported WHERE operator ||");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id = 1 FROM users")), "Unsupported select item = expression");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT 1 WHERE id = 1")), "Column id needs a FROM table");
+}
+
+TEST(JoinTest, RadixJoinMatchesNestedLoops) {
+    std::mt19937 rng(11);
+    auto entries = [&](size_t count) {
+        std::vector<joinEntry> out;
+        for (size_t i = 0; i < count; i++) {
+            out.push_back(joinEntry{.key = rng() % 500, .row = i});
+        }
+        return out;
+    };
+    std::vector<joinEntry> small = entries(1000);
+    std::vector<joinEntry> large = entries(5000);
+
+    for (bool smallLeft : {true, false}) {
+        const std::vector<joinEntry>& left = smallLeft ? small : large;
+        const std::vector<joinEntry>& right = smallLeft ? large : small;
+        std::vector<std::pair<uint64_t, uint64_t>> want;
+        for (const joinEntry& l : left) {
+            for (const joinEntry& r : right) {
+                if (l.key == r.key) {
+                    want.emplace_back(l.row, r.row);
+                }
+            }
+        }
+        std::sort(want.begin(), want.end());
+
+        // a small cache splits the inputs into many partitions
+        for (joinOptions opts : {joinOptions{.threads = 1}, joinOptions{.threads = 3, .cacheBytes = 512}}) {
+            joinPairs pairs = radixJoin(left, right, opts);
+            ASSERT_EQ(pairs.left.size(), pairs.right.size());
+            std::vector<std::pair<uint64_t, uint64_t>> got;
+            for (size_t i = 0; i < pairs.left.size(); i++) {
+                got.emplace_back(pairs.left[i], pairs.right[i]);
+            }
+            std::sort(got.begin(), got.end());
+            EXPECT_EQ(got, want) << "threads=" << opts.threads << " smallLeft=" << smallLeft;
+        }
+    }
+    EXPECT_TRUE(radixJoin({}, large).left.empty());
+}
+
+TEST(ExecutionTest, JoinsTablesOnEqualColumns) {
+    storage::catalog c;
+    std::string script = "CREATE TABLE users (id INT, name TEXT, country TEXT);"
+                         "CREATE TABLE orders (id INT, user_id INT, amount INT);"
+                         "CREATE TABLE countries (code TEXT, name TEXT);"
+                         "INSERT INTO countries VALUES ('nl', 'Netherlands'), ('fr', 'France'), ('fr', 'French Republic');";
+    const char* codes[] = {"nl", "fr", "de"};
+    size_t users = 300;
+    size_t orders = batchSize * 2 + 100;
+    for (size_t i = 0; i < users; i++) {
+        script += "INSERT INTO users VALUES (" + std::to_string(i) + ", 'user " + std::to_string(i) + "', '" +
+            codes[i % 3] + "');";
+    }
+    for (size_t i = 0; i < orders; i++) {
+        script += "INSERT INTO orders VALUES (" + std::to_string(i) + ", " + std::to_string(i * 7 % 350) + ", " +
+            std::to_string(i % 100) + ");";
+    }
+    load(c, script);
+
+    std::vector<std::string> want;
+    for (size_t i = 0; i < orders; i++) {
+        size_t user = i * 7 % 350;
+        if (user < 200 && i % 100 > 50) {
+            want.push_back("user " + std::to_string(user) + "|" + std::to_string(i % 100) + "|");
+        }
+    }
+    std::sort(want.begin(), want.end());
+    auto [result, err] = select(c, "SELECT users.name, amount FROM orders JOIN users ON orders.user_id = users.id "
+                                   "WHERE amount > 50 AND users.id < 200");
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(result.columns[0].name, "users.name");
+    EXPECT_EQ(rows(result), want);
+
+    // a TEXT key matching two rows, through a third table
+    want.clear();
+    for (size_t i = 0; i <= 250; i += 50) {
+        size_t user = i * 7 % 350;
+        if (user < users && user % 3 == 1) {
+            want.push_back(std::to_string(i) + "|France|");
+            want.push_back(std::to_string(i) + "|French Republic|");
+        } else if (user < users && user % 3 == 0) {
+            want.push_back(std::to_string(i) + "|Netherlands|");
+        }
+    }
+    std::sort(want.begin(), want.end());
+    std::tie(result, err) = select(c, "SELECT orders.id, countries.name FROM orders JOIN users ON users.id = user_id "
+                                      "JOIN countries ON country = code WHERE orders.id = 0 OR orders.id = 50 OR "
+                                      "orders.id = 100 OR orders.id = 150 OR orders.id = 200 OR orders.id = 250");
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(rows(result), want);
+
+    std::tie(result, err) = select(c, "SELECT users.name FROM users WHERE users.id = 3");
+    ASSERT_TRUE(err.empty()) << err;
+    ASSERT_EQ(result.rows, 1u);
+    EXPECT_EQ(result.columns[0].text(0), "user 3");
+
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id FROM orders JOIN users ON user_id = users.id")), "Column id is ambiguous");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT amount FROM orders JOIN users ON user_id < users.id")),
+        "JOIN users needs ON to equate one of its columns with a column of an earlier table");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT amount FROM orders JOIN users ON user_id = users.id WHERE amount > users.id")),
+        "WHERE conditions of a join must each compare the columns of a single table");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT amount FROM orders JOIN users ON user_id = users.id JOIN users ON 1 = 1")),
+        "Table users is joined more than once");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT x.id FROM users")), "Table x is not part of the query");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT nope FROM orders JOIN users ON user_id = users.id")),
+        "Column nope does not exist in any joined table");
+}
+
+TEST(AggregateTest, HashAggregateMatchesReference) {
+    storage::catalog c;
+    load(c, "CREATE TABLE sales (region TEXT, store INT, amount INT);");
+    storage::table& sales = *c.find("sales");
+    std::mt19937 rng(5);
+    size_t count = batchSize * 5 + 17;
+    for (size_t i = 0; i < count; i++) {
+        size_t store = rng() % 3000;
+        sales.columns()[0].appendText("region " + std::to_string(store % 7));
+        sales.columns()[1].appendInt(static_cast<int64_t>(store));
+        sales.columns()[2].appendInt(static_cast<int64_t>(rng() % 1000) - 300);
+    }
+    ASSERT_EQ(sales.commitAppends(), "");
+
+    std::vector<aggregate> aggregates = {
+        {aggregateKind::countKind},
+        {aggregateKind::sumKind, 2},
+        {aggregateKind::minKind, 2},
+        {aggregateKind::maxKind, 2},
+        {aggregateKind::avgKind, 2},
+        {aggregateKind::minKind, 0},
+        {aggregateKind::maxKind, 0},
+    };
+    auto input = [&](size_t part, size_t parts) {
+        return std::make_unique<tableScan>(sales, std::vector<size_t>{0, 1, 2}, nullptr, count * part / parts,
+            count * (part + 1) / parts);
+    };
+    std::vector<storage::columnType> schema = {storage::columnType::textType, storage::columnType::intType,
+                                               storage::columnType::intType};
+
+    // few groups on TEXT keys and many on INT keys
+    for (std::vector<size_t> keys : {std::vector<size_t>{0}, std::vector<size_t>{1, 0}}) {
+        std::map<std::string, std::vector<int64_t>> groups;
+        std::map<std::string, std::pair<std::string, std::string>> texts;
+        for (size_t row = 0; row < count; row++) {
+            std::string key;
+            for (size_t k : keys) {
+                key += k == 0 ? std::string(sales.columns()[0].text(row)) : std::to_string(sales.columns()[1].ints[row]);
+                key += "|";
+            }
+            int64_t amount = sales.columns()[2].ints[row];
+            std::string region(sales.columns()[0].text(row));
+            auto [it, added] = groups.try_emplace(key, std::vector<int64_t>{0, 0, amount, amount});
+            std::vector<int64_t>& g = it->second;
+            g[0]++;
+            g[1] += amount;
+            g[2] = std::min(g[2], amount);
+            g[3] = std::max(g[3], amount);
+            texts.try_emplace(key, region, region);
+        }
+        std::vector<std::string> want;
+        for (const auto& [key, g] : groups) {
+            want.push_back(key + std::to_string(g[0]) + "|" + std::to_string(g[1]) + "|" + std::to_string(g[2]) + "|" +
+                std::to_string(g[3]) + "|" + std::to_string(g[1] / g[0]) + "|" + texts[key].first + "|" +
+                texts[key].second + "|");
+        }
+        std::sort(want.begin(), want.end());
+
+        for (size_t threads : {1, 3}) {
+            hashAggregate agg(input, schema, 4, keys, aggregates, threads);
+            resultSet result;
+            for (storage::columnType type : agg.schema()) {
+                result.columns.push_back(storage::column{.type = type});
+            }
+            batch b;
+            while (agg.next(b)) {
+                appendBatch(result, b);
+            }
+            EXPECT_EQ(rows(result), want) << "keys=" << keys.size() << " threads=" << threads;
+        }
+    }
+}
+
+TEST(ExecutionTest, GroupsAndAggregates) {
+    storage::catalog c;
+    std::string script = "CREATE TABLE orders (id INT, customer TEXT, amount INT);"
+                         "CREATE TABLE empty (id INT, name TEXT);";
+    const char* customers[] = {"ann", "bob", "cat"};
+    size_t orders = batchSize + 50;
+    for (size_t i = 0; i < orders; i++) {
+        script += "INSERT INTO orders VALUES (" + std::to_string(i) + ", '" + customers[i % 3] + "', " +
+            std::to_string(i % 10) + ");";
+    }
+    load(c, script);
+
+    std::vector<std::string> want;
+    for (size_t k = 0; k < 3; k++) {
+        int64_t n = 0;
+        int64_t sum = 0;
+        for (size_t i = k; i < orders; i += 3) {
+            n++;
+            sum += static_cast<int64_t>(i % 10);
+        }
+        want.push_back(std::to_string(n) + "|" + customers[k] + "|" + std::to_string(sum) + "|1|");
+    }
+    std::sort(want.begin(), want.end());
+    auto [result, err] = select(c, "SELECT COUNT(*), customer, SUM(amount), 1 FROM orders GROUP BY customer");
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(result.columns[0].name, "count(*)");
+    EXPECT_EQ(result.columns[2].name, "sum(amount)");
+    EXPECT_EQ(rows(result), want);
+
+    std::tie(result, err) = select(c, "SELECT MIN(customer), MAX(amount), AVG(amount) FROM orders WHERE id < 4");
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(rows(result), std::vector<std::string>{"ann|3|1|"});
+
+    // a global aggregation has a row even without input rows
+    std::tie(result, err) = select(c, "SELECT COUNT(*), MAX(name), SUM(id) FROM empty");
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(rows(result), std::vector<std::string>{"0||0|"});
+    std::tie(result, err) = select(c, "SELECT id FROM empty GROUP BY id");
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(result.rows, 0u);
+
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id, COUNT(*) FROM orders GROUP BY customer")),
+        "Column id must be in GROUP BY or in an aggregate");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT SUM(customer) FROM orders")), "Can not sum TEXT column customer");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT MEDIAN(amount) FROM orders")), "Unknown function median");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT MAX(*) FROM orders")), "Only COUNT takes *");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id FROM orders WHERE COUNT(*) > 1")),
+        "Aggregates are only allowed in the select list");
+}
+
+TEST(SortTest, RadixSortMatchesStableSort) {
+    std::mt19937_64 rng(29);
+    for (uint64_t range : {uint64_t{7}, uint64_t{1} << 20, ~uint64_t{0}}) {
+        std::vector<sortEntry> entries;
+        for (size_t i = 0; i < 50000; i++) {
+            entries.push_back(sortEntry{.key = rng() % range + (range < 100 ? uint64_t{1} << 40 : 0), .row = i});
+        }
+        std::vector<sortEntry> want = entries;
+        std::stable_sort(want.begin(), want.end(), [](const sortEntry& a, const sortEntry& b) { return a.key < b.key; });
+
+        for (size_t threads : {1, 3}) {
+            std::vector<sortEntry> got = entries;
+            radixSort(got, threads);
+            ASSERT_EQ(got.size(), want.size());
+            for (size_t i = 0; i < got.size(); i++) {
+                ASSERT_EQ(got[i].key, want[i].key) << "range=" << range << " threads=" << threads << " i=" << i;
+                ASSERT_EQ(got[i].row, want[i].row) << "range=" << range << " threads=" << threads << " i=" << i;
+            }
+        }
+    }
+}
+
+TEST(ExecutionTest, OrdersAndLimitsRows) {
+    storage::catalog c;
+    load(c, "CREATE TABLE people (id INT, name TEXT, age INT, note TEXT);");
+    storage::table& table = *c.find("people");
+    size_t people = batchSize * 3 + 11;
+    std::mt19937 rng(31);
+    std::vector<std::tuple<int64_t, std::string, int64_t>> all;
+    std::vector<std::string> notes;
+    for (size_t i = 0; i < people; i++) {
+        // names share long prefixes, so normalized keys tie
+        std::string name = "person with a long name " + std::to_string(rng() % 500);
+        int64_t age = static_cast<int64_t>(rng() % 90) - 5;
+        all.emplace_back(static_cast<int64_t>(i), name, age);
+        table.columns()[0].appendInt(static_cast<int64_t>(i));
+        table.columns()[1].appendText(name);
+        table.columns()[2].appendInt(age);
+        notes.push_back("note " + std::to_string(rng() % 50) + " of some length");
+        table.columns()[3].appendText(notes.back());
+    }
+    ASSERT_EQ(table.commitAppends(), "");
+
+    // ordered renders the rows of a result as lines in result order
+    auto ordered = [](const resultSet& result) {
+        std::vector<std::string> lines;
+        for (size_t row = 0; row < result.rows; row++) {
+            std::string line;
+            for (const storage::column& col : result.columns) {
+                line += col.type == storage::columnType::intType ? std::to_string(col.ints[row])
+                                                                 : std::string(col.text(row));
+                line += "|";
+            }
+            lines.push_back(line);
+        }
+        return lines;
+    };
+
+    // by age descending, then name, ties in insertion order
+    auto byAge = all;
+    std::stable_sort(byAge.begin(), byAge.end(), [](const auto& a, const auto& b) {
+        return std::get<2>(a) != std::get<2>(b) ? std::get<2>(a) > std::get<2>(b) : std::get<1>(a) < std::get<1>(b);
+    });
+    for (size_t limit : {size_t{0}, size_t{1}, size_t{10}, batchSize + 3, people, topNLimit + 1}) {
+        std::vector<std::string> want;
+        for (size_t i = 0; i < std::min(limit, people); i++) {
+            want.push_back(std::to_string(std::get<0>(byAge[i])) + "|");
+        }
+        auto [result, err] = select(c, "SELECT id FROM people ORDER BY age DESC, name LIMIT " + std::to_string(limit));
+        ASSERT_TRUE(err.empty()) << err;
+        ASSERT_EQ(result.columns.size(), 1u);
+        EXPECT_EQ(ordered(result), want) << "limit=" << limit;
+    }
+
+    // the merge sort of several threads agrees with the SQL order
+    {
+        sortRows sorted(std::make_unique<tableScan>(table, std::vector<size_t>{0, 2, 1}),
+            {{1, true}, {2, false}}, 1, 3);
+        resultSet result;
+        result.columns.push_back(storage::column{.type = storage::columnType::intType});
+        batch b;
+        while (sorted.next(b)) {
+            appendBatch(result, b);
+        }
+        auto [sql, err] = select(c, "SELECT id FROM people ORDER BY age DESC, name");
+        ASSERT_TRUE(err.empty()) << err;
+        EXPECT_EQ(ordered(result), ordered(sql));
+    }
+
+    // TEXT keys, exactly normalized or not
+    for (bool byNote : {false, true}) {
+        std::vector<size_t> order(people);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return byNote ? notes[a] > notes[b] : std::get<1>(all[a]) < std::get<1>(all[b]);
+        });
+        std::vector<std::string> want;
+        for (size_t i : order) {
+            want.push_back(std::to_string(i) + "|");
+        }
+        auto [result, err] = select(c, byNote ? "SELECT id FROM people ORDER BY note DESC" : "SELECT id FROM people ORDER BY name");
+        ASSERT_TRUE(err.empty()) << err;
+        EXPECT_EQ(ordered(result), want) << "byNote=" << byNote;
+    }
+
+    // a lone INT key is radix sorted, stably
+    auto byAgeOnly = all;
+    std::stable_sort(byAgeOnly.begin(), byAgeOnly.end(), [](const auto& a, const auto& b) {
+        return std::get<2>(a) < std::get<2>(b);
+    });
+    std::vector<std::string> want;
+    for (const auto& [id, name, age] : byAgeOnly) {
+        want.push_back(std::to_string(age) + "|" + std::to_string(id) + "|");
+    }
+    auto [result, err] = select(c, "SELECT age, id FROM people ORDER BY 1");
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(ordered(result), want);
+
+    auto [prepared, prepareErr] = parser::prepare("SELECT name, COUNT(*) FROM people GROUP BY name "
+                                                  "ORDER BY COUNT(*) DESC, name LIMIT ?");
+    ASSERT_TRUE(prepareErr.empty()) << prepareErr;
+    auto [bound, bindErr] = parser::bind(prepared, {parser::numericParameter("3")});
+    ASSERT_TRUE(bindErr.empty()) << bindErr;
+    std::tie(result, err) = executeSelect(*bound.statement().SelectStatement, c, bound.parameters);
+    ASSERT_TRUE(err.empty()) << err;
+    std::map<std::string, int64_t> counts;
+    for (const auto& [id, name, age] : all) {
+        counts[name]++;
+    }
+    std::vector<std::pair<int64_t, std::string>> byCount;
+    for (const auto& [name, n] : counts) {
+        byCount.emplace_back(-n, name);
+    }
+    std::sort(byCount.begin(), byCount.end());
+    want.clear();
+    for (size_t i = 0; i < 3; i++) {
+        want.push_back(byCount[i].second + "|" + std::to_string(-byCount[i].first) + "|");
+    }
+    EXPECT_EQ(ordered(result), want);
+
+    // LIMIT without ORDER BY takes the first rows scanned
+    std::tie(result, err) = select(c, "SELECT id FROM people WHERE age > 50 LIMIT 5");
+    ASSERT_TRUE(err.empty()) << err;
+    want.clear();
+    for (const auto& [id, name, age] : all) {
+        if (age > 50 && want.size() < 5) {
+            want.push_back(std::to_string(id) + "|");
+        }
+    }
+    EXPECT_EQ(ordered(result), want);
+
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id FROM people ORDER BY 2")), "ORDER BY position 2 is not in the select list");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT id FROM people LIMIT 'ten'")), "LIMIT needs a count of rows");
+    EXPECT_EQ(std::get<1>(select(c, "SELECT name, COUNT(*) FROM people GROUP BY name ORDER BY age")),
+        "Column age must be in GROUP BY or in an aggregate");
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,270 @@
+#include "filter.h"
+#include "../lexer/scan.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NICOLASSQL_X86 1
+#endif
+
+namespace execution {
+
+namespace {
+
+// every comparison is a == b or a > b, with the operands possibly swapped
+// and the result possibly negated, so each kernel needs just the two
+// compare instructions the CPU has
+constexpr bool usesEqual(compareOp op) {
+	return op == compareOp::equalOp || op == compareOp::notEqualOp;
+}
+
+constexpr bool swapsOperands(compareOp op) {
+	return op == compareOp::lessOp || op == compareOp::greaterEqualOp;
+}
+
+constexpr bool negates(compareOp op) {
+	return op == compareOp::notEqualOp || op == compareOp::lessEqualOp || op == compareOp::greaterEqualOp;
+}
+
+// b points at a single value when broadcast is set and at count values
+// otherwise
+using compareKernel = void (*)(const int64_t* a, const int64_t* b, size_t count, uint64_t* bitmap);
+
+template <compareOp op, bool broadcast>
+void compareScalar(const int64_t* a, const int64_t* b, size_t count, uint64_t* bitmap) {
+	for (size_t w = 0; w < bitmapWords(count); w++) {
+		uint64_t word = 0;
+		size_t rows = count - w * 64 < 64 ? count - w * 64 : 64;
+		for (size_t j = 0; j < rows; j++) {
+			int64_t x = a[w * 64 + j];
+			int64_t y = broadcast ? *b : b[w * 64 + j];
+			bool hit = usesEqual(op) ? x == y : swapsOperands(op) ? y > x : x > y;
+			word |= static_cast<uint64_t>(hit != negates(op)) << j;
+		}
+		bitmap[w] = word;
+	}
+}
+
+#ifdef NICOLASSQL_X86
+
+template <compareOp op, bool broadcast>
+__attribute__((target("sse4.2")))
+void compareSse42(const int64_t* a, const int64_t* b, size_t count, uint64_t* bitmap) {
+	const __m128i constant = _mm_set1_epi64x(broadcast ? *b : 0);
+	size_t words = count / 64;
+	for (size_t w = 0; w < words; w++) {
+		uint64_t word = 0;
+		for (size_t j = 0; j < 64; j += 2) {
+			size_t i = w * 64 + j;
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+			__m128i y = broadcast ? constant : _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+			__m128i hit = usesEqual(op) ? _mm_cmpeq_epi64(x, y)
+				: swapsOperands(op) ? _mm_cmpgt_epi64(y, x) : _mm_cmpgt_epi64(x, y);
+			word |= static_cast<uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(hit))) << j;
+		}
+		bitmap[w] = negates(op) ? ~word : word;
+	}
+	compareScalar<op, broadcast>(a + words * 64, broadcast ? b : b + words * 64, count - words * 64, bitmap + words);
+}
+
+template <compareOp op, bool broadcast>
+__attribute__((target("avx2")))
+void compareAvx2(const int64_t* a, const int64_t* b, size_t count, uint64_t* bitmap) {
+	const __m256i constant = _mm256_set1_epi64x(broadcast ? *b : 0);
+	size_t words = count / 64;
+	for (size_t w = 0; w < words; w++) {
+		uint64_t word = 0;
+		for (size_t j = 0; j < 64; j += 4) {
+			size_t i = w * 64 + j;
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+			__m256i y = broadcast ? constant : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+			__m256i hit = usesEqual(op) ? _mm256_cmpeq_epi64(x, y)
+				: swapsOperands(op) ? _mm256_cmpgt_epi64(y, x) : _mm256_cmpgt_epi64(x, y);
+			word |= static_cast<uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(hit))) << j;
+		}
+		bitmap[w] = negates(op) ? ~word : word;
+	}
+	_mm256_zeroupper();
+	compareScalar<op, broadcast>(a + words * 64, broadcast ? b : b + words * 64, count - words * 64, bitmap + words);
+}
+
+bool hasSse42() {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.2");
+}
+
+#endif
+
+template <compareOp op, bool broadcast>
+compareKernel kernelFor(nicolassql::scanLevel level) {
+#ifdef NICOLASSQL_X86
+	// 64 bit compares arrived with SSE4.2, so the SSE2 level only uses
+	// vectors where the CPU has it
+	static const bool sse42 = hasSse42();
+	switch (level) {
+	case nicolassql::scanLevel::avx2Level:
+		return compareAvx2<op, broadcast>;
+	case nicolassql::scanLevel::sse2Level:
+		return sse42 ? compareSse42<op, broadcast> : compareScalar<op, broadcast>;
+	default:
+		break;
+	}
+#endif
+	return compareScalar<op, broadcast>;
+}
+
+template <bool broadcast>
+compareKernel kernelFor(nicolassql::scanLevel level, compareOp op) {
+	switch (op) {
+	case compareOp::equalOp:
+		return kernelFor<compareOp::equalOp, broadcast>(level);
+	case compareOp::notEqualOp:
+		return kernelFor<compareOp::notEqualOp, broadcast>(level);
+	case compareOp::lessOp:
+		return kernelFor<compareOp::lessOp, broadcast>(level);
+	case compareOp::lessEqualOp:
+		return kernelFor<compareOp::lessEqualOp, broadcast>(level);
+	case compareOp::greaterOp:
+		return kernelFor<compareOp::greaterOp, broadcast>(level);
+	case compareOp::greaterEqualOp:
+		break;
+	}
+	return kernelFor<compareOp::greaterEqualOp, broadcast>(level);
+}
+
+// codeBlock is the number of frame of reference codes unpacked at a time,
+// a whole number of bitmap words
+constexpr size_t codeBlock = 2048;
+
+template <typename T>
+bool holds(const T& a, const T& b, compareOp op) {
+	switch (op) {
+	case compareOp::equalOp:
+		return a == b;
+	case compareOp::notEqualOp:
+		return a != b;
+	case compareOp::lessOp:
+		return a < b;
+	case compareOp::lessEqualOp:
+		return a <= b;
+	case compareOp::greaterOp:
+		return a > b;
+	case compareOp::greaterEqualOp:
+		break;
+	}
+	return a >= b;
+}
+
+// setBits sets bits from up to to of bitmap
+void setBits(uint64_t* bitmap, size_t from, size_t to) {
+	while (from < to) {
+		size_t bits = std::min<size_t>(64 - from % 64, to - from);
+		uint64_t mask = bits == 64 ? ~uint64_t{0} : ((uint64_t{1} << bits) - 1) << (from % 64);
+		bitmap[from / 64] |= mask;
+		from += bits;
+	}
+}
+
+}
+
+void compareIntsToConstant(const int64_t* values, size_t count, compareOp op, int64_t constant, uint64_t* bitmap) {
+	kernelFor<true>(nicolassql::currentScanLevel(), op)(values, &constant, count, bitmap);
+}
+
+void compareInts(const int64_t* a, const int64_t* b, size_t count, compareOp op, uint64_t* bitmap) {
+	kernelFor<false>(nicolassql::currentScanLevel(), op)(a, b, count, bitmap);
+}
+
+void compareChunkToConstant(const storage::encodedInts& chunk, size_t first, size_t count, compareOp op,
+		int64_t constant, uint64_t* bitmap) {
+	switch (chunk.kind) {
+	case storage::encodingKind::frameKind: {
+		// every code lies in [0, 2^width), so a constant outside that range
+		// compares like the code just past the end it is beyond
+		__int128 distance = static_cast<__int128>(constant) - chunk.base;
+		int64_t limit = int64_t{1} << chunk.width;
+		int64_t code = distance < 0 ? -1 : distance > limit ? limit : static_cast<int64_t>(distance);
+		int64_t codes[codeBlock];
+		for (size_t done = 0; done < count; done += codeBlock) {
+			size_t n = std::min(codeBlock, count - done);
+			chunk.codes(first + done, n, codes);
+			compareIntsToConstant(codes, n, op, code, bitmap + done / 64);
+		}
+		return;
+	}
+	case storage::encodingKind::runKind: {
+		std::fill(bitmap, bitmap + bitmapWords(count), 0);
+		size_t r = chunk.run(first);
+		for (size_t row = 0; row < count; r++) {
+			size_t end = std::min<size_t>(count, chunk.ends[r] - first);
+			if (holds(chunk.values[r], constant, op)) {
+				setBits(bitmap, row, end);
+			}
+			row = end;
+		}
+		return;
+	}
+	default:
+		compareIntsToConstant(chunk.values.data() + first, count, op, constant, bitmap);
+	}
+}
+
+void compareTextChunkToConstant(const storage::encodedText& chunk, size_t first, size_t count, compareOp op,
+		std::string_view constant, uint64_t* bitmap) {
+	if (chunk.kind != storage::encodingKind::dictionaryKind) {
+		std::fill(bitmap, bitmap + bitmapWords(count), 0);
+		for (size_t i = 0; i < count; i++) {
+			bitmap[i / 64] |= static_cast<uint64_t>(holds(chunk.entry(first + i), constant, op)) << (i % 64);
+		}
+		return;
+	}
+
+	// code is the first entry not below constant. When constant is not an
+	// entry, no code equals it, and it sorts just before code.
+	size_t low = 0;
+	size_t high = chunk.entries();
+	while (low < high) {
+		size_t mid = (low + high) / 2;
+		if (chunk.entry(mid) < constant) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	int64_t code = static_cast<int64_t>(low);
+	bool found = low < chunk.entries() && chunk.entry(low) == constant;
+	if (!found) {
+		switch (op) {
+		case compareOp::equalOp:
+		case compareOp::notEqualOp:
+			code = -1;
+			break;
+		case compareOp::lessEqualOp:
+			op = compareOp::lessOp;
+			break;
+		case compareOp::greaterOp:
+			op = compareOp::greaterEqualOp;
+			break;
+		default:
+			break;
+		}
+	}
+	compareChunkToConstant(chunk.codes, first, count, op, code, bitmap);
+}
+
+size_t selectionFromBitmap(const uint64_t* bitmap, size_t count, uint32_t* selection) {
+	size_t n = 0;
+	for (size_t w = 0; w < bitmapWords(count); w++) {
+		uint64_t word = bitmap[w];
+		if (count - w * 64 < 64) {
+			word &= (uint64_t{1} << (count - w * 64)) - 1;
+		}
+		while (word != 0) {
+			selection[n++] = static_cast<uint32_t>(w * 64 + __builtin_ctzll(word));
+			word &= word - 1;
+		}
+	}
+	return n;
+}
+
+}
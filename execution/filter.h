@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "../storage/encoding.h"
+
+namespace execution {
+
+// The filter kernels evaluate comparisons of INT column vectors into
+// selection bitmaps, bit i%64 of word i/64 standing for row i. Like the
+// lexer's scan functions they compare 4 (AVX2) or 2 (SSE4.2) values at a
+// time, following nicolassql::currentScanLevel, and fall back to a plain
+// loop elsewhere.
+
+enum class compareOp : uint8_t {
+	equalOp = 0,
+	notEqualOp,
+	lessOp,
+	lessEqualOp,
+	greaterOp,
+	greaterEqualOp,
+};
+
+// bitmapWords is the number of words a bitmap of count rows takes up
+constexpr size_t bitmapWords(size_t count) {
+	return (count + 63) / 64;
+}
+
+// compareIntsToConstant sets bit i of bitmap to whether values[i] op
+// constant holds. Bits past count in the last word are cleared.
+void compareIntsToConstant(const int64_t* values, size_t count, compareOp op, int64_t constant, uint64_t* bitmap);
+
+// compareInts sets bit i of bitmap to whether a[i] op b[i] holds
+void compareInts(const int64_t* a, const int64_t* b, size_t count, compareOp op, uint64_t* bitmap);
+
+// compareChunkToConstant is compareIntsToConstant over the count values of
+// a sealed chunk from row first on, without decoding them: frame of
+// reference codes are compared with the constant's distance from the
+// chunk's base, and each run is compared once for all of its rows
+void compareChunkToConstant(const storage::encodedInts& chunk, size_t first, size_t count, compareOp op,
+	int64_t constant, uint64_t* bitmap);
+
+// compareTextChunkToConstant does the same for a TEXT chunk. A dictionary
+// chunk finds where constant falls among its sorted entries once and then
+// compares codes; a plain chunk compares a value at a time.
+void compareTextChunkToConstant(const storage::encodedText& chunk, size_t first, size_t count, compareOp op,
+	std::string_view constant, uint64_t* bitmap);
+
+// selectionFromBitmap writes the positions of the set bits among the
+// first count bits of bitmap to selection, in order, and returns how many
+// there are
+size_t selectionFromBitmap(const uint64_t* bitmap, size_t count, uint32_t* selection);
+
+}
@@ -0,0 +1,165 @@
+#include "join.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace execution {
+
+namespace {
+
+// below minEntriesPerThread entries per thread, starting the threads costs
+// more than they save
+constexpr size_t minEntriesPerThread = 1 << 16;
+
+// maxRadixBits bounds the partitions to what one pass scatters into
+// without thrashing the TLB
+constexpr unsigned maxRadixBits = 14;
+
+inline size_t partitionOf(uint64_t key, unsigned bits) {
+	return bits == 0 ? 0 : static_cast<size_t>(hashOf(key) >> (64 - bits));
+}
+
+// partitioned is a join input scattered by partition, partition p being
+// entries[starts[p]] to entries[starts[p+1]]
+struct partitioned {
+	std::unique_ptr<joinEntry[]> entries;
+	std::vector<size_t> starts;
+};
+
+// partition scatters in into the 2^bits partitions. Each thread counts
+// the entries of its stretch per partition first, so that it then writes
+// them to the right place without coordinating with the others.
+partitioned partition(const std::vector<joinEntry>& in, unsigned bits, size_t threads) {
+	size_t parts = size_t{1} << bits;
+	partitioned out;
+	out.entries.reset(new joinEntry[in.size()]);
+	out.starts.assign(parts + 1, 0);
+	auto stretch = [&](size_t t) { return in.size() * t / threads; };
+
+	std::vector<size_t> positions(threads * parts, 0);
+	runParallel(threads, [&](size_t t) {
+		size_t* counts = positions.data() + t * parts;
+		for (size_t i = stretch(t); i < stretch(t + 1); i++) {
+			counts[partitionOf(in[i].key, bits)]++;
+		}
+	});
+
+	// thread t writes its entries of partition p after those of the
+	// threads before it
+	size_t offset = 0;
+	for (size_t p = 0; p < parts; p++) {
+		for (size_t t = 0; t < threads; t++) {
+			size_t count = positions[t * parts + p];
+			positions[t * parts + p] = offset;
+			offset += count;
+		}
+		out.starts[p + 1] = offset;
+	}
+
+	runParallel(threads, [&](size_t t) {
+		size_t* next = positions.data() + t * parts;
+		for (size_t i = stretch(t); i < stretch(t + 1); i++) {
+			out.entries[next[partitionOf(in[i].key, bits)]++] = in[i];
+		}
+	});
+	return out;
+}
+
+// radixBits is the number of partitions, as a power of two, that keeps the
+// hash table of each partition of build rows within cacheBytes
+unsigned radixBits(size_t buildRows, size_t cacheBytes) {
+	// an entry, its link in its bucket's chain and about one bucket head
+	constexpr size_t bytesPerRow = sizeof(joinEntry) + 2 * sizeof(uint32_t);
+	unsigned bits = 0;
+	while (bits < maxRadixBits && (buildRows >> bits) * bytesPerRow > cacheBytes) {
+		bits++;
+	}
+	return bits;
+}
+
+}
+
+joinPairs radixJoin(std::vector<joinEntry> left, std::vector<joinEntry> right, joinOptions opts) {
+	joinPairs result;
+	if (left.empty() || right.empty()) {
+		return result;
+	}
+
+	// the hash tables hold the smaller side
+	bool swapped = left.size() > right.size();
+	const std::vector<joinEntry>& build = swapped ? right : left;
+	const std::vector<joinEntry>& probe = swapped ? left : right;
+
+	size_t threads = opts.threads;
+	if (threads == 0) {
+		threads = std::min(availableThreads(), std::max<size_t>(1, (build.size() + probe.size()) / minEntriesPerThread));
+	}
+	unsigned bits = radixBits(build.size(), opts.cacheBytes);
+	partitioned builds = partition(build, bits, threads);
+	partitioned probes = partition(probe, bits, threads);
+	std::vector<joinEntry>().swap(left);
+	std::vector<joinEntry>().swap(right);
+
+	// threads take the next partition left to join, so a few large
+	// partitions do not hold up the others
+	size_t parts = size_t{1} << bits;
+	std::atomic<size_t> nextPart{0};
+	std::vector<joinPairs> found(threads);
+	runParallel(threads, [&](size_t t) {
+		joinPairs& out = found[t];
+		std::vector<uint32_t> heads;
+		std::vector<uint32_t> chain;
+		for (size_t p = nextPart++; p < parts; p = nextPart++) {
+			const joinEntry* b = builds.entries.get() + builds.starts[p];
+			size_t buildRows = builds.starts[p + 1] - builds.starts[p];
+			const joinEntry* q = probes.entries.get() + probes.starts[p];
+			size_t probeRows = probes.starts[p + 1] - probes.starts[p];
+			if (buildRows == 0 || probeRows == 0) {
+				continue;
+			}
+
+			// chains link the rows of a bucket, 0 ending them and row i
+			// being i+1
+			size_t buckets = 1;
+			while (buckets < buildRows) {
+				buckets *= 2;
+			}
+			uint64_t mask = buckets - 1;
+			heads.assign(buckets, 0);
+			chain.resize(buildRows);
+			for (size_t i = 0; i < buildRows; i++) {
+				uint64_t bucket = hashOf(b[i].key) & mask;
+				chain[i] = heads[bucket];
+				heads[bucket] = static_cast<uint32_t>(i + 1);
+			}
+
+			for (size_t j = 0; j < probeRows; j++) {
+				uint64_t key = q[j].key;
+				for (uint32_t i = heads[hashOf(key) & mask]; i != 0; i = chain[i - 1]) {
+					if (b[i - 1].key == key) {
+						out.left.push_back(swapped ? q[j].row : b[i - 1].row);
+						out.right.push_back(swapped ? b[i - 1].row : q[j].row);
+					}
+				}
+			}
+		}
+	});
+
+	std::vector<size_t> offsets(threads + 1, 0);
+	for (size_t t = 0; t < threads; t++) {
+		offsets[t + 1] = offsets[t] + found[t].left.size();
+	}
+	if (threads == 1) {
+		return std::move(found[0]);
+	}
+	result.left.resize(offsets[threads]);
+	result.right.resize(offsets[threads]);
+	runParallel(threads, [&](size_t t) {
+		std::copy(found[t].left.begin(), found[t].left.end(), result.left.begin() + offsets[t]);
+		std::copy(found[t].right.begin(), found[t].right.end(), result.right.begin() + offsets[t]);
+	});
+	return result;
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace execution {
+
+// A radix join matches the rows of two inputs on equal keys. Both inputs
+// are first scattered into partitions by the high bits of their keys'
+// hash, each partition of the smaller input small enough for its hash
+// table to stay in the L2 cache; each pair of partitions is then joined on
+// its own, so building and probing never miss the cache. Partitioning and
+// joining both run on several threads.
+
+// joinEntry is a row of a join input: its INT key, or the hash of its TEXT
+// key, and the row it came from
+struct joinEntry {
+	uint64_t key;
+	uint64_t row;
+};
+
+struct joinOptions {
+	// threads partition and join in parallel; zero uses every core, or
+	// fewer for small inputs
+	size_t threads = 0;
+	// cacheBytes is what the hash table of one partition may take up
+	size_t cacheBytes = 256 * 1024;
+};
+
+// joinPairs are the matching rows of a join, left[i] with right[i]
+struct joinPairs {
+	std::vector<uint64_t> left;
+	std::vector<uint64_t> right;
+};
+
+// radixJoin returns every pair of a left and a right entry with equal
+// keys, in no particular order. Entries whose keys are hashes match on
+// equal hashes, so the caller checks that their values are equal too.
+joinPairs radixJoin(std::vector<joinEntry> left, std::vector<joinEntry> right, joinOptions opts = {});
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "../lexer/pool.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+namespace execution {
+
+// availableThreads is the number of threads that run at once on this
+// machine
+inline size_t availableThreads() {
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// hashOf mixes every bit of key into every bit of the hash, so that the
+// partitioned operators can take its high bits for the partition and the
+// hash tables within partitions its low bits
+inline uint64_t hashOf(uint64_t key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+// runParallel calls fn(t) for every t below threads on the shared thread
+// pool, the calling thread taking part, and returns once all are done.
+// Operators call it several times per query, so no call starts threads.
+template <typename F>
+void runParallel(size_t threads, F fn) {
+	nicolassql::sharedPool().parallelFor(threads, fn);
+}
+
+}
@@ -0,0 +1,352 @@
+#include "sort.h"
+#include "parallel.h"
+#include <algorithm>
+
+namespace execution {
+
+namespace {
+
+// below minRowsPerThread rows per thread, starting the threads costs more
+// than they save
+constexpr size_t minRowsPerThread = 1 << 16;
+
+size_t threadsFor(size_t threads, size_t rows) {
+	if (threads != 0) {
+		return threads;
+	}
+	return std::min(availableThreads(), std::max<size_t>(1, rows / minRowsPerThread));
+}
+
+uint64_t normalizedInt(int64_t value, bool descending) {
+	uint64_t key = static_cast<uint64_t>(value) ^ (uint64_t{1} << 63);
+	return descending ? ~key : key;
+}
+
+// normalizedText is the first eight bytes of value, big-endian, shorter
+// values padded with zeros
+uint64_t normalizedText(std::string_view value, bool descending) {
+	uint64_t key = 0;
+	for (size_t i = 0; i < sizeof(key); i++) {
+		key = (key << 8) | (i < value.size() ? static_cast<unsigned char>(value[i]) : 0);
+	}
+	return descending ? ~key : key;
+}
+
+// exactText is the first seven bytes of value followed by its length, an
+// order preserving key that ties only for equal values when every value
+// is at most seven bytes long
+uint64_t exactText(std::string_view value, bool descending) {
+	uint64_t key = 0;
+	for (size_t i = 0; i < sizeof(key) - 1; i++) {
+		key = (key << 8) | (i < value.size() ? static_cast<unsigned char>(value[i]) : 0);
+	}
+	key = (key << 8) | value.size();
+	return descending ? ~key : key;
+}
+
+// compareRows orders rows a and b of r by keys from the first'th on,
+// negative when a goes first
+int compareRows(const resultSet& r, const std::vector<sortKey>& keys, size_t first, uint64_t a, uint64_t b) {
+	for (size_t i = first; i < keys.size(); i++) {
+		const sortKey& k = keys[i];
+		const storage::column& col = r.columns[k.column];
+		int order = 0;
+		if (col.type == storage::columnType::intType) {
+			order = col.ints[a] < col.ints[b] ? -1 : col.ints[a] > col.ints[b] ? 1 : 0;
+		} else {
+			order = col.text(a).compare(col.text(b));
+		}
+		if (order != 0) {
+			return k.descending ? -order : order;
+		}
+	}
+	return 0;
+}
+
+// entryOrder orders the entries of rows of r by their normalized keys,
+// then by keys, then by row, so that the order is total and stable. When
+// exact is set the normalized keys tie only for equal first keys, which
+// then need no comparing.
+struct entryOrder {
+	const resultSet& r;
+	const std::vector<sortKey>& keys;
+	bool exact = false;
+
+	bool operator()(const sortEntry& a, const sortEntry& b) const {
+		if (a.key != b.key) {
+			return a.key < b.key;
+		}
+		int order = compareRows(r, keys, exact ? 1 : 0, a.row, b.row);
+		return order != 0 ? order < 0 : a.row < b.row;
+	}
+};
+
+// mergeSort sorts a stretch of entries per thread and then merges the
+// stretches pairwise, the merges of a round running side by side
+void mergeSort(std::vector<sortEntry>& entries, const entryOrder& less, size_t threads) {
+	std::vector<size_t> bounds(threads + 1);
+	for (size_t t = 0; t <= threads; t++) {
+		bounds[t] = entries.size() * t / threads;
+	}
+	runParallel(threads, [&](size_t t) {
+		std::sort(entries.begin() + bounds[t], entries.begin() + bounds[t + 1], less);
+	});
+	for (size_t step = 1; step < threads; step *= 2) {
+		runParallel((threads + 2 * step - 1) / (2 * step), [&](size_t p) {
+			size_t lo = p * 2 * step;
+			size_t mid = std::min(lo + step, threads);
+			size_t hi = std::min(lo + 2 * step, threads);
+			std::inplace_merge(entries.begin() + bounds[lo], entries.begin() + bounds[mid], entries.begin() + bounds[hi], less);
+		});
+	}
+}
+
+// gather copies the first columns columns of the rows of from that
+// entries point at, in the order of entries
+resultSet gather(const resultSet& from, const std::vector<sortEntry>& entries, size_t columns) {
+	resultSet out;
+	out.rows = entries.size();
+	for (size_t i = 0; i < columns; i++) {
+		const storage::column& col = from.columns[i];
+		storage::column& to = out.columns.emplace_back(storage::column{.name = col.name, .type = col.type});
+		if (col.type == storage::columnType::intType) {
+			to.ints.resize(entries.size());
+			int64_t* ints = to.ints.data();
+			for (size_t j = 0; j < entries.size(); j++) {
+				ints[j] = col.ints[entries[j].row];
+			}
+			continue;
+		}
+
+		size_t bytes = 0;
+		for (const sortEntry& e : entries) {
+			bytes += col.text(e.row).size();
+		}
+		to.chars.reserve(bytes);
+		to.offsets.reserve(entries.size() + 1);
+		for (const sortEntry& e : entries) {
+			to.appendText(col.text(e.row));
+		}
+	}
+	return out;
+}
+
+// resultFor makes the empty columns of a result of the given types
+resultSet resultFor(const std::vector<storage::columnType>& types) {
+	resultSet r;
+	for (storage::columnType type : types) {
+		r.columns.push_back(storage::column{.type = type});
+	}
+	return r;
+}
+
+}
+
+void radixSort(std::vector<sortEntry>& entries, size_t threads) {
+	size_t n = entries.size();
+	if (n < 2) {
+		return;
+	}
+	threads = threadsFor(threads, n);
+	auto stretch = [&](size_t t) { return n * t / threads; };
+
+	// bytes in which no two keys differ need no pass
+	std::vector<uint64_t> differing(threads, 0);
+	runParallel(threads, [&](size_t t) {
+		uint64_t first = entries[0].key;
+		for (size_t i = stretch(t); i < stretch(t + 1); i++) {
+			differing[t] |= entries[i].key ^ first;
+		}
+	});
+	uint64_t differs = 0;
+	for (uint64_t d : differing) {
+		differs |= d;
+	}
+
+	std::vector<sortEntry> buffer(n);
+	sortEntry* from = entries.data();
+	sortEntry* to = buffer.data();
+	std::vector<size_t> positions(threads * 256);
+	for (unsigned shift = 0; shift < 64; shift += 8) {
+		if (((differs >> shift) & 0xff) == 0) {
+			continue;
+		}
+
+		std::fill(positions.begin(), positions.end(), 0);
+		runParallel(threads, [&](size_t t) {
+			size_t* counts = positions.data() + t * 256;
+			for (size_t i = stretch(t); i < stretch(t + 1); i++) {
+				counts[(from[i].key >> shift) & 0xff]++;
+			}
+		});
+
+		// thread t writes its entries of each byte value after those of the
+		// threads before it, which keeps the sort stable
+		size_t offset = 0;
+		for (size_t b = 0; b < 256; b++) {
+			for (size_t t = 0; t < threads; t++) {
+				size_t count = positions[t * 256 + b];
+				positions[t * 256 + b] = offset;
+				offset += count;
+			}
+		}
+
+		runParallel(threads, [&](size_t t) {
+			size_t* next = positions.data() + t * 256;
+			for (size_t i = stretch(t); i < stretch(t + 1); i++) {
+				to[next[(from[i].key >> shift) & 0xff]++] = from[i];
+			}
+		});
+		std::swap(from, to);
+	}
+
+	if (from != entries.data()) {
+		entries.swap(buffer);
+	}
+}
+
+sortRows::sortRows(std::unique_ptr<physicalOperator> child, std::vector<sortKey> keys, size_t columns, size_t threads)
+	: child(std::move(child)), keys(std::move(keys)), columns(columns), threads(threads) {}
+
+void sortRows::run() {
+	resultSet input = resultFor(child->schema());
+	batch b;
+	while (child->next(b)) {
+		appendBatch(input, b);
+	}
+
+	const sortKey& first = keys[0];
+	const storage::column& col = input.columns[first.column];
+	std::vector<sortEntry> entries(input.rows);
+	bool exact = true;
+	if (col.type == storage::columnType::intType) {
+		for (size_t row = 0; row < input.rows; row++) {
+			entries[row] = sortEntry{.key = normalizedInt(col.ints[row], first.descending), .row = row};
+		}
+	} else {
+		// the bytes every value starts with decide nothing, so the
+		// normalized keys start after them
+		size_t shared = input.rows == 0 ? 0 : col.text(0).size();
+		for (size_t row = 1; row < input.rows && shared > 0; row++) {
+			std::string_view a = col.text(0).substr(0, shared);
+			std::string_view b = col.text(row);
+			size_t same = 0;
+			while (same < a.size() && same < b.size() && a[same] == b[same]) {
+				same++;
+			}
+			shared = same;
+		}
+		for (size_t row = 0; row < input.rows && exact; row++) {
+			exact = col.text(row).size() - shared < sizeof(uint64_t);
+		}
+		for (size_t row = 0; row < input.rows; row++) {
+			std::string_view value = col.text(row).substr(shared);
+			uint64_t key = exact ? exactText(value, first.descending) : normalizedText(value, first.descending);
+			entries[row] = sortEntry{.key = key, .row = row};
+		}
+	}
+
+	size_t workers = threadsFor(threads, entries.size());
+	if (keys.size() == 1 && exact) {
+		radixSort(entries, workers);
+	} else {
+		mergeSort(entries, entryOrder{input, keys, exact}, workers);
+	}
+	result = gather(input, entries, columns);
+}
+
+bool sortRows::next(batch& out) {
+	if (!done) {
+		run();
+		done = true;
+	}
+	return emitBatch(result, position, out);
+}
+
+std::vector<storage::columnType> sortRows::schema() const {
+	std::vector<storage::columnType> types = child->schema();
+	types.resize(columns);
+	return types;
+}
+
+topN::topN(std::unique_ptr<physicalOperator> child, std::vector<sortKey> keys, size_t columns, size_t limit)
+	: child(std::move(child)), keys(std::move(keys)), columns(columns), limit(limit) {}
+
+void topN::run() {
+	// kept holds the rows that were among the best when they came in; the
+	// heap points at those that still are, the worst on top
+	resultSet kept = resultFor(child->schema());
+	entryOrder less{kept, keys};
+	std::vector<sortEntry> heap;
+	heap.reserve(limit);
+
+	const sortKey& first = keys[0];
+	std::vector<uint32_t> candidates;
+	std::vector<uint64_t> candidateKeys;
+	batch b;
+	while (limit > 0 && child->next(b)) {
+		const columnVector& v = b.columns[first.column];
+		candidates.clear();
+		candidateKeys.clear();
+		for (size_t i = 0; i < b.count; i++) {
+			size_t position = b.position(i);
+			uint64_t key = v.type == storage::columnType::intType
+				? normalizedInt(v.intAt(position), first.descending)
+				: normalizedText(v.textAt(position), first.descending);
+			if (heap.size() < limit || key <= heap.front().key) {
+				candidates.push_back(static_cast<uint32_t>(position));
+				candidateKeys.push_back(key);
+			}
+		}
+		if (candidates.empty()) {
+			continue;
+		}
+
+		batch picked = b;
+		picked.count = candidates.size();
+		picked.selection = candidates.data();
+		size_t start = kept.rows;
+		appendBatch(kept, picked);
+		for (size_t i = 0; i < candidates.size(); i++) {
+			sortEntry e{.key = candidateKeys[i], .row = start + i};
+			if (heap.size() < limit) {
+				heap.push_back(e);
+				std::push_heap(heap.begin(), heap.end(), less);
+			} else if (less(e, heap.front())) {
+				std::pop_heap(heap.begin(), heap.end(), less);
+				heap.back() = e;
+				std::push_heap(heap.begin(), heap.end(), less);
+			}
+		}
+
+		// rows that dropped out of the heap are let go of once they make up
+		// most of kept; the rows left keep their order, and so their ties
+		if (kept.rows > 2 * limit + batchSize) {
+			std::sort(heap.begin(), heap.end(), [](const sortEntry& x, const sortEntry& y) { return x.row < y.row; });
+			kept = gather(kept, heap, kept.columns.size());
+			for (size_t i = 0; i < heap.size(); i++) {
+				heap[i].row = i;
+			}
+			std::make_heap(heap.begin(), heap.end(), less);
+		}
+	}
+
+	std::sort_heap(heap.begin(), heap.end(), less);
+	result = gather(kept, heap, columns);
+}
+
+bool topN::next(batch& out) {
+	if (!done) {
+		run();
+		done = true;
+	}
+	return emitBatch(result, position, out);
+}
+
+std::vector<storage::columnType> topN::schema() const {
+	std::vector<storage::columnType> types = child->schema();
+	types.resize(columns);
+	return types;
+}
+
+}
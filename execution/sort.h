@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "execution.h"
+
+namespace execution {
+
+// Sorting compares rows by a normalized key first: a uint64_t whose
+// unsigned order is the order of the first sort key, an INT with its sign
+// bit flipped or the first eight bytes of a TEXT after those all values
+// share, inverted when the key is descending. Only rows whose normalized
+// keys tie are compared value by value. INT keys, and TEXT keys of at
+// most seven bytes after the shared ones, are normalized exactly, so a
+// lone such key is decided by its normalized key alone and radix sorted.
+
+// sortKey is a column to order by
+struct sortKey {
+	size_t column;
+	bool descending = false;
+};
+
+// sortEntry is a row to sort and its normalized key
+struct sortEntry {
+	uint64_t key;
+	uint64_t row;
+};
+
+// radixSort sorts entries by key, stably, a byte at a time from the
+// lowest. Each pass is split between threads, zero using every core, and
+// passes over bytes that all entries share are skipped.
+void radixSort(std::vector<sortEntry>& entries, size_t threads = 0);
+
+// sortRows emits the rows of its child ordered by keys, ties keeping the
+// order the child produced them in. It reads the whole child first. Only
+// the first columns columns are emitted, so keys may be columns that are
+// not part of the result.
+class sortRows : public physicalOperator {
+public:
+	sortRows(std::unique_ptr<physicalOperator> child, std::vector<sortKey> keys, size_t columns, size_t threads = 0);
+	bool next(batch& out) override;
+	std::vector<storage::columnType> schema() const override;
+
+private:
+	void run();
+
+	std::unique_ptr<physicalOperator> child;
+	std::vector<sortKey> keys;
+	size_t columns;
+	size_t threads;
+
+	bool done = false;
+	resultSet result;
+	size_t position = 0;
+};
+
+// topN emits the first limit rows of its child as sortRows would order
+// them, keeping only the best rows seen so far in a bounded heap: a row
+// whose normalized key is worse than that of the worst row kept is
+// dropped without being copied.
+class topN : public physicalOperator {
+public:
+	topN(std::unique_ptr<physicalOperator> child, std::vector<sortKey> keys, size_t columns, size_t limit);
+	bool next(batch& out) override;
+	std::vector<storage::columnType> schema() const override;
+
+private:
+	void run();
+
+	std::unique_ptr<physicalOperator> child;
+	std::vector<sortKey> keys;
+	size_t columns;
+	size_t limit;
+
+	bool done = false;
+	resultSet result;
+	size_t position = 0;
+};
+
+}
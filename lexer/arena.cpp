@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <cstring>
+#include "arena.h"
+
+namespace nicolassql {
+
+// blocks double in size up to this, so big parses take few trips to the heap
+constexpr size_t maxBlockSize = 1 << 20;
+
+arena::arena(size_t initialBlockSize) : blockSize(initialBlockSize) {}
+
+arena::~arena() {
+	runFinalizers();
+}
+
+void arena::runFinalizers() {
+	for (finalizer* f = finalizers; f != nullptr; f = f->next) {
+		f->destroy(f->object);
+	}
+	finalizers = nullptr;
+}
+
+void arena::reset() {
+	runFinalizers();
+
+	if (!blocks.empty()) {
+		auto largest = std::max_element(blocks.begin(), blocks.end(),
+			[](const block& a, const block& b) { return a.size < b.size; });
+		block kept = std::move(*largest);
+		blocks.clear();
+		blocks.push_back(std::move(kept));
+
+		next = blocks.back().memory.get();
+		end = next + blocks.back().size;
+	}
+
+	allocated = 0;
+	reserved = blocks.empty() ? 0 : blocks.back().size;
+	nodes = 0;
+}
+
+void* arena::grow(size_t size, size_t alignment) {
+	size_t needed = size + alignment;
+
+	// oversized requests get a block of their own so the current one can
+	// keep serving small requests
+	if (needed > blockSize / 4 && next != nullptr) {
+		blocks.push_back(block{std::unique_ptr<std::byte[]>(new std::byte[needed]), needed});
+		reserved += needed;
+		allocated += size;
+
+		uintptr_t start = reinterpret_cast<uintptr_t>(blocks.back().memory.get());
+		start = (start + alignment - 1) & ~(uintptr_t(alignment) - 1);
+		return reinterpret_cast<void*>(start);
+	}
+
+	size_t length = std::max(blockSize, needed);
+	blocks.push_back(block{std::unique_ptr<std::byte[]>(new std::byte[length]), length});
+	reserved += length;
+	next = blocks.back().memory.get();
+	end = next + length;
+	blockSize = std::min(blockSize * 2, maxBlockSize);
+
+	return bump(size, alignment);
+}
+
+std::string_view arena::copy(std::string_view text) {
+	char* out = static_cast<char*>(bump(text.size(), 1));
+	std::memcpy(out, text.data(), text.size());
+	return {out, text.size()};
+}
+
+void* arena::do_allocate(size_t bytes, size_t alignment) {
+	return bump(bytes, alignment);
+}
+
+void arena::do_deallocate(void*, size_t, size_t) {
+	// memory is only given back when the whole arena goes away
+}
+
+bool arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+	return this == &other;
+}
+
+}
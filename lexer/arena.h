@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nicolassql {
+
+// arena is a monotonic bump allocator. Everything allocated from it, the
+// tokens of a parse and the AST nodes built from them, stays valid until
+// the arena is destroyed and is then released in one shot, a block at a
+// time. It is also a memory_resource so std::pmr containers can live in it.
+class arena : public std::pmr::memory_resource {
+public:
+	explicit arena(size_t initialBlockSize = 4096);
+	~arena() override;
+
+	arena(const arena&) = delete;
+	arena& operator=(const arena&) = delete;
+
+	// make constructs a T in the arena. Destructors of types that need one
+	// run when the arena is destroyed.
+	template <typename T, typename... Args>
+	T* make(Args&&... args) {
+		T* object = new (bump(sizeof(T), alignof(T))) T{std::forward<Args>(args)...};
+		nodes++;
+
+		if constexpr (!std::is_trivially_destructible_v<T>) {
+			finalizers = new (bump(sizeof(finalizer), alignof(finalizer))) finalizer{
+				.destroy = [](void* p) { static_cast<T*>(p)->~T(); },
+				.object = object,
+				.next = finalizers,
+			};
+		}
+
+		return object;
+	}
+
+	std::string_view copy(std::string_view text);
+
+	// reset frees everything allocated so far but keeps the largest block
+	// for reuse, so a loop that resets per iteration stops touching the heap
+	void reset();
+
+	// bytesAllocated is what callers asked for, bytesReserved what the
+	// arena took from the heap to serve them
+	uint64_t bytesAllocated() const { return allocated; }
+	uint64_t bytesReserved() const { return reserved; }
+	uint64_t nodesAllocated() const { return nodes; }
+
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+	struct finalizer {
+		void (*destroy)(void*);
+		void* object;
+		finalizer* next;
+	};
+
+	void* bump(size_t size, size_t alignment) {
+		uintptr_t start = (reinterpret_cast<uintptr_t>(next) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+		if (next == nullptr || start + size > reinterpret_cast<uintptr_t>(end)) {
+			return grow(size, alignment);
+		}
+
+		next = reinterpret_cast<std::byte*>(start + size);
+		allocated += size;
+		return reinterpret_cast<void*>(start);
+	}
+
+	void* grow(size_t size, size_t alignment);
+
+	struct block {
+		std::unique_ptr<std::byte[]> memory;
+		size_t size;
+	};
+
+	void runFinalizers();
+
+	std::vector<block> blocks;
+	std::byte* next = nullptr;
+	std::byte* end = nullptr;
+	size_t blockSize;
+	finalizer* finalizers = nullptr;
+
+	uint64_t allocated = 0;
+	uint64_t reserved = 0;
+	uint64_t nodes = 0;
+};
+
+}
@@ -1,8 +1,12 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
 #include <iterator>
 #include <string>
 #include <tuple>
 #include <vector>
 #include "lexer.h"
+#include "scan.h"
 
 namespace nicolassql {
 
@@ -10,23 +14,26 @@ namespace nicolassql {
 	std::tuple<std::unique_ptr<token>, cursor, bool> lexSymbol(std::string_view source, cursor ic);
 	std::tuple<std::unique_ptr<token>, cursor, bool> lexString(std::string_view source, cursor ic);
 	std::tuple<std::unique_ptr<token>, cursor, bool> lexNumeric(std::string_view source, cursor ic);
-	std::tuple<std::unique_ptr<token>, cursor, bool> lexIdentifier(std::string_view source, cursor ic);
+	std::tuple<std::unique_ptr<token>, cursor, bool> lexIdentifier(std::string_view source, cursor ic, arena& storage);
 
-std::tuple<std::vector<token*>, std::string> lex(std::string_view source) {
+std::tuple<std::vector<token*>, std::string> lexReference(std::string_view source, arena& storage) {
 	std::vector<token*> tokens;
 	cursor cur{};
 
+	lexer identifierLexer = [&storage](std::string_view source, const cursor& ic) {
+		return lexIdentifier(source, ic, storage);
+	};
+	const std::array<lexer, 6> lexers = {
+		&lexKeyword, &lexSymbol, &lexString, &lexNumeric, &lexPlaceholder, identifierLexer
+	};
+
 	while (cur.pointer < source.length()) {
 		bool matched = false;
-		using LexerFn = std::tuple<std::unique_ptr<token>, cursor, bool>(*)(std::string_view, cursor);
-		static constexpr std::array<LexerFn, 5> lexers = {
-			&lexKeyword, &lexSymbol, &lexString, &lexNumeric, &lexIdentifier
-		};
-		for (lexer l : lexers) {
+		for (const lexer& l : lexers) {
 			if (auto [token, newCursor, ok] = l(source, cur); ok) {
 				cur = newCursor;
 				if (token != nullptr) {
-					tokens.push_back(token.release());
+					tokens.push_back(storage.make<nicolassql::token>(*token));
 				}
 
 				matched = true;
@@ -117,9 +124,12 @@ std::tuple<std::unique_ptr<token>, cursor, bool> lexNumeric(std::string_view sou
 		return {nullptr, ic, false};
 	}
 
+	// the loop bumps the column before it sees the terminating character
+	cur.loc.col = ic.loc.col + (cur.pointer - ic.pointer);
+
 	return std::make_tuple(
 		std::make_unique<token>(token{
-			.value = std::string(source.substr(ic.pointer, cur.pointer - ic.pointer)),
+			.value = source.substr(ic.pointer, cur.pointer - ic.pointer),
 			.kind = tokenKind::numericKind,
 			.loc = ic.loc
 		}),
@@ -143,30 +153,32 @@ std::tuple<std::unique_ptr<token>, cursor, bool> lexCharacterDelimited(std::stri
 	cur.loc.col++;
 	cur.pointer++;
 
-	std::vector<char> value;
 	for(; cur.pointer < source.length(); cur.pointer++) {
 		char c = source[cur.pointer];
 
 		if (c == delimiter) {
 			// SQL escapes are via double characters, not backslash
 			if (cur.pointer+1 >= source.length() || source[cur.pointer+1] != delimiter) {
+				// step past the closing delimiter
+				cur.pointer++;
+				cur.loc.col++;
+
 				return std::make_tuple(
 					std::make_unique<token>(token{
-						.value = std::string(value.begin(), value.end()),
-						.loc = ic.loc,
+						// escapes stay doubled, so the value is a plain view
+						.value = source.substr(ic.pointer + 1, cur.pointer - ic.pointer - 2),
 						.kind = tokenKind::stringKind,
+						.loc = ic.loc,
 					}), 
 					cur, 
 					true			
 				);
 			} else {
-				value.push_back(delimiter);
 				cur.pointer++;
 				cur.loc.col++;
 			}
 		}
 
-		value.push_back(c);
 		cur.loc.col++;
 	}
 
@@ -229,6 +241,10 @@ std::string longestMatch(std::string_view source, cursor ic, std::vector<std::st
 }
 
 std::tuple<std::unique_ptr<token>, cursor, bool> lexSymbol(std::string_view source, cursor ic) {
+	if (ic.pointer >= source.length()) {
+		return {nullptr, ic, false};
+	}
+
 	char c = source[ic.pointer];
 	cursor cur = ic;
 
@@ -250,6 +266,32 @@ std::tuple<std::unique_ptr<token>, cursor, bool> lexSymbol(std::string_view sour
 	case ')':
 	case ';':
 	case '*':
+	case '=':
+		break;
+	case '|':
+		// only valid as the || concatenation operator
+		if (cur.pointer >= source.length() || source[cur.pointer] != '|') {
+			return {nullptr, ic, false};
+		}
+		cur.pointer++;
+		cur.loc.col++;
+		break;
+	case '!':
+		// only valid as the != comparison
+		if (cur.pointer >= source.length() || source[cur.pointer] != '=') {
+			return {nullptr, ic, false};
+		}
+		cur.pointer++;
+		cur.loc.col++;
+		break;
+	case '<':
+	case '>':
+		// <=, >= and <> take the second character too
+		if (cur.pointer < source.length() &&
+				(source[cur.pointer] == '=' || (c == '<' && source[cur.pointer] == '>'))) {
+			cur.pointer++;
+			cur.loc.col++;
+		}
 		break;
 	default:
 		return {nullptr, ic, false};
@@ -257,9 +299,10 @@ std::tuple<std::unique_ptr<token>, cursor, bool> lexSymbol(std::string_view sour
 
 	return std::make_tuple(
 		std::make_unique<token>(token{
-			.value = std::string(1, c),
-			.loc = ic.loc,
+			.value = source.substr(ic.pointer, cur.pointer - ic.pointer),
 			.kind = tokenKind::symbolKind,
+			.id = internedId(symbols, source.substr(ic.pointer, cur.pointer - ic.pointer)),
+			.loc = ic.loc,
 		}), 
 		cur, 
 		true			
@@ -280,11 +323,24 @@ std::tuple<std::unique_ptr<token>, cursor, bool> lexKeyword(std::string_view sou
 		textKeyword,
 		intKeyword,
 		asKeyword,
+		whereKeyword,
+		andKeyword,
+		orKeyword,
+		indexKeyword,
+		onKeyword,
+		copyKeyword,
+		joinKeyword,
+		groupKeyword,
+		byKeyword,
+		orderKeyword,
+		limitKeyword,
+		ascKeyword,
+		descKeyword,
 	};
 	
 	std::vector<char> value;
 	std::vector<int> skipList;
-	std::string match;
+	keyword match;
 
 	while (cur.pointer < source.size()) {
 		char c = source[cur.pointer++];
@@ -305,7 +361,7 @@ std::tuple<std::unique_ptr<token>, cursor, bool> lexKeyword(std::string_view sou
 			if (prefix == kw) {
 				skipList.push_back(i);
 				if (len_kw > match.size()) {
-					match = std::string(kw);
+					match = kw;
 				}
 				continue;
 			}
@@ -327,23 +383,80 @@ std::tuple<std::unique_ptr<token>, cursor, bool> lexKeyword(std::string_view sou
 		return {nullptr, ic, false};
 	}
 
+	// a keyword has to be the whole word: "orders" is an identifier, not
+	// the keyword or followed by "ders"
+	if (ic.pointer + match.size() < source.size()) {
+		char next = source[ic.pointer + match.size()];
+		bool isAlphanumeric = (next >= 'A' && next <= 'Z') || (next >= 'a' && next <= 'z') || (next >= '0' && next <= '9');
+		if (isAlphanumeric || next == '$' || next == '_') {
+			return {nullptr, ic, false};
+		}
+		// nor is the table of a qualified name, as in "on.x"
+		if (next == '.' && ic.pointer + match.size() + 1 < source.size()) {
+			char after = source[ic.pointer + match.size() + 1];
+			if ((after >= 'A' && after <= 'Z') || (after >= 'a' && after <= 'z')) {
+				return {nullptr, ic, false};
+			}
+		}
+	}
+
 	cur.pointer = ic.pointer + match.size();
 	cur.loc.col = ic.loc.col + static_cast<uint64_t>(match.size());
 
 	auto tok = std::make_unique<token>(token{
 			.value = match,
 			.kind = tokenKind::keywordKind,
-			.loc = ic.loc
+			.id = internedId(nicolassql::keywords, match),
+			.loc = ic.loc,
 			});
 	return {std::move(tok), cur, true};
 }
 
-std::tuple<std::unique_ptr<token>, cursor, bool> lexIdentifier(std::string_view source, cursor ic) {
+std::tuple<std::unique_ptr<token>, cursor, bool> lexPlaceholder(std::string_view source, cursor ic) {
+	if (ic.pointer >= source.length()) {
+		return {nullptr, ic, false};
+	}
+
+	cursor cur = ic;
+	char c = source[cur.pointer];
+	if (c == '?') {
+		cur.pointer++;
+	} else if (c == '$') {
+		cur.pointer++;
+		// $ must be followed by the parameter number
+		while (cur.pointer < source.length() && source[cur.pointer] >= '0' && source[cur.pointer] <= '9') {
+			cur.pointer++;
+		}
+		if (cur.pointer == ic.pointer + 1) {
+			return {nullptr, ic, false};
+		}
+	} else {
+		return {nullptr, ic, false};
+	}
+
+	cur.loc.col += cur.pointer - ic.pointer;
+	return std::make_tuple(
+		std::make_unique<token>(token{
+			.value = source.substr(ic.pointer, cur.pointer - ic.pointer),
+			.kind = tokenKind::placeholderKind,
+			.loc = ic.loc,
+		}),
+		cur,
+		true
+	);
+}
+
+std::tuple<std::unique_ptr<token>, cursor, bool> lexIdentifier(std::string_view source, cursor ic, arena& storage) {
 	// handle seperately if it is a double-quoted identifier
 	if (auto [tok, newCursor, ok] = lexCharacterDelimited(source, ic, '"'); ok) {
+		tok->kind = tokenKind::identifierKind;
 		return {std::move(tok), newCursor, true};
 	}	
 
+	if (ic.pointer >= source.length()) {
+		return {nullptr, ic, false};
+	}
+
 	cursor cur = ic;
 
 	char c = source[cur.pointer];
@@ -355,35 +468,47 @@ std::tuple<std::unique_ptr<token>, cursor, bool> lexIdentifier(std::string_view
 	cur.pointer++;
 	cur.loc.col++;
 
-	std::vector<char> value = {c};
+	bool hasUpper = c >= 'A' && c <= 'Z';
+	bool qualified = false;
 	for(; cur.pointer < source.length(); cur.pointer++) {
 		c = source[cur.pointer];
 
 		isAlphabetical = (c >= 'A' && c <= 'Z' || (c >= 'a' && c <= 'z'));
 		bool isNumeric = (c >= '0' && c <= '9');
 		if (isAlphabetical || isNumeric || c == '$' || c == '_') {
-			value.push_back(c);
+			hasUpper = hasUpper || (c >= 'A' && c <= 'Z');
 			cur.loc.col++;
 			continue;
 		}
 
-		break;
-	}
+		// a qualified name, table.column, is a single identifier
+		if (c == '.' && !qualified && cur.pointer+1 < source.length()) {
+			char next = source[cur.pointer+1];
+			if ((next >= 'A' && next <= 'Z') || (next >= 'a' && next <= 'z')) {
+				qualified = true;
+				cur.loc.col++;
+				continue;
+			}
+		}
 
-	if (value.size() == 0) {
-		return {nullptr, ic, false};
+		break;
 	}
 
+	std::string_view identifier = source.substr(ic.pointer, cur.pointer - ic.pointer);
 
-	std::string rawIdentifier(value.begin(), value.end());
-	std::transform(rawIdentifier.begin(), rawIdentifier.end(), rawIdentifier.begin(),
+	// only identifiers that need lowercasing are copied
+	if (hasUpper) {
+		char* lowered = static_cast<char*>(storage.allocate(identifier.size(), 1));
+		std::transform(identifier.begin(), identifier.end(), lowered,
                [](unsigned char c) { return std::tolower(c); });
+		identifier = std::string_view(lowered, identifier.size());
+	}
 
 	return std::make_tuple(
 		std::make_unique<token>(token{
-			.value = std::move(rawIdentifier),
-			.loc = ic.loc,
+			.value = identifier,
 			.kind = tokenKind::identifierKind,
+			.loc = ic.loc,
 		}), 
 		cur, 
 		true			
@@ -391,8 +516,467 @@ std::tuple<std::unique_ptr<token>, cursor, bool> lexIdentifier(std::string_view
 
 }
 
-std::tuple<std::unique_ptr<token>, cursor, bool> lexString(std::string source, cursor ic) {
-	return lexCharacterDelimited(source, ic, '\'');
+// The functions above each try to match one kind of token and are run in
+// turn at every position by lexReference. lex below produces the same
+// tokens in a single pass: the first byte of a token is classified through
+// a 256-entry table and only the matching scanner runs.
+
+enum class charClass : uint8_t {
+	invalidClass = 0,
+	spaceClass,
+	newlineClass,
+	symbolClass,
+	pipeClass,
+	quoteClass,
+	doubleQuoteClass,
+	digitClass,
+	periodClass,
+	letterClass,
+	questionClass,
+	dollarClass,
+	comparisonClass,
+};
+
+constexpr std::array<charClass, 256> makeCharClasses() {
+	std::array<charClass, 256> classes{};
+	for (int c = 'a'; c <= 'z'; c++) {
+		classes[c] = charClass::letterClass;
+	}
+	for (int c = 'A'; c <= 'Z'; c++) {
+		classes[c] = charClass::letterClass;
+	}
+	for (int c = '0'; c <= '9'; c++) {
+		classes[c] = charClass::digitClass;
+	}
+	classes[' '] = charClass::spaceClass;
+	classes['\t'] = charClass::spaceClass;
+	classes['\n'] = charClass::newlineClass;
+	for (unsigned char c : {',', '(', ')', ';', '*', '='}) {
+		classes[c] = charClass::symbolClass;
+	}
+	classes['|'] = charClass::pipeClass;
+	classes['\''] = charClass::quoteClass;
+	classes['"'] = charClass::doubleQuoteClass;
+	classes['.'] = charClass::periodClass;
+	classes['?'] = charClass::questionClass;
+	classes['$'] = charClass::dollarClass;
+	for (unsigned char c : {'<', '>', '!'}) {
+		classes[c] = charClass::comparisonClass;
+	}
+	return classes;
+}
+
+constexpr std::array<bool, 256> makeIdentifierChars() {
+	std::array<bool, 256> chars{};
+	for (int c = 'a'; c <= 'z'; c++) {
+		chars[c] = true;
+	}
+	for (int c = 'A'; c <= 'Z'; c++) {
+		chars[c] = true;
+	}
+	for (int c = '0'; c <= '9'; c++) {
+		chars[c] = true;
+	}
+	chars['$'] = true;
+	chars['_'] = true;
+	return chars;
+}
+
+constexpr std::array<char, 256> makeLowercase() {
+	std::array<char, 256> lower{};
+	for (int c = 0; c < 256; c++) {
+		lower[c] = static_cast<char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+	}
+	return lower;
+}
+
+constexpr auto charClasses = makeCharClasses();
+constexpr auto identifierChars = makeIdentifierChars();
+constexpr auto lowercase = makeLowercase();
+
+inline char lowerAt(std::string_view source, uint64_t i) {
+	return lowercase[static_cast<unsigned char>(source[i])];
+}
+
+constexpr size_t keywordSlots = 64;
+constexpr int8_t emptySlot = -1;
+
+// keywordHash only looks at the length and the two end characters, which
+// is enough to separate every keyword; the static_assert below fails the
+// build if a new keyword collides with an existing one.
+constexpr size_t keywordHash(char first, char last, size_t length) {
+	return (5 * static_cast<unsigned char>(first) + 7 * static_cast<unsigned char>(last) + 5 * length) & (keywordSlots - 1);
+}
+
+constexpr std::array<int8_t, keywordSlots> makeKeywordTable() {
+	std::array<int8_t, keywordSlots> table{};
+	for (auto& slot : table) {
+		slot = emptySlot;
+	}
+	for (size_t i = 0; i < keywords.size(); i++) {
+		table[keywordHash(keywords[i].front(), keywords[i].back(), keywords[i].size())] = static_cast<int8_t>(i);
+	}
+	return table;
+}
+
+constexpr auto keywordTable = makeKeywordTable();
+
+constexpr bool keywordHashIsPerfect() {
+	size_t used = 0;
+	for (int8_t slot : keywordTable) {
+		used += slot != emptySlot;
+	}
+	return used == keywords.size();
+}
+
+static_assert(keywordHashIsPerfect(), "keywordHash collides, adjust it for the new keyword");
+
+constexpr size_t keywordLengthBounds(bool longest) {
+	size_t bound = keywords[0].size();
+	for (keyword k : keywords) {
+		bound = longest ? std::max(bound, k.size()) : std::min(bound, k.size());
+	}
+	return bound;
+}
+
+constexpr size_t minKeywordLength = keywordLengthBounds(false);
+constexpr size_t maxKeywordLength = keywordLengthBounds(true);
+
+// matchKeyword returns the interned id of the keyword spelled,
+// case-insensitively, by the length characters of source at start, or 0.
+// The caller passes the whole identifier run, so a keyword only matches
+// as a complete word.
+uint16_t matchKeyword(std::string_view source, uint64_t start, size_t length) {
+	if (length < minKeywordLength || length > maxKeywordLength) {
+		return 0;
+	}
+
+	int8_t slot = keywordTable[keywordHash(lowerAt(source, start), lowerAt(source, start + length - 1), length)];
+	if (slot == emptySlot || keywords[slot].size() != length) {
+		return 0;
+	}
+
+	keyword k = keywords[slot];
+	for (size_t i = 0; i < length; i++) {
+		if (lowerAt(source, start + i) != k[i]) {
+			return 0;
+		}
+	}
+
+	return static_cast<uint16_t>(slot + 1);
+}
+
+// scanNumeric returns the end of the number starting at start, or npos if
+// the characters there do not form one. It follows the same rules as
+// lexNumeric.
+uint64_t scanNumeric(std::string_view source, uint64_t start) {
+	charClass first = charClasses[static_cast<unsigned char>(source[start])];
+	if (first != charClass::digitClass && first != charClass::periodClass) {
+		return std::string_view::npos;
+	}
+
+	bool periodFound = first == charClass::periodClass;
+	bool expMarkerFound = false;
+
+	uint64_t i = start + 1;
+	while (true) {
+		// digits never change the state, skip them a vector at a time
+		i += digitRun(source.data() + i, source.length() - i);
+		if (i >= source.length()) {
+			break;
+		}
+
+		char c = source[i];
+		if (c == '.') {
+			if (periodFound) {
+				return std::string_view::npos;
+			}
+
+			periodFound = true;
+			i++;
+			continue;
+		}
+
+		if (c == 'e') {
+			if (expMarkerFound) {
+				return std::string_view::npos;
+			}
+
+			periodFound = true;
+			expMarkerFound = true;
+
+			if (i == source.length()-1) {
+				return std::string_view::npos;
+			}
+
+			char cNext = source[i+1];
+			if (cNext == '-' || cNext == '+') {
+				i++;
+			}
+
+			i++;
+			continue;
+		}
+
+		break;
+	}
+
+	return i;
+}
+
+// scanDelimited returns the position just past the closing delimiter of
+// the literal opened at start, or npos if it is never closed
+uint64_t scanDelimited(std::string_view source, uint64_t start, char delimiter) {
+	uint64_t i = start + 1;
+	while (true) {
+		i += findByte(source.data() + i, source.length() - i, delimiter);
+		if (i >= source.length()) {
+			return std::string_view::npos;
+		}
+
+		// SQL escapes are via double characters, not backslash
+		if (i+1 < source.length() && source[i+1] == delimiter) {
+			i += 2;
+			continue;
+		}
+
+		return i + 1;
+	}
+}
+
+// singleCharSymbols maps the first character of each one character symbol
+// to its interned id
+constexpr std::array<uint16_t, 256> makeSingleCharSymbols() {
+	std::array<uint16_t, 256> ids{};
+	for (size_t i = 0; i < symbols.size(); i++) {
+		if (symbols[i].size() == 1) {
+			ids[static_cast<unsigned char>(symbols[i][0])] = static_cast<uint16_t>(i + 1);
+		}
+	}
+	return ids;
+}
+
+constexpr auto singleCharSymbols = makeSingleCharSymbols();
+constexpr uint16_t concatSymbolId = internedId(symbols, concatSymbol);
+
+// comparisonSymbol returns the interned id of the symbol made of the
+// comparison character first and the one after it, preferring the two
+// character forms, or 0 for a lone !
+uint16_t comparisonSymbol(char first, char second) {
+	constexpr uint16_t lt = internedId(symbols, ltSymbol);
+	constexpr uint16_t lte = internedId(symbols, lteSymbol);
+	constexpr uint16_t gt = internedId(symbols, gtSymbol);
+	constexpr uint16_t gte = internedId(symbols, gteSymbol);
+	constexpr uint16_t neq = internedId(symbols, neqSymbol);
+	constexpr uint16_t neq2 = internedId(symbols, neqSymbol2);
+	switch (first) {
+	case '<':
+		return second == '=' ? lte : second == '>' ? neq : lt;
+	case '>':
+		return second == '=' ? gte : gt;
+	default:
+		return second == '=' ? neq2 : 0;
+	}
+}
+
+// runEnds reports whether the characters accepted by inRun extend from
+// start up to the end of source
+template <typename Predicate>
+bool runEnds(std::string_view source, uint64_t start, Predicate inRun) {
+	for (uint64_t i = start; i < source.length(); i++) {
+		if (!inRun(source[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+lexStatus lexToken(std::string_view source, cursor& cur, bool atEnd, arena& storage, token& out) {
+	uint64_t start = cur.pointer;
+	uint64_t end = std::string_view::npos;
+
+	auto emit = [&](std::string_view value, tokenKind kind, uint64_t end, uint16_t id = 0) {
+		out = token{
+			.value = value,
+			.kind = kind,
+			.id = id,
+			.loc = cur.loc,
+		};
+		cur.loc.col += end - cur.pointer;
+		cur.pointer = end;
+		return lexStatus::tokenLexed;
+	};
+
+	switch (charClasses[static_cast<unsigned char>(source[start])]) {
+	case charClass::spaceClass:
+	case charClass::newlineClass: {
+		// whitespace is skipped a whole run at a time; the column restarts
+		// after the last newline in the run
+		const char* run = source.data() + start;
+		uint64_t length = whitespaceRun(run, source.length() - start);
+		uint64_t afterNewline = 0;
+		bool sawNewline = false;
+		for (uint64_t i = findByte(run, length, '\n'); i < length; i += 1 + findByte(run + i + 1, length - i - 1, '\n')) {
+			cur.loc.line++;
+			afterNewline = i + 1;
+			sawNewline = true;
+		}
+
+		cur.loc.col = sawNewline ? length - afterNewline : cur.loc.col + length;
+		cur.pointer += length;
+		return lexStatus::skipped;
+	}
+
+	case charClass::symbolClass: {
+		uint16_t id = singleCharSymbols[static_cast<unsigned char>(source[start])];
+		return emit(symbols[id - 1], tokenKind::symbolKind, start + 1, id);
+	}
+
+	case charClass::pipeClass:
+		if (start+1 < source.length() && source[start+1] == '|') {
+			return emit(concatSymbol, tokenKind::symbolKind, start + 2, concatSymbolId);
+		}
+		if (start+1 == source.length() && !atEnd) {
+			return lexStatus::needMore;
+		}
+		return lexStatus::failed;
+
+	case charClass::quoteClass:
+	case charClass::doubleQuoteClass:
+		end = scanDelimited(source, start, source[start]);
+		// a quote that ends the input might open an escape instead
+		if (!atEnd && (end == std::string_view::npos || end == source.length())) {
+			return lexStatus::needMore;
+		}
+		if (end != std::string_view::npos) {
+			bool isString = source[start] == '\'';
+			return emit(source.substr(start + 1, end - start - 2),
+				isString ? tokenKind::stringKind : tokenKind::identifierKind, end);
+		}
+		return lexStatus::failed;
+
+	case charClass::digitClass:
+	case charClass::periodClass:
+		// scanNumeric never looks past the first character that can not be
+		// part of a number, so only a run reaching the end is undecided
+		if (!atEnd && runEnds(source, start, [](char c) {
+				return (c >= '0' && c <= '9') || c == '.' || c == 'e' || c == '+' || c == '-';
+			})) {
+			return lexStatus::needMore;
+		}
+		end = scanNumeric(source, start);
+		if (end != std::string_view::npos) {
+			return emit(source.substr(start, end - start), tokenKind::numericKind, end);
+		}
+		return lexStatus::failed;
+
+	case charClass::letterClass: {
+		bool hasUpper = false;
+		// a qualified name, table.column, is a single identifier
+		bool qualified = false;
+		for (end = start; end < source.length(); end++) {
+			if (!identifierChars[static_cast<unsigned char>(source[end])]) {
+				if (source[end] != '.' || qualified || end+1 >= source.length() ||
+						charClasses[static_cast<unsigned char>(source[end+1])] != charClass::letterClass) {
+					break;
+				}
+				qualified = true;
+			}
+			hasUpper = hasUpper || lowerAt(source, end) != source[end];
+		}
+
+		// a trailing . may yet be followed by the column
+		if (!atEnd && (end == source.length() || (!qualified && end+1 == source.length() && source[end] == '.'))) {
+			return lexStatus::needMore;
+		}
+
+		if (uint16_t id = matchKeyword(source, start, end - start); id != 0) {
+			return emit(keywords[id - 1], tokenKind::keywordKind, end, id);
+		}
+
+		std::string_view identifier = source.substr(start, end - start);
+		if (hasUpper) {
+			char* lowered = static_cast<char*>(storage.allocate(identifier.size(), 1));
+			for (uint64_t i = start; i < end; i++) {
+				lowered[i - start] = lowerAt(source, i);
+			}
+			identifier = std::string_view(lowered, identifier.size());
+		}
+		return emit(identifier, tokenKind::identifierKind, end);
+	}
+
+	case charClass::questionClass:
+		return emit(source.substr(start, 1), tokenKind::placeholderKind, start + 1);
+
+	case charClass::dollarClass:
+		end = start + 1 + digitRun(source.data() + start + 1, source.length() - start - 1);
+		if (end == source.length() && !atEnd) {
+			return lexStatus::needMore;
+		}
+		if (end > start + 1) {
+			return emit(source.substr(start, end - start), tokenKind::placeholderKind, end);
+		}
+		return lexStatus::failed;
+
+	case charClass::comparisonClass: {
+		if (start+1 == source.length() && !atEnd) {
+			return lexStatus::needMore;
+		}
+		char second = start+1 < source.length() ? source[start+1] : '\0';
+		uint16_t id = comparisonSymbol(source[start], second);
+		if (id == 0) {
+			return lexStatus::failed;
+		}
+		symbol s = symbols[id - 1];
+		return emit(s, tokenKind::symbolKind, start + s.size(), id);
+	}
+
+	case charClass::invalidClass:
+		break;
+	}
+
+	return lexStatus::failed;
+}
+
+std::string lexErrorMessage(std::optional<std::string_view> previous, location loc) {
+	std::string hint = "";
+	if (previous) {
+		hint = " after " + std::string(*previous);
+	}
+
+	return "Unable to lex token" + hint + " at " + 
+			std::to_string(loc.line) + ":" + std::to_string(loc.col);
+}
+
+std::tuple<std::vector<token*>, std::string> lex(std::string_view source, arena& storage) {
+	cursor cur{};
+	return lex(source, storage, cur);
+}
+
+std::tuple<std::vector<token*>, std::string> lex(std::string_view source, arena& storage, cursor& cur) {
+	std::vector<token*> tokens;
+
+	while (cur.pointer < source.length()) {
+		token tok;
+		switch (lexToken(source, cur, true, storage, tok)) {
+		case lexStatus::tokenLexed:
+			tokens.push_back(storage.make<token>(tok));
+			continue;
+		case lexStatus::skipped:
+			continue;
+		case lexStatus::needMore:
+		case lexStatus::failed:
+			break;
+		}
+
+		std::optional<std::string_view> previous;
+		if (!tokens.empty()) {
+			previous = tokens.back()->value;
+		}
+		return {tokens, lexErrorMessage(previous, cur.loc)};
+	}
+
+	return {tokens, ""};
 }
 
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <cstdint>
 #include <string>
 #include <string_view>
@@ -6,6 +7,8 @@
 #include <functional>
 #include <vector>
 #include <memory>
+#include <optional>
+#include "arena.h"
 
 namespace nicolassql {
 
@@ -28,6 +31,18 @@ constexpr keyword intoKeyword = "into";
 constexpr keyword valuesKeyword = "values";
 constexpr keyword intKeyword = "int";
 constexpr keyword textKeyword = "text";
+constexpr keyword andKeyword = "and";
+constexpr keyword orKeyword = "or";
+constexpr keyword indexKeyword = "index";
+constexpr keyword onKeyword = "on";
+constexpr keyword copyKeyword = "copy";
+constexpr keyword joinKeyword = "join";
+constexpr keyword groupKeyword = "group";
+constexpr keyword byKeyword = "by";
+constexpr keyword orderKeyword = "order";
+constexpr keyword limitKeyword = "limit";
+constexpr keyword ascKeyword = "asc";
+constexpr keyword descKeyword = "desc";
 
 typedef std::string_view symbol;
 
@@ -36,6 +51,70 @@ constexpr symbol asteriskSymbol = "*";
 constexpr symbol commaSymbol = ",";
 constexpr symbol leftparenSymbol = "(";
 constexpr symbol rightparenSymbol = ")";
+constexpr symbol equalsSymbol = "=";
+constexpr symbol concatSymbol = "||";
+constexpr symbol neqSymbol = "<>";
+constexpr symbol neqSymbol2 = "!=";
+constexpr symbol ltSymbol = "<";
+constexpr symbol lteSymbol = "<=";
+constexpr symbol gtSymbol = ">";
+constexpr symbol gteSymbol = ">=";
+
+// keywords and symbols are interned: the lexer tags their tokens with an
+// id, their index in the lists below plus one, so the parser compares ids
+// instead of text
+constexpr std::array<keyword, 23> keywords = {
+	selectKeyword,
+	insertKeyword,
+	valuesKeyword,
+	tableKeyword,
+	createKeyword,
+	fromKeyword,
+	intoKeyword,
+	textKeyword,
+	intKeyword,
+	asKeyword,
+	whereKeyword,
+	andKeyword,
+	orKeyword,
+	indexKeyword,
+	onKeyword,
+	copyKeyword,
+	joinKeyword,
+	groupKeyword,
+	byKeyword,
+	orderKeyword,
+	limitKeyword,
+	ascKeyword,
+	descKeyword,
+};
+
+constexpr std::array<symbol, 13> symbols = {
+	semicolonSymbol,
+	asteriskSymbol,
+	commaSymbol,
+	leftparenSymbol,
+	rightparenSymbol,
+	equalsSymbol,
+	concatSymbol,
+	neqSymbol,
+	neqSymbol2,
+	ltSymbol,
+	lteSymbol,
+	gtSymbol,
+	gteSymbol,
+};
+
+// internedId returns the id of value in list, or 0 if it is not there
+template <size_t N>
+constexpr uint16_t internedId(const std::array<std::string_view, N>& list, std::string_view value) {
+	for (size_t i = 0; i < N; i++) {
+		if (list[i] == value) {
+			return static_cast<uint16_t>(i + 1);
+		}
+	}
+	return 0;
+}
 
 enum class tokenKind : unsigned int {
 	keywordKind = 0,
@@ -43,15 +122,31 @@ enum class tokenKind : unsigned int {
 	identifierKind,
 	stringKind,
 	numericKind,
+	// placeholderKind tokens are the ? and $n parameters of a prepared
+	// statement, their value is the placeholder as written
+	placeholderKind,
 };
 
+// token values are views: into the lexed source for most tokens, into the
+// keyword and symbol constants above, or into the arena passed to lex for
+// lowercased identifiers. The source and arena must outlive the token.
 struct token {
-	std::string value;
+	std::string_view value;
 	tokenKind kind;
+	// interned id of keyword and symbol tokens, 0 for everything else
+	uint16_t id = 0;
 	location loc;
 
 	bool equals(const token& other) const {
-		return value == other.value && kind == other.kind;
+		if (kind != other.kind) {
+			return false;
+		}
+
+		if (id != 0 && other.id != 0) {
+			return id == other.id;
+		}
+
+		return value == other.value;
 	}
 };
 
@@ -62,8 +157,38 @@ struct cursor {
 
 using lexer = std::function<std::tuple<std::unique_ptr<token>, cursor, bool>(std::string_view, const cursor&)>;
 
+// lex tokenizes source in a single pass, dispatching on a character class
+// table instead of trying every lexer below at each position. The tokens
+// are allocated in storage and freed with it.
+std::tuple<std::vector<token*>, std::string>
+lex(std::string_view source, arena& storage);
+
+// lex lexes source starting at cur and leaves cur where it stopped, which
+// is the end of source unless an error is returned
 std::tuple<std::vector<token*>, std::string>
-lex(std::string_view source);
+lex(std::string_view source, arena& storage, cursor& cur);
+
+enum class lexStatus : unsigned int {
+	tokenLexed = 0,
+	skipped,
+	needMore,
+	failed,
+};
+
+// lexToken lexes the token at cur into out and moves cur past it, or
+// past the whitespace found there. When atEnd is false source may stop
+// in the middle of a token; lexToken then leaves cur alone and returns
+// needMore so the caller can extend source and try again.
+lexStatus lexToken(std::string_view source, cursor& cur, bool atEnd, arena& storage, token& out);
+
+// lexErrorMessage describes a failure to lex at loc, previous being the
+// value of the last token lexed if there was one
+std::string lexErrorMessage(std::optional<std::string_view> previous, location loc);
+
+// lexReference runs the individual lexers below in turn at every position.
+// It is much slower than lex and only kept to check and benchmark it against.
+std::tuple<std::vector<token*>, std::string>
+lexReference(std::string_view source, arena& storage);
 
 std::tuple<std::unique_ptr<token>, cursor, bool>
 lexNumeric(std::string_view source, cursor ic);
@@ -78,6 +203,9 @@ std::tuple<std::unique_ptr<token>, cursor, bool>
 lexKeyword(std::string_view source, cursor ic);
 
 std::tuple<std::unique_ptr<token>, cursor, bool>
-lexIdentifier(std::string_view source, cursor ic);
+lexPlaceholder(std::string_view source, cursor ic);
+
+std::tuple<std::unique_ptr<token>, cursor, bool>
+lexIdentifier(std::string_view source, cursor ic, arena& storage);
 
 }
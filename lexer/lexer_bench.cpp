@@ -0,0 +1,138 @@
+#include <benchmark/benchmark.h>
+#include "lexer.h"
+#include "scan.h"
+#include "stream.h"
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace nicolassql;
+
+// bulkInsertScript builds a script of single-row INSERTs roughly the given
+// size, mixing identifiers, numbers and quoted text like a data dump
+static std::string bulkInsertScript(size_t bytes) {
+    std::mt19937 rng(7);
+    std::string script;
+    script.reserve(bytes + 256);
+    script += "CREATE TABLE users (id INT, name TEXT, bio TEXT, score INT);\n";
+    for (uint64_t row = 0; script.size() < bytes; row++) {
+        script += "INSERT INTO users VALUES (";
+        script += std::to_string(row);
+        script += ", 'user";
+        script += std::to_string(rng() % 100000);
+        script += "', 'likes ''sql'' and long walks on the beach', ";
+        script += std::to_string(rng() % 1000);
+        script += ".";
+        script += std::to_string(rng() % 100);
+        script += ");\n";
+    }
+    return script;
+}
+
+// documentScript builds INSERTs carrying long text payloads and indented,
+// wide numbers: the shape where the scan functions do most of the work
+static std::string documentScript(size_t bytes) {
+    std::mt19937 rng(11);
+    std::string script;
+    script.reserve(bytes + 1024);
+    for (uint64_t row = 0; script.size() < bytes; row++) {
+        script += "INSERT INTO documents VALUES (\n        ";
+        script += std::to_string(row * 1000003ull + 1000000000000ull);
+        script += ",\n        '";
+        size_t length = 200 + rng() % 800;
+        for (size_t i = 0; i < length; i++) {
+            script += static_cast<char>('a' + rng() % 26);
+        }
+        script += " isn''t short'\n);\n";
+    }
+    return script;
+}
+
+template <typename Lex>
+static void runLexer(benchmark::State& state, Lex lexFn) {
+    std::string script = bulkInsertScript(static_cast<size_t>(state.range(0)) << 20);
+    size_t tokenCount = 0;
+    for (auto _ : state) {
+        arena storage;
+        auto [tokens, err] = lexFn(script, storage);
+        if (!err.empty()) {
+            state.SkipWithError(err.c_str());
+        }
+        tokenCount = tokens.size();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * script.size()));
+    state.counters["tokens"] = static_cast<double>(tokenCount);
+}
+
+static void BM_LexReference(benchmark::State& state) {
+    runLexer(state, lexReference);
+}
+
+static void BM_Lex(benchmark::State& state) {
+    runLexer(state, [](std::string_view source, arena& storage) { return lex(source, storage); });
+}
+
+// BM_LexScanLevel lexes the document script with the scan functions pinned
+// to one level, so the vector kernels can be compared against the scalar loop
+static void BM_LexScanLevel(benchmark::State& state) {
+    auto level = static_cast<scanLevel>(state.range(0));
+    if (level > bestScanLevel()) {
+        state.SkipWithError("scan level not supported by this CPU");
+        return;
+    }
+    setScanLevel(level);
+
+    std::string script = documentScript(16 << 20);
+    for (auto _ : state) {
+        arena storage;
+        auto [tokens, err] = lex(script, storage);
+        if (!err.empty()) {
+            state.SkipWithError(err.c_str());
+        }
+        benchmark::DoNotOptimize(tokens.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * script.size()));
+    setScanLevel(bestScanLevel());
+}
+
+// BM_StreamLex pulls the script through a streamLexer in 64 KiB chunks,
+// copying every value into an arena that is reset every 4096 tokens
+static void BM_StreamLex(benchmark::State& state) {
+    std::string script = bulkInsertScript(static_cast<size_t>(state.range(0)) << 20);
+    for (auto _ : state) {
+        size_t offset = 0;
+        streamLexer lexer([&](char* buffer, size_t size) -> std::tuple<size_t, std::string> {
+            size_t n = std::min(size, script.size() - offset);
+            std::memcpy(buffer, script.data() + offset, n);
+            offset += n;
+            return {n, ""};
+        });
+
+        auto storage = std::make_unique<arena>();
+        for (size_t count = 1; ; count++) {
+            auto [tok, err] = lexer.next(*storage);
+            if (tok == nullptr) {
+                if (!err.empty()) {
+                    state.SkipWithError(err.c_str());
+                }
+                break;
+            }
+            if (count % 4096 == 0) {
+                storage = std::make_unique<arena>();
+            }
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * script.size()));
+}
+
+BENCHMARK(BM_LexReference)->Arg(4)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Lex)->Arg(4)->Arg(16)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LexScanLevel)
+    ->Arg(static_cast<int>(scanLevel::scalarLevel))
+    ->Arg(static_cast<int>(scanLevel::sse2Level))
+    ->Arg(static_cast<int>(scanLevel::avx2Level))
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_StreamLex)->Arg(16)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
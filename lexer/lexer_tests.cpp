@@ -1,11 +1,19 @@
 #include <gtest/gtest.h>
 #include "lexer.h"
+#include "pool.h"
+#include "scan.h"
+#include "stream.h"
 #include <algorithm>
 #include <cctype>
 #include <tuple>
 #include <vector>
 #include <string>
 #include <memory>
+#include <atomic>
+#include <random>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
 
 using namespace nicolassql;
 
@@ -80,6 +88,11 @@ TEST(TokenLexSymbol, ValidAndInvalidSymbols) {
     std::vector<Test> tests = {
         {true,  "= "},
         {true,  "||"},
+        {true,  "<= "},
+        {true,  "<>"},
+        {true,  "!="},
+        {true,  ">"},
+        {false, "!"},
         {false, "@"},
         {false, ""},
     };
@@ -94,6 +107,30 @@ TEST(TokenLexSymbol, ValidAndInvalidSymbols) {
     }
 }
 
+TEST(TokenLexPlaceholder, ValidAndInvalidPlaceholders) {
+    struct Test { bool ok; std::string src; std::string value; };
+    std::vector<Test> tests = {
+        {true,  "?",     "?"},
+        {true,  "?, ?",  "?"},
+        {true,  "$1",    "$1"},
+        {true,  "$12)",  "$12"},
+        {false, "$",     ""},
+        {false, "$a",    ""},
+        {false, "1",     ""},
+        {false, "",      ""},
+    };
+
+    for (auto& t : tests) {
+        auto [tok, cur, ok] = lexPlaceholder(t.src, cursor{});
+        EXPECT_EQ(t.ok, ok) << "input=" << t.src;
+        if (ok) {
+            EXPECT_EQ(t.value, std::string(tok->value)) << "input=" << t.src;
+            EXPECT_EQ(tok->kind, tokenKind::placeholderKind);
+            EXPECT_EQ(cur.pointer, t.value.size());
+        }
+    }
+}
+
 TEST(TokenLexIdentifier, ValidAndInvalidIdentifiers) {
     struct Test { bool ok; std::string src, expected; };
     std::vector<Test> tests = {
@@ -104,14 +141,19 @@ TEST(TokenLexIdentifier, ValidAndInvalidIdentifiers) {
         {true,  "a9$",        "a9$"},
         {true,  "userName",   "username"},
         {true,  "\"userName\"", "userName"},
+        {true,  "Users.Id",   "users.id"},
+        {true,  "a.b.c",      "a.b"},
+        {true,  "a.1",        "a"},
+        {true,  "a.",         "a"},
         {false, "\"",         ""},
         {false, "_sadsfa",    ""},
         {false, "9sadsfa",    ""},
         {false, " abc",       ""},
     };
 
+    arena storage;
     for (auto& t : tests) {
-        auto [tok, cur, ok] = lexIdentifier(t.src, cursor{});
+        auto [tok, cur, ok] = lexIdentifier(t.src, cursor{}, storage);
         EXPECT_EQ(t.ok, ok) << "input=" << t.src;
         if (ok) {
             EXPECT_EQ(t.expected, std::string(tok->value))
@@ -128,6 +170,25 @@ TEST(TokenLexKeyword, ValidAndInvalidKeywords) {
         {true,  "as",       "as"},
         {true,  "SELECT",   "select"},
         {true,  "into",     "into"},
+        {true,  "where",    "where"},
+        {true,  "AND",      "and"},
+        {true,  "or (",     "or"},
+        {true,  "INDEX",    "index"},
+        {true,  "on",       "on"},
+        {false, "one",      ""},
+        {true,  "COPY",     "copy"},
+        {true,  "join",     "join"},
+        {true,  "GROUP",    "group"},
+        {true,  "by",       "by"},
+        {true,  "ORDER",    "order"},
+        {true,  "limit",    "limit"},
+        {true,  "asc",      "asc"},
+        {true,  "DESC",     "desc"},
+        {false, "ascii",    ""},
+        {false, "bye",      ""},
+        {false, "on.x",     ""},
+        {false, "orders",   ""},
+        {false, "intx",     ""},
         {false, " into",    ""},
         {false, "flubbrety",""},
     };
@@ -192,10 +253,39 @@ TEST(Lex, FullSequences) {
          { tokenKind::keywordKind,    "from",      0,10 },
          { tokenKind::identifierKind, "users",     0,15 },
          { tokenKind::symbolKind,     ";",         0,20 }} },
+      { "select id from users where id>=2 and name<>'x' or id!=3",
+        {{ tokenKind::keywordKind,    "select",    0, 0 },
+         { tokenKind::identifierKind, "id",        0, 7 },
+         { tokenKind::keywordKind,    "from",      0,10 },
+         { tokenKind::identifierKind, "users",     0,15 },
+         { tokenKind::keywordKind,    "where",     0,21 },
+         { tokenKind::identifierKind, "id",        0,27 },
+         { tokenKind::symbolKind,     ">=",        0,29 },
+         { tokenKind::numericKind,    "2",         0,31 },
+         { tokenKind::keywordKind,    "and",       0,33 },
+         { tokenKind::identifierKind, "name",      0,37 },
+         { tokenKind::symbolKind,     "<>",        0,41 },
+         { tokenKind::stringKind,     "x",         0,43 },
+         { tokenKind::keywordKind,    "or",        0,47 },
+         { tokenKind::identifierKind, "id",        0,50 },
+         { tokenKind::symbolKind,     "!=",        0,52 },
+         { tokenKind::numericKind,    "3",         0,54 }} },
+      { "select u.id from u join o on o.u = U.ID",
+        {{ tokenKind::keywordKind,    "select",    0, 0 },
+         { tokenKind::identifierKind, "u.id",      0, 7 },
+         { tokenKind::keywordKind,    "from",      0,12 },
+         { tokenKind::identifierKind, "u",         0,17 },
+         { tokenKind::keywordKind,    "join",      0,19 },
+         { tokenKind::identifierKind, "o",         0,24 },
+         { tokenKind::keywordKind,    "on",        0,26 },
+         { tokenKind::identifierKind, "o.u",       0,29 },
+         { tokenKind::symbolKind,     "=",         0,33 },
+         { tokenKind::identifierKind, "u.id",      0,35 }} },
     };
 
     for (auto& tc : tests) {
-        auto [tokens, err] = lex(tc.input);
+        arena storage;
+        auto [tokens, err] = lex(tc.input, storage);
         EXPECT_TRUE(err.empty()) << "input=" << tc.input;
         ASSERT_EQ(tc.toks.size(), tokens.size()) << "input=" << tc.input;
         for (size_t i = 0; i < tokens.size(); ++i) {
@@ -208,8 +298,202 @@ TEST(Lex, FullSequences) {
             EXPECT_EQ(tc.toks[i].col,  tokens[i]->loc.col)
               << "input="<<tc.input<<" idx="<<i;
         }
-        // clean up
-        for (auto* p : tokens) delete p;
+    }
+}
+
+TEST(Lex, ValuesViewIntoSource) {
+    std::string source = "insert into users values ('it''s', 42, Name)";
+    arena storage;
+    auto [tokens, err] = lex(source, storage);
+    ASSERT_TRUE(err.empty()) << err;
+    ASSERT_EQ(11u, tokens.size());
+
+    auto inSource = [&](const token* t) {
+        return t->value.data() >= source.data() &&
+               t->value.data() + t->value.size() <= source.data() + source.size();
+    };
+    EXPECT_TRUE(inSource(tokens[2])) << "lowercase identifier should not be copied";
+    EXPECT_TRUE(inSource(tokens[5])) << "string literal should not be copied";
+    EXPECT_TRUE(inSource(tokens[7])) << "number should not be copied";
+    EXPECT_FALSE(inSource(tokens[9])) << "uppercase identifier is lowered into the arena";
+    EXPECT_EQ("name", std::string(tokens[9]->value));
+}
+
+TEST(Lex, MatchesReferenceLexer) {
+    // fragments chosen to hit keyword prefixes, escapes, exponent markers
+    // and unterminated literals, glued together at random
+    std::vector<std::string> fragments = {
+        "select", "SELECT", "insert", "into", "int", "intx", "as", "asdf",
+        "values", "Table", "create", "from", "text", "users", "a9$_b",
+        "105", "1.5", ".1", "1e5", "1e-3", "1e", "1..2", "4.", "1ee4",
+        "'abc'", "'a '' b'", "'open", "\"Quoted\"", "\"open",
+        ",", "(", ")", ";", "*", "=", "||", "|", "@", " ", "\t", "\n",
+        "?", "$1", "$42", "$",
+        "where", "and", "or", "orders", "Android", "<", "<=", ">", ">=",
+        "<>", "!=", "!", "=", ".", "users.id", "on.X", "join",
+        // long runs so the vector scans see full blocks and tails
+        "'a string well past thirty two bytes, with '' an escape in it'",
+        "12345678901234567890123456789012345678901234567890.5e+10",
+        "   \n\t     \n                                   \n  ",
+    };
+
+    // every scan level the CPU supports must lex the same way
+    for (unsigned int level = 0; level <= static_cast<unsigned int>(bestScanLevel()); level++) {
+        setScanLevel(static_cast<scanLevel>(level));
+        std::mt19937 rng(42);
+        for (int iteration = 0; iteration < 2000; iteration++) {
+            std::string input;
+            int parts = rng() % 12;
+            for (int i = 0; i < parts; i++) {
+                input += fragments[rng() % fragments.size()];
+            }
+
+            arena storage;
+            auto [want, wantErr] = lexReference(input, storage);
+            auto [got, gotErr] = lex(input, storage);
+            EXPECT_EQ(wantErr, gotErr) << "level=" << level << " input=" << input;
+            ASSERT_EQ(want.size(), got.size()) << "level=" << level << " input=" << input;
+            for (size_t i = 0; i < want.size(); ++i) {
+                EXPECT_TRUE(want[i]->equals(*got[i])) << "input=" << input << " idx=" << i;
+                EXPECT_EQ(want[i]->id, got[i]->id) << "input=" << input << " idx=" << i;
+                EXPECT_EQ(want[i]->loc.line, got[i]->loc.line) << "input=" << input << " idx=" << i;
+                EXPECT_EQ(want[i]->loc.col, got[i]->loc.col) << "input=" << input << " idx=" << i;
+            }
+        }
+    }
+    setScanLevel(bestScanLevel());
+}
+
+TEST(Scan, LevelsAgreeWithScalar) {
+    std::mt19937 rng(7);
+    const std::string alphabet = "09a '\n\t\"x5";
+    for (int iteration = 0; iteration < 500; iteration++) {
+        // runs of one class with a random break, at a random alignment
+        std::string buffer(rng() % 100 + 1, ' ');
+        char fill = alphabet[rng() % alphabet.size()];
+        for (char& c : buffer) {
+            c = rng() % 8 == 0 ? alphabet[rng() % alphabet.size()] : fill;
+        }
+        size_t offset = rng() % buffer.size();
+        const char* data = buffer.data() + offset;
+        size_t size = buffer.size() - offset;
+
+        setScanLevel(scanLevel::scalarLevel);
+        size_t quote = findByte(data, size, '\'');
+        size_t delimiter = findAnyByte(data, size, '\'', '"', '\n');
+        size_t digits = digitRun(data, size);
+        size_t whitespace = whitespaceRun(data, size);
+        for (unsigned int level = 1; level <= static_cast<unsigned int>(bestScanLevel()); level++) {
+            setScanLevel(static_cast<scanLevel>(level));
+            EXPECT_EQ(quote, findByte(data, size, '\'')) << "level=" << level << " input=" << buffer;
+            EXPECT_EQ(delimiter, findAnyByte(data, size, '\'', '"', '\n')) << "level=" << level << " input=" << buffer;
+            EXPECT_EQ(digits, digitRun(data, size)) << "level=" << level << " input=" << buffer;
+            EXPECT_EQ(whitespace, whitespaceRun(data, size)) << "level=" << level << " input=" << buffer;
+        }
+    }
+    setScanLevel(bestScanLevel());
+}
+
+TEST(Arena, CountsTokensAndBytes) {
+    arena storage;
+    auto [tokens, err] = lex("SELECT Id, name FROM users;", storage);
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(tokens.size(), storage.nodesAllocated());
+    // one token per node plus the lowered "id"
+    EXPECT_EQ(tokens.size() * sizeof(token) + 2, storage.bytesAllocated());
+    EXPECT_GE(storage.bytesReserved(), storage.bytesAllocated());
+}
+
+TEST(StreamLexer, MatchesLexAcrossChunkBoundaries) {
+    std::string script =
+        "CREATE TABLE users (id INT, name TEXT);\n"
+        "insert into Users values (105, 'it''s a longer string than a chunk', 1.5e-3);\n"
+        "select \"Quoted Name\", id || name from users;\n"
+        "insert into users values ($1, ?, $23);\n"
+        "select id from users where id <= 4 and name <> 'b' or id != $1;\n"
+        "select 'trailing''' ;";
+
+    arena want;
+    auto [expected, err] = lex(script, want);
+    ASSERT_TRUE(err.empty()) << err;
+
+    for (size_t chunkSize : {1, 2, 3, 7, 64, 4096}) {
+        size_t offset = 0;
+        streamLexer lexer([&](char* buffer, size_t size) -> std::tuple<size_t, std::string> {
+            size_t n = std::min(size, script.size() - offset);
+            std::memcpy(buffer, script.data() + offset, n);
+            offset += n;
+            return {n, ""};
+        }, chunkSize);
+
+        arena storage;
+        for (size_t i = 0; i <= expected.size(); i++) {
+            auto [tok, err] = lexer.next(storage);
+            ASSERT_TRUE(err.empty()) << err << " chunk=" << chunkSize;
+            if (i == expected.size()) {
+                EXPECT_EQ(nullptr, tok) << "chunk=" << chunkSize;
+                break;
+            }
+            ASSERT_NE(nullptr, tok) << "chunk=" << chunkSize << " idx=" << i;
+            EXPECT_TRUE(expected[i]->equals(*tok)) << "chunk=" << chunkSize << " idx=" << i;
+            EXPECT_EQ(expected[i]->loc.line, tok->loc.line) << "chunk=" << chunkSize << " idx=" << i;
+            EXPECT_EQ(expected[i]->loc.col, tok->loc.col) << "chunk=" << chunkSize << " idx=" << i;
+        }
+    }
+}
+
+TEST(StreamLexer, ReadersAndErrors) {
+    std::istringstream in("select a\nfrom b @");
+    streamLexer fromStream(istreamReader(in), 4);
+    arena storage;
+    std::vector<std::string> values;
+    std::string err;
+    while (true) {
+        auto [tok, e] = fromStream.next(storage);
+        if (tok == nullptr) {
+            err = e;
+            break;
+        }
+        values.push_back(std::string(tok->value));
+    }
+    EXPECT_EQ((std::vector<std::string>{"select", "a", "from", "b"}), values);
+    EXPECT_EQ("Unable to lex token after b at 1:7", err);
+
+    std::FILE* file = std::tmpfile();
+    ASSERT_NE(nullptr, file);
+    std::fputs("insert into t values (1)", file);
+    std::fflush(file);
+    std::rewind(file);
+    streamLexer fromFile(fileDescriptorReader(fileno(file)), 8);
+    size_t count = 0;
+    while (true) {
+        auto [tok, e] = fromFile.next(storage);
+        ASSERT_TRUE(e.empty()) << e;
+        if (tok == nullptr) {
+            break;
+        }
+        count++;
+    }
+    EXPECT_EQ(7u, count);
+    EXPECT_EQ(8u, fromFile.bufferSize());
+    std::fclose(file);
+}
+
+TEST(ThreadPool, RunsEveryTaskOnce) {
+    threadPool pool(4);
+    EXPECT_EQ(pool.size(), 4u);
+    for (size_t count : {0, 1, 3, 1000}) {
+        std::vector<std::atomic<int>> runs(count);
+        std::atomic<int> nested{0};
+        pool.parallelFor(count, [&](size_t i) {
+            runs[i]++;
+            // nested calls run inline rather than deadlocking
+            pool.parallelFor(2, [&](size_t) { nested++; });
+        });
+        for (auto& r : runs) {
+            EXPECT_EQ(r.load(), 1);
+        }
+        EXPECT_EQ(nested.load(), static_cast<int>(count * 2));
     }
 }
 
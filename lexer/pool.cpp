@@ -0,0 +1,98 @@
+#include "pool.h"
+#include <algorithm>
+
+namespace nicolassql {
+
+namespace {
+
+// insideTask is set while a thread runs a task, so nested parallelFor
+// calls run inline instead of waiting on the pool they are blocking
+thread_local bool insideTask = false;
+
+}
+
+threadPool::threadPool(size_t threads) {
+	if (threads == 0) {
+		threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	}
+
+	workers.reserve(threads - 1);
+	for (size_t i = 1; i < threads; i++) {
+		workers.emplace_back([this] { work(); });
+	}
+}
+
+threadPool::~threadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void threadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+	if (insideTask || workers.empty() || count <= 1) {
+		for (size_t i = 0; i < count; i++) {
+			fn(i);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> job(jobMutex);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		task = &fn;
+		this->count = count;
+		next = 0;
+		generation++;
+	}
+	wake.notify_all();
+
+	runTasks();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return next >= this->count && running == 0; });
+	task = nullptr;
+}
+
+void threadPool::work() {
+	size_t seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping) {
+				return;
+			}
+			seen = generation;
+		}
+		runTasks();
+	}
+}
+
+void threadPool::runTasks() {
+	insideTask = true;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (next < count) {
+		size_t i = next++;
+		running++;
+		lock.unlock();
+		(*task)(i);
+		lock.lock();
+		running--;
+	}
+	if (running == 0) {
+		done.notify_all();
+	}
+	insideTask = false;
+}
+
+threadPool& sharedPool() {
+	static threadPool pool;
+	return pool;
+}
+
+}
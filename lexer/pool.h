@@ -0,0 +1,51 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nicolassql {
+
+// threadPool runs the tasks of one parallelFor at a time on a fixed set
+// of worker threads. The calling thread works on the tasks too, so a pool
+// of size n runs on n-1 extra threads.
+class threadPool {
+public:
+	// threads of 0 uses one thread per hardware core
+	explicit threadPool(size_t threads = 0);
+	~threadPool();
+
+	threadPool(const threadPool&) = delete;
+	threadPool& operator=(const threadPool&) = delete;
+
+	// parallelFor calls task(i) for every i in [0, count) and returns once
+	// all of them have finished. Calls made from inside a task run inline.
+	void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+	size_t size() const { return workers.size() + 1; }
+
+private:
+	void work();
+	void runTasks();
+
+	std::vector<std::thread> workers;
+	std::mutex jobMutex;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(size_t)>* task = nullptr;
+	size_t count = 0;
+	size_t next = 0;
+	size_t running = 0;
+	size_t generation = 0;
+	bool stopping = false;
+};
+
+// sharedPool is a process wide pool sized to the machine, created on
+// first use
+threadPool& sharedPool();
+
+}
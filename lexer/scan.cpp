@@ -0,0 +1,253 @@
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NICOLASSQL_X86 1
+#endif
+
+namespace nicolassql {
+
+namespace {
+
+size_t findByteScalar(const char* data, size_t size, char c) {
+	size_t i = 0;
+	while (i < size && data[i] != c) {
+		i++;
+	}
+	return i;
+}
+
+size_t findAnyByteScalar(const char* data, size_t size, char a, char b, char c) {
+	size_t i = 0;
+	while (i < size && data[i] != a && data[i] != b && data[i] != c) {
+		i++;
+	}
+	return i;
+}
+
+size_t digitRunScalar(const char* data, size_t size) {
+	size_t i = 0;
+	while (i < size && data[i] >= '0' && data[i] <= '9') {
+		i++;
+	}
+	return i;
+}
+
+size_t whitespaceRunScalar(const char* data, size_t size) {
+	size_t i = 0;
+	while (i < size && (data[i] == ' ' || data[i] == '\t' || data[i] == '\n')) {
+		i++;
+	}
+	return i;
+}
+
+#ifdef NICOLASSQL_X86
+
+// each kernel builds a mask with a bit set for every byte that ends the
+// run, then the lowest set bit is the answer; the tail that does not fill
+// a whole vector is left to the next narrower kernel. The AVX2 kernels
+// clear the upper register halves before handing over, or the SSE2 code
+// after them pays a state transition penalty on every call.
+
+size_t findByteSse2(const char* data, size_t size, char c) {
+	const __m128i needle = _mm_set1_epi8(c);
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return i + findByteScalar(data + i, size - i, c);
+}
+
+size_t findAnyByteSse2(const char* data, size_t size, char a, char b, char c) {
+	const __m128i first = _mm_set1_epi8(a);
+	const __m128i second = _mm_set1_epi8(b);
+	const __m128i third = _mm_set1_epi8(c);
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i found = _mm_or_si128(_mm_cmpeq_epi8(block, first),
+			_mm_or_si128(_mm_cmpeq_epi8(block, second), _mm_cmpeq_epi8(block, third)));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(found));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return i + findAnyByteScalar(data + i, size - i, a, b, c);
+}
+
+size_t digitRunSse2(const char* data, size_t size) {
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i nine = _mm_set1_epi8(9);
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		// a byte is a digit when byte - '0' is at most 9 as an unsigned value
+		__m128i offset = _mm_sub_epi8(block, zero);
+		__m128i isDigit = _mm_cmpeq_epi8(_mm_max_epu8(offset, nine), nine);
+		unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(isDigit)) & 0xffff;
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return i + digitRunScalar(data + i, size - i);
+}
+
+size_t whitespaceRunSse2(const char* data, size_t size) {
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i newline = _mm_set1_epi8('\n');
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i isSpace = _mm_or_si128(_mm_cmpeq_epi8(block, space),
+			_mm_or_si128(_mm_cmpeq_epi8(block, tab), _mm_cmpeq_epi8(block, newline)));
+		unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(isSpace)) & 0xffff;
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return i + whitespaceRunScalar(data + i, size - i);
+}
+
+__attribute__((target("avx2")))
+size_t findByteAvx2(const char* data, size_t size, char c) {
+	const __m256i needle = _mm256_set1_epi8(c);
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	_mm256_zeroupper();
+	return i + findByteSse2(data + i, size - i, c);
+}
+
+__attribute__((target("avx2")))
+size_t findAnyByteAvx2(const char* data, size_t size, char a, char b, char c) {
+	const __m256i first = _mm256_set1_epi8(a);
+	const __m256i second = _mm256_set1_epi8(b);
+	const __m256i third = _mm256_set1_epi8(c);
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		__m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(block, first),
+			_mm256_or_si256(_mm256_cmpeq_epi8(block, second), _mm256_cmpeq_epi8(block, third)));
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(found));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	_mm256_zeroupper();
+	return i + findAnyByteSse2(data + i, size - i, a, b, c);
+}
+
+__attribute__((target("avx2")))
+size_t digitRunAvx2(const char* data, size_t size) {
+	const __m256i zero = _mm256_set1_epi8('0');
+	const __m256i nine = _mm256_set1_epi8(9);
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		__m256i offset = _mm256_sub_epi8(block, zero);
+		__m256i isDigit = _mm256_cmpeq_epi8(_mm256_max_epu8(offset, nine), nine);
+		unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(isDigit));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	_mm256_zeroupper();
+	return i + digitRunSse2(data + i, size - i);
+}
+
+__attribute__((target("avx2")))
+size_t whitespaceRunAvx2(const char* data, size_t size) {
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		__m256i isSpace = _mm256_or_si256(_mm256_cmpeq_epi8(block, space),
+			_mm256_or_si256(_mm256_cmpeq_epi8(block, tab), _mm256_cmpeq_epi8(block, newline)));
+		unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(isSpace));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	_mm256_zeroupper();
+	return i + whitespaceRunSse2(data + i, size - i);
+}
+
+#endif
+
+struct scanKernels {
+	size_t (*findByte)(const char*, size_t, char);
+	size_t (*findAnyByte)(const char*, size_t, char, char, char);
+	size_t (*digitRun)(const char*, size_t);
+	size_t (*whitespaceRun)(const char*, size_t);
+	scanLevel level;
+};
+
+scanKernels kernelsFor(scanLevel level) {
+	switch (level) {
+#ifdef NICOLASSQL_X86
+	case scanLevel::avx2Level:
+		return {findByteAvx2, findAnyByteAvx2, digitRunAvx2, whitespaceRunAvx2, level};
+	case scanLevel::sse2Level:
+		return {findByteSse2, findAnyByteSse2, digitRunSse2, whitespaceRunSse2, level};
+#endif
+	default:
+		return {findByteScalar, findAnyByteScalar, digitRunScalar, whitespaceRunScalar, scanLevel::scalarLevel};
+	}
+}
+
+scanKernels kernels = kernelsFor(bestScanLevel());
+
+}
+
+scanLevel bestScanLevel() {
+#ifdef NICOLASSQL_X86
+	// this runs during static initialization, before the CPU model has
+	// necessarily been detected
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return scanLevel::avx2Level;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return scanLevel::sse2Level;
+	}
+#endif
+	return scanLevel::scalarLevel;
+}
+
+void setScanLevel(scanLevel level) {
+	kernels = kernelsFor(level);
+}
+
+scanLevel currentScanLevel() {
+	return kernels.level;
+}
+
+size_t findByte(const char* data, size_t size, char c) {
+	return kernels.findByte(data, size, c);
+}
+
+size_t findAnyByte(const char* data, size_t size, char a, char b, char c) {
+	return kernels.findAnyByte(data, size, a, b, c);
+}
+
+size_t digitRun(const char* data, size_t size) {
+	return kernels.digitRun(data, size);
+}
+
+size_t whitespaceRun(const char* data, size_t size) {
+	return kernels.whitespaceRun(data, size);
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+
+namespace nicolassql {
+
+// The scan functions find the end of the runs the lexer spends most of its
+// time in: quoted text, digits and whitespace. They look at 16 (SSE2) or
+// 32 (AVX2) bytes at a time, picked at startup from what the CPU supports,
+// and fall back to a plain loop elsewhere.
+
+// findByte returns the index of the first c in data, or size if there is none
+size_t findByte(const char* data, size_t size, char c);
+
+// findAnyByte returns the index of the first a, b or c in data, or size if
+// there is none
+size_t findAnyByte(const char* data, size_t size, char a, char b, char c);
+
+// digitRun returns the number of leading '0'-'9' characters in data
+size_t digitRun(const char* data, size_t size);
+
+// whitespaceRun returns the number of leading spaces, tabs and newlines in data
+size_t whitespaceRun(const char* data, size_t size);
+
+enum class scanLevel : unsigned int {
+	scalarLevel = 0,
+	sse2Level,
+	avx2Level,
+};
+
+// bestScanLevel is the widest level the running CPU supports
+scanLevel bestScanLevel();
+
+// setScanLevel switches the scan functions to level, which must not be
+// above bestScanLevel. It is meant for tests and benchmarks and is not
+// safe to call while other threads are lexing.
+void setScanLevel(scanLevel level);
+
+scanLevel currentScanLevel();
+
+}
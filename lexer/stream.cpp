@@ -0,0 +1,117 @@
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include "stream.h"
+
+namespace nicolassql {
+
+reader fileDescriptorReader(int fd) {
+	return [fd](char* buffer, size_t size) -> std::tuple<size_t, std::string> {
+		while (true) {
+			ssize_t n = ::read(fd, buffer, size);
+			if (n >= 0) {
+				return {static_cast<size_t>(n), ""};
+			}
+			if (errno != EINTR) {
+				return {0, std::string("Unable to read input: ") + std::strerror(errno)};
+			}
+		}
+	};
+}
+
+reader istreamReader(std::istream& in) {
+	return [&in](char* buffer, size_t size) -> std::tuple<size_t, std::string> {
+		in.read(buffer, static_cast<std::streamsize>(size));
+		if (in.bad()) {
+			return {0, "Unable to read input stream"};
+		}
+		return {static_cast<size_t>(in.gcount()), ""};
+	};
+}
+
+streamLexer::streamLexer(reader read, size_t chunkSize)
+	: read(std::move(read)),
+	  buffer(new char[chunkSize]),
+	  capacity(chunkSize) {}
+
+std::string streamLexer::fill() {
+	// keep the unfinished token, drop everything before it
+	if (begin > 0) {
+		std::memmove(buffer.get(), buffer.get() + begin, end - begin);
+		end -= begin;
+		begin = 0;
+	}
+
+	// a single token larger than the buffer forces it to grow
+	if (end == capacity) {
+		std::unique_ptr<char[]> grown(new char[capacity * 2]);
+		std::memcpy(grown.get(), buffer.get(), end);
+		buffer = std::move(grown);
+		capacity *= 2;
+	}
+
+	auto [n, err] = read(buffer.get() + end, capacity - end);
+	if (err != "") {
+		return err;
+	}
+
+	end += n;
+	atEnd = n == 0;
+	return "";
+}
+
+std::tuple<token*, std::string> streamLexer::next(arena& storage) {
+	while (true) {
+		if (begin == end) {
+			if (atEnd) {
+				return {nullptr, ""};
+			}
+
+			if (std::string err = fill(); err != "") {
+				return {nullptr, err};
+			}
+			continue;
+		}
+
+		std::string_view window(buffer.get() + begin, end - begin);
+		cursor cur{.pointer = 0, .loc = loc};
+		token tok;
+		switch (lexToken(window, cur, atEnd, storage, tok)) {
+		case lexStatus::needMore:
+			if (std::string err = fill(); err != "") {
+				return {nullptr, err};
+			}
+			continue;
+
+		case lexStatus::skipped:
+			begin += cur.pointer;
+			loc = cur.loc;
+			continue;
+
+		case lexStatus::tokenLexed: {
+			// values viewing the buffer are copied out before it is reused
+			const char* data = tok.value.data();
+			if (data >= window.data() && data < window.data() + window.size()) {
+				tok.value = storage.copy(tok.value);
+			}
+
+			begin += cur.pointer;
+			loc = cur.loc;
+			lexedAny = true;
+			previous.assign(tok.value);
+			return {storage.make<token>(tok), ""};
+		}
+
+		case lexStatus::failed:
+			break;
+		}
+
+		std::optional<std::string_view> hint;
+		if (lexedAny) {
+			hint = previous;
+		}
+		return {nullptr, lexErrorMessage(hint, loc)};
+	}
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include "arena.h"
+#include "lexer.h"
+
+namespace nicolassql {
+
+// reader copies up to size bytes of input into buffer and returns how
+// many it wrote, 0 once the input is exhausted
+using reader = std::function<std::tuple<size_t, std::string>(char* buffer, size_t size)>;
+
+reader fileDescriptorReader(int fd);
+reader istreamReader(std::istream& in);
+
+constexpr size_t defaultChunkSize = 64 * 1024;
+
+// streamLexer tokenizes input pulled from a reader in fixed-size chunks,
+// so memory is bounded by the chunk size (or the largest single token)
+// instead of the size of the input. Tokens that straddle a chunk boundary
+// are finished once the next chunk has been read.
+class streamLexer {
+public:
+	explicit streamLexer(reader read, size_t chunkSize = defaultChunkSize);
+
+	// next returns the next token, or nullptr at the end of the input. The
+	// token and its value are allocated in storage, so they stay valid
+	// after the chunk they came from has been overwritten.
+	std::tuple<token*, std::string> next(arena& storage);
+
+	// bufferSize is the memory currently held for input
+	size_t bufferSize() const { return capacity; }
+
+private:
+	std::string fill();
+
+	reader read;
+	std::unique_ptr<char[]> buffer;
+	size_t capacity;
+	size_t begin = 0;
+	size_t end = 0;
+	bool atEnd = false;
+	location loc{};
+
+	bool lexedAny = false;
+	std::string previous;
+};
+
+}
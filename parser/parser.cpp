@@ -1,5 +1,11 @@
 #include "../lexer/lexer.h"
+#include "../lexer/scan.h"
+#include "../lexer/stream.h"
 #include "../ast/ast.h"
+#include "parser.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <initializer_list>
 #include <iterator>
 #include <memory>
@@ -12,45 +18,115 @@ namespace parser {
 
 using namespace nicolassql;
 
-std::tuple<std::unique_ptr<ast::Statement>, uint64_t, bool> parseStatement(
+// every parse function allocates the nodes it builds in storage, the arena
+// owned by the Ast being built
+
+std::tuple<ast::Statement*, uint64_t, bool> parseStatement(
     const std::vector<token*>& tokens, 
     uint64_t initialCursor, 
-    token delimiter);
+    token delimiter,
+    arena& storage);
 
-std::tuple<std::unique_ptr<ast::SelectStatement>, uint64_t, bool> parseSelectStatement(
+std::tuple<ast::SelectStatement*, uint64_t, bool> parseSelectStatement(
     const std::vector<token*>& tokens, 
     uint64_t initialCursor, 
-    token delimiter);
+    token delimiter,
+    arena& storage);
+
+std::tuple<ast::expression*, uint64_t, bool> parseExpression(
+    const std::vector<token*>& tokens,
+    uint64_t initialCursor,
+    uint8_t minBindingPower,
+    arena& storage);
 
-std::tuple<std::unique_ptr<std::vector<std::unique_ptr<ast::expression>>>, uint64_t, bool> parseExpressions(
+std::tuple<ast::list<ast::expression>*, uint64_t, bool> parseExpressions(
     const std::vector<token*>& tokens, 
     uint64_t initialCursor, 
-    const std::vector<token>& delimiters);
+    std::initializer_list<token> delimiters,
+    arena& storage);
+
+// appendExpressions parses a comma separated expression list into exps,
+// up to one of delimiters
+std::tuple<uint64_t, bool> appendExpressions(
+    const std::vector<token*>& tokens,
+    uint64_t initialCursor,
+    std::initializer_list<token> delimiters,
+    arena& storage,
+    ast::list<ast::expression>& exps);
+
+std::tuple<ast::InsertStatement*, uint64_t, bool> parseInsertStatement(
+	const std::vector<token*>& tokens,
+	uint64_t initialCursor,
+	token delimiter,
+	arena& storage);
+
+std::tuple<ast::CreateTableStatement*, uint64_t, bool> parseCreateTableStatement(
+	const std::vector<token*>& tokens,
+	uint64_t initialCursor,
+	token delimiter,
+	arena& storage);
 
-std::tuple<std::unique_ptr<ast::InsertStatement>, uint64_t, bool> parseInsertStatement(
+std::tuple<ast::CreateIndexStatement*, uint64_t, bool> parseCreateIndexStatement(
 	const std::vector<token*>& tokens,
 	uint64_t initialCursor,
-	token delimiter);
+	arena& storage);
 
-std::tuple<std::unique_ptr<ast::CreateTableStatement>, uint64_t, bool> parseCreateTableStatement(
+std::tuple<ast::CopyStatement*, uint64_t, bool> parseCopyStatement(
 	const std::vector<token*>& tokens,
 	uint64_t initialCursor,
-	token delimiter);
+	arena& storage);
 
-token tokenFromKeyword(keyword k) {
+constexpr token tokenFromKeyword(keyword k) {
 	return token{
+		.value = k,
 		.kind = tokenKind::keywordKind,
-		.value = std::string(k),
+		.id = internedId(keywords, k),
 	};
 }
 
-token tokenFromSymbol(symbol s) {
+constexpr token tokenFromSymbol(symbol s) {
 	return token{
+		.value = s,
 		.kind = tokenKind::symbolKind,
-		.value = std::string(s),
+		.id = internedId(symbols, s),
 	};
 }
 
+constexpr uint16_t selectKeywordId = tokenFromKeyword(selectKeyword).id;
+constexpr uint16_t insertKeywordId = tokenFromKeyword(insertKeyword).id;
+constexpr uint16_t createKeywordId = tokenFromKeyword(createKeyword).id;
+constexpr uint16_t copyKeywordId = tokenFromKeyword(copyKeyword).id;
+
+// symbolBindingPowers maps each symbol id to how tightly it holds its
+// operands as a binary operator, 0 for symbols that are not one
+constexpr std::array<uint8_t, symbols.size() + 1> makeSymbolBindingPowers() {
+	std::array<uint8_t, symbols.size() + 1> powers{};
+	for (symbol s : {equalsSymbol, neqSymbol, neqSymbol2, ltSymbol, lteSymbol, gtSymbol, gteSymbol}) {
+		powers[internedId(symbols, s)] = 3;
+	}
+	powers[internedId(symbols, concatSymbol)] = 4;
+	return powers;
+}
+
+constexpr auto symbolBindingPowers = makeSymbolBindingPowers();
+
+// bindingPower is how tightly the binary operator t holds its operands, or
+// 0 if t is not one: OR binds loosest, then AND, then the comparisons,
+// then ||
+uint8_t bindingPower(const token& t) {
+	constexpr uint16_t andId = tokenFromKeyword(andKeyword).id;
+	constexpr uint16_t orId = tokenFromKeyword(orKeyword).id;
+
+	switch (t.kind) {
+	case tokenKind::keywordKind:
+		return t.id == orId ? 1 : t.id == andId ? 2 : 0;
+	case tokenKind::symbolKind:
+		return t.id < symbolBindingPowers.size() ? symbolBindingPowers[t.id] : 0;
+	default:
+		return 0;
+	}
+}
+
 bool expectToken(const std::vector<token*>& tokens, uint64_t cursor, const token& t) {
 	if (cursor >= tokens.size()) {
 		return false;
@@ -67,34 +143,35 @@ void helpMessage(const std::vector<token*>& tokens, uint64_t cursor, std::string
 		c = tokens[cursor - 1];
 	}
 
-	std::printf("[%llu,%llu]: %s, got: %s\n", c->loc.line, c->loc.col, msg.c_str(), c->value.c_str());
+	std::printf("[%llu,%llu]: %s, got: %.*s\n", c->loc.line, c->loc.col, msg.c_str(),
+		static_cast<int>(c->value.size()), c->value.data());
 }
 
 std::tuple<std::unique_ptr<ast::Ast>, std::string> Parse(std::string source) {
-    auto [tokens, err] = lex(source);
-	if (err != "") {
-		return {nullptr, err};
-	}
+	return Parse(std::make_shared<const std::string>(std::move(source)));
+}
+
+// parseTokens parses all statements in tokens into statements
+std::string parseTokens(std::vector<token*>& tokens, arena& storage, ast::list<ast::Statement>& statements) {
 
 	if (!tokens.empty()) {
 		token semiTok = tokenFromSymbol(semicolonSymbol);
 		token* lastTok = tokens.back();
 		if (!semiTok.equals(*lastTok)) {
-			tokens.push_back(new token {semiTok});
+			tokens.push_back(storage.make<token>(semiTok));
 		}
 	}
 
-	ast::Ast a{};
 	uint64_t cursor = 0;
 	while (cursor < tokens.size()) {
-		auto [stmt, newCursor, ok] = parseStatement(tokens, cursor, tokenFromSymbol(semicolonSymbol));
+		auto [stmt, newCursor, ok] = parseStatement(tokens, cursor, tokenFromSymbol(semicolonSymbol), storage);
 		if (!ok) {
 			helpMessage(tokens, cursor, "Expected statement");
-			return {nullptr, "Failed to parse, expected statement"};
+			return "Failed to parse, expected statement";
 		}
 		cursor = newCursor;
 
-		a.Statements.push_back(std::move(stmt));
+		statements.push_back(stmt);
 
 		bool atLeastOneSemicolon = false;
 		while (expectToken(tokens, cursor, tokenFromSymbol(semicolonSymbol)) == true) {
@@ -104,63 +181,353 @@ std::tuple<std::unique_ptr<ast::Ast>, std::string> Parse(std::string source) {
 
 		if (!atLeastOneSemicolon) {
 			helpMessage(tokens, cursor, "Expected semi-colon delimiter between statemetns");
-			return {nullptr, "Missing semi-colon between statements"};
+			return "Missing semi-colon between statements";
 		}
 	}
 
-	return std::make_tuple(
-		std::make_unique<ast::Ast>(std::move(a)),
-		""
-	);
+	return "";
+}
+
+std::tuple<std::unique_ptr<ast::Ast>, std::string> Parse(std::shared_ptr<const std::string> source) {
+	auto a = std::make_unique<ast::Ast>(std::move(source));
+
+	auto [tokens, err] = lex(*a->Source, *a->Arena);
+	if (err != "") {
+		return {nullptr, err};
+	}
+
+	if (std::string err = parseTokens(tokens, *a->Arena, a->Statements); err != "") {
+		return {nullptr, err};
+	}
+
+	return {std::move(a), ""};
+}
+
+std::tuple<std::unique_ptr<ast::Ast>, std::string> Parse(reader read, size_t chunkSize) {
+	// there is no source to view into, every token value is copied into
+	// the arena as it is lexed
+	auto a = std::make_unique<ast::Ast>(nullptr);
+	streamLexer lexer(std::move(read), chunkSize);
+
+	std::vector<token*> tokens;
+	while (true) {
+		auto [tok, err] = lexer.next(*a->Arena);
+		if (err != "") {
+			return {nullptr, err};
+		}
+		if (tok == nullptr) {
+			break;
+		}
+		tokens.push_back(tok);
+	}
+
+	if (std::string err = parseTokens(tokens, *a->Arena, a->Statements); err != "") {
+		return {nullptr, err};
+	}
+
+	return {std::move(a), ""};
+}
+
+// minChunkBytes keeps ParseParallel from splitting scripts so small that
+// handing the pieces to the pool costs more than parsing them
+constexpr uint64_t minChunkBytes = 64 * 1024;
+
+// statementBoundaries cuts source into about parts pieces of similar size.
+// Every cut falls just after a run of semicolons that is outside any
+// quoted literal, so each piece holds whole statements and lexes the same
+// on its own as it does in place.
+std::vector<uint64_t> statementBoundaries(std::string_view source, size_t parts) {
+	std::vector<uint64_t> cuts{0};
+	const char* data = source.data();
+	uint64_t size = source.size();
+	uint64_t target = size / parts;
+
+	uint64_t i = 0;
+	while (i < size) {
+		// until the piece is big enough only quotes matter, after that the
+		// next semicolon ends it
+		bool wantCut = i >= cuts.back() + target;
+		uint64_t limit = wantCut ? size : std::min(size, cuts.back() + target);
+		i += findAnyByte(data + i, limit - i, '\'', '"', wantCut ? ';' : '\'');
+		if (i >= limit) {
+			i = limit;
+			continue;
+		}
+
+		if (data[i] == ';') {
+			while (i < size) {
+				if (data[i] == ';') {
+					i++;
+					continue;
+				}
+				uint64_t run = whitespaceRun(data + i, size - i);
+				if (run == 0) {
+					break;
+				}
+				i += run;
+			}
+			if (i < size) {
+				cuts.push_back(i);
+			}
+			continue;
+		}
+
+		// an escaped delimiter closes and reopens the literal, so finding
+		// the next one is enough to track whether we are inside it
+		char delimiter = data[i];
+		uint64_t close = i + 1 + findByte(data + i + 1, size - i - 1, delimiter);
+		if (close >= size) {
+			break;
+		}
+		i = close + 1;
+	}
+
+	cuts.push_back(size);
+	return cuts;
+}
+
+std::tuple<std::unique_ptr<ast::Ast>, std::string> ParseParallel(std::string source, threadPool& pool) {
+	return ParseParallel(std::make_shared<const std::string>(std::move(source)), pool);
+}
+
+std::tuple<std::unique_ptr<ast::Ast>, std::string> ParseParallel(std::shared_ptr<const std::string> source, threadPool& pool) {
+	size_t parts = std::min<uint64_t>(pool.size() * 4, source->size() / minChunkBytes);
+	if (parts <= 1) {
+		return Parse(std::move(source));
+	}
+
+	std::string_view script = *source;
+	std::vector<uint64_t> cuts = statementBoundaries(script, parts);
+	size_t chunks = cuts.size() - 1;
+
+	struct chunk {
+		std::unique_ptr<arena> storage = std::make_unique<arena>();
+		std::vector<token*> tokens;
+		// where lexing stopped, relative to the start of the chunk
+		location end{};
+		std::string err;
+	};
+	std::vector<chunk> pieces(chunks);
+
+	pool.parallelFor(chunks, [&](size_t i) {
+		chunk& piece = pieces[i];
+		cursor cur{};
+		auto [tokens, err] = lex(script.substr(cuts[i], cuts[i+1] - cuts[i]), *piece.storage, cur);
+		piece.tokens = std::move(tokens);
+		piece.end = cur.loc;
+		piece.err = std::move(err);
+	});
+
+	for (chunk& piece : pieces) {
+		if (piece.err != "") {
+			// the message carries a location relative to the chunk, lex the
+			// whole script again for the one Parse would report
+			return Parse(std::move(source));
+		}
+	}
+
+	// each chunk was lexed from line 0, column 0; move it to where it
+	// starts in the script
+	std::vector<location> starts(chunks);
+	for (size_t i = 1; i < chunks; i++) {
+		const location& previous = pieces[i-1].end;
+		starts[i] = previous.line == 0
+			? location{.line = starts[i-1].line, .col = starts[i-1].col + previous.col}
+			: location{.line = starts[i-1].line + previous.line, .col = previous.col};
+	}
+
+	std::vector<ast::list<ast::Statement>> statements;
+	statements.reserve(chunks);
+	for (chunk& piece : pieces) {
+		statements.emplace_back(piece.storage.get());
+	}
+
+	pool.parallelFor(chunks, [&](size_t i) {
+		chunk& piece = pieces[i];
+		for (token* tok : piece.tokens) {
+			if (tok->loc.line == 0) {
+				tok->loc.col += starts[i].col;
+			}
+			tok->loc.line += starts[i].line;
+		}
+		piece.err = parseTokens(piece.tokens, *piece.storage, statements[i]);
+	});
+
+	size_t total = 0;
+	for (size_t i = 0; i < chunks; i++) {
+		if (pieces[i].err != "") {
+			return {nullptr, pieces[i].err};
+		}
+		total += statements[i].size();
+	}
+
+	auto a = std::make_unique<ast::Ast>(std::move(source));
+	a->Statements.reserve(total);
+	for (size_t i = 0; i < chunks; i++) {
+		a->Statements.insert(a->Statements.end(), statements[i].begin(), statements[i].end());
+		a->ChunkArenas.push_back(std::move(pieces[i].storage));
+	}
+
+	return {std::move(a), ""};
+}
+
+statementStream::statementStream(reader read, size_t chunkSize)
+	: lexer(std::move(read), chunkSize) {}
+
+std::tuple<ast::Statement*, std::string> statementStream::next() {
+	statementArena.reset();
+	tokens.clear();
+
+	token semiTok = tokenFromSymbol(semicolonSymbol);
+	while (true) {
+		auto [tok, err] = lexer.next(statementArena);
+		if (err != "") {
+			return {nullptr, err};
+		}
+
+		if (tok == nullptr) {
+			if (tokens.empty()) {
+				return {nullptr, ""};
+			}
+
+			tokens.push_back(statementArena.make<token>(semiTok));
+			break;
+		}
+
+		// skip the empty statements between repeated semicolons
+		if (semiTok.equals(*tok) && tokens.empty()) {
+			continue;
+		}
+
+		tokens.push_back(tok);
+		if (semiTok.equals(*tok)) {
+			break;
+		}
+	}
+
+	auto [stmt, cursor, ok] = parseStatement(tokens, 0, semiTok, statementArena);
+	if (!ok) {
+		helpMessage(tokens, 0, "Expected statement");
+		return {nullptr, "Failed to parse, expected statement"};
+	}
+
+	if (cursor != tokens.size() - 1) {
+		helpMessage(tokens, cursor, "Expected semi-colon delimiter between statemetns");
+		return {nullptr, "Missing semi-colon between statements"};
+	}
+
+	return {stmt, ""};
+}
+
+std::string ParseEach(reader read, const std::function<bool(const ast::Statement&)>& handle, size_t chunkSize) {
+	statementStream statements(std::move(read), chunkSize);
+	while (true) {
+		auto [stmt, err] = statements.next();
+		if (stmt == nullptr) {
+			return err;
+		}
+
+		if (!handle(*stmt)) {
+			return "";
+		}
+	}
 }
 
-std::tuple<std::unique_ptr<ast::Statement>, uint64_t, bool> parseStatement(
+std::tuple<ast::Statement*, uint64_t, bool> parseStatement(
 				const std::vector<token*>& tokens, 
 				uint64_t initialCursor, 
-				token delimiter) {
+				token delimiter,
+				arena& storage) {
 	uint64_t cursor = initialCursor;
 
-	token semicolonToken = tokenFromSymbol(semicolonSymbol);
+	if (cursor >= tokens.size() || tokens[cursor]->kind != tokenKind::keywordKind) {
+		return {nullptr, initialCursor, false};
+	}
+
+	// the leading keyword decides which statement this is, so no parse is
+	// attempted and then thrown away
+	switch (tokens[cursor]->id) {
+	case selectKeywordId: {
+		auto [slct, newCursor, ok] = parseSelectStatement(tokens, cursor, delimiter, storage);
+		if (!ok) {
+			break;
+		}
 
-	// look for SELECT statement
-	auto [slct, newCursor, ok] = parseSelectStatement(tokens, cursor, semicolonToken);
-	if (ok) {
 		return std::make_tuple(
-			std::make_unique<ast::Statement>(ast::Statement{
+			storage.make<ast::Statement>(ast::Statement{
 				.Kind = ast::AstKind::SelectKind,
-				.SelectStatement = slct.release(),
+				.SelectStatement = slct,
 			}), 
 			newCursor, 
 			true
 		);
 	}
 
-	// look for INSERT statement
-	auto [inst, newCursor1, ok1] = parseInsertStatement(tokens, cursor, semicolonToken);
-	if (ok1) {
+	case insertKeywordId: {
+		auto [inst, newCursor, ok] = parseInsertStatement(tokens, cursor, delimiter, storage);
+		if (!ok) {
+			break;
+		}
+
 		return std::make_tuple(
-			std::make_unique<ast::Statement>(ast::Statement{
+			storage.make<ast::Statement>(ast::Statement{
 				.Kind = ast::AstKind::InsertKind,
-				.InsertStatement = inst.release(),
+				.InsertStatement = inst,
 			}), 
-			newCursor1, 
+			newCursor, 
 			true
 		);
 	}
 
-	// look for CREATE statement
-	auto [crtTbl, newCursor2, ok2] = parseCreateTableStatement(tokens, cursor, semicolonToken);
-	if (ok2) {
+	case createKeywordId: {
+		if (expectToken(tokens, cursor + 1, tokenFromKeyword(indexKeyword))) {
+			auto [crtIdx, newCursor, ok] = parseCreateIndexStatement(tokens, cursor, storage);
+			if (!ok) {
+				break;
+			}
+
+			return std::make_tuple(
+				storage.make<ast::Statement>(ast::Statement{
+					.Kind = ast::AstKind::CreateIndexKind,
+					.CreateIndexStatement = crtIdx,
+				}),
+				newCursor,
+				true
+			);
+		}
+
+		auto [crtTbl, newCursor, ok] = parseCreateTableStatement(tokens, cursor, delimiter, storage);
+		if (!ok) {
+			break;
+		}
+
 		return std::make_tuple(
-			std::make_unique<ast::Statement>(ast::Statement{
+			storage.make<ast::Statement>(ast::Statement{
 				.Kind = ast::AstKind::CreateTableKind,
-				.CreateTableStatement = crtTbl.release(),
+				.CreateTableStatement = crtTbl,
 			}), 
-			newCursor2, 
+			newCursor, 
 			true
 		);
 	}
 
+	case copyKeywordId: {
+		auto [cpy, newCursor, ok] = parseCopyStatement(tokens, cursor, storage);
+		if (!ok) {
+			break;
+		}
+
+		return std::make_tuple(
+			storage.make<ast::Statement>(ast::Statement{
+				.Kind = ast::AstKind::CopyKind,
+				.CopyStatement = cpy,
+			}),
+			newCursor,
+			true
+		);
+	}
+	}
+
 	return {nullptr, initialCursor, false};
 }
 
@@ -183,25 +550,28 @@ std::tuple<token*, uint64_t, bool> parseToken(
 	return {nullptr, initialCursor, false};
 }
 
-std::tuple<std::unique_ptr<ast::SelectStatement>, uint64_t, bool> parseSelectStatement(
+std::tuple<ast::SelectStatement*, uint64_t, bool> parseSelectStatement(
 								const std::vector<token*>& tokens,
 								uint64_t initialCursor,
-								token delimiter) {
+								token delimiter,
+								arena& storage) {
 	uint64_t cursor = initialCursor;
 	if (!expectToken(tokens, cursor, tokenFromKeyword(selectKeyword))) {
 		return {nullptr, initialCursor, false};
 	}
 	cursor++;
 
-	ast::SelectStatement slct{};
-
-	std::vector<token> endDelimiters = { tokenFromKeyword(fromKeyword), delimiter };
-	auto [exps, newCursor, ok] = parseExpressions(tokens, cursor, endDelimiters);
+	auto [exps, newCursor, ok] = parseExpressions(tokens, cursor,
+		{ tokenFromKeyword(fromKeyword), tokenFromKeyword(whereKeyword), tokenFromKeyword(groupKeyword),
+			tokenFromKeyword(orderKeyword), tokenFromKeyword(limitKeyword), delimiter },
+		storage);
 	if (!ok) {
 		return {nullptr, initialCursor, false};
 	}
 
-	slct.item = std::move(*exps);
+	auto slct = storage.make<ast::SelectStatement>(ast::SelectStatement{
+		.item = std::move(*exps),
+	});
 	cursor = newCursor;
 
 	if (expectToken(tokens, cursor, tokenFromKeyword(fromKeyword))) {
@@ -213,55 +583,324 @@ std::tuple<std::unique_ptr<ast::SelectStatement>, uint64_t, bool> parseSelectSta
 			return {nullptr, initialCursor, false};
 		}
 
-		slct.from = *from;
+		slct->from = *from;
 		cursor = newCursor1;
+
+		while (expectToken(tokens, cursor, tokenFromKeyword(joinKeyword))) {
+			cursor++;
+
+			auto [table, newCursor2, ok2] = parseToken(tokens, cursor, tokenKind::identifierKind);
+			if (!ok2) {
+				helpMessage(tokens, cursor, "Expected table name after JOIN");
+				return {nullptr, initialCursor, false};
+			}
+			cursor = newCursor2;
+
+			if (!expectToken(tokens, cursor, tokenFromKeyword(onKeyword))) {
+				helpMessage(tokens, cursor, "Expected ON");
+				return {nullptr, initialCursor, false};
+			}
+			cursor++;
+
+			auto [on, newCursor3, ok3] = parseExpression(tokens, cursor, 0, storage);
+			if (!ok3) {
+				helpMessage(tokens, cursor, "Expected JOIN condition");
+				return {nullptr, initialCursor, false};
+			}
+			cursor = newCursor3;
+
+			if (slct->joins == nullptr) {
+				slct->joins = storage.make<ast::list<ast::joinClause>>(&storage);
+			}
+			slct->joins->push_back(storage.make<ast::joinClause>(ast::joinClause{
+				.table = *table,
+				.on = on,
+			}));
+		}
 	}
 
-	return std::make_tuple(
-		std::make_unique<ast::SelectStatement>(std::move(slct)),
-		cursor,
-		true
-	);
+	if (expectToken(tokens, cursor, tokenFromKeyword(whereKeyword))) {
+		cursor++;
+
+		auto [where, newCursor2, ok2] = parseExpression(tokens, cursor, 0, storage);
+		if (!ok2) {
+			helpMessage(tokens, cursor, "Expected WHERE conditionals");
+			return {nullptr, initialCursor, false};
+		}
+
+		slct->where = where;
+		cursor = newCursor2;
+	}
+
+	if (expectToken(tokens, cursor, tokenFromKeyword(groupKeyword))) {
+		cursor++;
+		if (!expectToken(tokens, cursor, tokenFromKeyword(byKeyword))) {
+			helpMessage(tokens, cursor, "Expected BY");
+			return {nullptr, initialCursor, false};
+		}
+		cursor++;
+
+		auto [groupBy, newCursor3, ok3] = parseExpressions(tokens, cursor,
+			{ tokenFromKeyword(orderKeyword), tokenFromKeyword(limitKeyword), delimiter }, storage);
+		if (!ok3 || groupBy->empty()) {
+			helpMessage(tokens, cursor, "Expected GROUP BY expressions");
+			return {nullptr, initialCursor, false};
+		}
+
+		slct->groupBy = groupBy;
+		cursor = newCursor3;
+	}
+
+	if (expectToken(tokens, cursor, tokenFromKeyword(orderKeyword))) {
+		cursor++;
+		if (!expectToken(tokens, cursor, tokenFromKeyword(byKeyword))) {
+			helpMessage(tokens, cursor, "Expected BY");
+			return {nullptr, initialCursor, false};
+		}
+		cursor++;
+
+		slct->orderBy = storage.make<ast::list<ast::orderItem>>(&storage);
+		do {
+			if (!slct->orderBy->empty()) {
+				cursor++;
+			}
+			auto [expr, newCursor4, ok4] = parseExpression(tokens, cursor, 0, storage);
+			if (!ok4) {
+				helpMessage(tokens, cursor, "Expected ORDER BY expression");
+				return {nullptr, initialCursor, false};
+			}
+			cursor = newCursor4;
+
+			bool descending = expectToken(tokens, cursor, tokenFromKeyword(descKeyword));
+			if (descending || expectToken(tokens, cursor, tokenFromKeyword(ascKeyword))) {
+				cursor++;
+			}
+			slct->orderBy->push_back(storage.make<ast::orderItem>(ast::orderItem{
+				.expr = expr,
+				.descending = descending,
+			}));
+		} while (expectToken(tokens, cursor, tokenFromSymbol(commaSymbol)));
+	}
+
+	if (expectToken(tokens, cursor, tokenFromKeyword(limitKeyword))) {
+		cursor++;
+
+		auto [limit, newCursor5, ok5] = parseExpression(tokens, cursor, 0, storage);
+		if (!ok5) {
+			helpMessage(tokens, cursor, "Expected LIMIT count");
+			return {nullptr, initialCursor, false};
+		}
+
+		slct->limit = limit;
+		cursor = newCursor5;
+	}
+
+	return {slct, cursor, true};
 
 }
 
 
 
-std::tuple<std::unique_ptr<ast::expression>, uint64_t, bool> parseExpression(
-		const std::vector<token*>& tokens, 
+// convertLiteral stores the value of a numeric or string literal in expr:
+// an INT when the number is integral and fits, a double otherwise. Text
+// with doubled quotes is copied into storage once they are undone.
+void convertLiteral(ast::expression& expr, arena& storage) {
+	std::string_view value = expr.literal->value;
+	const char* end = value.data() + value.size();
+	switch (expr.literal->kind) {
+	case tokenKind::numericKind: {
+		auto [stop, ec] = std::from_chars(value.data(), end, expr.intValue);
+		if (ec == std::errc() && stop == end) {
+			expr.type = ast::literalType::intLiteral;
+			return;
+		}
+		expr.intValue = 0;
+		auto [floatStop, floatEc] = std::from_chars(value.data(), end, expr.floatValue);
+		if (floatEc == std::errc() && floatStop == end) {
+			expr.type = ast::literalType::floatLiteral;
+		}
+		return;
+	}
+
+	case tokenKind::stringKind: {
+		expr.type = ast::literalType::textLiteral;
+		size_t quote = findByte(value.data(), value.size(), '\'');
+		if (quote >= value.size()) {
+			expr.text = value;
+			return;
+		}
+		char* text = static_cast<char*>(storage.allocate(value.size(), 1));
+		size_t length = 0;
+		for (size_t i = 0; i < value.size(); i++) {
+			text[length++] = value[i];
+			if (value[i] == '\'' && i + 1 < value.size() && value[i + 1] == '\'') {
+				i++;
+			}
+		}
+		expr.text = std::string_view(text, length);
+		return;
+	}
+
+	default:
+		return;
+	}
+}
+
+// parseOperand parses a literal, a placeholder, a function call or a
+// parenthesized expression
+std::tuple<ast::expression*, uint64_t, bool> parseOperand(
+		const std::vector<token*>& tokens,
 		uint64_t initialCursor,
-		token _token
-		) {
+		arena& storage) {
 	uint64_t cursor = initialCursor;
 
-	std::vector<tokenKind> kinds = {tokenKind::identifierKind, tokenKind::numericKind, tokenKind::stringKind};
-	for (tokenKind kind : kinds) {
-		auto [t, newCursor, ok] = parseToken(tokens, cursor, kind);
-		if (ok) {
-			return std::make_tuple(
-				std::make_unique<ast::expression>(ast::expression{
-					.literal = t,
-					.kind = ast::expressionKind::literalKind,
-				}),
-				newCursor,
-				true
-			);
+	if (cursor >= tokens.size()) {
+		return {nullptr, initialCursor, false};
+	}
+
+	// a name followed by ( calls the function it names
+	if (tokens[cursor]->kind == tokenKind::identifierKind &&
+			expectToken(tokens, cursor + 1, tokenFromSymbol(leftparenSymbol))) {
+		auto call = storage.make<ast::callExpression>(ast::callExpression{
+			.function = *tokens[cursor],
+			.argument = nullptr,
+		});
+		cursor += 2;
+
+		if (expectToken(tokens, cursor, tokenFromSymbol(asteriskSymbol))) {
+			cursor++;
+		} else {
+			auto [argument, newCursor, ok] = parseExpression(tokens, cursor, 0, storage);
+			if (!ok) {
+				helpMessage(tokens, cursor, "Expected function argument");
+				return {nullptr, initialCursor, false};
+			}
+			call->argument = argument;
+			cursor = newCursor;
+		}
+
+		if (!expectToken(tokens, cursor, tokenFromSymbol(rightparenSymbol))) {
+			helpMessage(tokens, cursor, "Expected closing paren");
+			return {nullptr, initialCursor, false};
 		}
+
+		return {storage.make<ast::expression>(ast::expression{
+			.literal = tokens[initialCursor],
+			.kind = ast::expressionKind::callKind,
+			.call = call,
+		}), cursor + 1, true};
 	}
 
-	return {nullptr, initialCursor, false};
+	switch (tokens[cursor]->kind) {
+	case tokenKind::identifierKind:
+	case tokenKind::numericKind:
+	case tokenKind::stringKind: {
+		auto expr = storage.make<ast::expression>(ast::expression{
+			.literal = tokens[cursor],
+			.kind = ast::expressionKind::literalKind,
+		});
+		convertLiteral(*expr, storage);
+		return std::make_tuple(expr, cursor + 1, true);
+	}
+	case tokenKind::placeholderKind:
+		return std::make_tuple(
+			storage.make<ast::expression>(ast::expression{
+				.literal = tokens[cursor],
+				.kind = ast::expressionKind::placeholderKind,
+			}),
+			cursor + 1,
+			true
+		);
+	default:
+		break;
+	}
+
+	if (!expectToken(tokens, cursor, tokenFromSymbol(leftparenSymbol))) {
+		return {nullptr, initialCursor, false};
+	}
+	cursor++;
+
+	auto [inner, newCursor, ok] = parseExpression(tokens, cursor, 0, storage);
+	if (!ok) {
+		return {nullptr, initialCursor, false};
+	}
+	cursor = newCursor;
+
+	if (!expectToken(tokens, cursor, tokenFromSymbol(rightparenSymbol))) {
+		helpMessage(tokens, cursor, "Expected closing paren");
+		return {nullptr, initialCursor, false};
+	}
+
+	return {inner, cursor + 1, true};
 }
 
-std::tuple<std::unique_ptr<std::vector<std::unique_ptr<ast::expression>>>, uint64_t, bool> parseExpressions(
+// parseExpression parses operands joined by binary operators that bind
+// tighter than minBindingPower. It stops at the first token that does not
+// continue the expression and leaves checking that token to the caller.
+std::tuple<ast::expression*, uint64_t, bool> parseExpression(
+		const std::vector<token*>& tokens,
+		uint64_t initialCursor,
+		uint8_t minBindingPower,
+		arena& storage) {
+	auto [exp, cursor, ok] = parseOperand(tokens, initialCursor, storage);
+	if (!ok) {
+		return {nullptr, initialCursor, false};
+	}
+
+	while (cursor < tokens.size()) {
+		const token& op = *tokens[cursor];
+		uint8_t power = bindingPower(op);
+		// operators of equal power associate to the left
+		if (power <= minBindingPower) {
+			break;
+		}
+
+		auto [b, newCursor, okB] = parseExpression(tokens, cursor + 1, power, storage);
+		if (!okB) {
+			helpMessage(tokens, cursor + 1, "Expected right operand");
+			return {nullptr, initialCursor, false};
+		}
+
+		exp = storage.make<ast::expression>(ast::expression{
+			.literal = nullptr,
+			.kind = ast::expressionKind::binaryKind,
+			.binary = storage.make<ast::binaryExpression>(ast::binaryExpression{
+				.a = exp,
+				.b = b,
+				.op = op,
+			}),
+		});
+		cursor = newCursor;
+	}
+
+	return {exp, cursor, true};
+}
+
+std::tuple<ast::list<ast::expression>*, uint64_t, bool> parseExpressions(
 		const std::vector<token*>& tokens, 
 		uint64_t initialCursor, 
-		const std::vector<token>& delimiters) {
+		std::initializer_list<token> delimiters,
+		arena& storage) {
+	auto exps = storage.make<ast::list<ast::expression>>(&storage);
+	auto [cursor, ok] = appendExpressions(tokens, initialCursor, delimiters, storage, *exps);
+	if (!ok) {
+		return {nullptr, initialCursor, false};
+	}
+	return {exps, cursor, true};
+}
+
+std::tuple<uint64_t, bool> appendExpressions(
+		const std::vector<token*>& tokens,
+		uint64_t initialCursor,
+		std::initializer_list<token> delimiters,
+		arena& storage,
+		ast::list<ast::expression>& exps) {
 	size_t cursor = initialCursor;
-    auto exps = std::make_unique<std::vector<std::unique_ptr<ast::expression>>>();
+	size_t first = exps.size();
 
 	while (true) {
 		if (cursor >= tokens.size()) {
-			return {nullptr, initialCursor, false};
+			return {initialCursor, false};
 		}
 
 		// look for delimiter
@@ -278,36 +917,34 @@ std::tuple<std::unique_ptr<std::vector<std::unique_ptr<ast::expression>>>, uint6
 		}
 	
 		// look for comma
-		if (!exps->empty()) {
+		if (exps.size() > first) {
 			auto commaTok = tokenFromSymbol(commaSymbol);
 			if (!expectToken(tokens, cursor, commaTok)) {
 				helpMessage(tokens, cursor, "Expected comma");
-				return {nullptr, initialCursor, false};
+				return {initialCursor, false};
 			}
 			++cursor;
 		}
 
 		// parse next expression
-		auto commaForExpr = tokenFromSymbol(commaSymbol);
-		auto [exprPtr, newCursor, okExpr] = parseExpression(tokens, cursor, commaForExpr);
+		auto [exprPtr, newCursor, okExpr] = parseExpression(tokens, cursor, 0, storage);
 		if (!okExpr) {
 			helpMessage(tokens, cursor, "Expected expression");
-			return {nullptr, initialCursor, false};
+			return {initialCursor, false};
 		}
 
 		cursor = newCursor;
-		exps->push_back(std::move(exprPtr));
+		exps.push_back(exprPtr);
 	}
 
-	return { std::move(exps), cursor, true};
-
-
+	return {cursor, true};
 }
 
-std::tuple<std::unique_ptr<ast::InsertStatement>, uint64_t, bool> parseInsertStatement(
+std::tuple<ast::InsertStatement*, uint64_t, bool> parseInsertStatement(
 	const std::vector<token*>& tokens,
 	uint64_t initialCursor,
-	token delimiter) {
+	token delimiter,
+	arena& storage) {
 
 	uint64_t cursor = initialCursor;
 
@@ -338,31 +975,54 @@ std::tuple<std::unique_ptr<ast::InsertStatement>, uint64_t, bool> parseInsertSta
 	}
 	cursor++;
 
-	// Look for left paren
-	if (!expectToken(tokens, cursor, tokenFromSymbol(leftparenSymbol))) {
-		helpMessage(tokens, cursor, "Expected left paren");
-		return {nullptr, initialCursor, false};
-	}
-	cursor++;
+	// look for the rows, each an expression list in parens, all of them
+	// appended to one list so a bulk load allocates nothing per row
+	auto values = storage.make<ast::list<ast::expression>>(&storage);
+	uint64_t rows = 0;
+	size_t width = 0;
+	while (true) {
+		// Look for left paren
+		if (!expectToken(tokens, cursor, tokenFromSymbol(leftparenSymbol))) {
+			helpMessage(tokens, cursor, "Expected left paren");
+			return {nullptr, initialCursor, false};
+		}
+		cursor++;
 
-	// look for expression list
-	auto [values, newCursor2, ok2] = parseExpressions(tokens, cursor, std::vector<token>{tokenFromSymbol(rightparenSymbol)});
-	if (!ok2) {
-		return {nullptr, initialCursor, false};
-	}
-	cursor = newCursor2;
+		// look for expression list
+		auto [newCursor2, ok2] = appendExpressions(tokens, cursor, {tokenFromSymbol(rightparenSymbol)}, storage, *values);
+		if (!ok2) {
+			return {nullptr, initialCursor, false};
+		}
+		cursor = newCursor2;
 
-	// look for right paren
-	if (!expectToken(tokens, cursor, tokenFromSymbol(rightparenSymbol))) {
-		helpMessage(tokens, cursor, "Expected right paren");
-		return {nullptr, initialCursor, false};
+		// look for right paren
+		if (!expectToken(tokens, cursor, tokenFromSymbol(rightparenSymbol))) {
+			helpMessage(tokens, cursor, "Expected right paren");
+			return {nullptr, initialCursor, false};
+		}
+
+		// every row has as many values as the first
+		if (rows == 0) {
+			width = values->size();
+		} else if (values->size() != width * (rows + 1)) {
+			helpMessage(tokens, cursor, "Expected " + std::to_string(width) + " values in every row");
+			return {nullptr, initialCursor, false};
+		}
+		rows++;
+		cursor++;
+
+		// look for comma before the next row
+		if (!expectToken(tokens, cursor, tokenFromSymbol(commaSymbol))) {
+			break;
+		}
+		cursor++;
 	}
-	cursor++;
 
 	return std::make_tuple(
-			std::make_unique<ast::InsertStatement>(ast::InsertStatement{
+			storage.make<ast::InsertStatement>(ast::InsertStatement{
 				.table = *table,
-				.values = std::move(values),
+				.values = values,
+				.rows = rows,
 			}), 
 			cursor, 
 			true
@@ -370,14 +1030,15 @@ std::tuple<std::unique_ptr<ast::InsertStatement>, uint64_t, bool> parseInsertSta
 
 }
 
-std::tuple<std::unique_ptr<std::vector<std::unique_ptr<ast::columnDefinition>>>, uint64_t, bool> parseColumnDefinitions(
+std::tuple<ast::list<ast::columnDefinition>*, uint64_t, bool> parseColumnDefinitions(
 		const std::vector<token*>& tokens,
 		uint64_t initialCursor,
-		token delimiter) {
+		token delimiter,
+		arena& storage) {
 
 	uint64_t cursor = initialCursor;
 
-	std::vector<std::unique_ptr<ast::columnDefinition>> cds;
+	auto cds = storage.make<ast::list<ast::columnDefinition>>(&storage);
 	while (true) {
 		if (cursor >= tokens.size()) {
 			return {nullptr, initialCursor, false};
@@ -389,7 +1050,7 @@ std::tuple<std::unique_ptr<std::vector<std::unique_ptr<ast::columnDefinition>>>,
 			break;
 		}
 
-		if (cds.size() > 0) {
+		if (cds->size() > 0) {
 			if (!expectToken(tokens, cursor, tokenFromSymbol(commaSymbol))) {
 				helpMessage(tokens, cursor, "Expected comma");
 				return {nullptr, initialCursor, false};
@@ -414,19 +1075,20 @@ std::tuple<std::unique_ptr<std::vector<std::unique_ptr<ast::columnDefinition>>>,
 		}
 		cursor = newCursor2;
 
-		cds.push_back(std::make_unique<ast::columnDefinition>(ast::columnDefinition{
+		cds->push_back(storage.make<ast::columnDefinition>(ast::columnDefinition{
 			.name = *id,
 			.datatype = *ty,
 		}));
 	}
 
-	return {std::make_unique<std::vector<std::unique_ptr<ast::columnDefinition>>>(std::move(cds)), cursor, true};
+	return {cds, cursor, true};
 }
 
-std::tuple<std::unique_ptr<ast::CreateTableStatement>, uint64_t, bool> parseCreateTableStatement(
+std::tuple<ast::CreateTableStatement*, uint64_t, bool> parseCreateTableStatement(
 	const std::vector<token*>& tokens,
 	uint64_t initialCursor,
-	token delimiter) {
+	token delimiter,
+	arena& storage) {
 
 	uint64_t cursor = initialCursor;
 
@@ -453,12 +1115,78 @@ std::tuple<std::unique_ptr<ast::CreateTableStatement>, uint64_t, bool> parseCrea
 	}
 	cursor++;
 
-	auto [cols, newCursor2, ok2] = parseColumnDefinitions(tokens, cursor, tokenFromSymbol(rightparenSymbol));
+	auto [cols, newCursor2, ok2] = parseColumnDefinitions(tokens, cursor, tokenFromSymbol(rightparenSymbol), storage);
+	if (!ok2) {
+		return {nullptr, initialCursor, false};
+	}
+	cursor = newCursor2;
+
+	if (!expectToken(tokens, cursor, tokenFromSymbol(rightparenSymbol))) {
+		helpMessage(tokens, cursor, "Expected right parenthesis");
+		return {nullptr, initialCursor, false};
+	}
+	cursor++;
+
+	return std::make_tuple(
+			storage.make<ast::CreateTableStatement>(ast::CreateTableStatement{
+				.name = *name,
+				.cols = cols,
+			}),
+			cursor,
+			true
+		);
+}
+
+std::tuple<ast::CreateIndexStatement*, uint64_t, bool> parseCreateIndexStatement(
+	const std::vector<token*>& tokens,
+	uint64_t initialCursor,
+	arena& storage) {
+
+	uint64_t cursor = initialCursor;
+
+	if (!expectToken(tokens, cursor, tokenFromKeyword(createKeyword))) {
+		return {nullptr, initialCursor, false};
+	}
+	cursor++;
+
+	if (!expectToken(tokens, cursor, tokenFromKeyword(indexKeyword))) {
+		return {nullptr, initialCursor, false};
+	}
+	cursor++;
+
+	auto [name, newCursor, ok] = parseToken(tokens, cursor, tokenKind::identifierKind);
+	if (!ok) {
+		helpMessage(tokens, cursor, "Expected index name");
+		return {nullptr, initialCursor, false};
+	}
+	cursor = newCursor;
+
+	if (!expectToken(tokens, cursor, tokenFromKeyword(onKeyword))) {
+		helpMessage(tokens, cursor, "Expected ON");
+		return {nullptr, initialCursor, false};
+	}
+	cursor++;
+
+	auto [table, newCursor2, ok2] = parseToken(tokens, cursor, tokenKind::identifierKind);
 	if (!ok2) {
+		helpMessage(tokens, cursor, "Expected table name");
 		return {nullptr, initialCursor, false};
 	}
 	cursor = newCursor2;
 
+	if (!expectToken(tokens, cursor, tokenFromSymbol(leftparenSymbol))) {
+		helpMessage(tokens, cursor, "Expected left parenthesis");
+		return {nullptr, initialCursor, false};
+	}
+	cursor++;
+
+	auto [column, newCursor3, ok3] = parseToken(tokens, cursor, tokenKind::identifierKind);
+	if (!ok3) {
+		helpMessage(tokens, cursor, "Expected column name");
+		return {nullptr, initialCursor, false};
+	}
+	cursor = newCursor3;
+
 	if (!expectToken(tokens, cursor, tokenFromSymbol(rightparenSymbol))) {
 		helpMessage(tokens, cursor, "Expected right parenthesis");
 		return {nullptr, initialCursor, false};
@@ -466,9 +1194,56 @@ std::tuple<std::unique_ptr<ast::CreateTableStatement>, uint64_t, bool> parseCrea
 	cursor++;
 
 	return std::make_tuple(
-			std::make_unique<ast::CreateTableStatement>(ast::CreateTableStatement{
+			storage.make<ast::CreateIndexStatement>(ast::CreateIndexStatement{
 				.name = *name,
-				.cols = std::move(cols),				
+				.table = *table,
+				.column = *column,
+			}),
+			cursor,
+			true
+		);
+}
+
+std::tuple<ast::CopyStatement*, uint64_t, bool> parseCopyStatement(
+	const std::vector<token*>& tokens,
+	uint64_t initialCursor,
+	arena& storage) {
+
+	uint64_t cursor = initialCursor;
+
+	if (!expectToken(tokens, cursor, tokenFromKeyword(copyKeyword))) {
+		return {nullptr, initialCursor, false};
+	}
+	cursor++;
+
+	auto [table, newCursor, ok] = parseToken(tokens, cursor, tokenKind::identifierKind);
+	if (!ok) {
+		helpMessage(tokens, cursor, "Expected table name");
+		return {nullptr, initialCursor, false};
+	}
+	cursor = newCursor;
+
+	if (!expectToken(tokens, cursor, tokenFromKeyword(fromKeyword))) {
+		helpMessage(tokens, cursor, "Expected FROM");
+		return {nullptr, initialCursor, false};
+	}
+	cursor++;
+
+	auto [file, newCursor2, ok2] = parseToken(tokens, cursor, tokenKind::stringKind);
+	if (!ok2) {
+		helpMessage(tokens, cursor, "Expected file name");
+		return {nullptr, initialCursor, false};
+	}
+	cursor = newCursor2;
+
+	// the path is converted like any other string literal
+	ast::expression path{.literal = file, .kind = ast::expressionKind::literalKind};
+	convertLiteral(path, storage);
+
+	return std::make_tuple(
+			storage.make<ast::CopyStatement>(ast::CopyStatement{
+				.table = *table,
+				.file = path.text,
 			}),
 			cursor,
 			true
@@ -1,12 +1,60 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <tuple>
 #include <memory>
+#include <vector>
 #include "../ast/ast.h"
+#include "../lexer/pool.h"
+#include "../lexer/stream.h"
 
 namespace parser {
 
 std::tuple<std::unique_ptr<ast::Ast>, std::string> Parse(std::string source);
 
+// Parse shares ownership of source with the returned Ast, whose tokens view
+// into it, so callers that already hold the script avoid another copy
+std::tuple<std::unique_ptr<ast::Ast>, std::string> Parse(std::shared_ptr<const std::string> source);
+
+// Parse lexes input pulled from read a chunk at a time, so the script is
+// never held in memory as a whole, only its tokens and AST
+std::tuple<std::unique_ptr<ast::Ast>, std::string> Parse(nicolassql::reader read,
+	size_t chunkSize = nicolassql::defaultChunkSize);
+
+// ParseParallel splits source between statements and lexes and parses
+// the pieces on pool. The result is the same as Parse(source): statements
+// come in script order and token locations refer to the whole script.
+std::tuple<std::unique_ptr<ast::Ast>, std::string> ParseParallel(std::string source,
+	nicolassql::threadPool& pool = nicolassql::sharedPool());
+
+std::tuple<std::unique_ptr<ast::Ast>, std::string> ParseParallel(std::shared_ptr<const std::string> source,
+	nicolassql::threadPool& pool = nicolassql::sharedPool());
+
+// statementStream parses input pulled from a reader one statement at a
+// time. Each statement lives in an arena that is reset when the next one
+// is parsed, so memory stays constant however long the input is.
+class statementStream {
+public:
+	explicit statementStream(nicolassql::reader read, size_t chunkSize = nicolassql::defaultChunkSize);
+
+	// next returns the next statement, or nullptr at the end of the input
+	// or on error. The statement and its tokens are only valid until the
+	// following call to next.
+	std::tuple<ast::Statement*, std::string> next();
+
+	const nicolassql::arena& storage() const { return statementArena; }
+
+private:
+	nicolassql::streamLexer lexer;
+	nicolassql::arena statementArena;
+	std::vector<nicolassql::token*> tokens;
+};
+
+// ParseEach hands every statement read from read to handle, freeing it
+// before the next one is parsed, and stops early if handle returns false
+std::string ParseEach(nicolassql::reader read,
+	const std::function<bool(const ast::Statement&)>& handle,
+	size_t chunkSize = nicolassql::defaultChunkSize);
+
 }
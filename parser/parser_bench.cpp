@@ -0,0 +1,112 @@
+#include <benchmark/benchmark.h>
+#include "parser.h"
+#include "prepare.h"
+#include <memory>
+#include <string>
+
+using namespace nicolassql;
+
+// mixedScript alternates the three statement kinds, CREATE TABLE last as
+// it is the last one parseStatement used to try
+static std::string mixedScript(int statements) {
+    std::string script;
+    for (int i = 0; i < statements; i++) {
+        switch (i % 3) {
+        case 0:
+            script += "INSERT INTO users VALUES (" + std::to_string(i) + ", 'name', 42);\n";
+            break;
+        case 1:
+            script += "SELECT id, name, score FROM users;\n";
+            break;
+        case 2:
+            script += "CREATE TABLE t" + std::to_string(i) + " (id INT, name TEXT, score INT);\n";
+            break;
+        }
+    }
+    return script;
+}
+
+// BM_LexOnly is the lexing share of BM_Parse, subtract it to get the
+// parser's own per-statement cost
+static void BM_LexOnly(benchmark::State& state) {
+    int statements = static_cast<int>(state.range(0));
+    std::string script = mixedScript(statements);
+    for (auto _ : state) {
+        arena storage;
+        auto [tokens, err] = lex(script, storage);
+        benchmark::DoNotOptimize(tokens.data());
+    }
+    state.SetItemsProcessed(state.iterations() * statements);
+}
+
+static void BM_Parse(benchmark::State& state) {
+    int statements = static_cast<int>(state.range(0));
+    auto script = std::make_shared<const std::string>(mixedScript(statements));
+    for (auto _ : state) {
+        auto [a, err] = parser::Parse(script);
+        if (!err.empty()) {
+            state.SkipWithError(err.c_str());
+        }
+        benchmark::DoNotOptimize(a.get());
+    }
+    state.SetItemsProcessed(state.iterations() * statements);
+}
+
+// BM_ParseParallel parses a restore-sized script on a pool of range(0)
+// threads; compare against BM_ParseParallel/1 for the speedup
+static void BM_ParseParallel(benchmark::State& state) {
+    int statements = 300000;
+    auto script = std::make_shared<const std::string>(mixedScript(statements));
+    threadPool pool(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        auto [a, err] = parser::ParseParallel(script, pool);
+        if (!err.empty()) {
+            state.SkipWithError(err.c_str());
+        }
+        benchmark::DoNotOptimize(a.get());
+    }
+    state.SetItemsProcessed(state.iterations() * statements);
+    state.counters["threads"] = static_cast<double>(pool.size());
+}
+
+static const char* insertShape = "INSERT INTO users VALUES (?, ?, ?, 42, 'constant text')";
+
+// BM_ParseStatement is what every execution of a statement costs without
+// the plan cache: the literal values change, so it is lexed and parsed again
+static void BM_ParseStatement(benchmark::State& state) {
+    int64_t i = 0;
+    for (auto _ : state) {
+        std::string text = "INSERT INTO users VALUES (" + std::to_string(i++) + ", 'name', 1.5, 42, 'constant text')";
+        auto [a, err] = parser::Parse(std::move(text));
+        benchmark::DoNotOptimize(a.get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// BM_PrepareCached looks the same shape up in the plan cache and binds
+// new values to it
+static void BM_PrepareCached(benchmark::State& state) {
+    parser::planCache cache;
+    int64_t i = 0;
+    for (auto _ : state) {
+        std::string id = std::to_string(i++);
+        auto [prepared, err] = cache.prepare(insertShape);
+        auto [bound, bindErr] = parser::bind(prepared, {
+            parser::numericParameter(id),
+            parser::stringParameter("name"),
+            parser::numericParameter("1.5"),
+        });
+        benchmark::DoNotOptimize(bound.parameters.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hits"] = static_cast<double>(cache.hits());
+    state.counters["misses"] = static_cast<double>(cache.misses());
+}
+
+BENCHMARK(BM_LexOnly)->Arg(30000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Parse)->Arg(30000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParseStatement);
+BENCHMARK(BM_PrepareCached);
+BENCHMARK(BM_ParseParallel)->RangeMultiplier(2)->Range(1, 8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
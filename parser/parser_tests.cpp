@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include "parser.h"
+#include "prepare.h"
 #include "../ast/ast.h"
+#include <sstream>
 
 using namespace parser;
 using namespace nicolassql;
@@ -11,7 +13,7 @@ TEST(ParserTest, InsertStatement) {
     ASSERT_TRUE(err.empty()) << "Parse error: " << err;
     ASSERT_EQ(astPtr->Statements.size(), 1u);
 
-    auto* stmt = astPtr->Statements[0].get();
+    auto* stmt = astPtr->Statements[0];
     EXPECT_EQ(stmt->Kind, AstKind::InsertKind);
 
     auto* ins = stmt->InsertStatement;
@@ -24,12 +26,59 @@ TEST(ParserTest, InsertStatement) {
     EXPECT_EQ(vals[1]->literal->value, "233");
 }
 
+TEST(ParserTest, InsertStatementWithManyRows) {
+    auto [astPtr, err] = Parse("INSERT INTO users VALUES (1, 'ann'), (2, 'bob'),(3, ?); SELECT 1");
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+    ASSERT_EQ(astPtr->Statements.size(), 2u);
+
+    auto* ins = astPtr->Statements[0]->InsertStatement;
+    EXPECT_EQ(ins->rows, 3u);
+    auto& vals = *ins->values;
+    ASSERT_EQ(vals.size(), 6u);
+    EXPECT_EQ(vals[2]->literal->value, "2");
+    EXPECT_EQ(vals[3]->literal->value, "bob");
+    EXPECT_EQ(vals[5]->kind, expressionKind::placeholderKind);
+    EXPECT_EQ(std::get<0>(Parse("INSERT INTO users VALUES (1)"))->Statements[0]->InsertStatement->rows, 1u);
+
+    for (const char* bad : {"INSERT INTO users VALUES (1, 2), (3)", "INSERT INTO users VALUES (1), (2, 3)",
+                            "INSERT INTO users VALUES (1),", "INSERT INTO users VALUES (1) (2)"}) {
+        EXPECT_FALSE(std::get<1>(Parse(bad)).empty()) << bad;
+    }
+}
+
+TEST(ParserTest, LiteralsComeConverted) {
+    auto [astPtr, err] = Parse("INSERT INTO t VALUES (42, 1.5, 99999999999999999999, 'it''s', 'plain', ?)");
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+    auto& vals = *astPtr->Statements[0]->InsertStatement->values;
+    ASSERT_EQ(vals.size(), 6u);
+
+    EXPECT_EQ(vals[0]->type, literalType::intLiteral);
+    EXPECT_EQ(vals[0]->intValue, 42);
+    EXPECT_EQ(vals[1]->type, literalType::floatLiteral);
+    EXPECT_DOUBLE_EQ(vals[1]->floatValue, 1.5);
+    EXPECT_EQ(vals[2]->type, literalType::floatLiteral);
+    EXPECT_DOUBLE_EQ(vals[2]->floatValue, 1e20);
+    EXPECT_EQ(vals[3]->type, literalType::textLiteral);
+    EXPECT_EQ(vals[3]->text, "it's");
+    EXPECT_EQ(vals[3]->literal->value, "it''s");
+    EXPECT_EQ(vals[4]->text, "plain");
+    EXPECT_EQ(vals[4]->text.data(), vals[4]->literal->value.data());
+    EXPECT_EQ(vals[5]->type, literalType::noLiteral);
+
+    auto [selectAst, selectErr] = Parse("SELECT name FROM t WHERE id = 7");
+    ASSERT_TRUE(selectErr.empty()) << "Parse error: " << selectErr;
+    auto* where = selectAst->Statements[0]->SelectStatement->where;
+    EXPECT_EQ(selectAst->Statements[0]->SelectStatement->item[0]->type, literalType::noLiteral);
+    EXPECT_EQ(where->binary->b->type, literalType::intLiteral);
+    EXPECT_EQ(where->binary->b->intValue, 7);
+}
+
 TEST(ParserTest, CreateTableStatement) {
     auto [astPtr, err] = Parse("CREATE TABLE users (id INT, name TEXT)");
     ASSERT_TRUE(err.empty()) << "Parse error: " << err;
     ASSERT_EQ(astPtr->Statements.size(), 1u);
 
-    auto* stmt = astPtr->Statements[0].get();
+    auto* stmt = astPtr->Statements[0];
     EXPECT_EQ(stmt->Kind, AstKind::CreateTableKind);
 
     auto* crt = stmt->CreateTableStatement;
@@ -44,6 +93,68 @@ TEST(ParserTest, CreateTableStatement) {
     EXPECT_EQ(cols[1]->datatype.value, "text");
 }
 
+TEST(ParserTest, CreateIndexStatement) {
+    auto [astPtr, err] = Parse("CREATE INDEX users_id ON users (id); CREATE TABLE t (a INT)");
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+    ASSERT_EQ(astPtr->Statements.size(), 2u);
+
+    auto* stmt = astPtr->Statements[0];
+    EXPECT_EQ(stmt->Kind, AstKind::CreateIndexKind);
+    auto* idx = stmt->CreateIndexStatement;
+    ASSERT_NE(idx, nullptr);
+    EXPECT_EQ(idx->name.value, "users_id");
+    EXPECT_EQ(idx->table.value, "users");
+    EXPECT_EQ(idx->column.value, "id");
+    EXPECT_EQ(astPtr->Statements[1]->Kind, AstKind::CreateTableKind);
+
+    for (const char* bad : {"CREATE INDEX ON users (id)", "CREATE INDEX i users (id)",
+                            "CREATE INDEX i ON users id", "CREATE INDEX i ON users (id, name)"}) {
+        EXPECT_FALSE(std::get<1>(Parse(bad)).empty()) << bad;
+    }
+}
+
+TEST(ParserTest, CopyStatement) {
+    auto [astPtr, err] = Parse("COPY users FROM '/tmp/it''s.csv'; SELECT 1");
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+    ASSERT_EQ(astPtr->Statements.size(), 2u);
+
+    auto* stmt = astPtr->Statements[0];
+    EXPECT_EQ(stmt->Kind, AstKind::CopyKind);
+    ASSERT_NE(stmt->CopyStatement, nullptr);
+    EXPECT_EQ(stmt->CopyStatement->table.value, "users");
+    EXPECT_EQ(stmt->CopyStatement->file, "/tmp/it's.csv");
+
+    for (const char* bad : {"COPY FROM 'a.csv'", "COPY users 'a.csv'", "COPY users FROM a"}) {
+        EXPECT_FALSE(std::get<1>(Parse(bad)).empty()) << bad;
+    }
+}
+
+TEST(ParserTest, DispatchesOnLeadingKeyword) {
+    struct Test { const char* source; AstKind kind; };
+    std::vector<Test> tests = {
+        {"SELECT a FROM b", AstKind::SelectKind},
+        {"select a from b", AstKind::SelectKind},
+        {"INSERT INTO b VALUES (1)", AstKind::InsertKind},
+        {"CREATE TABLE b (a INT)", AstKind::CreateTableKind},
+        {"CREATE INDEX i ON b (a)", AstKind::CreateIndexKind},
+        {"COPY b FROM 'b.csv'", AstKind::CopyKind},
+    };
+    for (const Test& test : tests) {
+        auto [astPtr, err] = Parse(test.source);
+        ASSERT_TRUE(err.empty()) << test.source << ": " << err;
+        ASSERT_EQ(astPtr->Statements.size(), 1u) << test.source;
+        EXPECT_EQ(astPtr->Statements[0]->Kind, test.kind) << test.source;
+    }
+
+    // a leading token that starts no statement, and a statement that goes
+    // wrong after its keyword, are both rejected rather than tried as
+    // another kind
+    for (const char* bad : {"FROM b", "WHERE a = 1", "b VALUES (1)", "1", "INSERT b VALUES (1)", "CREATE b (a INT)",
+            "SELECT a FROM b; DROP TABLE b"}) {
+        EXPECT_EQ(std::get<1>(Parse(bad)), "Failed to parse, expected statement") << bad;
+    }
+}
+
 TEST(ParserTest, SelectColumnsAndFrom) {
     // NOTE: the C++ parser currently only recognizes bare identifiers in SELECT,
     //       it does not yet handle '*' or 'AS' aliases.
@@ -51,13 +162,13 @@ TEST(ParserTest, SelectColumnsAndFrom) {
     ASSERT_TRUE(err.empty()) << "Parse error: " << err;
     ASSERT_EQ(astPtr->Statements.size(), 1u);
 
-    auto* stmt = astPtr->Statements[0].get();
+    auto* stmt = astPtr->Statements[0];
     EXPECT_EQ(stmt->Kind, AstKind::SelectKind);
 
     auto* sl = stmt->SelectStatement;
     ASSERT_NE(sl, nullptr);
 
-    // sl->item is a std::vector<std::unique_ptr<expression>>
+    // sl->item is a list of arena-allocated expressions
     auto& items = sl->item;
     ASSERT_EQ(items.size(), 2u);
     EXPECT_EQ(items[0]->literal->value, "id");
@@ -67,6 +178,382 @@ TEST(ParserTest, SelectColumnsAndFrom) {
     EXPECT_EQ(sl->from.value, "users");
 }
 
+TEST(ParserTest, SelectWhere) {
+    auto [astPtr, err] = Parse("SELECT id FROM users WHERE id >= 2 AND (name = 'a' OR name <> $1) AND age < 9");
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+    auto* sl = astPtr->Statements[0]->SelectStatement;
+    ASSERT_EQ(sl->item.size(), 1u);
+    EXPECT_EQ(sl->from.value, "users");
+    ASSERT_NE(sl->where, nullptr);
+
+    // AND associates to the left: ((id >= 2 AND (...)) AND age < 9)
+    ASSERT_EQ(sl->where->kind, expressionKind::binaryKind);
+    auto* top = sl->where->binary;
+    EXPECT_EQ(top->op.value, "and");
+    ASSERT_EQ(top->b->kind, expressionKind::binaryKind);
+    EXPECT_EQ(top->b->binary->op.value, "<");
+    EXPECT_EQ(top->b->binary->a->literal->value, "age");
+
+    auto* left = top->a->binary;
+    EXPECT_EQ(left->op.value, "and");
+    EXPECT_EQ(left->a->binary->op.value, ">=");
+    EXPECT_EQ(left->a->binary->b->literal->value, "2");
+
+    // the parentheses keep OR under the AND
+    auto* nested = left->b->binary;
+    EXPECT_EQ(nested->op.value, "or");
+    EXPECT_EQ(nested->a->binary->op.value, "=");
+    EXPECT_EQ(nested->b->binary->op.value, "<>");
+    EXPECT_EQ(nested->b->binary->b->kind, expressionKind::placeholderKind);
+
+    // comparisons bind tighter than AND, and || tighter than comparisons
+    auto [a2, err2] = Parse("SELECT 1 WHERE a = 1 OR b || c = d");
+    ASSERT_TRUE(err2.empty()) << err2;
+    auto* w = a2->Statements[0]->SelectStatement->where->binary;
+    EXPECT_EQ(w->op.value, "or");
+    EXPECT_EQ(w->b->binary->op.value, "=");
+    EXPECT_EQ(w->b->binary->a->binary->op.value, "||");
+
+    EXPECT_FALSE(std::get<1>(Parse("SELECT id FROM users WHERE")).empty());
+    EXPECT_FALSE(std::get<1>(Parse("SELECT id FROM users WHERE id =")).empty());
+    EXPECT_FALSE(std::get<1>(Parse("SELECT id FROM users WHERE (id = 1")).empty());
+    EXPECT_FALSE(std::get<1>(Parse("SELECT id FROM users WHERE id 1")).empty());
+}
+
+TEST(ParserTest, SelectJoin) {
+    auto [astPtr, err] = Parse(
+        "SELECT users.name, amount FROM orders JOIN users ON orders.user_id = users.id "
+        "JOIN items ON items.id = orders.item WHERE amount > 3");
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+    auto* sl = astPtr->Statements[0]->SelectStatement;
+    EXPECT_EQ(sl->item[0]->literal->value, "users.name");
+    EXPECT_EQ(sl->from.value, "orders");
+    ASSERT_NE(sl->joins, nullptr);
+    ASSERT_EQ(sl->joins->size(), 2u);
+
+    auto* first = (*sl->joins)[0];
+    EXPECT_EQ(first->table.value, "users");
+    ASSERT_EQ(first->on->kind, expressionKind::binaryKind);
+    EXPECT_EQ(first->on->binary->a->literal->value, "orders.user_id");
+    EXPECT_EQ(first->on->binary->b->literal->value, "users.id");
+    EXPECT_EQ((*sl->joins)[1]->table.value, "items");
+    ASSERT_NE(sl->where, nullptr);
+    EXPECT_EQ(sl->where->binary->op.value, ">");
+
+    EXPECT_EQ(std::get<0>(Parse("SELECT id FROM users"))->Statements[0]->SelectStatement->joins, nullptr);
+    for (const char* bad : {"SELECT a FROM t JOIN ON t.a = u.a", "SELECT a FROM t JOIN u t.a = u.a",
+                            "SELECT a FROM t JOIN u ON", "SELECT a FROM t JOIN u ON t.a = u.a JOIN"}) {
+        EXPECT_FALSE(std::get<1>(Parse(bad)).empty()) << bad;
+    }
+}
+
+TEST(ParserTest, SelectGroupBy) {
+    auto [astPtr, err] = Parse("SELECT kind, COUNT(*), sum(amount), max(name) FROM orders WHERE amount > 1 "
+                               "GROUP BY kind, day; SELECT count(id) FROM t");
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+    auto* sl = astPtr->Statements[0]->SelectStatement;
+    ASSERT_EQ(sl->item.size(), 4u);
+    EXPECT_EQ(sl->item[0]->kind, expressionKind::literalKind);
+
+    auto* count = sl->item[1];
+    ASSERT_EQ(count->kind, expressionKind::callKind);
+    EXPECT_EQ(count->call->function.value, "count");
+    EXPECT_EQ(count->call->argument, nullptr);
+    EXPECT_EQ(count->literal->value, "count");
+    ASSERT_EQ(sl->item[2]->kind, expressionKind::callKind);
+    EXPECT_EQ(sl->item[2]->call->argument->literal->value, "amount");
+
+    ASSERT_NE(sl->where, nullptr);
+    ASSERT_NE(sl->groupBy, nullptr);
+    ASSERT_EQ(sl->groupBy->size(), 2u);
+    EXPECT_EQ((*sl->groupBy)[1]->literal->value, "day");
+    EXPECT_EQ(astPtr->Statements[1]->SelectStatement->groupBy, nullptr);
+
+    for (const char* bad : {"SELECT kind FROM t GROUP kind", "SELECT kind FROM t GROUP BY", "SELECT count( FROM t",
+                            "SELECT count(* FROM t", "SELECT kind FROM t GROUP BY kind,"}) {
+        EXPECT_FALSE(std::get<1>(Parse(bad)).empty()) << bad;
+    }
+}
+
+TEST(ParserTest, SelectOrderByLimit) {
+    auto [astPtr, err] = Parse("SELECT id, name FROM users WHERE age > 3 ORDER BY name DESC, id ASC, age LIMIT 50; "
+                               "SELECT kind, count(*) FROM t GROUP BY kind ORDER BY kind LIMIT $1; "
+                               "SELECT id FROM users LIMIT 5");
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+    auto* sl = astPtr->Statements[0]->SelectStatement;
+    ASSERT_NE(sl->orderBy, nullptr);
+    ASSERT_EQ(sl->orderBy->size(), 3u);
+    EXPECT_EQ((*sl->orderBy)[0]->expr->literal->value, "name");
+    EXPECT_TRUE((*sl->orderBy)[0]->descending);
+    EXPECT_FALSE((*sl->orderBy)[1]->descending);
+    EXPECT_FALSE((*sl->orderBy)[2]->descending);
+    ASSERT_NE(sl->limit, nullptr);
+    EXPECT_EQ(sl->limit->intValue, 50);
+
+    auto* grouped = astPtr->Statements[1]->SelectStatement;
+    ASSERT_NE(grouped->groupBy, nullptr);
+    ASSERT_EQ(grouped->orderBy->size(), 1u);
+    EXPECT_EQ(grouped->limit->kind, expressionKind::placeholderKind);
+    EXPECT_EQ(astPtr->Statements[2]->SelectStatement->orderBy, nullptr);
+    EXPECT_EQ(astPtr->Statements[2]->SelectStatement->limit->intValue, 5);
+
+    for (const char* bad : {"SELECT id FROM t ORDER id", "SELECT id FROM t ORDER BY", "SELECT id FROM t ORDER BY id,",
+                            "SELECT id FROM t LIMIT", "SELECT id FROM t ORDER BY id DESC ASC"}) {
+        EXPECT_FALSE(std::get<1>(Parse(bad)).empty()) << bad;
+    }
+}
+
+TEST(ParserTest, AstKeepsSharedSourceAlive) {
+    auto source = std::make_shared<const std::string>("SELECT Id FROM users");
+    auto [astPtr, err] = Parse(source);
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+    source.reset();
+
+    auto* sl = astPtr->Statements[0]->SelectStatement;
+    EXPECT_EQ(sl->item[0]->literal->value, "id");
+    EXPECT_EQ(sl->from.value, "users");
+    EXPECT_EQ(sl->from.value.data(), astPtr->Source->data() + 15);
+}
+
+TEST(ParserTest, ArenaCountsPerParse) {
+    auto [small, err] = Parse("INSERT INTO users VALUES (1)");
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+    auto [large, err2] = Parse("INSERT INTO users VALUES (1); INSERT INTO users VALUES (2, 3)");
+    ASSERT_TRUE(err2.empty()) << "Parse error: " << err2;
+
+    EXPECT_GT(small->Arena->nodesAllocated(), 0u);
+    EXPECT_GT(large->Arena->nodesAllocated(), small->Arena->nodesAllocated());
+    EXPECT_GT(large->Arena->bytesAllocated(), small->Arena->bytesAllocated());
+}
+
+TEST(ParserTest, ParseFromReader) {
+    std::istringstream in("CREATE TABLE users (id INT, name TEXT);\nINSERT INTO users VALUES (1, 'ann');");
+    auto [astPtr, err] = Parse(nicolassql::istreamReader(in), 8);
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+    ASSERT_EQ(astPtr->Statements.size(), 2u);
+    EXPECT_EQ(astPtr->Source, nullptr);
+
+    auto* ins = astPtr->Statements[1]->InsertStatement;
+    ASSERT_NE(ins, nullptr);
+    EXPECT_EQ(ins->table.value, "users");
+    EXPECT_EQ((*ins->values)[1]->literal->value, "ann");
+}
+
+TEST(ParserTest, StatementStreamReusesMemory) {
+    std::string script;
+    for (int i = 0; i < 2000; i++) {
+        script += "INSERT INTO users VALUES (" + std::to_string(i) + ", 'name " + std::to_string(i) + "');;\n";
+    }
+    script += "SELECT id FROM users";
+
+    std::istringstream in(script);
+    statementStream statements(nicolassql::istreamReader(in), 256);
+    uint64_t inserts = 0;
+    uint64_t maxReserved = 0;
+    ast::Statement* last = nullptr;
+    while (true) {
+        auto [stmt, err] = statements.next();
+        ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+        if (stmt == nullptr) {
+            break;
+        }
+        last = stmt;
+        if (stmt->Kind == AstKind::InsertKind) {
+            EXPECT_EQ((*stmt->InsertStatement->values)[0]->literal->value, std::to_string(inserts));
+            inserts++;
+        }
+        maxReserved = std::max(maxReserved, statements.storage().bytesReserved());
+    }
+
+    EXPECT_EQ(inserts, 2000u);
+    ASSERT_NE(last, nullptr);
+    EXPECT_EQ(last->Kind, AstKind::SelectKind);
+    // one statement's worth of arena, however long the script
+    EXPECT_LE(maxReserved, 8192u);
+}
+
+TEST(ParserTest, ParseEachStopsAndReportsErrors) {
+    std::istringstream in("SELECT a FROM b; SELECT c FROM d; SELECT e FROM f");
+    int seen = 0;
+    auto err = ParseEach(nicolassql::istreamReader(in), [&](const ast::Statement&) {
+        return ++seen < 2;
+    });
+    EXPECT_TRUE(err.empty());
+    EXPECT_EQ(seen, 2);
+
+    std::istringstream bad("SELECT a FROM b; SELECT c FROM d e");
+    seen = 0;
+    err = ParseEach(nicolassql::istreamReader(bad), [&](const ast::Statement&) {
+        seen++;
+        return true;
+    });
+    EXPECT_EQ(err, "Missing semi-colon between statements");
+    EXPECT_EQ(seen, 1);
+}
+
+// describe flattens the tokens of a statement with their locations, so two
+// Asts can be compared for both content and position
+static std::string describe(const ast::Statement& stmt) {
+    std::string out;
+    auto add = [&](const token& tok) {
+        out += std::string(tok.value) + "@" + std::to_string(tok.loc.line) + ":" + std::to_string(tok.loc.col) + " ";
+    };
+    switch (stmt.Kind) {
+    case AstKind::SelectKind:
+        for (auto* item : stmt.SelectStatement->item) {
+            add(*item->literal);
+        }
+        add(stmt.SelectStatement->from);
+        break;
+    case AstKind::InsertKind:
+        add(stmt.InsertStatement->table);
+        for (auto* value : *stmt.InsertStatement->values) {
+            add(*value->literal);
+        }
+        break;
+    case AstKind::CreateTableKind:
+        add(stmt.CreateTableStatement->name);
+        for (auto* col : *stmt.CreateTableStatement->cols) {
+            add(col->name);
+            add(col->datatype);
+        }
+        break;
+    case AstKind::CreateIndexKind:
+        add(stmt.CreateIndexStatement->name);
+        add(stmt.CreateIndexStatement->table);
+        add(stmt.CreateIndexStatement->column);
+        break;
+    case AstKind::CopyKind:
+        add(stmt.CopyStatement->table);
+        out += std::string(stmt.CopyStatement->file) + " ";
+        break;
+    }
+    return out;
+}
+
+TEST(ParserTest, ParseParallelMatchesParse) {
+    // literals hide semicolons, quotes and newlines from the splitter, and
+    // some statements share a line so chunks can start mid-line
+    std::string script = "CREATE TABLE users (id INT, name TEXT);\n";
+    for (int i = 0; i < 20000; i++) {
+        script += "INSERT INTO users VALUES (" + std::to_string(i) + ", 'a;b '' \n;c');";
+        script += i % 3 == 0 ? " " : ";\n";
+        if (i % 7 == 0) {
+            script += "SELECT \"odd;name\", id FROM users;\n\n";
+        }
+    }
+    script += "SELECT id FROM users";
+
+    auto [want, err] = Parse(script);
+    ASSERT_TRUE(err.empty()) << "Parse error: " << err;
+
+    for (size_t threads : {1, 2, 3, 8}) {
+        threadPool pool(threads);
+        auto [got, err2] = ParseParallel(script, pool);
+        ASSERT_TRUE(err2.empty()) << "Parse error: " << err2;
+        ASSERT_EQ(want->Statements.size(), got->Statements.size()) << "threads=" << threads;
+        for (size_t i = 0; i < want->Statements.size(); i++) {
+            ASSERT_EQ(describe(*want->Statements[i]), describe(*got->Statements[i])) << "threads=" << threads << " statement=" << i;
+        }
+    }
+}
+
+TEST(ParserTest, ParseParallelReportsParseErrors) {
+    std::string script;
+    for (int i = 0; i < 20000; i++) {
+        script += "INSERT INTO users VALUES (" + std::to_string(i) + ", 'name');\n";
+    }
+    std::string lexError = script + "SELECT @ FROM users;" + script;
+    std::string parseError = script + "SELECT FROM;" + script;
+
+    threadPool pool(4);
+    for (const std::string& bad : {lexError, parseError}) {
+        auto [want, wantErr] = Parse(bad);
+        auto [got, gotErr] = ParseParallel(bad, pool);
+        EXPECT_FALSE(wantErr.empty());
+        EXPECT_EQ(wantErr, gotErr);
+        EXPECT_EQ(got, nullptr);
+    }
+}
+
+TEST(PrepareTest, BindsPlaceholders) {
+    auto [prepared, err] = prepare("INSERT INTO users VALUES (?, 'fixed', ?)");
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(prepared->parameters, 2u);
+
+    std::string name = "ann";
+    auto [bound, bindErr] = bind(prepared, {numericParameter("7"), stringParameter(name)});
+    ASSERT_TRUE(bindErr.empty()) << bindErr;
+    auto& values = *bound.statement().InsertStatement->values;
+    ASSERT_EQ(values.size(), 3u);
+    EXPECT_EQ(bound.value(*values[0]).value, "7");
+    EXPECT_EQ(bound.value(*values[0]).kind, tokenKind::numericKind);
+    EXPECT_EQ(bound.value(*values[1]).value, "fixed");
+    EXPECT_EQ(bound.value(*values[2]).value, "ann");
+
+    auto [numbered, err2] = prepare("SELECT $2, $1, $2 FROM users");
+    ASSERT_TRUE(err2.empty()) << err2;
+    EXPECT_EQ(numbered->parameters, 2u);
+    auto [bound2, bindErr2] = bind(numbered, {numericParameter("1"), numericParameter("2")});
+    ASSERT_TRUE(bindErr2.empty()) << bindErr2;
+    auto& items = bound2.statement().SelectStatement->item;
+    EXPECT_EQ(bound2.value(*items[0]).value, "2");
+    EXPECT_EQ(bound2.value(*items[1]).value, "1");
+    EXPECT_EQ(bound2.value(*items[2]).value, "2");
+
+    // placeholders inside WHERE are numbered in text order too
+    auto [filtered, err3] = prepare("SELECT ? FROM users WHERE id > ? AND name = ?");
+    ASSERT_TRUE(err3.empty()) << err3;
+    EXPECT_EQ(filtered->parameters, 3u);
+    auto* where = filtered->statement->SelectStatement->where->binary;
+    EXPECT_EQ(where->a->binary->b->placeholder, 2u);
+    EXPECT_EQ(where->b->binary->b->placeholder, 3u);
+}
+
+TEST(PrepareTest, RejectsBadStatementsAndParameters) {
+    EXPECT_EQ(std::get<1>(prepare("SELECT ?, $1 FROM users")), "Placeholders must be either all ? or all $n");
+    EXPECT_EQ(std::get<1>(prepare("SELECT $0 FROM users")), "Invalid placeholder $0");
+    EXPECT_EQ(std::get<1>(prepare("SELECT a FROM b; SELECT c FROM d")), "Prepared statements must hold exactly one statement");
+
+    auto [prepared, err] = prepare("INSERT INTO users VALUES (?)");
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(std::get<1>(bind(prepared, {})), "Expected 1 parameters, got 0");
+    token keyword{.value = "select", .kind = tokenKind::keywordKind};
+    EXPECT_EQ(std::get<1>(bind(prepared, {keyword})), "Parameter 1 must be a numeric or string value");
+}
+
+TEST(PlanCacheTest, HitsOnNormalizedTextAndEvictsLeastRecent) {
+    EXPECT_EQ(normalizeStatement("  SELECT  Id,\n\tname FROM Users ;; "), "select id, name from users");
+    EXPECT_EQ(normalizeStatement("SELECT 'Keep  This' FROM \"T\""), "select 'Keep  This' from \"T\"");
+
+    planCache cache(2);
+    auto [first, err] = cache.prepare("SELECT id FROM users WHERE_IS_NOT_SUPPORTED");
+    EXPECT_EQ(first, nullptr);
+    EXPECT_FALSE(err.empty());
+    EXPECT_EQ(cache.size(), 0u);
+
+    auto [a, errA] = cache.prepare("SELECT id FROM users");
+    auto [a2, errA2] = cache.prepare("select  ID from USERS;");
+    ASSERT_TRUE(errA.empty() && errA2.empty());
+    EXPECT_EQ(a.get(), a2.get());
+    EXPECT_EQ(cache.hits(), 1u);
+    EXPECT_EQ(cache.misses(), 2u);
+
+    auto [b, errB] = cache.prepare("INSERT INTO users VALUES (?)");
+    ASSERT_TRUE(errB.empty());
+    // touching a makes b the least recently used
+    cache.prepare("SELECT id FROM users");
+    auto [c, errC] = cache.prepare("INSERT INTO users VALUES (?, ?)");
+    ASSERT_TRUE(errC.empty());
+    EXPECT_EQ(cache.size(), 2u);
+
+    uint64_t misses = cache.misses();
+    cache.prepare("SELECT id FROM users");
+    EXPECT_EQ(cache.misses(), misses);
+    cache.prepare("INSERT INTO users VALUES (?)");
+    EXPECT_EQ(cache.misses(), misses + 1);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,261 @@
+#include "prepare.h"
+#include "parser.h"
+#include "../lexer/scan.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <functional>
+
+namespace parser {
+
+using namespace nicolassql;
+
+namespace {
+
+// visit calls fn on expr and, for binary expressions and calls, on their
+// operands, left to right
+void visit(ast::expression& expr, const std::function<void(ast::expression&)>& fn) {
+	if (expr.kind == ast::expressionKind::binaryKind) {
+		visit(*expr.binary->a, fn);
+		fn(expr);
+		visit(*expr.binary->b, fn);
+		return;
+	}
+	fn(expr);
+	if (expr.kind == ast::expressionKind::callKind && expr.call->argument != nullptr) {
+		visit(*expr.call->argument, fn);
+	}
+}
+
+// forEachExpression calls fn on the expressions of stmt in the order they
+// appear in its text
+void forEachExpression(const ast::Statement& stmt, const std::function<void(ast::expression&)>& fn) {
+	switch (stmt.Kind) {
+	case ast::AstKind::SelectKind:
+		for (ast::expression* item : stmt.SelectStatement->item) {
+			visit(*item, fn);
+		}
+		if (stmt.SelectStatement->joins != nullptr) {
+			for (ast::joinClause* join : *stmt.SelectStatement->joins) {
+				visit(*join->on, fn);
+			}
+		}
+		if (stmt.SelectStatement->where != nullptr) {
+			visit(*stmt.SelectStatement->where, fn);
+		}
+		if (stmt.SelectStatement->groupBy != nullptr) {
+			for (ast::expression* key : *stmt.SelectStatement->groupBy) {
+				visit(*key, fn);
+			}
+		}
+		if (stmt.SelectStatement->orderBy != nullptr) {
+			for (ast::orderItem* order : *stmt.SelectStatement->orderBy) {
+				visit(*order->expr, fn);
+			}
+		}
+		if (stmt.SelectStatement->limit != nullptr) {
+			visit(*stmt.SelectStatement->limit, fn);
+		}
+		break;
+	case ast::AstKind::InsertKind:
+		for (ast::expression* value : *stmt.InsertStatement->values) {
+			visit(*value, fn);
+		}
+		break;
+	case ast::AstKind::CreateTableKind:
+	case ast::AstKind::CreateIndexKind:
+	case ast::AstKind::CopyKind:
+		break;
+	}
+}
+
+// numberPlaceholders sets the parameter number of every placeholder in
+// stmt and returns how many parameters it takes
+std::tuple<uint16_t, std::string> numberPlaceholders(const ast::Statement& stmt) {
+	uint16_t positional = 0;
+	uint16_t numbered = 0;
+	std::string err;
+	forEachExpression(stmt, [&](ast::expression& expr) {
+		if (expr.kind != ast::expressionKind::placeholderKind || !err.empty()) {
+			return;
+		}
+
+		std::string_view value = expr.literal->value;
+		if (value == "?") {
+			expr.placeholder = ++positional;
+			return;
+		}
+
+		uint16_t n = 0;
+		auto [end, ec] = std::from_chars(value.data() + 1, value.data() + value.size(), n);
+		if (ec != std::errc() || end != value.data() + value.size() || n == 0) {
+			err = "Invalid placeholder " + std::string(value);
+			return;
+		}
+		expr.placeholder = n;
+		numbered = std::max(numbered, n);
+	});
+
+	if (!err.empty()) {
+		return {0, err};
+	}
+	if (positional != 0 && numbered != 0) {
+		return {0, "Placeholders must be either all ? or all $n"};
+	}
+	return {std::max(positional, numbered), ""};
+}
+
+void normalizeInto(std::string_view text, std::string& out) {
+	// the result is never longer than text, so it is written in place
+	// through a pointer rather than appended a character at a time
+	out.resize(text.size());
+	char* begin = out.data();
+	char* next = begin;
+
+	bool pendingSpace = false;
+	for (size_t i = 0; i < text.size(); ) {
+		char c = text[i];
+		if (c == ' ' || c == '\t' || c == '\n') {
+			pendingSpace = next != begin;
+			i += whitespaceRun(text.data() + i, text.size() - i);
+			continue;
+		}
+
+		if (pendingSpace) {
+			*next++ = ' ';
+			pendingSpace = false;
+		}
+
+		if (c == '\'' || c == '"') {
+			// quoted text is kept as is; an escaped delimiter just starts
+			// the next quoted run
+			size_t close = i + 1 + findByte(text.data() + i + 1, text.size() - i - 1, c);
+			size_t end = std::min(close + 1, text.size());
+			std::memcpy(next, text.data() + i, end - i);
+			next += end - i;
+			i = end;
+			continue;
+		}
+
+		*next++ = (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+		i++;
+	}
+
+	while (next != begin && (next[-1] == ';' || next[-1] == ' ')) {
+		next--;
+	}
+	out.resize(next - begin);
+}
+
+}
+
+std::tuple<std::shared_ptr<const preparedStatement>, std::string> prepare(std::string text) {
+	auto [a, err] = Parse(std::move(text));
+	if (err != "") {
+		return {nullptr, err};
+	}
+
+	if (a->Statements.size() != 1) {
+		return {nullptr, "Prepared statements must hold exactly one statement"};
+	}
+
+	const ast::Statement* stmt = a->Statements[0];
+	auto [parameters, placeholderErr] = numberPlaceholders(*stmt);
+	if (placeholderErr != "") {
+		return {nullptr, placeholderErr};
+	}
+
+	return {std::make_shared<const preparedStatement>(preparedStatement{
+		.ast = std::move(a),
+		.statement = stmt,
+		.parameters = parameters,
+	}), ""};
+}
+
+std::tuple<boundStatement, std::string> bind(std::shared_ptr<const preparedStatement> prepared,
+		std::vector<token> parameters) {
+	if (parameters.size() != prepared->parameters) {
+		return {boundStatement{}, "Expected " + std::to_string(prepared->parameters) +
+			" parameters, got " + std::to_string(parameters.size())};
+	}
+
+	for (size_t i = 0; i < parameters.size(); i++) {
+		tokenKind kind = parameters[i].kind;
+		if (kind != tokenKind::numericKind && kind != tokenKind::stringKind) {
+			return {boundStatement{}, "Parameter " + std::to_string(i + 1) + " must be a numeric or string value"};
+		}
+	}
+
+	return {boundStatement{
+		.prepared = std::move(prepared),
+		.parameters = std::move(parameters),
+	}, ""};
+}
+
+token numericParameter(std::string_view value) {
+	return token{
+		.value = value,
+		.kind = tokenKind::numericKind,
+	};
+}
+
+token stringParameter(std::string_view value) {
+	return token{
+		.value = value,
+		.kind = tokenKind::stringKind,
+	};
+}
+
+std::string normalizeStatement(std::string_view text) {
+	std::string out;
+	normalizeInto(text, out);
+	return out;
+}
+
+planCache::planCache(size_t capacity) : limit(std::max<size_t>(capacity, 1)) {}
+
+size_t planCache::size() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return recent.size();
+}
+
+std::tuple<std::shared_ptr<const preparedStatement>, std::string> planCache::prepare(std::string_view text) {
+	// the key is built in a per-thread buffer so a hit allocates nothing
+	thread_local std::string key;
+	normalizeInto(text, key);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (auto found = index.find(key); found != index.end()) {
+			recent.splice(recent.begin(), recent, found->second);
+			hitCount.fetch_add(1, std::memory_order_relaxed);
+			return {found->second->second, ""};
+		}
+	}
+
+	// parse without holding the lock, other statements can still be
+	// looked up meanwhile
+	missCount.fetch_add(1, std::memory_order_relaxed);
+	auto [prepared, err] = parser::prepare(std::string(text));
+	if (err != "") {
+		return {nullptr, err};
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (auto found = index.find(key); found != index.end()) {
+		// another thread prepared the same statement first
+		recent.splice(recent.begin(), recent, found->second);
+		return {found->second->second, ""};
+	}
+
+	recent.emplace_front(key, prepared);
+	index.emplace(recent.front().first, recent.begin());
+	if (recent.size() > limit) {
+		index.erase(recent.back().first);
+		recent.pop_back();
+	}
+
+	return {std::move(prepared), ""};
+}
+
+}
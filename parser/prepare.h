@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "../ast/ast.h"
+
+namespace parser {
+
+// preparedStatement is one parsed statement whose placeholders are filled
+// in by bind. It is not modified after prepare, so a single one can be
+// shared by the plan cache and any number of callers.
+struct preparedStatement {
+	std::unique_ptr<ast::Ast> ast;
+	const ast::Statement* statement;
+	// parameters is the number of values bind expects
+	uint16_t parameters;
+};
+
+// prepare parses text, which must hold exactly one statement, and numbers
+// its placeholders: ? in the order they appear, $n as written. The two
+// styles can not be mixed in one statement.
+std::tuple<std::shared_ptr<const preparedStatement>, std::string> prepare(std::string text);
+
+// boundStatement is a prepared statement together with the values of its
+// parameters, ready to be executed
+struct boundStatement {
+	std::shared_ptr<const preparedStatement> prepared;
+	std::vector<nicolassql::token> parameters;
+
+	const ast::Statement& statement() const { return *prepared->statement; }
+
+	// value returns the token expr evaluates to: its literal, or the
+	// parameter bound to its placeholder
+	const nicolassql::token& value(const ast::expression& expr) const {
+		if (expr.kind == ast::expressionKind::placeholderKind) {
+			return parameters[expr.placeholder - 1];
+		}
+		return *expr.literal;
+	}
+};
+
+// bind checks parameters against the placeholders of prepared. Parameters
+// must be numeric or string tokens; their values are views the caller
+// keeps alive for as long as the boundStatement is used.
+std::tuple<boundStatement, std::string> bind(std::shared_ptr<const preparedStatement> prepared,
+	std::vector<nicolassql::token> parameters);
+
+// numericParameter and stringParameter build parameter tokens for bind. A
+// string parameter is the text itself: quotes in it are not escaped.
+nicolassql::token numericParameter(std::string_view value);
+nicolassql::token stringParameter(std::string_view value);
+
+// normalizeStatement reduces text to the form the plan cache is keyed on:
+// whitespace runs collapsed to one space, text outside quotes lowercased
+// and trailing semicolons dropped. Statements that normalize the same
+// parse the same.
+std::string normalizeStatement(std::string_view text);
+
+constexpr size_t defaultPlanCacheSize = 1024;
+
+// planCache keeps the most recently prepared statements keyed on their
+// normalized text, so preparing a statement seen before is a hash lookup
+// instead of a lex and parse. It is safe to use from several threads.
+class planCache {
+public:
+	explicit planCache(size_t capacity = defaultPlanCacheSize);
+
+	// prepare returns the cached statement for text, preparing and caching
+	// it on a miss; statements that fail to prepare are not cached
+	std::tuple<std::shared_ptr<const preparedStatement>, std::string> prepare(std::string_view text);
+
+	uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+	uint64_t misses() const { return missCount.load(std::memory_order_relaxed); }
+	size_t size() const;
+	size_t capacity() const { return limit; }
+
+private:
+	using entry = std::pair<std::string, std::shared_ptr<const preparedStatement>>;
+
+	size_t limit;
+	mutable std::mutex mutex;
+	// recent is ordered from most to least recently used; index views the
+	// keys stored in it
+	std::list<entry> recent;
+	std::unordered_map<std::string_view, std::list<entry>::iterator> index;
+	std::atomic<uint64_t> hitCount{0};
+	std::atomic<uint64_t> missCount{0};
+};
+
+}
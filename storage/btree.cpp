@@ -0,0 +1,84 @@
+#include "btree.h"
+#include "storage.h"
+
+namespace storage {
+
+tableIndex::tableIndex(std::string name, size_t column, columnType type, bool deferred)
+	: indexName(std::move(name)), col(column), type(type), built(!deferred) {}
+
+size_t tableIndex::size() const {
+	return type == columnType::intType ? ints.size() : texts.size();
+}
+
+void tableIndex::catchUp(const table& t) {
+	if (built.load(std::memory_order_acquire)) {
+		indexRows(t);
+	}
+}
+
+void tableIndex::build(const table& t) {
+	if (built.load(std::memory_order_acquire)) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(buildMutex);
+	if (!built.load(std::memory_order_relaxed)) {
+		indexRows(t);
+		built.store(true, std::memory_order_release);
+	}
+}
+
+void tableIndex::indexRows(const table& t) {
+	const storage::column& values = t.columns()[col];
+	size_t rows = t.rows();
+	if (indexedRows >= rows) {
+		return;
+	}
+
+	if (type == columnType::intType) {
+		if (rows - indexedRows > indexedRows) {
+			std::vector<std::pair<int64_t, uint64_t>> sorted;
+			sorted.reserve(rows);
+			for (size_t row = 0; row < rows; row++) {
+				sorted.emplace_back(values.intAt(row), row);
+			}
+			std::sort(sorted.begin(), sorted.end());
+			ints.build(sorted);
+		} else {
+			for (size_t row = indexedRows; row < rows; row++) {
+				ints.insert(values.intAt(row), row);
+			}
+		}
+	} else if (rows - indexedRows > indexedRows) {
+		std::vector<std::pair<std::string_view, uint64_t>> sorted;
+		sorted.reserve(rows);
+		for (size_t row = 0; row < rows; row++) {
+			sorted.emplace_back(values.text(row), row);
+		}
+		std::sort(sorted.begin(), sorted.end());
+		texts.build(sorted);
+	} else {
+		for (size_t row = indexedRows; row < rows; row++) {
+			texts.insert(values.text(row), row);
+		}
+	}
+	indexedRows = rows;
+}
+
+bool tableIndex::lookup(const keyRange& range, size_t limit, std::vector<uint64_t>& rows) const {
+	size_t found = 0;
+	auto visit = [&](uint64_t row) {
+		if (++found > limit) {
+			return false;
+		}
+		rows.push_back(row);
+		return true;
+	};
+	if (type == columnType::intType) {
+		ints.scan(range.low, range.high, visit);
+	} else {
+		texts.scan(range.lowText, range.highText, visit);
+	}
+	return found <= limit;
+}
+
+}
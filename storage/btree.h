@@ -0,0 +1,503 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace storage {
+
+class table;
+enum class columnType : uint8_t;
+
+// A B+-tree maps keys to the rows that hold them. Every entry is a key and
+// a row, and entries are ordered by both, so equal keys sit together in
+// row order and every entry is unique. Leaves are chained left to right
+// for range scans; inner nodes hold the first entry of each child but the
+// first as separators.
+//
+// The keys of a node live apart from its rows and children, so a search
+// reads only keys. Keys is the layout of those keys: intKeys stores INT
+// keys inline in one array, textKeys stores the prefix every TEXT key of a
+// node shares once and packs the rest of each key back to back.
+
+// intKeys holds up to capacity INT keys, 16 cache lines of them, plus one
+// more while the node is split
+struct intKeys {
+	using key = int64_t;
+	using keyView = int64_t;
+	static constexpr size_t capacity = 127;
+
+	size_t size() const { return count; }
+	int64_t at(size_t i) const { return values[i]; }
+
+	int compare(size_t i, int64_t k) const {
+		return values[i] < k ? -1 : values[i] > k ? 1 : 0;
+	}
+
+	// equalRange returns the positions of the keys equal to k
+	std::pair<size_t, size_t> equalRange(int64_t k) const {
+		const int64_t* first = std::lower_bound(values.data(), values.data() + count, k);
+		const int64_t* last = std::upper_bound(first, values.data() + count, k);
+		return {first - values.data(), last - values.data()};
+	}
+
+	void insert(size_t i, int64_t k) {
+		std::memmove(&values[i + 1], &values[i], (count - i) * sizeof(int64_t));
+		values[i] = k;
+		count++;
+	}
+
+	// moveTail moves the keys from position from on to the empty to
+	void moveTail(size_t from, intKeys& to) {
+		std::memcpy(to.values.data(), &values[from], (count - from) * sizeof(int64_t));
+		to.count = count - from;
+		count = from;
+	}
+
+	void truncate(size_t size) { count = size; }
+
+private:
+	size_t count = 0;
+	std::array<int64_t, capacity + 1> values;
+};
+
+// textKeys holds up to capacity TEXT keys, each stored as the suffix left
+// after the prefix all of them share
+struct textKeys {
+	using key = std::string;
+	using keyView = std::string_view;
+	static constexpr size_t capacity = 63;
+
+	size_t size() const { return offsets.size() - 1; }
+
+	std::string at(size_t i) const {
+		return prefix + std::string(suffix(i));
+	}
+
+	int compare(size_t i, std::string_view k) const {
+		size_t shared = std::min(prefix.size(), k.size());
+		if (int c = std::string_view(prefix).compare(0, shared, k.substr(0, shared)); c != 0) {
+			return c;
+		}
+		if (k.size() < prefix.size()) {
+			return 1;
+		}
+		return sign(suffix(i).compare(k.substr(prefix.size())));
+	}
+
+	std::pair<size_t, size_t> equalRange(std::string_view k) const {
+		// a key outside the prefix is below or above every key of the node
+		size_t shared = std::min(prefix.size(), k.size());
+		int c = std::string_view(prefix).compare(0, shared, k.substr(0, shared));
+		if (c > 0 || (c == 0 && k.size() < prefix.size())) {
+			return {0, 0};
+		}
+		if (c < 0) {
+			return {size(), size()};
+		}
+
+		std::string_view rest = k.substr(prefix.size());
+		size_t low = 0;
+		size_t high = size();
+		while (low < high) {
+			size_t mid = (low + high) / 2;
+			if (suffix(mid) < rest) {
+				low = mid + 1;
+			} else {
+				high = mid;
+			}
+		}
+		size_t last = low;
+		while (last < size() && suffix(last) == rest) {
+			last++;
+		}
+		return {low, last};
+	}
+
+	void insert(size_t i, std::string_view k) {
+		if (size() == 0) {
+			prefix = k;
+		} else if (k.compare(0, prefix.size(), prefix) != 0 || k.size() < prefix.size()) {
+			// k does not share the whole prefix: keep only what it shares
+			size_t shared = 0;
+			while (shared < prefix.size() && shared < k.size() && prefix[shared] == k[shared]) {
+				shared++;
+			}
+			rebuild(shared);
+		}
+
+		std::string_view rest = k.substr(prefix.size());
+		suffixes.insert(offsets[i], rest);
+		offsets.insert(offsets.begin() + static_cast<ptrdiff_t>(i) + 1, offsets[i] + static_cast<uint32_t>(rest.size()));
+		for (size_t j = i + 2; j < offsets.size(); j++) {
+			offsets[j] += static_cast<uint32_t>(rest.size());
+		}
+	}
+
+	void moveTail(size_t from, textKeys& to) {
+		std::vector<std::string> tail;
+		for (size_t i = from; i < size(); i++) {
+			tail.push_back(at(i));
+		}
+		truncate(from);
+		to.assign(tail);
+	}
+
+	void truncate(size_t count) {
+		std::vector<std::string> head;
+		for (size_t i = 0; i < count; i++) {
+			head.push_back(at(i));
+		}
+		assign(head);
+	}
+
+private:
+	static int sign(int c) { return c < 0 ? -1 : c > 0 ? 1 : 0; }
+
+	std::string_view suffix(size_t i) const {
+		return std::string_view(suffixes).substr(offsets[i], offsets[i + 1] - offsets[i]);
+	}
+
+	// assign replaces the keys with sorted, which makes the prefix as long as
+	// the first and last of them share and so every one of them does
+	void assign(const std::vector<std::string>& sorted) {
+		prefix.clear();
+		suffixes.clear();
+		offsets.assign(1, 0);
+		if (sorted.empty()) {
+			return;
+		}
+		const std::string& first = sorted.front();
+		const std::string& last = sorted.back();
+		size_t shared = 0;
+		while (shared < first.size() && shared < last.size() && first[shared] == last[shared]) {
+			shared++;
+		}
+		prefix = first.substr(0, shared);
+		for (const std::string& k : sorted) {
+			suffixes.append(k, shared);
+			offsets.push_back(static_cast<uint32_t>(suffixes.size()));
+		}
+	}
+
+	// rebuild shortens the prefix to its first length bytes
+	void rebuild(size_t length) {
+		std::string moved = prefix.substr(length);
+		std::string packed;
+		std::vector<uint32_t> next{0};
+		for (size_t i = 0; i < size(); i++) {
+			packed += moved;
+			packed += suffix(i);
+			next.push_back(static_cast<uint32_t>(packed.size()));
+		}
+		prefix.resize(length);
+		suffixes = std::move(packed);
+		offsets = std::move(next);
+	}
+
+	std::string prefix;
+	std::string suffixes;
+	std::vector<uint32_t> offsets{0};
+};
+
+// bound is one end of a key range, or no end at all when unbounded
+template <typename KeyView>
+struct bound {
+	bool unbounded = true;
+	bool inclusive = true;
+	KeyView value{};
+};
+
+template <typename Keys>
+class bplusTree {
+public:
+	using key = typename Keys::key;
+	using keyView = typename Keys::keyView;
+
+	size_t size() const { return entries; }
+	// height is the number of levels above the leaves
+	size_t height() const { return levels; }
+
+	void insert(keyView k, uint64_t row) {
+		if (leaves.empty()) {
+			root = newLeaf();
+		}
+		auto [split, separator, separatorRow, right] = insertInto(root, levels, k, row);
+		if (split) {
+			// the root split: a new root holds both halves
+			uint32_t top = newInner();
+			innerNode& node = *inners[top];
+			node.keys.insert(0, separator);
+			node.rows[0] = separatorRow;
+			node.children[0] = root;
+			node.children[1] = right;
+			root = top;
+			levels++;
+		}
+		entries++;
+	}
+
+	// build replaces the tree with sorted, entries ordered by key and row,
+	// filling each node up to seven eighths so later inserts rarely split
+	void build(const std::vector<std::pair<keyView, uint64_t>>& sorted) {
+		leaves.clear();
+		inners.clear();
+		levels = 0;
+		entries = sorted.size();
+		root = newLeaf();
+		if (sorted.empty()) {
+			return;
+		}
+
+		constexpr size_t fill = Keys::capacity - Keys::capacity / 8;
+		struct child {
+			uint32_t node;
+			key first;
+			uint64_t firstRow;
+		};
+		std::vector<child> level;
+		uint32_t previous = root;
+		for (size_t i = 0; i < sorted.size(); i += fill) {
+			uint32_t id = level.empty() ? root : newLeaf();
+			leafNode& leaf = *leaves[id];
+			size_t count = std::min(fill, sorted.size() - i);
+			for (size_t j = 0; j < count; j++) {
+				leaf.keys.insert(j, sorted[i + j].first);
+				leaf.rows[j] = sorted[i + j].second;
+			}
+			if (!level.empty()) {
+				leaves[previous]->next = id;
+			}
+			previous = id;
+			level.push_back(child{id, key(sorted[i].first), sorted[i].second});
+		}
+
+		while (level.size() > 1) {
+			std::vector<child> above;
+			for (size_t i = 0; i < level.size(); i += fill + 1) {
+				uint32_t id = newInner();
+				innerNode& node = *inners[id];
+				size_t count = std::min(fill + 1, level.size() - i);
+				node.children[0] = level[i].node;
+				for (size_t j = 1; j < count; j++) {
+					node.keys.insert(j - 1, level[i + j].first);
+					node.rows[j - 1] = level[i + j].firstRow;
+					node.children[j] = level[i + j].node;
+				}
+				above.push_back(child{id, std::move(level[i].first), level[i].firstRow});
+			}
+			level = std::move(above);
+			levels++;
+		}
+		root = level[0].node;
+	}
+
+	// scan calls visit with the row of every entry whose key lies between
+	// low and high, in key order, until visit returns false
+	template <typename Visit>
+	void scan(const bound<keyView>& low, const bound<keyView>& high, Visit visit) const {
+		if (leaves.empty()) {
+			return;
+		}
+
+		// descend to the first entry not below low
+		bool after = !low.unbounded && !low.inclusive;
+		uint32_t node = root;
+		for (size_t level = levels; level > 0; level--) {
+			const innerNode& inner = *inners[node];
+			size_t child = low.unbounded ? 0 : position(inner.keys, inner.rows, low.value, 0, after);
+			node = inner.children[child];
+		}
+		const leafNode* leaf = leaves[node].get();
+		size_t i = low.unbounded ? 0 : position(leaf->keys, leaf->rows, low.value, 0, after);
+
+		while (leaf != nullptr) {
+			for (; i < leaf->keys.size(); i++) {
+				if (!high.unbounded) {
+					int c = leaf->keys.compare(i, high.value);
+					if (c > 0 || (c == 0 && !high.inclusive)) {
+						return;
+					}
+				}
+				if (!visit(leaf->rows[i])) {
+					return;
+				}
+			}
+			leaf = leaf->next == noNode ? nullptr : leaves[leaf->next].get();
+			i = 0;
+		}
+	}
+
+private:
+	static constexpr uint32_t noNode = ~uint32_t{0};
+
+	struct leafNode {
+		Keys keys;
+		std::array<uint64_t, Keys::capacity + 1> rows;
+		uint32_t next = noNode;
+	};
+
+	struct innerNode {
+		Keys keys;
+		std::array<uint64_t, Keys::capacity + 1> rows;
+		std::array<uint32_t, Keys::capacity + 2> children;
+	};
+
+	struct splitResult {
+		bool split = false;
+		key separator{};
+		uint64_t separatorRow = 0;
+		uint32_t right = noNode;
+	};
+
+	uint32_t newLeaf() {
+		leaves.push_back(std::make_unique<leafNode>());
+		return static_cast<uint32_t>(leaves.size() - 1);
+	}
+
+	uint32_t newInner() {
+		inners.push_back(std::make_unique<innerNode>());
+		return static_cast<uint32_t>(inners.size() - 1);
+	}
+
+	// position counts the entries of a node below the entry of k and row,
+	// or with after set, the entries whose key is k or below. In an inner
+	// node that is the child to descend into.
+	static size_t position(const Keys& keys, const std::array<uint64_t, Keys::capacity + 1>& rows,
+			keyView k, uint64_t row, bool after) {
+		auto [first, last] = keys.equalRange(k);
+		if (after) {
+			return last;
+		}
+		return std::lower_bound(rows.begin() + first, rows.begin() + last, row) - rows.begin();
+	}
+
+	// insertInto adds the entry to the subtree of node, level levels above
+	// the leaves, and returns the new right sibling if node had to split
+	splitResult insertInto(uint32_t node, size_t level, keyView k, uint64_t row) {
+		if (level == 0) {
+			leafNode& leaf = *leaves[node];
+			size_t i = position(leaf.keys, leaf.rows, k, row, false);
+			leaf.keys.insert(i, k);
+			std::copy_backward(leaf.rows.begin() + i, leaf.rows.begin() + leaf.keys.size() - 1,
+				leaf.rows.begin() + leaf.keys.size());
+			leaf.rows[i] = row;
+			if (leaf.keys.size() <= Keys::capacity) {
+				return {};
+			}
+
+			uint32_t id = newLeaf();
+			leafNode& right = *leaves[id];
+			leafNode& left = *leaves[node];
+			size_t mid = left.keys.size() / 2;
+			std::copy(left.rows.begin() + mid, left.rows.begin() + left.keys.size(), right.rows.begin());
+			left.keys.moveTail(mid, right.keys);
+			right.next = left.next;
+			left.next = id;
+			return {true, right.keys.at(0), right.rows[0], id};
+		}
+
+		// entries equal to a separator belong to its right child, which
+		// starts with it
+		innerNode* inner = inners[node].get();
+		size_t child = position(inner->keys, inner->rows, k, row, false);
+		if (child < inner->keys.size() && inner->keys.compare(child, k) == 0 && inner->rows[child] == row) {
+			child++;
+		}
+		splitResult below = insertInto(inner->children[child], level - 1, k, row);
+		if (!below.split) {
+			return {};
+		}
+
+		// insertInto may have grown inners
+		inner = inners[node].get();
+		size_t count = inner->keys.size();
+		inner->keys.insert(child, below.separator);
+		std::copy_backward(inner->rows.begin() + child, inner->rows.begin() + count, inner->rows.begin() + count + 1);
+		inner->rows[child] = below.separatorRow;
+		std::copy_backward(inner->children.begin() + child + 1, inner->children.begin() + count + 1,
+			inner->children.begin() + count + 2);
+		inner->children[child + 1] = below.right;
+		if (inner->keys.size() <= Keys::capacity) {
+			return {};
+		}
+
+		// the middle separator moves up, the ones after it go right
+		uint32_t id = newInner();
+		innerNode& right = *inners[id];
+		innerNode& left = *inners[node];
+		count = left.keys.size();
+		size_t mid = count / 2;
+		splitResult up{true, left.keys.at(mid), left.rows[mid], id};
+		std::copy(left.rows.begin() + mid + 1, left.rows.begin() + count, right.rows.begin());
+		std::copy(left.children.begin() + mid + 1, left.children.begin() + count + 1, right.children.begin());
+		left.keys.moveTail(mid + 1, right.keys);
+		left.keys.truncate(mid);
+		return up;
+	}
+
+	std::vector<std::unique_ptr<leafNode>> leaves;
+	std::vector<std::unique_ptr<innerNode>> inners;
+	uint32_t root = noNode;
+	size_t levels = 0;
+	size_t entries = 0;
+};
+
+// keyRange bounds the INT or TEXT keys an index lookup wants
+struct keyRange {
+	bound<int64_t> low;
+	bound<int64_t> high;
+	bound<std::string_view> lowText;
+	bound<std::string_view> highText;
+};
+
+// tableIndex is a secondary index over one column of a table, kept in
+// step with the rows appended to it. A deferred index holds no rows until
+// build is first called, so loading a table does not sort its columns for
+// indexes no query may use.
+class tableIndex {
+public:
+	tableIndex(std::string name, size_t column, columnType type, bool deferred = false);
+
+	const std::string& name() const { return indexName; }
+	size_t column() const { return col; }
+
+	// size is the number of rows indexed, none while the index is deferred
+	size_t size() const;
+
+	// catchUp indexes the rows t gained since the last call. When they
+	// outnumber the rows indexed before, a bulk load sorts every row and
+	// rebuilds the tree, which beats inserting them one by one. A deferred
+	// index is left alone until it is built.
+	void catchUp(const table& t);
+
+	// build indexes every row of t if the index is still deferred. Callers
+	// that race to build it wait for the first.
+	void build(const table& t);
+
+	// lookup appends the rows whose key lies in range to rows, in key
+	// order. It gives up and returns false once there are more than limit.
+	bool lookup(const keyRange& range, size_t limit, std::vector<uint64_t>& rows) const;
+
+private:
+	void indexRows(const table& t);
+
+	std::string indexName;
+	size_t col;
+	columnType type;
+	std::atomic<bool> built;
+	std::mutex buildMutex;
+	size_t indexedRows = 0;
+	bplusTree<intKeys> ints;
+	bplusTree<textKeys> texts;
+};
+
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+namespace storage {
+
+// columnBuffer is a growable array of column values. It either owns its
+// values or views values that live elsewhere, such as the pages of a
+// mapped table file; the first change to a viewing buffer copies the
+// values into memory of its own.
+template <typename T>
+class columnBuffer {
+public:
+	using value_type = T;
+	using iterator = const T*;
+	using const_iterator = const T*;
+
+	columnBuffer() = default;
+	columnBuffer(std::initializer_list<T> values) : owned(values) { sync(); }
+
+	columnBuffer(const columnBuffer& other) : owned(other.begin(), other.end()) { sync(); }
+	columnBuffer(columnBuffer&& other) noexcept { *this = std::move(other); }
+
+	columnBuffer& operator=(const columnBuffer& other) {
+		owned.assign(other.begin(), other.end());
+		sync();
+		return *this;
+	}
+
+	columnBuffer& operator=(columnBuffer&& other) noexcept {
+		owned = std::move(other.owned);
+		viewing = other.viewing;
+		values = viewing ? other.values : owned.data();
+		count = other.count;
+		other.viewing = false;
+		other.sync();
+		return *this;
+	}
+
+	// view makes a buffer of the size values at values, which must outlive it
+	static columnBuffer view(const T* values, size_t size) {
+		columnBuffer b;
+		b.viewing = true;
+		b.values = values;
+		b.count = size;
+		return b;
+	}
+
+	bool isView() const { return viewing; }
+
+	const T* data() const { return values; }
+	T* data() {
+		own();
+		return owned.data();
+	}
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	// capacity is what the buffer holds room for, for a view its size
+	size_t capacity() const { return viewing ? count : owned.capacity(); }
+
+	const T& operator[](size_t i) const { return values[i]; }
+	const T& back() const { return values[count - 1]; }
+	const T* begin() const { return values; }
+	const T* end() const { return values + count; }
+
+	void push_back(T value) {
+		own();
+		owned.push_back(value);
+		sync();
+	}
+
+	// append adds the values from first to last
+	void append(const T* first, const T* last) {
+		own();
+		owned.insert(owned.end(), first, last);
+		sync();
+	}
+
+	// append adds n copies of value
+	void append(size_t n, T value) {
+		own();
+		owned.insert(owned.end(), n, value);
+		sync();
+	}
+
+	void resize(size_t size) {
+		own();
+		owned.resize(size);
+		sync();
+	}
+
+	void reserve(size_t size) {
+		own();
+		owned.reserve(size);
+		sync();
+	}
+
+	friend bool operator==(const columnBuffer& a, const columnBuffer& b) {
+		return std::equal(a.begin(), a.end(), b.begin(), b.end());
+	}
+
+	friend bool operator==(const columnBuffer& a, const std::vector<T>& b) {
+		return std::equal(a.begin(), a.end(), b.begin(), b.end());
+	}
+
+private:
+	void own() {
+		if (viewing) {
+			owned.assign(values, values + count);
+			viewing = false;
+			sync();
+		}
+	}
+
+	void sync() {
+		values = owned.data();
+		count = owned.size();
+	}
+
+	std::vector<T> owned;
+	bool viewing = false;
+	// values and count describe the live values, owned or not, so reads
+	// never branch on which it is
+	const T* values = nullptr;
+	size_t count = 0;
+};
+
+}
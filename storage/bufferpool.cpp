@@ -0,0 +1,420 @@
+#include "bufferpool.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <unistd.h>
+
+namespace storage {
+
+namespace {
+
+// a page key is the file id above the page number
+constexpr int pageBits = 40;
+
+uint64_t pageKey(fileId file, uint64_t page) {
+	return static_cast<uint64_t>(file) << pageBits | page;
+}
+
+fileId keyFile(uint64_t key) {
+	return static_cast<fileId>(key >> pageBits);
+}
+
+uint64_t keyPage(uint64_t key) {
+	return key & ((uint64_t{1} << pageBits) - 1);
+}
+
+int64_t now() {
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+char* allocateFrames(size_t frames) {
+	void* memory = std::aligned_alloc(4096, frames * pageSize);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return static_cast<char*>(memory);
+}
+
+std::string readPage(int fd, char* out, uint64_t page) {
+	size_t read = 0;
+	while (read < pageSize) {
+		ssize_t n = ::pread(fd, out + read, pageSize - read, static_cast<off_t>(page * pageSize + read));
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return "Could not read page " + std::to_string(page) + ": " + std::strerror(errno);
+		}
+		if (n == 0) {
+			break;
+		}
+		read += static_cast<size_t>(n);
+	}
+	std::memset(out + read, 0, pageSize - read);
+	return "";
+}
+
+std::string writePage(int fd, const char* in, uint64_t page) {
+	size_t written = 0;
+	while (written < pageSize) {
+		ssize_t n = ::pwrite(fd, in + written, pageSize - written, static_cast<off_t>(page * pageSize + written));
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return "Could not write page " + std::to_string(page) + ": " + std::strerror(errno);
+		}
+		written += static_cast<size_t>(n);
+	}
+	return "";
+}
+
+}
+
+pageHandle& pageHandle::operator=(pageHandle&& other) noexcept {
+	if (this != &other) {
+		release();
+		pool = other.pool;
+		frame = other.frame;
+		bytes = other.bytes;
+		other.pool = nullptr;
+		other.bytes = nullptr;
+	}
+	return *this;
+}
+
+char* pageHandle::mutableData() {
+	pool->frameTable[frame].dirty.store(true, std::memory_order_relaxed);
+	return bytes;
+}
+
+void pageHandle::release() {
+	if (pool != nullptr) {
+		pool->unpin(frame);
+		pool = nullptr;
+		bytes = nullptr;
+	}
+}
+
+bufferPool::bufferPool(poolOptions opts)
+	: opts(opts), frameCount(std::max<size_t>(opts.frames, 1)),
+	  memory(allocateFrames(frameCount), std::free), frameTable(new frame[frameCount]) {
+	this->opts.lruK = std::clamp<size_t>(opts.lruK, 1, maxLruK);
+
+	size_t shardCount = 1;
+	while (shardCount < opts.shards) {
+		shardCount <<= 1;
+	}
+	shards.reset(new shard[shardCount]);
+	shardMask = shardCount - 1;
+	for (size_t i = 0; i < shardCount; i++) {
+		shards[i].pages.reserve(2 * frameCount / shardCount + 1);
+	}
+
+	// frames are handed out from the back, lowest first
+	freeFrames.reserve(frameCount);
+	for (size_t f = frameCount; f > 0; f--) {
+		freeFrames.push_back(static_cast<uint32_t>(f - 1));
+	}
+
+	if (opts.writeBackInterval.count() > 0) {
+		writer = std::thread(&bufferPool::writeBackLoop, this);
+	}
+}
+
+bufferPool::~bufferPool() {
+	{
+		std::lock_guard<std::mutex> lock(writerMu);
+		stopping = true;
+	}
+	writerWake.notify_all();
+	if (writer.joinable()) {
+		writer.join();
+	}
+	flush();
+	for (uint32_t i = 0; i < fileCount.load(std::memory_order_acquire); i++) {
+		::close(fds[i]);
+	}
+}
+
+std::tuple<fileId, std::string> bufferPool::openFile(const std::string& path) {
+	std::lock_guard<std::mutex> lock(filesMu);
+	uint32_t count = fileCount.load(std::memory_order_relaxed);
+	if (count == maxFiles) {
+		return {0, "The buffer pool can not open more than " + std::to_string(maxFiles) + " files"};
+	}
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return {0, "Could not open table file " + path + ": " + std::strerror(errno)};
+	}
+	fds[count] = fd;
+	fileCount.store(count + 1, std::memory_order_release);
+	return {count, ""};
+}
+
+bufferPool::shard& bufferPool::shardOf(uint64_t key) const {
+	// Fibonacci hashing spreads the consecutive pages of a scan over shards
+	return shards[(key * 0x9e3779b97f4a7c15ull) >> 32 & shardMask];
+}
+
+void bufferPool::touch(frame& f) {
+	if (opts.policy == evictionPolicy::clockPolicy) {
+		// a frame that is used a lot keeps its cache line shared
+		if (!f.referenced.load(std::memory_order_relaxed)) {
+			f.referenced.store(true, std::memory_order_relaxed);
+		}
+		return;
+	}
+	for (size_t i = opts.lruK - 1; i > 0; i--) {
+		f.history[i].store(f.history[i - 1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	f.history[0].store(now(), std::memory_order_relaxed);
+}
+
+void bufferPool::unpin(uint32_t f) {
+	frameTable[f].pins.fetch_sub(1, std::memory_order_release);
+}
+
+std::tuple<pageHandle, std::string> bufferPool::pin(fileId file, uint64_t page) {
+	if (file >= fileCount.load(std::memory_order_acquire)) {
+		return {pageHandle(), "Unknown file " + std::to_string(file)};
+	}
+	if (page >> pageBits != 0) {
+		return {pageHandle(), "Page " + std::to_string(page) + " is out of range"};
+	}
+	uint64_t key = pageKey(file, page);
+	shard& s = shardOf(key);
+
+	{
+		std::lock_guard<std::mutex> lock(s.mu);
+		if (auto it = s.pages.find(key); it != s.pages.end()) {
+			frame& f = frameTable[it->second];
+			f.pins.fetch_add(1, std::memory_order_acquire);
+			s.hits++;
+			touch(f);
+			return {pageHandle(this, it->second, frameData(it->second)), ""};
+		}
+		s.misses++;
+	}
+
+	// the page is read into a frame nobody else can see yet, without any
+	// lock; if another thread read it meanwhile its copy wins
+	auto [victim, err] = claimFrame();
+	if (err != "") {
+		return {pageHandle(), err};
+	}
+	auto giveBack = [&] {
+		frameTable[victim].state.store(freeFrame, std::memory_order_release);
+		std::lock_guard<std::mutex> lock(freeMu);
+		freeFrames.push_back(victim);
+	};
+	if (err = readPage(fds[file], frameData(victim), page); err != "") {
+		giveBack();
+		return {pageHandle(), err};
+	}
+
+	std::lock_guard<std::mutex> lock(s.mu);
+	if (auto it = s.pages.find(key); it != s.pages.end()) {
+		giveBack();
+		frame& f = frameTable[it->second];
+		f.pins.fetch_add(1, std::memory_order_acquire);
+		touch(f);
+		return {pageHandle(this, it->second, frameData(it->second)), ""};
+	}
+
+	frame& f = frameTable[victim];
+	f.key.store(key, std::memory_order_relaxed);
+	f.pins.store(1, std::memory_order_relaxed);
+	f.dirty.store(false, std::memory_order_relaxed);
+	f.referenced.store(true, std::memory_order_relaxed);
+	for (auto& use : f.history) {
+		use.store(0, std::memory_order_relaxed);
+	}
+	touch(f);
+	f.state.store(usedFrame, std::memory_order_release);
+	s.pages.emplace(key, victim);
+	return {pageHandle(this, victim, frameData(victim)), ""};
+}
+
+std::tuple<uint32_t, std::string> bufferPool::claimFrame() {
+	{
+		std::lock_guard<std::mutex> lock(freeMu);
+		if (!freeFrames.empty()) {
+			uint32_t f = freeFrames.back();
+			freeFrames.pop_back();
+			return {f, ""};
+		}
+	}
+
+	uint64_t attempts = 0;
+	for (;;) {
+		auto [f, found] = pickVictim(attempts);
+		if (!found) {
+			return {0, "All " + std::to_string(frameCount) + " frames of the buffer pool are pinned"};
+		}
+		std::string err;
+		if (tryEvict(f, err)) {
+			return {f, ""};
+		}
+		if (err != "") {
+			return {0, err};
+		}
+	}
+}
+
+std::tuple<uint32_t, bool> bufferPool::pickVictim(uint64_t& attempts) {
+	// a victim another thread pins or evicts first costs an attempt; a sweep
+	// takes two passes to clear the reference bits it meets first
+	uint64_t maxAttempts = 3 * frameCount;
+
+	if (opts.policy == evictionPolicy::clockPolicy) {
+		while (attempts++ < maxAttempts) {
+			uint32_t f = static_cast<uint32_t>(hand.fetch_add(1, std::memory_order_relaxed) % frameCount);
+			frame& candidate = frameTable[f];
+			if (candidate.state.load(std::memory_order_acquire) != usedFrame ||
+					candidate.pins.load(std::memory_order_acquire) > 0) {
+				continue;
+			}
+			if (candidate.referenced.exchange(false, std::memory_order_relaxed)) {
+				continue;
+			}
+			return {f, true};
+		}
+		return {0, false};
+	}
+
+	// LRU-K compares every unpinned frame, a pass over the frame table per
+	// miss; a page used fewer than K times has no K-th use and goes first
+	if (attempts++ >= maxAttempts) {
+		return {0, false};
+	}
+	bool found = false;
+	uint32_t best = 0;
+	int64_t bestKth = 0;
+	int64_t bestLast = 0;
+	for (uint32_t f = 0; f < frameCount; f++) {
+		frame& candidate = frameTable[f];
+		if (candidate.state.load(std::memory_order_acquire) != usedFrame ||
+				candidate.pins.load(std::memory_order_acquire) > 0) {
+			continue;
+		}
+		int64_t kth = candidate.history[opts.lruK - 1].load(std::memory_order_relaxed);
+		int64_t last = candidate.history[0].load(std::memory_order_relaxed);
+		if (!found || kth < bestKth || (kth == bestKth && last < bestLast)) {
+			found = true;
+			best = f;
+			bestKth = kth;
+			bestLast = last;
+		}
+	}
+	return {best, found};
+}
+
+bool bufferPool::tryEvict(uint32_t f, std::string& err) {
+	frame& victim = frameTable[f];
+	uint8_t expected = usedFrame;
+	if (!victim.state.compare_exchange_strong(expected, evictingFrame, std::memory_order_acq_rel)) {
+		return false;
+	}
+
+	// pins are taken under the shard mutex, so none can appear while the
+	// page leaves the page table
+	uint64_t key = victim.key.load(std::memory_order_relaxed);
+	shard& s = shardOf(key);
+	std::lock_guard<std::mutex> lock(s.mu);
+	if (victim.pins.load(std::memory_order_acquire) > 0) {
+		victim.state.store(usedFrame, std::memory_order_release);
+		return false;
+	}
+	if (victim.dirty.load(std::memory_order_acquire)) {
+		if (err = writeBack(f); err != "") {
+			victim.state.store(usedFrame, std::memory_order_release);
+			return false;
+		}
+	}
+	s.pages.erase(key);
+	evictions.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+std::string bufferPool::writeBack(uint32_t f) {
+	frame& dirty = frameTable[f];
+	uint64_t key = dirty.key.load(std::memory_order_relaxed);
+	// a change made while the page is written marks it dirty again
+	dirty.dirty.store(false, std::memory_order_release);
+	if (std::string err = writePage(fds[keyFile(key)], frameData(f), keyPage(key)); err != "") {
+		dirty.dirty.store(true, std::memory_order_release);
+		return err;
+	}
+	writeBacks.fetch_add(1, std::memory_order_relaxed);
+	return "";
+}
+
+void bufferPool::writeBackLoop() {
+	std::unique_lock<std::mutex> lock(writerMu);
+	while (!writerWake.wait_for(lock, opts.writeBackInterval, [&] { return stopping; })) {
+		lock.unlock();
+		for (uint32_t f = 0; f < frameCount; f++) {
+			frame& candidate = frameTable[f];
+			if (candidate.state.load(std::memory_order_acquire) != usedFrame ||
+					!candidate.dirty.load(std::memory_order_acquire) ||
+					candidate.pins.load(std::memory_order_acquire) > 0) {
+				continue;
+			}
+			// the frame may have moved on to another page since the check
+			uint64_t key = candidate.key.load(std::memory_order_relaxed);
+			shard& s = shardOf(key);
+			std::lock_guard<std::mutex> shardLock(s.mu);
+			auto it = s.pages.find(key);
+			if (it != s.pages.end() && it->second == f && candidate.pins.load(std::memory_order_acquire) == 0 &&
+					candidate.dirty.load(std::memory_order_acquire)) {
+				// a failed write leaves the page dirty for eviction or flush
+				// to report
+				writeBack(f);
+			}
+		}
+		lock.lock();
+	}
+}
+
+std::string bufferPool::flush() {
+	std::string firstErr;
+	for (uint32_t f = 0; f < frameCount; f++) {
+		frame& candidate = frameTable[f];
+		if (!candidate.dirty.load(std::memory_order_acquire)) {
+			continue;
+		}
+		uint64_t key = candidate.key.load(std::memory_order_relaxed);
+		shard& s = shardOf(key);
+		std::lock_guard<std::mutex> lock(s.mu);
+		auto it = s.pages.find(key);
+		if (it != s.pages.end() && it->second == f && candidate.dirty.load(std::memory_order_acquire)) {
+			if (std::string err = writeBack(f); err != "" && firstErr == "") {
+				firstErr = err;
+			}
+		}
+	}
+	for (uint32_t i = 0; i < fileCount.load(std::memory_order_acquire); i++) {
+		if (::fsync(fds[i]) != 0 && firstErr == "") {
+			firstErr = std::string("Could not sync table file: ") + std::strerror(errno);
+		}
+	}
+	return firstErr;
+}
+
+poolStats bufferPool::stats() const {
+	poolStats total;
+	for (size_t i = 0; i <= shardMask; i++) {
+		std::lock_guard<std::mutex> lock(shards[i].mu);
+		total.hits += shards[i].hits;
+		total.misses += shards[i].misses;
+	}
+	total.evictions = evictions.load(std::memory_order_relaxed);
+	total.writeBacks = writeBacks.load(std::memory_order_relaxed);
+	return total;
+}
+
+}
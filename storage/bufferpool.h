@@ -0,0 +1,194 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "pagefile.h"
+
+namespace storage {
+
+enum class evictionPolicy : uint8_t {
+	// clockPolicy sweeps the frames and evicts the first unpinned page that
+	// was not used since the sweep last passed it
+	clockPolicy,
+	// lruKPolicy evicts the page whose K-th most recent use is oldest, pages
+	// used fewer than K times first, so one scan over many pages can not
+	// push out pages that are used again and again
+	lruKPolicy,
+};
+
+struct poolOptions {
+	// frames is how many pages the pool holds, pageSize bytes each
+	size_t frames = 1024;
+	evictionPolicy policy = evictionPolicy::clockPolicy;
+	// lruK is the K of lruKPolicy, at most maxLruK
+	size_t lruK = 2;
+	// shards splits the page table, each part with a mutex of its own; it
+	// is rounded up to a power of two
+	size_t shards = 16;
+	// the background writer writes dirty unpinned pages back this often;
+	// zero leaves them until eviction or flush
+	std::chrono::milliseconds writeBackInterval{100};
+};
+
+constexpr size_t maxLruK = 4;
+
+struct poolStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+	uint64_t writeBacks = 0;
+
+	double hitRate() const {
+		return hits + misses == 0 ? 0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+	}
+};
+
+using fileId = uint32_t;
+
+class bufferPool;
+
+// pageHandle keeps one page pinned in the pool, so it is neither evicted nor
+// moved, until the handle is released or destroyed
+class pageHandle {
+public:
+	pageHandle() = default;
+	~pageHandle() { release(); }
+
+	pageHandle(const pageHandle&) = delete;
+	pageHandle& operator=(const pageHandle&) = delete;
+	pageHandle(pageHandle&& other) noexcept { *this = std::move(other); }
+	pageHandle& operator=(pageHandle&& other) noexcept;
+
+	explicit operator bool() const { return bytes != nullptr; }
+
+	// data is the pageSize bytes of the page
+	const char* data() const { return bytes; }
+
+	// mutableData marks the page dirty and returns its bytes to change
+	char* mutableData();
+
+	void release();
+
+private:
+	friend class bufferPool;
+	pageHandle(bufferPool* pool, uint32_t frame, char* bytes) : pool(pool), frame(frame), bytes(bytes) {}
+
+	bufferPool* pool = nullptr;
+	uint32_t frame = 0;
+	char* bytes = nullptr;
+};
+
+// bufferPool caches pages of table files in a fixed number of frames, for
+// tables too big to keep in memory whole. Pinning a page already in the
+// pool takes only the mutex of its page table shard; misses pick a victim
+// with the configured policy, write it back if dirty and read the page in
+// its place.
+//
+// The pool stands alone for now: loadTable maps table files and scans read
+// the mapped columns, so no query pins pages yet. Reading columns through
+// the pool needs columns whose pages can be missing from memory, and
+// readInts and readText copying out of pinned pages, which is left to a
+// follow-up. Until then the pool tests and BM_PoolScan are its only
+// callers.
+class bufferPool {
+public:
+	explicit bufferPool(poolOptions opts = {});
+	// the destructor writes back every dirty page; no page may be pinned
+	~bufferPool();
+
+	bufferPool(const bufferPool&) = delete;
+	bufferPool& operator=(const bufferPool&) = delete;
+
+	// openFile makes the file at path, created if missing, readable through
+	// the pool
+	std::tuple<fileId, std::string> openFile(const std::string& path);
+
+	// pin returns page of file, reading it in unless it is in the pool.
+	// Pages past the end of the file read as zeros.
+	std::tuple<pageHandle, std::string> pin(fileId file, uint64_t page);
+
+	// flush writes back every dirty page and syncs the files. Pages pinned
+	// for writing meanwhile may be written half changed and stay dirty.
+	std::string flush();
+
+	poolStats stats() const;
+	size_t frames() const { return frameCount; }
+
+private:
+	friend class pageHandle;
+
+	enum frameState : uint8_t {
+		freeFrame,
+		usedFrame,
+		// evictingFrame is a used frame one thread is trying to evict
+		evictingFrame,
+	};
+
+	struct frame {
+		std::atomic<uint8_t> state{freeFrame};
+		std::atomic<uint32_t> pins{0};
+		std::atomic<bool> referenced{false};
+		std::atomic<bool> dirty{false};
+		// key names the page held; it only changes while the frame is free
+		// or being evicted
+		std::atomic<uint64_t> key{0};
+		// history holds the times of the latest uses, most recent first
+		std::array<std::atomic<int64_t>, maxLruK> history{};
+	};
+
+	struct alignas(64) shard {
+		std::mutex mu;
+		std::unordered_map<uint64_t, uint32_t> pages;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+	};
+
+	static constexpr size_t maxFiles = 1024;
+
+	shard& shardOf(uint64_t key) const;
+	char* frameData(uint32_t f) const { return memory.get() + static_cast<size_t>(f) * pageSize; }
+	void touch(frame& f);
+	void unpin(uint32_t f);
+
+	// claimFrame returns a frame holding no page, evicting one if none is free
+	std::tuple<uint32_t, std::string> claimFrame();
+	std::tuple<uint32_t, bool> pickVictim(uint64_t& attempts);
+	// tryEvict drops the page of f from the page table once f is unpinned,
+	// writing it back first if dirty
+	bool tryEvict(uint32_t f, std::string& err);
+	std::string writeBack(uint32_t f);
+	void writeBackLoop();
+
+	poolOptions opts;
+	size_t frameCount;
+	std::unique_ptr<char, void (*)(void*)> memory;
+	std::unique_ptr<frame[]> frameTable;
+	std::unique_ptr<shard[]> shards;
+	size_t shardMask;
+
+	std::array<int, maxFiles> fds{};
+	std::atomic<uint32_t> fileCount{0};
+	std::mutex filesMu;
+
+	std::mutex freeMu;
+	std::vector<uint32_t> freeFrames;
+	std::atomic<uint64_t> hand{0};
+	std::atomic<uint64_t> evictions{0};
+	std::atomic<uint64_t> writeBacks{0};
+
+	std::mutex writerMu;
+	std::condition_variable writerWake;
+	bool stopping = false;
+	std::thread writer;
+};
+
+}
@@ -0,0 +1,232 @@
+#include "csv.h"
+#include "../lexer/pool.h"
+#include "../lexer/scan.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace storage {
+
+using namespace nicolassql;
+
+namespace {
+
+// chunkResult is what parsing one chunk produced: its rows as columns, or
+// the error of its first bad row, row counting from the chunk's start
+struct chunkResult {
+	std::vector<column> columns;
+	size_t rows = 0;
+	std::string err;
+	size_t errRow = 0;
+};
+
+// countQuotes counts the " in data
+size_t countQuotes(const char* data, size_t size) {
+	size_t count = 0;
+	for (size_t i = findByte(data, size, '"'); i < size; i += 1 + findByte(data + i + 1, size - i - 1, '"')) {
+		count++;
+	}
+	return count;
+}
+
+// rowStart returns the position just past the first line break at or
+// after from that is outside quotes, given whether from is inside quotes,
+// or size if there is none
+size_t rowStart(const char* data, size_t size, size_t from, bool quoted) {
+	size_t i = from;
+	while (i < size) {
+		i += findAnyByte(data + i, size - i, '"', '\n', '\n');
+		if (i >= size) {
+			return size;
+		}
+		if (data[i] == '\n' && !quoted) {
+			return i + 1;
+		}
+		if (data[i] == '"') {
+			quoted = !quoted;
+		}
+		i++;
+	}
+	return size;
+}
+
+// parseChunk parses the rows from data to end, which start and end on row
+// boundaries, into columns typed like those of t
+void parseChunk(const table& t, const char* data, const char* end, chunkResult& out) {
+	for (const column& col : t.columns()) {
+		out.columns.push_back(column{.name = col.name, .type = col.type});
+	}
+	size_t width = out.columns.size();
+	std::string unquoted;
+
+	const char* p = data;
+	while (p < end) {
+		for (size_t i = 0; i < width; i++) {
+			column& col = out.columns[i];
+			std::string_view field;
+			if (p < end && *p == '"') {
+				// a quoted field runs to the quote not doubled
+				unquoted.clear();
+				const char* q = p + 1;
+				while (true) {
+					size_t n = findByte(q, static_cast<size_t>(end - q), '"');
+					if (q + n >= end) {
+						out.err = "unterminated quoted field";
+						out.errRow = out.rows;
+						return;
+					}
+					unquoted.append(q, n + 1);
+					q += n + 1;
+					if (q < end && *q == '"') {
+						q++;
+						continue;
+					}
+					unquoted.pop_back();
+					break;
+				}
+				field = unquoted;
+				p = q;
+			} else {
+				const char* stop = p + findAnyByte(p, static_cast<size_t>(end - p), ',', '\n', '\r');
+				field = std::string_view(p, static_cast<size_t>(stop - p));
+				p = stop;
+			}
+
+			if (col.type == columnType::intType) {
+				int64_t n = 0;
+				auto [stop, ec] = std::from_chars(field.data(), field.data() + field.size(), n);
+				if (ec != std::errc() || stop != field.data() + field.size()) {
+					out.err = "expected an INT for column " + col.name + ", got " + std::string(field);
+					out.errRow = out.rows;
+					return;
+				}
+				col.ints.push_back(n);
+			} else {
+				col.appendText(field);
+			}
+
+			// the field must end the row or be followed by the next one
+			bool last = i + 1 == width;
+			if (p < end && *p == ',' && !last) {
+				p++;
+				continue;
+			}
+			if (p < end && *p == '\r') {
+				p++;
+			}
+			if (!last || (p < end && *p != '\n')) {
+				out.err = "expected " + std::to_string(width) + " fields";
+				out.errRow = out.rows;
+				return;
+			}
+			if (p < end) {
+				p++;
+			}
+		}
+		out.rows++;
+	}
+}
+
+// appendColumn appends the values of from to to
+void appendColumn(column& to, const column& from) {
+	if (to.type == columnType::intType) {
+		to.ints.append(from.ints.begin(), from.ints.end());
+		return;
+	}
+	uint64_t base = to.chars.size();
+	to.chars.append(from.chars.begin(), from.chars.end());
+	size_t start = to.offsets.size();
+	to.offsets.resize(start + from.offsets.size() - 1);
+	uint64_t* offsets = to.offsets.data() + start;
+	for (size_t i = 1; i < from.offsets.size(); i++) {
+		offsets[i - 1] = from.offsets[i] + base;
+	}
+}
+
+}
+
+std::tuple<size_t, std::string> copyFromCsv(table& t, const std::string& path, csvOptions opts) {
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return {0, "Could not open CSV file " + path + ": " + std::strerror(errno)};
+	}
+	struct stat info{};
+	if (::fstat(fd, &info) != 0) {
+		std::string err = "Could not stat CSV file " + path + ": " + std::strerror(errno);
+		::close(fd);
+		return {0, err};
+	}
+	size_t size = static_cast<size_t>(info.st_size);
+	if (size == 0) {
+		::close(fd);
+		return {0, ""};
+	}
+	void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (address == MAP_FAILED) {
+		return {0, "Could not map CSV file " + path + ": " + std::strerror(errno)};
+	}
+	::madvise(address, size, MADV_SEQUENTIAL);
+	const char* data = static_cast<const char*>(address);
+
+	size_t threads = opts.threads != 0 ? opts.threads : sharedPool().size();
+	size_t chunks = std::max<size_t>(1, std::min(threads, size / std::max<size_t>(1, opts.minChunkBytes)));
+
+	// a cut lands inside quotes when an odd number of quotes precede it, so
+	// counting the quotes of every stretch first lets each cut move to the
+	// next row boundary on its own
+	std::vector<size_t> quotes(chunks);
+	auto stretch = [&](size_t k) { return k * (size / chunks); };
+	sharedPool().parallelFor(chunks - 1, [&](size_t k) {
+		quotes[k] = countQuotes(data + stretch(k), stretch(k + 1) - stretch(k));
+	});
+
+	std::vector<size_t> cuts{0};
+	size_t quotesBefore = 0;
+	for (size_t k = 1; k < chunks; k++) {
+		quotesBefore += quotes[k - 1];
+		cuts.push_back(std::max(cuts.back(), rowStart(data, size, stretch(k), quotesBefore % 2 == 1)));
+	}
+	cuts.push_back(size);
+
+	std::vector<chunkResult> results(chunks);
+	sharedPool().parallelFor(chunks, [&](size_t k) {
+		parseChunk(t, data + cuts[k], data + cuts[k + 1], results[k]);
+	});
+	::munmap(address, size);
+
+	size_t rows = 0;
+	for (const chunkResult& r : results) {
+		if (r.err != "") {
+			return {0, "Row " + std::to_string(rows + r.errRow + 1) + " of CSV file " + path + ": " + r.err};
+		}
+		rows += r.rows;
+	}
+
+	std::vector<column>& cols = t.columns();
+	t.reserve(rows);
+	for (size_t i = 0; i < cols.size(); i++) {
+		if (cols[i].type == columnType::textType) {
+			size_t textBytes = 0;
+			for (const chunkResult& r : results) {
+				textBytes += r.columns[i].chars.size();
+			}
+			cols[i].chars.reserve(cols[i].chars.size() + textBytes);
+		}
+		for (const chunkResult& r : results) {
+			appendColumn(cols[i], r.columns[i]);
+		}
+	}
+	if (std::string err = t.commitAppends(); err != "") {
+		return {0, err};
+	}
+	return {rows, ""};
+}
+
+}
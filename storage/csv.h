@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include "storage.h"
+
+namespace storage {
+
+// A CSV file holds one row per line, fields separated by commas and lines
+// ending in \n or \r\n. A field may be quoted with ", a quote inside it
+// doubled, and then holds commas and line breaks as they are. Every row
+// has as many fields as the table has columns, in column order; INT fields
+// are decimal integers and TEXT fields are taken as they are.
+
+struct csvOptions {
+	// the file is cut into threads chunks, parsed in parallel on the
+	// shared thread pool; zero makes one per pool thread
+	size_t threads = 0;
+	// files smaller than minChunkBytes per thread use fewer threads
+	size_t minChunkBytes = 1 << 20;
+};
+
+// copyFromCsv maps the CSV file at path and appends its rows to t, all of
+// them or, on error, none. The file is cut into chunks at row boundaries
+// that are parsed in parallel straight into column buffers, which are then
+// appended in file order. It returns the number of rows appended.
+std::tuple<size_t, std::string> copyFromCsv(table& t, const std::string& path, csvOptions opts = {});
+
+}
@@ -0,0 +1,344 @@
+#include "encoding.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+
+namespace storage {
+
+namespace {
+
+// frame of reference codes of maxFrameWidth bits or more save too little
+// over plain values to be worth unpacking; narrower codes are positive as
+// an int64_t and lie within the eight bytes their first bit is in
+constexpr unsigned maxFrameWidth = 48;
+
+// bitWidth is the number of bits n takes, 0 for 0
+unsigned bitWidth(uint64_t n) {
+	return n == 0 ? 0 : 64 - static_cast<unsigned>(__builtin_clzll(n));
+}
+
+// packedWords is the number of words rows codes of width bits are packed
+// into, with room to read the last code as a whole word
+size_t packedWords(size_t rows, unsigned width) {
+	return rows * width / 64 + 2;
+}
+
+// hashText mixes the bytes of v in a word at a time. It only spreads the
+// values of a chunk over the slots of its dictionary, so it can be cheap.
+uint64_t hashText(std::string_view v) {
+	uint64_t h = v.size() * 0x9e3779b97f4a7c15ULL;
+	size_t i = 0;
+	for (; i + 8 <= v.size(); i += 8) {
+		uint64_t word;
+		std::memcpy(&word, v.data() + i, sizeof(word));
+		h = (h ^ word) * 0xff51afd7ed558ccdULL;
+		h ^= h >> 32;
+	}
+	uint64_t rest = 0;
+	std::memcpy(&rest, v.data() + i, v.size() - i);
+	h = (h ^ rest) * 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	return h ^ (h >> 33);
+}
+
+// wordAt is the eight bytes of v from byte depth on, big-endian, those
+// past its end taken as zeros
+uint64_t wordAt(std::string_view v, size_t depth) {
+	uint64_t word = 0;
+	for (size_t b = depth; b < depth + sizeof(word); b++) {
+		word = (word << 8) | (b < v.size() ? static_cast<unsigned char>(v[b]) : 0);
+	}
+	return word;
+}
+
+// sortEntries orders the codes of entries from first to last, whose values
+// tie on their first depth bytes, by value. They are sorted on the eight
+// bytes from depth on, and each run that ties on those too is sorted on
+// the next eight, until the values of a run end there and are compared
+// whole.
+template <typename Value>
+void sortEntries(std::pair<uint64_t, uint32_t>* first, std::pair<uint64_t, uint32_t>* last, size_t depth,
+		const Value& value) {
+	for (auto* e = first; e != last; e++) {
+		e->first = wordAt(value(e->second), depth);
+	}
+	std::sort(first, last, [](const auto& a, const auto& b) { return a.first < b.first; });
+	for (auto* run = first; run != last;) {
+		auto* end = run + 1;
+		bool longer = value(run->second).size() > depth + 8;
+		for (; end != last && end->first == run->first; end++) {
+			longer = longer || value(end->second).size() > depth + 8;
+		}
+		if (end - run > 1 && longer) {
+			sortEntries(run, end, depth + 8, value);
+		} else if (end - run > 1) {
+			std::sort(run, end, [&](const auto& a, const auto& b) { return value(a.second) < value(b.second); });
+		}
+		run = end;
+	}
+}
+
+// unpackCodes writes count codes of packed from first on to out. Eight
+// codes take up width whole bytes, so from a multiple of eight on each
+// code of a group of eight is at a byte and shift known at compile time.
+template <unsigned width>
+void unpackCodes(const uint64_t* packed, size_t first, size_t count, int64_t* out) {
+	constexpr uint64_t mask = (uint64_t{1} << width) - 1;
+	const char* bytes = reinterpret_cast<const char*>(packed);
+	size_t i = 0;
+	if (first % 8 == 0) {
+		for (; i + 8 <= count; i += 8) {
+			const char* group = bytes + (first + i) / 8 * width;
+			for (unsigned j = 0; j < 8; j++) {
+				uint64_t word;
+				std::memcpy(&word, group + j * width / 8, sizeof(word));
+				out[i + j] = static_cast<int64_t>((word >> (j * width % 8)) & mask);
+			}
+		}
+	}
+	for (; i < count; i++) {
+		out[i] = static_cast<int64_t>(unpackCode(packed, width, first + i));
+	}
+}
+
+using unpackFunction = void (*)(const uint64_t* packed, size_t first, size_t count, int64_t* out);
+
+template <size_t... widths>
+constexpr std::array<unpackFunction, sizeof...(widths)> unpackers(std::index_sequence<widths...>) {
+	return {unpackCodes<widths>...};
+}
+
+// unpackFor holds unpackCodes for every width a frame of reference uses
+constexpr auto unpackFor = unpackers(std::make_index_sequence<maxFrameWidth>());
+
+}
+
+void encodedInts::decode(size_t first, size_t count, int64_t* out) const {
+	switch (kind) {
+	case encodingKind::frameKind:
+		codes(first, count, out);
+		for (size_t i = 0; i < count; i++) {
+			out[i] = static_cast<int64_t>(static_cast<uint64_t>(base) + static_cast<uint64_t>(out[i]));
+		}
+		return;
+	case encodingKind::runKind: {
+		size_t r = run(first);
+		for (size_t i = 0; i < count; i++) {
+			if (first + i >= ends[r]) {
+				r++;
+			}
+			out[i] = values[r];
+		}
+		return;
+	}
+	default:
+		std::memcpy(out, values.data() + first, count * sizeof(int64_t));
+	}
+}
+
+void encodedInts::codes(size_t first, size_t count, int64_t* out) const {
+	unpackFor[width](packed.data(), first, count, out);
+}
+
+size_t encodedInts::run(size_t row) const {
+	return static_cast<size_t>(std::upper_bound(ends.begin(), ends.end(), row) - ends.begin());
+}
+
+size_t encodedInts::bytes() const {
+	return packed.size() * sizeof(uint64_t) + values.size() * sizeof(int64_t) + ends.size() * sizeof(uint32_t);
+}
+
+bool encodedInts::valid() const {
+	switch (kind) {
+	case encodingKind::plainKind:
+		return values.size() == rows;
+	case encodingKind::frameKind:
+		return width < maxFrameWidth && packed.size() >= packedWords(rows, width);
+	case encodingKind::runKind:
+		return !ends.empty() && ends.size() == values.size() && ends.back() == rows;
+	default:
+		return false;
+	}
+}
+
+void encodedText::decode(size_t first, size_t count, std::vector<uint64_t>& out, std::string& text) const {
+	out.resize(count + 1);
+	out[0] = 0;
+	if (kind == encodingKind::plainKind) {
+		text.assign(chars.data() + offsets[first], offsets[first + count] - offsets[first]);
+		for (size_t i = 0; i < count; i++) {
+			out[i + 1] = offsets[first + i + 1] - offsets[first];
+		}
+		return;
+	}
+
+	// the offsets come first, so that the values can be copied into text
+	// sized for them at once
+	std::vector<int64_t> rowCodes(count);
+	codes.decode(first, count, rowCodes.data());
+	for (size_t i = 0; i < count; i++) {
+		size_t code = static_cast<size_t>(rowCodes[i]);
+		out[i + 1] = out[i] + offsets[code + 1] - offsets[code];
+	}
+	text.resize(out[count]);
+	for (size_t i = 0; i < count; i++) {
+		size_t code = static_cast<size_t>(rowCodes[i]);
+		std::memcpy(text.data() + out[i], chars.data() + offsets[code], out[i + 1] - out[i]);
+	}
+}
+
+size_t encodedText::bytes() const {
+	return offsets.size() * sizeof(uint64_t) + chars.size() + codes.bytes();
+}
+
+bool encodedText::valid() const {
+	if (offsets.empty() || offsets[0] != 0 || offsets.back() != chars.size()) {
+		return false;
+	}
+	switch (kind) {
+	case encodingKind::plainKind:
+		return offsets.size() == rows + 1 && textBytes == chars.size();
+	case encodingKind::dictionaryKind:
+		return offsets.size() >= 2 && codes.rows == rows && codes.valid();
+	default:
+		return false;
+	}
+}
+
+encodedInts encodeInts(const int64_t* values, size_t rows) {
+	encodedInts chunk;
+	chunk.rows = rows;
+	if (rows == 0) {
+		return chunk;
+	}
+
+	int64_t low = values[0];
+	int64_t high = values[0];
+	size_t runs = 1;
+	for (size_t i = 1; i < rows; i++) {
+		low = std::min(low, values[i]);
+		high = std::max(high, values[i]);
+		runs += values[i] != values[i - 1];
+	}
+
+	unsigned width = bitWidth(static_cast<uint64_t>(high) - static_cast<uint64_t>(low));
+	size_t plainBytes = rows * sizeof(int64_t);
+	size_t frameBytes = width < maxFrameWidth ? packedWords(rows, width) * sizeof(uint64_t) : SIZE_MAX;
+	size_t runBytes = runs * (sizeof(int64_t) + sizeof(uint32_t));
+
+	if (runBytes < frameBytes && runBytes < plainBytes) {
+		chunk.kind = encodingKind::runKind;
+		chunk.values.reserve(runs);
+		chunk.ends.reserve(runs);
+		for (size_t i = 0; i < rows; i++) {
+			if (i + 1 == rows || values[i + 1] != values[i]) {
+				chunk.values.push_back(values[i]);
+				chunk.ends.push_back(static_cast<uint32_t>(i + 1));
+			}
+		}
+		return chunk;
+	}
+
+	if (frameBytes < plainBytes) {
+		chunk.kind = encodingKind::frameKind;
+		chunk.base = low;
+		chunk.width = width;
+		chunk.packed.resize(packedWords(rows, width));
+		uint64_t* packed = chunk.packed.data();
+		for (size_t i = 0; width > 0 && i < rows; i++) {
+			uint64_t code = static_cast<uint64_t>(values[i]) - static_cast<uint64_t>(low);
+			size_t bit = i * width;
+			unsigned shift = bit & 63;
+			packed[bit >> 6] |= code << shift;
+			if (shift + width > 64) {
+				packed[(bit >> 6) + 1] |= code >> (64 - shift);
+			}
+		}
+		return chunk;
+	}
+
+	chunk.values.append(values, values + rows);
+	return chunk;
+}
+
+encodedText encodeText(const uint64_t* offsets, const char* chars, size_t rows) {
+	encodedText chunk;
+	chunk.rows = rows;
+	chunk.textBytes = offsets[rows] - offsets[0];
+	auto value = [&](size_t row) {
+		return std::string_view(chars + offsets[row], offsets[row + 1] - offsets[row]);
+	};
+
+	// rows first get the code of their value in the order values are met,
+	// found by open addressing into slots that hold codes. firstRows holds
+	// the row each code was first met in.
+	size_t mask = (size_t{2} << bitWidth(rows)) - 1;
+	std::vector<uint32_t> slots(mask + 1, UINT32_MAX);
+	std::vector<uint32_t> firstRows;
+	std::vector<int64_t> rowCodes(rows);
+	size_t plainBytes = chunk.textBytes + (rows + 1) * sizeof(uint64_t);
+	size_t distinctBytes = 0;
+	bool tooLarge = false;
+	for (size_t row = 0; row < rows && !tooLarge; row++) {
+		// a run of equal values is looked up once
+		std::string_view v = value(row);
+		if (row > 0 && v == value(row - 1)) {
+			rowCodes[row] = rowCodes[row - 1];
+			continue;
+		}
+		size_t slot = hashText(v) & mask;
+		while (slots[slot] != UINT32_MAX && value(firstRows[slots[slot]]) != v) {
+			slot = (slot + 1) & mask;
+		}
+		if (slots[slot] == UINT32_MAX) {
+			slots[slot] = static_cast<uint32_t>(firstRows.size());
+			firstRows.push_back(static_cast<uint32_t>(row));
+			distinctBytes += v.size();
+			// the entries alone outgrowing half the plain chunk rule the
+			// dictionary out
+			tooLarge = 2 * (distinctBytes + (firstRows.size() + 1) * sizeof(uint64_t)) > plainBytes;
+		}
+		rowCodes[row] = slots[slot];
+	}
+
+	size_t entries = firstRows.size();
+	size_t dictionaryBytes = distinctBytes + (entries + 1) * sizeof(uint64_t) + (rows * bitWidth(entries - 1) + 7) / 8;
+	// a row's value is read from wherever its entry is, so a dictionary
+	// must save more than a little room to be worth those reads
+	if (tooLarge || 2 * dictionaryBytes > plainBytes) {
+		chunk.chars.append(chars + offsets[0], chars + offsets[rows]);
+		chunk.offsets.resize(rows + 1);
+		uint64_t* chunkOffsets = chunk.offsets.data();
+		for (size_t row = 0; row <= rows; row++) {
+			chunkOffsets[row] = offsets[row] - offsets[0];
+		}
+		return chunk;
+	}
+
+	// and then the code of their value in the sorted dictionary
+	std::vector<std::pair<uint64_t, uint32_t>> sorted(entries);
+	for (size_t i = 0; i < entries; i++) {
+		sorted[i].second = static_cast<uint32_t>(i);
+	}
+	sortEntries(sorted.data(), sorted.data() + entries, 0, [&](uint32_t code) { return value(firstRows[code]); });
+	std::vector<int64_t> sortedCode(entries);
+	chunk.kind = encodingKind::dictionaryKind;
+	chunk.chars.reserve(distinctBytes);
+	chunk.offsets.reserve(entries + 1);
+	chunk.offsets.push_back(0);
+	for (size_t i = 0; i < entries; i++) {
+		sortedCode[sorted[i].second] = static_cast<int64_t>(i);
+		std::string_view entry = value(firstRows[sorted[i].second]);
+		chunk.chars.append(entry.data(), entry.data() + entry.size());
+		chunk.offsets.push_back(chunk.chars.size());
+	}
+	for (int64_t& code : rowCodes) {
+		code = sortedCode[static_cast<size_t>(code)];
+	}
+	chunk.codes = encodeInts(rowCodes.data(), rows);
+	return chunk;
+}
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "buffer.h"
+
+namespace storage {
+
+// Columns are stored in chunks of chunkRows rows. Once a chunk is full it
+// is sealed: its values are encoded in whichever way takes the least room
+// for that chunk, so a column of sorted ids, one of a few repeated states
+// and one of free text each get an encoding that suits them. Every
+// encoding reads a single row without decoding the rest of the chunk.
+//
+//	plain              the values as they were
+//	frame of reference INT values as their distance from the chunk's
+//	                   smallest value, bit-packed in as few bits as the
+//	                   largest distance needs
+//	run length         INT values as runs of equal values, each a value
+//	                   and the row it ends before
+//	dictionary         TEXT values as codes into the chunk's distinct
+//	                   values, sorted so that codes order like the values;
+//	                   the codes are an INT chunk of their own. Used only
+//	                   when it takes at most half the room of plain.
+
+// The arrays of a chunk are columnBuffers, so that a chunk loaded from a
+// table file views the mapped file in place.
+
+// chunkRows is the number of rows of a sealed chunk
+constexpr size_t chunkRows = size_t{1} << 16;
+
+// unpackCode reads code i of the width bit codes packed from bit 0 of
+// packed on, with one unaligned load of the eight bytes its first bit is
+// in. width must be below 57, so that they hold all of it.
+inline uint64_t unpackCode(const uint64_t* packed, unsigned width, size_t i) {
+	size_t bit = i * width;
+	uint64_t word;
+	std::memcpy(&word, reinterpret_cast<const char*>(packed) + (bit >> 3), sizeof(word));
+	return (word >> (bit & 7)) & ((uint64_t{1} << width) - 1);
+}
+
+enum class encodingKind : uint8_t {
+	plainKind = 0,
+	frameKind,
+	runKind,
+	dictionaryKind,
+};
+
+// encodedInts is a sealed chunk of INT values, or of dictionary codes
+struct encodedInts {
+	encodingKind kind = encodingKind::plainKind;
+	size_t rows = 0;
+
+	// frameKind: value i is base plus the width bits of packed from bit
+	// i*width on. packed ends with spare words, so the eight bytes a value
+	// starts in can always be read whole.
+	int64_t base = 0;
+	unsigned width = 0;
+	columnBuffer<uint64_t> packed;
+
+	// plainKind: value i is values[i]; runKind: run i holds values[i] from
+	// the end of the run before up to ends[i]
+	columnBuffer<int64_t> values;
+	columnBuffer<uint32_t> ends;
+
+	int64_t at(size_t row) const {
+		switch (kind) {
+		case encodingKind::frameKind:
+			return static_cast<int64_t>(static_cast<uint64_t>(base) + unpackCode(packed.data(), width, row));
+		case encodingKind::runKind:
+			return values[run(row)];
+		default:
+			return values[row];
+		}
+	}
+
+	// decode writes the count values from first on to out
+	void decode(size_t first, size_t count, int64_t* out) const;
+
+	// codes writes the count frame of reference codes from first on to
+	// out, each the distance of its value from base
+	void codes(size_t first, size_t count, int64_t* out) const;
+
+	// run returns the run that holds row
+	size_t run(size_t row) const;
+
+	size_t bytes() const;
+
+	// valid reports whether the arrays of the chunk fit its kind and rows,
+	// which a chunk read from a file must before it is read
+	bool valid() const;
+};
+
+// encodedText is a sealed chunk of TEXT values
+struct encodedText {
+	encodingKind kind = encodingKind::plainKind;
+	size_t rows = 0;
+	// textBytes is the length of every row's value together
+	size_t textBytes = 0;
+
+	// plainKind: value i spans chars offsets[i] to offsets[i+1].
+	// dictionaryKind: entry i does, and codes holds the entry of each row.
+	columnBuffer<uint64_t> offsets;
+	columnBuffer<char> chars;
+	encodedInts codes;
+
+	// entries is the number of distinct values of a dictionary chunk
+	size_t entries() const { return offsets.size() - 1; }
+
+	std::string_view entry(size_t i) const {
+		return std::string_view(chars.data() + offsets[i], offsets[i+1] - offsets[i]);
+	}
+
+	std::string_view at(size_t row) const {
+		return entry(kind == encodingKind::dictionaryKind ? static_cast<size_t>(codes.at(row)) : row);
+	}
+
+	// decode sets chars to the count values from first on, back to back,
+	// and offsets to the count+1 offsets they start and end at
+	void decode(size_t first, size_t count, std::vector<uint64_t>& offsets, std::string& chars) const;
+
+	size_t bytes() const;
+
+	// valid is encodedInts::valid for TEXT. Only the first and last offset
+	// of a chunk are checked, as for the plain rows of a table file.
+	bool valid() const;
+};
+
+// encodeInts seals the rows values at values
+encodedInts encodeInts(const int64_t* values, size_t rows);
+
+// encodeText seals the rows values that span chars offsets[i] to
+// offsets[i+1]
+encodedText encodeText(const uint64_t* offsets, const char* chars, size_t rows);
+
+}
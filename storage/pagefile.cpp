@@ -0,0 +1,551 @@
+#include "pagefile.h"
+#include "btree.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "table files store values little-endian and are mapped in place"
+#endif
+
+namespace storage {
+
+namespace {
+
+constexpr std::string_view magic = "NSQLTAB3";
+
+constexpr uint64_t pagesFor(uint64_t bytes) {
+	return (bytes + pageSize - 1) / pageSize;
+}
+
+std::string systemError(const std::string& what, const std::string& path) {
+	return what + " " + path + ": " + std::strerror(errno);
+}
+
+template <typename T>
+void putInt(std::string& out, T value) {
+	out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putName(std::string& out, std::string_view name) {
+	putInt(out, static_cast<uint32_t>(name.size()));
+	out.append(name);
+}
+
+// headerReader takes fields off the front of a header page, a run of
+// zone maps or the descriptors of sealed chunks; a read past its end
+// clears ok
+struct headerReader {
+	const char* next;
+	const char* end;
+	bool ok = true;
+
+	template <typename T>
+	T integer() {
+		T value{};
+		if (static_cast<size_t>(end - next) < sizeof(T)) {
+			ok = false;
+			return value;
+		}
+		std::memcpy(&value, next, sizeof(T));
+		next += sizeof(T);
+		return value;
+	}
+
+	std::string_view name() {
+		uint32_t size = integer<uint32_t>();
+		if (!ok || size > static_cast<size_t>(end - next)) {
+			ok = false;
+			return {};
+		}
+		std::string_view value(next, size);
+		next += size;
+		return value;
+	}
+};
+
+// extent is a chunk, heap, run of zone maps or array of a sealed chunk:
+// bytes bytes at data
+struct extent {
+	const char* data;
+	uint64_t bytes;
+};
+
+std::string writeAll(int fd, const char* data, size_t size, const std::string& path) {
+	while (size > 0) {
+		ssize_t n = ::write(fd, data, size);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return systemError("Could not write table file", path);
+		}
+		data += n;
+		size -= static_cast<size_t>(n);
+	}
+	return "";
+}
+
+// alignedBytes rounds bytes up to a whole number of words, where the
+// arrays of sealed chunks start
+constexpr uint64_t alignedBytes(uint64_t bytes) {
+	return (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+}
+
+// writePadded writes e and then zeros up to the next page boundary, or
+// with words set up to the next word boundary
+std::string writePadded(int fd, extent e, const std::string& path, bool words = false) {
+	static const char zeros[pageSize] = {};
+	if (std::string err = writeAll(fd, e.data, e.bytes, path); err != "") {
+		return err;
+	}
+	uint64_t padded = words ? alignedBytes(e.bytes) : pagesFor(e.bytes) * pageSize;
+	return writeAll(fd, zeros, padded - e.bytes, path);
+}
+
+std::string syncDirectory(const std::string& path) {
+	std::string directory = std::filesystem::path(path).parent_path().string();
+	int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return systemError("Could not open directory", directory);
+	}
+	int rc = ::fsync(fd);
+	::close(fd);
+	return rc == 0 ? "" : systemError("Could not sync directory", directory);
+}
+
+// descriptorBytes is the size of the descriptor of a sealed INT or TEXT
+// chunk, and arrayBytes of each array in it
+constexpr uint64_t arrayBytes = 2 * sizeof(uint64_t);
+constexpr uint64_t intDescriptorBytes = 2 + sizeof(int64_t) + 3 * arrayBytes;
+constexpr uint64_t textDescriptorBytes = 1 + sizeof(uint64_t) + 2 * arrayBytes + intDescriptorBytes;
+
+constexpr uint64_t descriptorBytes(columnType type) {
+	return type == columnType::intType ? intDescriptorBytes : textDescriptorBytes;
+}
+
+// sealedWriter lays out the sealed chunks of a column: the descriptors,
+// then the arrays they point at, which are written from where the chunks
+// are in memory
+struct sealedWriter {
+	std::string descriptors;
+	std::vector<extent> arrays;
+	// bytes is where the next array starts
+	uint64_t bytes;
+
+	sealedWriter(columnType type, size_t chunks) : bytes(alignedBytes(chunks * descriptorBytes(type))) {}
+
+	template <typename T>
+	void putArray(const columnBuffer<T>& values) {
+		putInt(descriptors, bytes);
+		putInt(descriptors, static_cast<uint64_t>(values.size()));
+		extent e{reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T)};
+		arrays.push_back(e);
+		bytes += alignedBytes(e.bytes);
+	}
+
+	void putChunk(const encodedInts& chunk) {
+		putInt(descriptors, static_cast<uint8_t>(chunk.kind));
+		putInt(descriptors, static_cast<uint8_t>(chunk.width));
+		putInt(descriptors, chunk.base);
+		putArray(chunk.packed);
+		putArray(chunk.values);
+		putArray(chunk.ends);
+	}
+
+	void putChunk(const encodedText& chunk) {
+		putInt(descriptors, static_cast<uint8_t>(chunk.kind));
+		putInt(descriptors, static_cast<uint64_t>(chunk.textBytes));
+		putArray(chunk.offsets);
+		putArray(chunk.chars);
+		putChunk(chunk.codes);
+	}
+
+	std::string write(int fd, const std::string& path) const {
+		std::string err = writePadded(fd, extent{descriptors.data(), descriptors.size()}, path, true);
+		for (size_t i = 0; i < arrays.size() && err == ""; i++) {
+			err = writePadded(fd, arrays[i], path, true);
+		}
+		if (err == "") {
+			static const char zeros[pageSize] = {};
+			err = writeAll(fd, zeros, pagesFor(bytes) * pageSize - bytes, path);
+		}
+		return err;
+	}
+};
+
+// sealedReader reads the sealed chunks of a column back, their arrays
+// viewing the mapped file
+struct sealedReader {
+	const char* data;
+	uint64_t bytes;
+	headerReader in{.next = data, .end = data + bytes};
+
+	template <typename T>
+	void viewArray(columnBuffer<T>& values) {
+		uint64_t offset = in.integer<uint64_t>();
+		uint64_t count = in.integer<uint64_t>();
+		if (!in.ok || offset % alignof(T) != 0 || offset > bytes || count > (bytes - offset) / sizeof(T)) {
+			in.ok = false;
+			return;
+		}
+		values = columnBuffer<T>::view(reinterpret_cast<const T*>(data + offset), count);
+	}
+
+	void readChunk(encodedInts& chunk) {
+		chunk.kind = static_cast<encodingKind>(in.integer<uint8_t>());
+		chunk.width = in.integer<uint8_t>();
+		chunk.base = in.integer<int64_t>();
+		chunk.rows = chunkRows;
+		viewArray(chunk.packed);
+		viewArray(chunk.values);
+		viewArray(chunk.ends);
+	}
+
+	void readChunk(encodedText& chunk) {
+		chunk.kind = static_cast<encodingKind>(in.integer<uint8_t>());
+		chunk.textBytes = in.integer<uint64_t>();
+		chunk.rows = chunkRows;
+		viewArray(chunk.offsets);
+		viewArray(chunk.chars);
+		readChunk(chunk.codes);
+		chunk.codes.rows = chunk.kind == encodingKind::dictionaryKind ? chunkRows : 0;
+	}
+};
+
+// readSealed adds the chunks sealed chunks of col from the bytes bytes at
+// data and reports whether all of them are whole
+bool readSealed(const char* data, uint64_t bytes, column& col, uint64_t chunks) {
+	sealedReader r{.data = data, .bytes = bytes};
+	for (uint64_t i = 0; i < chunks && r.in.ok; i++) {
+		if (col.type == columnType::intType) {
+			r.readChunk(col.intChunks.emplace_back());
+			r.in.ok = r.in.ok && col.intChunks.back().valid();
+		} else {
+			r.readChunk(col.textChunks.emplace_back());
+			r.in.ok = r.in.ok && col.textChunks.back().valid();
+		}
+	}
+	return r.in.ok;
+}
+
+// putZones appends the zone maps of col as a table file stores them
+void putZones(std::string& out, const column& col) {
+	if (col.type == columnType::intType) {
+		for (const zoneMap<int64_t>& zone : col.intZones) {
+			putInt(out, static_cast<uint64_t>(zone.rows));
+			putInt(out, zone.low);
+			putInt(out, zone.high);
+		}
+		return;
+	}
+	for (const zoneMap<std::string>& zone : col.textZones) {
+		putInt(out, static_cast<uint64_t>(zone.rows));
+		putName(out, zone.low);
+		putName(out, zone.high);
+	}
+}
+
+// readZones parses the zone maps of col from the bytes bytes at data.
+// Only the last may cover less than a whole chunk, and together they cover
+// at most rows rows; the table extends them over any rows after that.
+bool readZones(const char* data, uint64_t bytes, column& col, uint64_t rows) {
+	headerReader in{.next = data, .end = data + bytes};
+	uint64_t covered = 0;
+	while (in.ok && in.next < in.end) {
+		uint64_t count = in.integer<uint64_t>();
+		if (covered % chunkRows != 0 || count == 0 || count > chunkRows || count > rows - covered) {
+			return false;
+		}
+		covered += count;
+		if (col.type == columnType::intType) {
+			zoneMap<int64_t>& zone = col.intZones.emplace_back();
+			zone.rows = count;
+			zone.low = in.integer<int64_t>();
+			zone.high = in.integer<int64_t>();
+			continue;
+		}
+		zoneMap<std::string>& zone = col.textZones.emplace_back();
+		zone.rows = count;
+		zone.low = in.name();
+		zone.high = in.name();
+	}
+	return in.ok;
+}
+
+}
+
+std::string saveTable(const table& t, const std::string& path, uint64_t checkpointLsn) {
+	std::string header(magic);
+	putInt(header, static_cast<uint32_t>(pageSize));
+	putInt(header, static_cast<uint32_t>(t.columns().size()));
+	putInt(header, static_cast<uint64_t>(t.rows()));
+	putInt(header, checkpointLsn);
+	putName(header, t.name());
+
+	// extents point into zones, so it may not grow
+	std::vector<std::string> zones;
+	zones.reserve(t.columns().size());
+	std::vector<extent> extents;
+	std::vector<sealedWriter> sealed;
+	uint64_t page = 1;
+	for (const column& col : t.columns()) {
+		bool isInt = col.type == columnType::intType;
+		size_t chunks = col.sealedRows() / chunkRows;
+		size_t rows = t.rows() - col.sealedRows();
+		extent chunk = isInt
+			? extent{reinterpret_cast<const char*>(col.ints.data()), rows * sizeof(int64_t)}
+			: extent{reinterpret_cast<const char*>(col.offsets.data()), (rows + 1) * sizeof(uint64_t)};
+		extent heap = isInt ? extent{nullptr, 0} : extent{col.chars.data(), col.offsets[rows]};
+		std::string& zoneMaps = zones.emplace_back();
+		putZones(zoneMaps, col);
+		extent zone{zoneMaps.data(), zoneMaps.size()};
+		sealedWriter& encoded = sealed.emplace_back(col.type, chunks);
+		for (size_t i = 0; i < chunks; i++) {
+			if (isInt) {
+				encoded.putChunk(col.intChunks[i]);
+			} else {
+				encoded.putChunk(col.textChunks[i]);
+			}
+		}
+
+		putName(header, col.name);
+		header += static_cast<char>(isInt ? 0 : 1);
+		putInt(header, static_cast<uint64_t>(chunks));
+		putInt(header, page);
+		putInt(header, chunk.bytes);
+		page += pagesFor(chunk.bytes);
+		putInt(header, page);
+		putInt(header, heap.bytes);
+		page += pagesFor(heap.bytes);
+		putInt(header, page);
+		putInt(header, zone.bytes);
+		page += pagesFor(zone.bytes);
+		putInt(header, page);
+		putInt(header, encoded.bytes);
+		page += pagesFor(encoded.bytes);
+
+		extents.push_back(chunk);
+		extents.push_back(heap);
+		extents.push_back(zone);
+	}
+	putInt(header, static_cast<uint32_t>(t.indexes().size()));
+	for (const auto& index : t.indexes()) {
+		putName(header, index->name());
+		putInt(header, static_cast<uint32_t>(index->column()));
+	}
+	if (header.size() > pageSize) {
+		return "Table " + t.name() + " has too many columns for its header page";
+	}
+
+	// the new file only replaces the old one once it is whole, so a crash
+	// leaves one or the other
+	std::string temporary = path + ".tmp";
+	int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return systemError("Could not create table file", temporary);
+	}
+
+	// each column's chunk, heap and zone maps, then its sealed chunks
+	std::string err = writePadded(fd, extent{header.data(), header.size()}, temporary);
+	for (size_t i = 0; i < extents.size() && err == ""; i++) {
+		err = writePadded(fd, extents[i], temporary);
+		if (err == "" && i % 3 == 2) {
+			err = sealed[i / 3].write(fd, temporary);
+		}
+	}
+	if (err == "" && ::fsync(fd) != 0) {
+		err = systemError("Could not sync table file", temporary);
+	}
+	::close(fd);
+	if (err == "" && ::rename(temporary.c_str(), path.c_str()) != 0) {
+		err = systemError("Could not rename table file to", path);
+	}
+	if (err != "") {
+		::unlink(temporary.c_str());
+		return err;
+	}
+	return syncDirectory(path);
+}
+
+std::tuple<tableLayout, std::string> readLayout(const char* header, uint64_t fileSize, const std::string& path) {
+	tableLayout layout{};
+	headerReader in{.next = header, .end = header + pageSize};
+	if (std::string_view(header, magic.size()) != magic) {
+		return {layout, "Table file " + path + " is not a table file"};
+	}
+	in.next += magic.size();
+	if (in.integer<uint32_t>() != pageSize) {
+		return {layout, "Table file " + path + " uses a different page size"};
+	}
+	uint32_t columnCount = in.integer<uint32_t>();
+	layout.rows = in.integer<uint64_t>();
+	layout.checkpointLsn = in.integer<uint64_t>();
+	layout.name = in.name();
+
+	std::string damaged = "Table file " + path + " is damaged";
+	for (uint32_t i = 0; i < columnCount && in.ok; i++) {
+		columnExtents col{};
+		col.name = in.name();
+		uint8_t type = in.integer<uint8_t>();
+		col.sealedChunks = in.integer<uint64_t>();
+		col.chunkPage = in.integer<uint64_t>();
+		col.chunkBytes = in.integer<uint64_t>();
+		col.heapPage = in.integer<uint64_t>();
+		col.heapBytes = in.integer<uint64_t>();
+		col.zonePage = in.integer<uint64_t>();
+		col.zoneBytes = in.integer<uint64_t>();
+		col.sealedPage = in.integer<uint64_t>();
+		col.sealedBytes = in.integer<uint64_t>();
+
+		// every extent must lie inside the file, and the chunk must hold the
+		// rows the sealed chunks leave
+		auto fits = [&](uint64_t page, uint64_t bytes) {
+			return page <= fileSize / pageSize && bytes <= fileSize - page * pageSize;
+		};
+		col.type = type == 0 ? columnType::intType : columnType::textType;
+		if (!in.ok || type > 1 || col.sealedChunks > layout.rows / chunkRows) {
+			return {layout, damaged};
+		}
+		uint64_t rows = layout.rows - col.sealedChunks * chunkRows;
+		uint64_t values = type == 0 ? rows : rows + 1;
+		if (col.chunkBytes != values * sizeof(int64_t) || !fits(col.chunkPage, col.chunkBytes) ||
+				!fits(col.heapPage, col.heapBytes) || !fits(col.zonePage, col.zoneBytes) ||
+				!fits(col.sealedPage, col.sealedBytes)) {
+			return {layout, damaged};
+		}
+		layout.columns.push_back(std::move(col));
+	}
+	uint32_t indexCount = in.integer<uint32_t>();
+	for (uint32_t i = 0; i < indexCount && in.ok; i++) {
+		indexDefinition index{};
+		index.name = in.name();
+		index.column = in.integer<uint32_t>();
+		if (index.column >= columnCount) {
+			return {layout, damaged};
+		}
+		layout.indexes.push_back(std::move(index));
+	}
+	if (!in.ok) {
+		return {layout, damaged};
+	}
+	return {layout, ""};
+}
+
+std::tuple<std::unique_ptr<table>, std::string> loadTable(const std::string& path) {
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return {nullptr, systemError("Could not open table file", path)};
+	}
+	struct stat info{};
+	if (::fstat(fd, &info) != 0) {
+		std::string err = systemError("Could not stat table file", path);
+		::close(fd);
+		return {nullptr, err};
+	}
+	uint64_t size = static_cast<uint64_t>(info.st_size);
+	if (size < pageSize) {
+		::close(fd);
+		return {nullptr, "Table file " + path + " is too short"};
+	}
+
+	void* address = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (address == MAP_FAILED) {
+		return {nullptr, systemError("Could not map table file", path)};
+	}
+	std::shared_ptr<const void> mapping(address, [size](const void* p) {
+		::munmap(const_cast<void*>(p), size);
+	});
+	const char* base = static_cast<const char*>(address);
+
+	auto [layout, err] = readLayout(base, size, path);
+	if (err != "") {
+		return {nullptr, err};
+	}
+
+	uint64_t rows = layout.rows;
+	std::vector<column> columns;
+	for (const columnExtents& extents : layout.columns) {
+		const char* chunk = base + extents.chunkPage * pageSize;
+		uint64_t rest = rows - extents.sealedChunks * chunkRows;
+		column col{.name = extents.name, .type = extents.type};
+		if (extents.type == columnType::intType) {
+			col.ints = columnBuffer<int64_t>::view(reinterpret_cast<const int64_t*>(chunk), rest);
+		} else {
+			col.offsets = columnBuffer<uint64_t>::view(reinterpret_cast<const uint64_t*>(chunk), rest + 1);
+			col.chars = columnBuffer<char>::view(base + extents.heapPage * pageSize, extents.heapBytes);
+			if (col.offsets[0] != 0 || col.offsets[rest] != extents.heapBytes) {
+				return {nullptr, "Table file " + path + " is damaged"};
+			}
+		}
+		// the zone maps must cover the sealed rows, which the table can not
+		// extend them over
+		if (!readSealed(base + extents.sealedPage * pageSize, extents.sealedBytes, col, extents.sealedChunks) ||
+				!readZones(base + extents.zonePage * pageSize, extents.zoneBytes, col, rows) ||
+				col.zonedRows() < col.sealedRows()) {
+			return {nullptr, "Table file " + path + " is damaged"};
+		}
+		columns.push_back(std::move(col));
+	}
+
+	auto t = std::make_unique<table>(layout.name, std::move(columns), rows, layout.checkpointLsn, std::move(mapping));
+	// indexes are built when a query first uses them
+	for (const indexDefinition& index : layout.indexes) {
+		if (auto [added, indexErr] = t->addIndex(index.name, index.column, true); indexErr != "") {
+			return {nullptr, "Table file " + path + " is damaged: " + indexErr};
+		}
+	}
+	return {std::move(t), ""};
+}
+
+std::string saveCatalog(const catalog& c, const std::string& directory, uint64_t checkpointLsn) {
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	if (ec) {
+		return "Could not create directory " + directory + ": " + ec.message();
+	}
+	for (const table* t : c.list()) {
+		std::string path = (std::filesystem::path(directory) / (t->name() + std::string(tableFileExtension))).string();
+		if (std::string err = saveTable(*t, path, checkpointLsn); err != "") {
+			return err;
+		}
+	}
+	return "";
+}
+
+std::string loadCatalog(catalog& c, const std::string& directory) {
+	std::error_code ec;
+	if (!std::filesystem::exists(directory, ec)) {
+		return "";
+	}
+
+	std::vector<std::string> paths;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+		if (entry.path().extension() == tableFileExtension) {
+			paths.push_back(entry.path().string());
+		}
+	}
+	if (ec) {
+		return "Could not list directory " + directory + ": " + ec.message();
+	}
+	std::sort(paths.begin(), paths.end());
+
+	for (const std::string& path : paths) {
+		auto [t, err] = loadTable(path);
+		if (err != "") {
+			return err;
+		}
+		if (auto [added, addErr] = c.add(std::move(t)); addErr != "") {
+			return addErr;
+		}
+	}
+	return "";
+}
+
+}
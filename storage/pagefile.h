@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "storage.h"
+
+namespace storage {
+
+// A table file is a run of pageSize pages. Page 0 is the header:
+//
+//	magic "NSQLTAB3" | page size u32 | column count u32 | rows u64 |
+//	checkpoint lsn u64 | table name
+//
+// followed, per column, by its name, its type (0 INT, 1 TEXT), its count
+// of sealed chunks u64 and the first page and byte length of its chunk, of
+// its TEXT heap, of its zone maps and of its sealed chunks, and then by the
+// index count u32 and the name and column u32 of each index. Names are a
+// u32 length and the bytes.
+//
+// The chunk and heap hold the rows after the sealed chunks: an INT chunk
+// is their values; a TEXT chunk is their count+1 offsets into the heap,
+// which holds the text. The zone maps are, per chunkRows rows, their count
+// u64 and the bounds on their least and greatest value, as two i64 or two
+// names cut as zoneMap cuts them, so loading a table does not read every
+// row to rebuild them. The sealed chunks are the chunks as encoded in
+// memory: first a descriptor per chunk, then the arrays the descriptors
+// point at, each 8-byte aligned. An INT descriptor is
+//
+//	kind u8 | width u8 | base i64 | packed, values, ends
+//
+// and a TEXT descriptor is
+//
+//	kind u8 | text bytes u64 | offsets, chars | INT descriptor of codes
+//
+// with an array being its byte offset from the start of the sealed chunks
+// u64 and its length u64. Every chunk, heap, run of zone maps and run of
+// sealed chunks starts on a page of its own and stores values in the
+// machine's little-endian layout, so a mapped file is read in place.
+
+constexpr size_t pageSize = 64 * 1024;
+
+// tableFileExtension ends the name of every table file saveCatalog writes
+constexpr std::string_view tableFileExtension = ".table";
+
+// columnExtents locates the chunk, heap, zone maps and sealed chunks of a
+// column in a table file
+struct columnExtents {
+	std::string name;
+	columnType type;
+	uint64_t sealedChunks;
+	uint64_t chunkPage;
+	uint64_t chunkBytes;
+	uint64_t heapPage;
+	uint64_t heapBytes;
+	uint64_t zonePage;
+	uint64_t zoneBytes;
+	uint64_t sealedPage;
+	uint64_t sealedBytes;
+};
+
+// indexDefinition names an index and the column it covers; the index
+// itself is rebuilt when the table is loaded
+struct indexDefinition {
+	std::string name;
+	uint32_t column;
+};
+
+// tableLayout is what the header page of a table file holds
+struct tableLayout {
+	std::string name;
+	uint64_t rows;
+	uint64_t checkpointLsn;
+	std::vector<columnExtents> columns;
+	std::vector<indexDefinition> indexes;
+};
+
+// readLayout parses header, the first pageSize bytes of the table file at
+// path, and checks that every extent fits in its fileSize bytes and in the
+// row count
+std::tuple<tableLayout, std::string> readLayout(const char* header, uint64_t fileSize, const std::string& path);
+
+// saveTable writes t to path, replacing the file there only once the new
+// one is complete and synced. checkpointLsn is the log position t holds
+// every change up to. Sealed chunks are written as they are encoded, so
+// saving copies no column and loadTable maps them as they are.
+std::string saveTable(const table& t, const std::string& path, uint64_t checkpointLsn = 0);
+
+// loadTable maps the table file at path. The columns and their sealed
+// chunks view the mapping, so nothing is deserialized and rows are paged
+// in as queries touch them; the first append to a column copies the rows
+// after its sealed chunks into memory. Indexes are deferred: each is
+// built from the mapped columns when a query first looks it up.
+std::tuple<std::unique_ptr<table>, std::string> loadTable(const std::string& path);
+
+// saveCatalog saves every table of c to directory, as name.table
+std::string saveCatalog(const catalog& c, const std::string& directory, uint64_t checkpointLsn = 0);
+
+// loadCatalog adds the tables saved in directory to c
+std::string loadCatalog(catalog& c, const std::string& directory);
+
+}
@@ -0,0 +1,436 @@
+#include "storage.h"
+#include "btree.h"
+#include "csv.h"
+#include "../lexer/pool.h"
+#include <charconv>
+
+namespace storage {
+
+using namespace nicolassql;
+
+namespace {
+
+constexpr uint16_t intKeywordId = internedId(keywords, intKeyword);
+constexpr uint16_t textKeywordId = internedId(keywords, textKeyword);
+
+// makeRoom grows b to hold size values, at least doubling it so that
+// appends of a few rows at a time stay amortized constant
+template <typename T>
+void makeRoom(columnBuffer<T>& b, size_t size) {
+	if (b.capacity() < size) {
+		b.reserve(std::max(size, 2 * b.capacity()));
+	}
+}
+
+// truncate drops the rows of col past rows, undoing a partial append
+void truncate(column& col, size_t rows) {
+	rows -= col.sealedRows();
+	if (col.type == columnType::intType) {
+		col.ints.resize(rows);
+		return;
+	}
+	col.offsets.resize(rows + 1);
+	col.chars.resize(col.offsets.back());
+}
+
+}
+
+const int64_t* column::readInts(size_t first, size_t count, int64_t* scratch) const {
+	size_t sealed = sealedRows();
+	if (first >= sealed) {
+		return ints.data() + (first - sealed);
+	}
+	const encodedInts& chunk = intChunks[first / chunkRows];
+	if (chunk.kind == encodingKind::plainKind) {
+		return chunk.values.data() + first % chunkRows;
+	}
+	chunk.decode(first % chunkRows, count, scratch);
+	return scratch;
+}
+
+std::pair<const uint64_t*, const char*> column::readText(size_t first, size_t count,
+		std::vector<uint64_t>& scratchOffsets, std::string& scratchChars) const {
+	size_t sealed = sealedRows();
+	if (first >= sealed) {
+		return {offsets.data() + (first - sealed), chars.data()};
+	}
+	const encodedText& chunk = textChunks[first / chunkRows];
+	if (chunk.kind == encodingKind::plainKind) {
+		return {chunk.offsets.data() + first % chunkRows, chunk.chars.data()};
+	}
+	chunk.decode(first % chunkRows, count, scratchOffsets, scratchChars);
+	return {scratchOffsets.data(), scratchChars.data()};
+}
+
+void column::seal(size_t rows) {
+	size_t sealed = sealedRows();
+	if (rows < sealed + chunkRows) {
+		return;
+	}
+	// bulk loads seal many chunks at once, so they are encoded side by side
+	size_t chunks = (rows - sealed) / chunkRows;
+	size_t start = sealed / chunkRows;
+	if (type == columnType::intType) {
+		intChunks.resize(start + chunks);
+	} else {
+		textChunks.resize(start + chunks);
+	}
+	auto encode = [&](size_t k) {
+		if (type == columnType::intType) {
+			intChunks[start + k] = encodeInts(ints.begin() + k * chunkRows, chunkRows);
+		} else {
+			textChunks[start + k] = encodeText(offsets.begin() + k * chunkRows, chars.begin(), chunkRows);
+		}
+	};
+	sharedPool().parallelFor(chunks, encode);
+	size_t first = chunks * chunkRows;
+
+	// the rows left over move to the front of fresh buffers
+	if (type == columnType::intType) {
+		columnBuffer<int64_t> rest;
+		rest.append(ints.begin() + first, ints.end());
+		ints = std::move(rest);
+		return;
+	}
+	uint64_t base = offsets[first];
+	columnBuffer<uint64_t> restOffsets;
+	restOffsets.resize(offsets.size() - first);
+	uint64_t* to = restOffsets.data();
+	for (size_t i = first; i < offsets.size(); i++) {
+		to[i - first] = offsets[i] - base;
+	}
+	columnBuffer<char> restChars;
+	restChars.append(chars.begin() + base, chars.end());
+	offsets = std::move(restOffsets);
+	chars = std::move(restChars);
+}
+
+void lowerBound(std::string& bound, std::string_view value) {
+	bound.assign(value.data(), std::min(value.size(), zonePrefixBytes));
+}
+
+void upperBound(std::string& bound, std::string_view value) {
+	if (value.size() <= zonePrefixBytes) {
+		bound.assign(value.data(), value.size());
+		return;
+	}
+	// bytes compare unsigned, so a byte below 0xff can be raised
+	for (size_t i = zonePrefixBytes; i > 0; i--) {
+		if (static_cast<unsigned char>(value[i - 1]) != 0xff) {
+			bound.assign(value.data(), i);
+			bound.back() = static_cast<char>(static_cast<unsigned char>(bound.back()) + 1);
+			return;
+		}
+	}
+	// a prefix of 0xff bytes can not be raised, so the value is kept whole
+	bound.assign(value.data(), value.size());
+}
+
+void column::extendZones(size_t rows) {
+	size_t sealed = sealedRows();
+	for (size_t row = zonedRows(); row < rows;) {
+		size_t chunk = row / chunkRows;
+		size_t end = std::min(rows, (chunk + 1) * chunkRows);
+		if (type == columnType::intType) {
+			if (intZones.size() == chunk) {
+				intZones.emplace_back();
+			}
+			zoneMap<int64_t>& zone = intZones[chunk];
+			for (; row < end; row++) {
+				zone.add(ints[row - sealed]);
+			}
+			continue;
+		}
+		if (textZones.size() == chunk) {
+			textZones.emplace_back();
+		}
+		zoneMap<std::string>& zone = textZones[chunk];
+		for (; row < end; row++) {
+			zone.add(text(row));
+		}
+	}
+}
+
+table::table(std::string name, std::vector<column> columns)
+	: tableName(std::move(name)), cols(std::move(columns)) {}
+
+table::table(std::string name, std::vector<column> columns, size_t rows, uint64_t checkpointLsn,
+		std::shared_ptr<const void> backing)
+	: tableName(std::move(name)), cols(std::move(columns)), rowCount(rows), savedLsn(checkpointLsn),
+	  backing(std::move(backing)) {
+	// table files hold the zone maps of their rows, so this only covers
+	// rows a file has none for
+	for (column& col : cols) {
+		col.extendZones(rowCount);
+	}
+}
+
+table::~table() = default;
+
+std::tuple<size_t, bool> table::columnIndex(std::string_view name) const {
+	for (size_t i = 0; i < cols.size(); i++) {
+		if (cols[i].name == name) {
+			return {i, true};
+		}
+	}
+	return {0, false};
+}
+
+std::string table::appendRow(const ast::list<ast::expression>& values, const std::vector<token>& parameters) {
+	return appendRows(values, 1, parameters);
+}
+
+std::string table::appendRows(const ast::list<ast::expression>& values, size_t rows,
+		const std::vector<token>& parameters) {
+	size_t width = cols.size();
+	if (rows == 0 || values.size() != rows * width) {
+		return "Table " + tableName + " has " + std::to_string(width) +
+			" columns, got " + std::to_string(rows == 0 ? 0 : values.size() / rows) + " values";
+	}
+
+	// the values are converted a column at a time, so each loop appends to
+	// one buffer and checks one type
+	std::string err;
+	size_t i = 0;
+	for (; i < width && err.empty(); i++) {
+		column& col = cols[i];
+		bool isInt = col.type == columnType::intType;
+		if (isInt) {
+			makeRoom(col.ints, col.ints.size() + rows);
+		} else {
+			makeRoom(col.offsets, col.offsets.size() + rows);
+		}
+
+		for (size_t row = 0; row < rows; row++) {
+			const ast::expression& expr = *values[row * width + i];
+			if (expr.kind == ast::expressionKind::binaryKind) {
+				err = "Only literal values can be inserted into column " + col.name;
+				break;
+			}
+			const token* value = expr.literal;
+			if (expr.kind == ast::expressionKind::placeholderKind) {
+				if (expr.placeholder == 0 || expr.placeholder > parameters.size()) {
+					err = "Missing parameter " + std::string(expr.literal->value);
+					break;
+				}
+				value = &parameters[expr.placeholder - 1];
+			}
+
+			// literals come converted by the parser; parameters are still text
+			if (isInt && expr.type == ast::literalType::intLiteral) {
+				col.appendInt(expr.intValue);
+				continue;
+			}
+			if (!isInt && expr.type == ast::literalType::textLiteral) {
+				col.appendText(expr.text);
+				continue;
+			}
+			// INT values replayed from the log come without a token to print
+			if (value == nullptr) {
+				err = "Expected TEXT for column " + col.name + ", got " + std::to_string(expr.intValue);
+				break;
+			}
+
+			if (isInt) {
+				int64_t n = 0;
+				const char* end = value->value.data() + value->value.size();
+				auto [stop, ec] = std::from_chars(value->value.data(), end, n);
+				if (value->kind != tokenKind::numericKind || ec != std::errc() || stop != end) {
+					err = "Expected an INT for column " + col.name + ", got " + std::string(value->value);
+					break;
+				}
+				col.appendInt(n);
+				continue;
+			}
+
+			if (value->kind != tokenKind::stringKind) {
+				err = "Expected TEXT for column " + col.name + ", got " + std::string(value->value);
+				break;
+			}
+			// a bound parameter is the value itself, with no quotes to undo
+			col.appendText(value->value);
+		}
+	}
+
+	if (!err.empty()) {
+		for (size_t j = 0; j < i; j++) {
+			truncate(cols[j], rowCount);
+		}
+		return err;
+	}
+
+	rowCount += rows;
+	sealChunks();
+	for (const auto& index : tableIndexes) {
+		index->catchUp(*this);
+	}
+	return "";
+}
+
+std::string table::commitAppends() {
+	size_t rows = cols.empty() ? rowCount : cols[0].size();
+	for (const column& col : cols) {
+		if (col.size() != rows) {
+			return "Column " + col.name + " of table " + tableName + " has " +
+				std::to_string(col.size()) + " rows, expected " + std::to_string(rows);
+		}
+	}
+	rowCount = rows;
+	sealChunks();
+	for (const auto& index : tableIndexes) {
+		index->catchUp(*this);
+	}
+	return "";
+}
+
+std::tuple<tableIndex*, std::string> table::addIndex(std::string_view name, size_t column, bool deferred) {
+	for (const auto& index : tableIndexes) {
+		if (index->name() == name) {
+			return {nullptr, "Index " + std::string(name) + " already exists on table " + tableName};
+		}
+	}
+	auto index = std::make_unique<tableIndex>(std::string(name), column, cols[column].type, deferred);
+	index->catchUp(*this);
+	tableIndexes.push_back(std::move(index));
+	return {tableIndexes.back().get(), ""};
+}
+
+const tableIndex* table::indexOn(size_t column) const {
+	for (const auto& index : tableIndexes) {
+		if (index->column() == column) {
+			index->build(*this);
+			return index.get();
+		}
+	}
+	return nullptr;
+}
+
+void table::reserve(size_t rows, size_t textBytes) {
+	for (column& col : cols) {
+		if (col.type == columnType::intType) {
+			col.ints.reserve(col.ints.size() + rows);
+			continue;
+		}
+		col.offsets.reserve(col.offsets.size() + rows);
+		col.chars.reserve(col.chars.size() + rows * textBytes);
+	}
+}
+
+void table::sealChunks() {
+	for (column& col : cols) {
+		col.extendZones(rowCount);
+		col.seal(rowCount);
+	}
+}
+
+void table::countChunk(bool skipped) const {
+	(skipped ? chunksSkipped : chunksRead).fetch_add(1, std::memory_order_relaxed);
+}
+
+zoneStats table::zones() const {
+	return zoneStats{
+		.chunksSkipped = chunksSkipped.load(std::memory_order_relaxed),
+		.chunksRead = chunksRead.load(std::memory_order_relaxed),
+	};
+}
+
+size_t table::bytes() const {
+	size_t total = 0;
+	for (const column& col : cols) {
+		total += col.bytes();
+	}
+	return total;
+}
+
+std::tuple<table*, std::string> catalog::createTable(const ast::CreateTableStatement& stmt) {
+	std::string name(stmt.name.value);
+	if (byName.find(name) != byName.end()) {
+		return {nullptr, "Table " + name + " already exists"};
+	}
+
+	std::vector<column> columns;
+	columns.reserve(stmt.cols->size());
+	for (const ast::columnDefinition* def : *stmt.cols) {
+		for (const column& existing : columns) {
+			if (existing.name == def->name.value) {
+				return {nullptr, "Column " + existing.name + " is defined twice"};
+			}
+		}
+
+		columnType type;
+		switch (def->datatype.id) {
+		case intKeywordId:
+			type = columnType::intType;
+			break;
+		case textKeywordId:
+			type = columnType::textType;
+			break;
+		default:
+			return {nullptr, "Unknown type " + std::string(def->datatype.value) +
+				" for column " + std::string(def->name.value)};
+		}
+
+		columns.push_back(column{
+			.name = std::string(def->name.value),
+			.type = type,
+		});
+	}
+
+	return add(std::make_unique<table>(name, std::move(columns)));
+}
+
+std::tuple<table*, std::string> catalog::add(std::unique_ptr<table> t) {
+	if (byName.find(t->name()) != byName.end()) {
+		return {nullptr, "Table " + t->name() + " already exists"};
+	}
+	table* added = t.get();
+	byName.emplace(t->name(), std::move(t));
+	return {added, ""};
+}
+
+std::tuple<tableIndex*, std::string> catalog::createIndex(const ast::CreateIndexStatement& stmt) {
+	table* t = find(stmt.table.value);
+	if (t == nullptr) {
+		return {nullptr, "Table " + std::string(stmt.table.value) + " does not exist"};
+	}
+	auto [column, found] = t->columnIndex(stmt.column.value);
+	if (!found) {
+		return {nullptr, "Column " + std::string(stmt.column.value) + " does not exist in table " + t->name()};
+	}
+	return t->addIndex(stmt.name.value, column);
+}
+
+std::tuple<size_t, std::string> catalog::copy(const ast::CopyStatement& stmt) {
+	table* t = find(stmt.table.value);
+	if (t == nullptr) {
+		return {0, "Table " + std::string(stmt.table.value) + " does not exist"};
+	}
+	return copyFromCsv(*t, std::string(stmt.file));
+}
+
+std::string catalog::insert(const ast::InsertStatement& stmt, const std::vector<token>& parameters) {
+	table* t = find(stmt.table.value);
+	if (t == nullptr) {
+		return "Table " + std::string(stmt.table.value) + " does not exist";
+	}
+	return t->appendRows(*stmt.values, stmt.rows, parameters);
+}
+
+table* catalog::find(std::string_view name) const {
+	auto found = byName.find(name);
+	if (found == byName.end()) {
+		return nullptr;
+	}
+	return found->second.get();
+}
+
+std::vector<table*> catalog::list() const {
+	std::vector<table*> tables;
+	tables.reserve(byName.size());
+	for (const auto& [name, t] : byName) {
+		tables.push_back(t.get());
+	}
+	return tables;
+}
+
+}
@@ -0,0 +1,271 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "../ast/ast.h"
+#include "buffer.h"
+#include "encoding.h"
+
+namespace storage {
+
+class tableIndex;
+
+enum class columnType : uint8_t {
+	intType = 0,
+	textType,
+};
+
+// zonePrefixBytes bounds the TEXT bounds of a zone map, so long values
+// cost neither an allocation per new least or greatest value nor their
+// whole length in every zone map of a table file
+constexpr size_t zonePrefixBytes = 32;
+
+// lowerBound and upperBound set bound to value. A TEXT bound keeps at most
+// zonePrefixBytes bytes: a cut lower bound is the prefix, which sorts no
+// later than value, and a cut upper bound has its last byte that can be
+// raised raised, which sorts after value.
+inline void lowerBound(int64_t& bound, int64_t value) { bound = value; }
+inline void upperBound(int64_t& bound, int64_t value) { bound = value; }
+void lowerBound(std::string& bound, std::string_view value);
+void upperBound(std::string& bound, std::string_view value);
+
+// zoneMap sums up the values of one chunk of a column: how many rows it
+// holds and bounds on the least and greatest of their values, so that a
+// scan can tell that no row of the chunk satisfies a filter without
+// reading it. INT bounds are the values themselves. Values are never NULL,
+// so there are no nulls to count.
+template <typename T>
+struct zoneMap {
+	size_t rows = 0;
+	T low{};
+	T high{};
+
+	template <typename V>
+	void add(const V& value) {
+		if (rows == 0 || value < low) {
+			lowerBound(low, value);
+		}
+		if (rows == 0 || high < value) {
+			upperBound(high, value);
+		}
+		rows++;
+	}
+};
+
+// column holds the values of one table column. The first sealedRows()
+// rows are in sealed chunks, intChunks or textChunks, chunkRows rows each;
+// the rows after them are kept contiguously. INT values live in ints; TEXT
+// values are packed back to back in chars, value i spanning offsets[i] to
+// offsets[i+1], so a cell costs its bytes plus one offset rather than a
+// std::string. Columns that are not part of a table, such as those of a
+// query result, are never sealed, and ints, offsets and chars hold every
+// row. intZones or textZones hold a zone map per chunk of a table
+// column's rows, the last covering however many rows its chunk holds so
+// far, whether or not the chunk is sealed.
+struct column {
+	std::string name;
+	columnType type;
+
+	columnBuffer<int64_t> ints;
+	columnBuffer<uint64_t> offsets{0};
+	columnBuffer<char> chars;
+
+	std::vector<encodedInts> intChunks;
+	std::vector<encodedText> textChunks;
+
+	std::vector<zoneMap<int64_t>> intZones;
+	std::vector<zoneMap<std::string>> textZones;
+
+	size_t sealedRows() const {
+		return (type == columnType::intType ? intChunks.size() : textChunks.size()) * chunkRows;
+	}
+
+	size_t size() const {
+		return sealedRows() + (type == columnType::intType ? ints.size() : offsets.size() - 1);
+	}
+
+	// zonedRows is the number of rows the zone maps cover
+	size_t zonedRows() const {
+		size_t zones = type == columnType::intType ? intZones.size() : textZones.size();
+		if (zones == 0) {
+			return 0;
+		}
+		return (zones - 1) * chunkRows + (type == columnType::intType ? intZones.back().rows : textZones.back().rows);
+	}
+
+	int64_t intAt(size_t row) const {
+		size_t sealed = intChunks.size() * chunkRows;
+		return row < sealed ? intChunks[row / chunkRows].at(row % chunkRows) : ints[row - sealed];
+	}
+
+	std::string_view text(size_t row) const {
+		size_t sealed = textChunks.size() * chunkRows;
+		if (row < sealed) {
+			return textChunks[row / chunkRows].at(row % chunkRows);
+		}
+		row -= sealed;
+		return std::string_view(chars.data() + offsets[row], offsets[row+1] - offsets[row]);
+	}
+
+	// readInts points at the count values from row first on, which must
+	// not span the end of a sealed chunk. Values of an encoded chunk are
+	// decoded into scratch, which has room for count of them.
+	const int64_t* readInts(size_t first, size_t count, int64_t* scratch) const;
+
+	// readText is readInts for TEXT: it returns the offsets, count+1 of
+	// them, and the chars of the values, decoding into offsets and chars
+	std::pair<const uint64_t*, const char*> readText(size_t first, size_t count, std::vector<uint64_t>& offsets,
+		std::string& chars) const;
+
+	// seal encodes the first rows rows into chunks, as many whole chunks
+	// as they make, and takes them out of ints, offsets and chars
+	void seal(size_t rows);
+
+	// extendZones adds the rows from zonedRows() up to rows to the zone
+	// maps. None of them may be sealed yet.
+	void extendZones(size_t rows);
+
+	void appendInt(int64_t value) { ints.push_back(value); }
+
+	void appendText(std::string_view value) {
+		chars.append(value.data(), value.data() + value.size());
+		offsets.push_back(chars.size());
+	}
+
+	// bytes is the memory the column's values take up
+	size_t bytes() const {
+		size_t sealed = 0;
+		for (const encodedInts& chunk : intChunks) {
+			sealed += chunk.bytes();
+		}
+		for (const encodedText& chunk : textChunks) {
+			sealed += chunk.bytes();
+		}
+		return sealed + ints.capacity() * sizeof(int64_t) + offsets.capacity() * sizeof(uint64_t) + chars.capacity();
+	}
+};
+
+// zoneStats counts the chunks of a table that scans with a filter skipped
+// because the zone maps ruled the filter out, and those they read
+struct zoneStats {
+	uint64_t chunksSkipped = 0;
+	uint64_t chunksRead = 0;
+};
+
+class table {
+public:
+	table(std::string name, std::vector<column> columns);
+
+	// a table loaded from a file holds rows rows already, and backing keeps
+	// the memory its columns view alive
+	table(std::string name, std::vector<column> columns, size_t rows, uint64_t checkpointLsn,
+		std::shared_ptr<const void> backing);
+	~table();
+
+	table(const table&) = delete;
+	table& operator=(const table&) = delete;
+
+	const std::string& name() const { return tableName; }
+	const std::vector<column>& columns() const { return cols; }
+	std::vector<column>& columns() { return cols; }
+	size_t rows() const { return rowCount; }
+
+	// checkpointLsn is the log position the table was saved at; it holds the
+	// changes of every log record up to there
+	uint64_t checkpointLsn() const { return savedLsn; }
+
+	// columnIndex returns the position of the column called name
+	std::tuple<size_t, bool> columnIndex(std::string_view name) const;
+
+	// appendRow converts values to the column types and appends them as
+	// one row, leaving the table as it was on error. Placeholders are
+	// resolved from parameters, $1 being parameters[0].
+	std::string appendRow(const ast::list<ast::expression>& values,
+		const std::vector<nicolassql::token>& parameters = {});
+
+	// appendRows appends rows rows whose values lie back to back in values,
+	// like appendRow but a column at a time and all or nothing. Indexes
+	// catch up once at the end.
+	std::string appendRows(const ast::list<ast::expression>& values, size_t rows,
+		const std::vector<nicolassql::token>& parameters = {});
+
+	// commitAppends makes rows appended straight to the columns part of
+	// the table, for bulk loads that skip appendRow. Every column must have
+	// grown by the same number of rows.
+	std::string commitAppends();
+
+	// addIndex indexes column under name, which no other index of the
+	// table may use, and keeps the index up to date as rows are appended.
+	// A deferred index is built by the first indexOn that returns it.
+	std::tuple<tableIndex*, std::string> addIndex(std::string_view name, size_t column, bool deferred = false);
+
+	// indexes returns the indexes of the table in the order they were added
+	const std::vector<std::unique_ptr<tableIndex>>& indexes() const { return tableIndexes; }
+
+	// indexOn returns an index over column, built if it was deferred, or
+	// nullptr
+	const tableIndex* indexOn(size_t column) const;
+
+	// reserve makes room for rows more rows of about textBytes of TEXT each
+	void reserve(size_t rows, size_t textBytes = 0);
+
+	// countChunk records that a scan skipped or read a chunk; zones returns
+	// the counts so far, across every scan of the table
+	void countChunk(bool skipped) const;
+	zoneStats zones() const;
+
+	size_t bytes() const;
+
+private:
+	// sealChunks extends the zone maps of every column over the rows
+	// appended and then encodes the rows that fill whole chunks
+	void sealChunks();
+
+	std::string tableName;
+	std::vector<column> cols;
+	size_t rowCount = 0;
+	uint64_t savedLsn = 0;
+	std::shared_ptr<const void> backing;
+	std::vector<std::unique_ptr<tableIndex>> tableIndexes;
+	mutable std::atomic<uint64_t> chunksSkipped{0};
+	mutable std::atomic<uint64_t> chunksRead{0};
+};
+
+// catalog owns the tables of a database, keyed by name
+class catalog {
+public:
+	std::tuple<table*, std::string> createTable(const ast::CreateTableStatement& stmt);
+
+	// createIndex indexes the column stmt names
+	std::tuple<tableIndex*, std::string> createIndex(const ast::CreateIndexStatement& stmt);
+
+	// copy appends the rows of the CSV file stmt names to its table, see
+	// copyFromCsv, and returns how many there were
+	std::tuple<size_t, std::string> copy(const ast::CopyStatement& stmt);
+
+	// insert appends the rows of stmt to its table
+	std::string insert(const ast::InsertStatement& stmt,
+		const std::vector<nicolassql::token>& parameters = {});
+
+	// add takes over t, which must not share its name with another table
+	std::tuple<table*, std::string> add(std::unique_ptr<table> t);
+
+	// find returns the table called name, or nullptr
+	table* find(std::string_view name) const;
+
+	// list returns every table, ordered by name
+	std::vector<table*> list() const;
+
+	size_t size() const { return byName.size(); }
+
+private:
+	std::map<std::string, std::unique_ptr<table>, std::less<>> byName;
+};
+
+}
@@ -0,0 +1,316 @@
+#include <benchmark/benchmark.h>
+#include "storage.h"
+#include "bufferpool.h"
+#include "pagefile.h"
+#include "csv.h"
+#include "../parser/parser.h"
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+using namespace storage;
+
+// eventsScript is a bulk load of rows with two INT and two TEXT columns
+static std::string eventsScript(int rows) {
+    std::string script = "CREATE TABLE events (id INT, kind TEXT, payload TEXT, at INT);\n";
+    for (int i = 0; i < rows; i++) {
+        script += "INSERT INTO events VALUES (" + std::to_string(i) + ", 'click', 'user " +
+            std::to_string(i % 1000) + " opened page " + std::to_string(i % 37) + "', " +
+            std::to_string(1700000000 + i) + ");\n";
+    }
+    return script;
+}
+
+// BM_Ingest appends already parsed INSERTs to a fresh table, the cost of
+// the storage layer alone
+static void BM_Ingest(benchmark::State& state) {
+    int rows = static_cast<int>(state.range(0));
+    auto [a, err] = parser::Parse(eventsScript(rows));
+    if (!err.empty()) {
+        state.SkipWithError(err.c_str());
+        return;
+    }
+
+    size_t rawBytes = 0;
+    size_t storedBytes = 0;
+    for (auto _ : state) {
+        catalog c;
+        for (auto* stmt : a->Statements) {
+            if (stmt->Kind == ast::AstKind::CreateTableKind) {
+                c.createTable(*stmt->CreateTableStatement);
+                continue;
+            }
+            c.insert(*stmt->InsertStatement);
+        }
+
+        table* events = c.find("events");
+        storedBytes = events->bytes();
+        rawBytes = 0;
+        for (const column& col : events->columns()) {
+            for (size_t row = 0; row < events->rows(); row++) {
+                rawBytes += col.type == columnType::intType ? sizeof(int64_t) : col.text(row).size();
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+    state.counters["bytes/row"] = static_cast<double>(storedBytes) / rows;
+    state.counters["raw bytes/row"] = static_cast<double>(rawBytes) / rows;
+}
+
+BENCHMARK(BM_Ingest)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+constexpr int literalRows = 100000;
+
+// BM_InsertLiterals runs already parsed single-row INSERTs like BM_Ingest,
+// reading the values the parser converted when converted is set and
+// converting their tokens on every insert, as before, when it is not
+static void BM_InsertLiterals(benchmark::State& state) {
+    auto [a, err] = parser::Parse(eventsScript(literalRows));
+    if (!err.empty()) {
+        state.SkipWithError(err.c_str());
+        return;
+    }
+    if (state.range(0) == 0) {
+        for (auto* stmt : a->Statements) {
+            if (stmt->Kind == ast::AstKind::InsertKind) {
+                for (auto* value : *stmt->InsertStatement->values) {
+                    value->type = ast::literalType::noLiteral;
+                }
+            }
+        }
+    }
+
+    for (auto _ : state) {
+        catalog c;
+        for (auto* stmt : a->Statements) {
+            if (stmt->Kind == ast::AstKind::CreateTableKind) {
+                c.createTable(*stmt->CreateTableStatement);
+                continue;
+            }
+            c.insert(*stmt->InsertStatement);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * literalRows);
+}
+
+BENCHMARK(BM_InsertLiterals)->ArgName("converted")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+constexpr int bulkRows = 200000;
+
+// BM_BulkInsert parses and runs a load of bulkRows rows written as INSERTs
+// of rows_per_statement rows each, into a table indexed on id when indexed
+// is set
+static void BM_BulkInsert(benchmark::State& state) {
+    int perStatement = static_cast<int>(state.range(0));
+    std::string script = "CREATE TABLE events (id INT, kind TEXT, payload TEXT, at INT);\n";
+    if (state.range(1) != 0) {
+        script += "CREATE INDEX by_id ON events (id);\n";
+    }
+    for (int i = 0; i < bulkRows; i++) {
+        script += i % perStatement == 0 ? "INSERT INTO events VALUES " : ", ";
+        script += "(" + std::to_string(i * 7919 % bulkRows) + ", 'click', 'user " + std::to_string(i % 1000) +
+            " opened page " + std::to_string(i % 37) + "', " + std::to_string(1700000000 + i) + ")";
+        if (i % perStatement == perStatement - 1 || i == bulkRows - 1) {
+            script += ";\n";
+        }
+    }
+
+    for (auto _ : state) {
+        auto [a, err] = parser::Parse(script);
+        catalog c;
+        for (auto* stmt : a->Statements) {
+            std::string stmtErr;
+            switch (stmt->Kind) {
+            case ast::AstKind::CreateTableKind:
+                stmtErr = std::get<1>(c.createTable(*stmt->CreateTableStatement));
+                break;
+            case ast::AstKind::CreateIndexKind:
+                stmtErr = std::get<1>(c.createIndex(*stmt->CreateIndexStatement));
+                break;
+            default:
+                stmtErr = c.insert(*stmt->InsertStatement);
+            }
+            if (!stmtErr.empty()) {
+                state.SkipWithError(stmtErr.c_str());
+                return;
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * bulkRows);
+}
+
+BENCHMARK(BM_BulkInsert)
+    ->ArgNames({"rows_per_statement", "indexed"})
+    ->ArgsProduct({{1, 1000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+constexpr int copyRows = 1000000;
+
+// copyFile is eventsScript's rows as CSV, written once per process
+static const std::string& copyFile() {
+    static const std::string path = [] {
+        std::string file = (std::filesystem::temp_directory_path() /
+            ("nicolassql_copy_bench_" + std::to_string(::getpid()) + ".csv")).string();
+        std::ofstream out(file, std::ios::binary);
+        for (int i = 0; i < copyRows; i++) {
+            out << i << ",click,\"user " << i % 1000 << " opened page " << i % 37 << "\"," << 1700000000 + i << "\n";
+        }
+        return file;
+    }();
+    static const bool removeAtExit = std::atexit([] { std::filesystem::remove(path); }) == 0;
+    (void)removeAtExit;
+    return path;
+}
+
+// BM_CopyCsv loads copyFile into a fresh table with the given number of
+// threads; bytes/s counts the CSV
+static void BM_CopyCsv(benchmark::State& state) {
+    const std::string& path = copyFile();
+    auto [a, err] = parser::Parse("CREATE TABLE events (id INT, kind TEXT, payload TEXT, at INT)");
+    for (auto _ : state) {
+        catalog c;
+        auto [t, createErr] = c.createTable(*a->Statements[0]->CreateTableStatement);
+        auto [rows, copyErr] = copyFromCsv(*t, path, csvOptions{.threads = static_cast<size_t>(state.range(0))});
+        if (!copyErr.empty()) {
+            state.SkipWithError(copyErr.c_str());
+            return;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(std::filesystem::file_size(path)));
+    state.SetItemsProcessed(state.iterations() * copyRows);
+}
+
+// BM_InsertScript loads the same rows from eventsScript, lexing, parsing
+// and inserting one INSERT per row; bytes/s counts the script
+static void BM_InsertScript(benchmark::State& state) {
+    std::string script = eventsScript(copyRows);
+    for (auto _ : state) {
+        auto [a, err] = parser::Parse(script);
+        catalog c;
+        for (auto* stmt : a->Statements) {
+            if (stmt->Kind == ast::AstKind::CreateTableKind) {
+                c.createTable(*stmt->CreateTableStatement);
+                continue;
+            }
+            c.insert(*stmt->InsertStatement);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(script.size()));
+    state.SetItemsProcessed(state.iterations() * copyRows);
+}
+
+BENCHMARK(BM_CopyCsv)->ArgName("threads")->Arg(1)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_InsertScript)->Unit(benchmark::kMillisecond);
+
+constexpr size_t poolFrames = 256;
+
+// scanFile is a table file four times the size of a pool of poolFrames
+// frames, with two INT columns of scrambled values that stay plain when
+// sealed, written once per process
+static const std::string& scanFile() {
+    static const std::string path = [] {
+        std::string file = (std::filesystem::temp_directory_path() /
+            ("nicolassql_pool_bench_" + std::to_string(::getpid()))).string();
+        size_t rows = 4 * poolFrames * pageSize / (2 * sizeof(int64_t));
+        catalog c;
+        auto [a, err] = parser::Parse("CREATE TABLE wide (a INT, b INT)");
+        auto [t, createErr] = c.createTable(*a->Statements[0]->CreateTableStatement);
+        for (size_t i = 0; i < rows; i++) {
+            t->columns()[0].appendInt(static_cast<int64_t>(i * 0x9e3779b97f4a7c15));
+            t->columns()[1].appendInt(static_cast<int64_t>((i + 1) * 0xbf58476d1ce4e5b9));
+        }
+        t->commitAppends();
+        saveTable(*t, file);
+        return file;
+    }();
+    // registered after path is built, so it runs before path is destroyed
+    static const bool removeAtExit = std::atexit([] {
+        std::filesystem::remove(path);
+        std::filesystem::remove(path + ".hot");
+    }) == 0;
+    (void)removeAtExit;
+    return path;
+}
+
+static std::unique_ptr<bufferPool> sharedPool;
+static fileId scanned;
+static fileId hot;
+
+// BM_PoolScan has every thread sum both columns of a table four times the
+// pool size, page by page through a shared pool. range(0) picks CLOCK or
+// LRU-K; with range(1) set each scanned page is followed by a lookup in a
+// small hot file, the pages a policy should keep through the scans.
+static void BM_PoolScan(benchmark::State& state) {
+    const std::string& path = scanFile();
+    uint64_t fileSize = std::filesystem::file_size(path);
+    bool withHot = state.range(1) != 0;
+    if (state.thread_index() == 0) {
+        sharedPool = std::make_unique<bufferPool>(poolOptions{
+            .frames = poolFrames,
+            .policy = state.range(0) == 0 ? evictionPolicy::clockPolicy : evictionPolicy::lruKPolicy,
+        });
+        scanned = std::get<0>(sharedPool->openFile(path));
+        hot = std::get<0>(sharedPool->openFile(path + ".hot"));
+    }
+
+    int64_t sum = 0;
+    uint64_t hotLookups = 0;
+    for (auto _ : state) {
+        auto [header, err] = sharedPool->pin(scanned, 0);
+        auto [layout, layoutErr] = readLayout(header.data(), fileSize, path);
+        header.release();
+        if (!err.empty() || !layoutErr.empty()) {
+            state.SkipWithError((err + layoutErr).c_str());
+            break;
+        }
+        std::vector<std::pair<uint64_t, uint64_t>> extents;
+        for (const columnExtents& col : layout.columns) {
+            extents.emplace_back(col.sealedPage, col.sealedBytes);
+            extents.emplace_back(col.chunkPage, col.chunkBytes);
+        }
+        for (auto [first, bytes] : extents) {
+            for (uint64_t offset = 0; offset < bytes; offset += pageSize) {
+                auto [page, pinErr] = sharedPool->pin(scanned, first + offset / pageSize);
+                size_t values = std::min<uint64_t>(pageSize, bytes - offset) / sizeof(int64_t);
+                for (size_t i = 0; i < values; i++) {
+                    int64_t value;
+                    std::memcpy(&value, page.data() + i * sizeof(int64_t), sizeof(value));
+                    sum += value;
+                }
+                if (withHot) {
+                    auto [hotPage, hotErr] = sharedPool->pin(hot, hotLookups++ % 32);
+                    sum += hotPage.data()[0];
+                }
+            }
+        }
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(fileSize));
+
+    if (state.thread_index() == 0) {
+        poolStats stats = sharedPool->stats();
+        state.counters["hit_rate"] = stats.hitRate();
+        state.counters["evictions"] = static_cast<double>(stats.evictions);
+        sharedPool.reset();
+    }
+}
+
+static void poolScanArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"lru_k", "hot"});
+    for (int policy : {0, 1}) {
+        for (int withHot : {0, 1}) {
+            b->Args({policy, withHot});
+        }
+    }
+    b->ThreadRange(1, 8);
+    b->UseRealTime();
+    b->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK(BM_PoolScan)->Apply(poolScanArgs);
+
+BENCHMARK_MAIN();
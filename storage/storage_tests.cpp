@@ -0,0 +1,878 @@
+#include <gtest/gtest.h>
+#include "storage.h"
+#include "pagefile.h"
+#include "bufferpool.h"
+#include "btree.h"
+#include "csv.h"
+#include "../parser/parser.h"
+#include "../parser/prepare.h"
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+using namespace storage;
+using namespace nicolassql;
+
+// run executes the CREATE TABLE, CREATE INDEX and INSERT statements of
+// script against c
+static std::string run(catalog& c, const std::string& script) {
+    auto [a, err] = parser::Parse(script);
+    if (!err.empty()) {
+        return err;
+    }
+    for (auto* stmt : a->Statements) {
+        std::string stmtErr;
+        switch (stmt->Kind) {
+        case ast::AstKind::CreateTableKind:
+            stmtErr = std::get<1>(c.createTable(*stmt->CreateTableStatement));
+            break;
+        case ast::AstKind::CreateIndexKind:
+            stmtErr = std::get<1>(c.createIndex(*stmt->CreateIndexStatement));
+            break;
+        case ast::AstKind::CopyKind:
+            stmtErr = std::get<1>(c.copy(*stmt->CopyStatement));
+            break;
+        case ast::AstKind::InsertKind:
+            stmtErr = c.insert(*stmt->InsertStatement);
+            break;
+        default:
+            stmtErr = "unexpected statement";
+        }
+        if (!stmtErr.empty()) {
+            return stmtErr;
+        }
+    }
+    return "";
+}
+
+TEST(StorageTest, StoresRowsAsColumns) {
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE users (id INT, name TEXT);"
+                     "INSERT INTO users VALUES (1, 'ann');"
+                     "INSERT INTO users VALUES (22, 'it''s bob');"
+                     "INSERT INTO users VALUES (333, '')"), "");
+
+    table* users = c.find("users");
+    ASSERT_NE(users, nullptr);
+    EXPECT_EQ(users->rows(), 3u);
+
+    const column& id = users->columns()[0];
+    EXPECT_EQ(id.type, columnType::intType);
+    EXPECT_EQ(id.ints, (std::vector<int64_t>{1, 22, 333}));
+
+    const column& name = users->columns()[1];
+    EXPECT_EQ(name.type, columnType::textType);
+    EXPECT_EQ(name.text(0), "ann");
+    EXPECT_EQ(name.text(1), "it's bob");
+    EXPECT_EQ(name.text(2), "");
+    // one character buffer and one offset per row, nothing per cell
+    EXPECT_EQ(name.chars.size(), 11u);
+    EXPECT_EQ(name.offsets, (std::vector<uint64_t>{0, 3, 11, 11}));
+
+    auto [index, ok] = users->columnIndex("name");
+    EXPECT_TRUE(ok);
+    EXPECT_EQ(index, 1u);
+    EXPECT_FALSE(std::get<1>(users->columnIndex("age")));
+}
+
+TEST(StorageTest, RejectsBadRowsWithoutPartialAppends) {
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE users (id INT, name TEXT, age INT);"
+                     "INSERT INTO users VALUES (1, 'ann', 30)"), "");
+
+    EXPECT_EQ(run(c, "CREATE TABLE users (id INT)"), "Table users already exists");
+    EXPECT_EQ(run(c, "CREATE TABLE t (a INT, a TEXT)"), "Column a is defined twice");
+    EXPECT_EQ(run(c, "INSERT INTO nobody VALUES (1)"), "Table nobody does not exist");
+    EXPECT_EQ(run(c, "INSERT INTO users VALUES (1, 'ann')"), "Table users has 3 columns, got 2 values");
+    EXPECT_EQ(run(c, "INSERT INTO users VALUES (2, 'bob', 1.5)"), "Expected an INT for column age, got 1.5");
+    EXPECT_EQ(run(c, "INSERT INTO users VALUES (2, 3, 4)"), "Expected TEXT for column name, got 3");
+    EXPECT_EQ(run(c, "INSERT INTO users VALUES (2, 'bob', 1 = 1)"), "Only literal values can be inserted into column age");
+
+    table* users = c.find("users");
+    EXPECT_EQ(users->rows(), 1u);
+    for (const column& col : users->columns()) {
+        EXPECT_EQ(col.size(), 1u) << col.name;
+    }
+    EXPECT_EQ(users->columns()[1].chars.size(), 3u);
+}
+
+TEST(StorageTest, InsertsManyRowsAtOnce) {
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE users (id INT, name TEXT);"
+                     "CREATE INDEX by_id ON users (id);"
+                     "INSERT INTO users VALUES (3, 'ann'), (1, 'it''s bob'), (2, '')"), "");
+    table* users = c.find("users");
+    EXPECT_EQ(users->rows(), 3u);
+    EXPECT_EQ(users->columns()[0].ints, (std::vector<int64_t>{3, 1, 2}));
+    EXPECT_EQ(users->columns()[1].text(1), "it's bob");
+    EXPECT_EQ(users->columns()[1].text(2), "");
+    EXPECT_EQ(users->indexOn(0)->size(), 3u);
+
+    // a bad value anywhere leaves every row out
+    EXPECT_EQ(run(c, "INSERT INTO users VALUES (4, 'eve'), (5, 6)"), "Expected TEXT for column name, got 6");
+    EXPECT_EQ(run(c, "INSERT INTO users VALUES (4, 'eve'), ('x', 'y')"), "Expected an INT for column id, got x");
+    EXPECT_EQ(users->rows(), 3u);
+    for (const column& col : users->columns()) {
+        EXPECT_EQ(col.size(), 3u) << col.name;
+    }
+    EXPECT_EQ(users->indexOn(0)->size(), 3u);
+}
+
+TEST(StorageTest, InsertsBoundParameters) {
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE users (id INT, name TEXT)"), "");
+
+    auto [prepared, err] = parser::prepare("INSERT INTO users VALUES ($1, $2)");
+    ASSERT_TRUE(err.empty()) << err;
+    auto [bound, bindErr] = parser::bind(prepared, {parser::numericParameter("7"), parser::stringParameter("eve")});
+    ASSERT_TRUE(bindErr.empty()) << bindErr;
+
+    EXPECT_EQ(c.insert(*bound.statement().InsertStatement, bound.parameters), "");
+    EXPECT_EQ(c.insert(*bound.statement().InsertStatement), "Missing parameter $1");
+
+    table* users = c.find("users");
+    ASSERT_EQ(users->rows(), 1u);
+    EXPECT_EQ(users->columns()[0].ints[0], 7);
+    EXPECT_EQ(users->columns()[1].text(0), "eve");
+
+    // a parameter is stored as given: its quotes are not literal escapes
+    for (const char* name : {"O'Brien", "it''s"}) {
+        auto [quoted, quotedErr] = parser::bind(prepared, {parser::numericParameter("8"), parser::stringParameter(name)});
+        ASSERT_TRUE(quotedErr.empty()) << quotedErr;
+        EXPECT_EQ(c.insert(*quoted.statement().InsertStatement, quoted.parameters), "");
+        EXPECT_EQ(users->columns()[1].text(users->rows() - 1), name);
+    }
+}
+
+TEST(StorageTest, CommitsBulkAppends) {
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE users (id INT, name TEXT)"), "");
+    table* users = c.find("users");
+
+    users->columns()[0].appendInt(1);
+    users->columns()[0].appendInt(2);
+    users->columns()[1].appendText("ann");
+    EXPECT_EQ(users->commitAppends(), "Column name of table users has 1 rows, expected 2");
+    EXPECT_EQ(users->rows(), 0u);
+
+    users->columns()[1].appendText("bob");
+    EXPECT_EQ(users->commitAppends(), "");
+    EXPECT_EQ(users->rows(), 2u);
+}
+
+TEST(EncodingTest, ChunksRoundTrip) {
+    std::mt19937_64 rng(5);
+    struct intCase {
+        const char* name;
+        encodingKind kind;
+        std::function<int64_t(size_t)> value;
+    };
+    std::vector<intCase> intCases = {
+        {"ids", encodingKind::frameKind, [](size_t i) { return static_cast<int64_t>(i) + 1000000; }},
+        {"negative", encodingKind::frameKind, [&](size_t) { return static_cast<int64_t>(rng() % 5000) - 2500; }},
+        {"constant", encodingKind::runKind, [](size_t) { return int64_t{-7}; }},
+        {"runs", encodingKind::runKind, [](size_t i) { return static_cast<int64_t>(i / 1000) * 1000003; }},
+        {"wide", encodingKind::plainKind, [&](size_t) { return static_cast<int64_t>(rng()); }},
+        {"extremes", encodingKind::plainKind, [](size_t i) { return i % 2 ? INT64_MAX : INT64_MIN; }},
+    };
+    for (const intCase& c : intCases) {
+        std::vector<int64_t> values(chunkRows);
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = c.value(i);
+        }
+        encodedInts chunk = encodeInts(values.data(), values.size());
+        EXPECT_EQ(chunk.kind, c.kind) << c.name;
+        EXPECT_LE(chunk.bytes(), values.size() * sizeof(int64_t)) << c.name;
+        for (size_t i = 0; i < values.size(); i++) {
+            ASSERT_EQ(chunk.at(i), values[i]) << c.name << " row " << i;
+        }
+        std::vector<int64_t> decoded(777);
+        chunk.decode(12345, decoded.size(), decoded.data());
+        EXPECT_TRUE(std::equal(decoded.begin(), decoded.end(), values.begin() + 12345)) << c.name;
+    }
+
+    // a few distinct values make a dictionary whose codes order like them
+    column states{.name = "state", .type = columnType::textType};
+    column notes{.name = "note", .type = columnType::textType};
+    const char* names[] = {"open", "closed", "", "pending", "on hold"};
+    for (size_t i = 0; i < chunkRows; i++) {
+        states.appendText(names[rng() % 5]);
+        notes.appendText("note " + std::to_string(rng()));
+    }
+    encodedText dictionary = encodeText(states.offsets.data(), states.chars.data(), chunkRows);
+    ASSERT_EQ(dictionary.kind, encodingKind::dictionaryKind);
+    ASSERT_EQ(dictionary.entries(), 5u);
+    EXPECT_EQ(dictionary.entry(0), "");
+    EXPECT_EQ(dictionary.entry(4), "pending");
+    EXPECT_EQ(dictionary.textBytes, states.chars.size());
+    EXPECT_LT(dictionary.bytes(), states.bytes() / 10);
+    encodedText plain = encodeText(notes.offsets.data(), notes.chars.data(), chunkRows);
+    EXPECT_EQ(plain.kind, encodingKind::plainKind);
+    for (size_t i = 0; i < chunkRows; i++) {
+        ASSERT_EQ(dictionary.at(i), states.text(i)) << i;
+        ASSERT_EQ(plain.at(i), notes.text(i)) << i;
+    }
+    std::vector<uint64_t> offsets;
+    std::string chars;
+    dictionary.decode(100, 50, offsets, chars);
+    ASSERT_EQ(offsets.size(), 51u);
+    for (size_t i = 0; i < 50; i++) {
+        EXPECT_EQ(chars.substr(offsets[i], offsets[i + 1] - offsets[i]), states.text(100 + i));
+    }
+}
+
+// scanAll collects the rows tree holds between low and high
+template <typename Keys, typename KeyView>
+static std::vector<uint64_t> scanAll(const bplusTree<Keys>& tree, bound<KeyView> low, bound<KeyView> high) {
+    std::vector<uint64_t> rows;
+    tree.scan(low, high, [&](uint64_t row) {
+        rows.push_back(row);
+        return true;
+    });
+    return rows;
+}
+
+TEST(BTreeTest, IntKeysMatchSortedReference) {
+    // few distinct keys, so runs of duplicates span several leaves
+    std::mt19937_64 rng(7);
+    std::vector<std::pair<int64_t, uint64_t>> entries;
+    bplusTree<intKeys> inserted;
+    for (uint64_t row = 0; row < 50000; row++) {
+        int64_t key = static_cast<int64_t>(rng() % 3000) - 1500;
+        entries.emplace_back(key, row);
+        inserted.insert(key, row);
+    }
+    std::sort(entries.begin(), entries.end());
+    bplusTree<intKeys> built;
+    built.build(entries);
+    EXPECT_EQ(inserted.size(), entries.size());
+    EXPECT_EQ(built.size(), entries.size());
+    EXPECT_GE(inserted.height(), 2u);
+
+    struct Test { bound<int64_t> low; bound<int64_t> high; };
+    std::vector<Test> tests = {
+        {{}, {}},
+        {{false, true, 17}, {false, true, 17}},
+        {{false, false, -3}, {false, true, 250}},
+        {{false, true, -3}, {false, false, 250}},
+        {{}, {false, false, -1400}},
+        {{false, false, 1400}, {}},
+        {{false, true, 5000}, {}},
+        {{false, true, 10}, {false, true, 9}},
+    };
+    for (const Test& t : tests) {
+        std::vector<uint64_t> want;
+        for (const auto& [key, row] : entries) {
+            bool aboveLow = t.low.unbounded || key > t.low.value || (t.low.inclusive && key == t.low.value);
+            bool belowHigh = t.high.unbounded || key < t.high.value || (t.high.inclusive && key == t.high.value);
+            if (aboveLow && belowHigh) {
+                want.push_back(row);
+            }
+        }
+        EXPECT_EQ(scanAll(inserted, t.low, t.high), want) << t.low.value << " " << t.high.value;
+        EXPECT_EQ(scanAll(built, t.low, t.high), want) << t.low.value << " " << t.high.value;
+    }
+
+    // inserts into a built tree split its nodes like any other
+    for (uint64_t row = 50000; row < 60000; row++) {
+        built.insert(17, row);
+    }
+    EXPECT_EQ(scanAll(built, bound<int64_t>{false, true, 17}, bound<int64_t>{false, true, 17}).size(),
+        scanAll(inserted, bound<int64_t>{false, true, 17}, bound<int64_t>{false, true, 17}).size() + 10000);
+}
+
+TEST(BTreeTest, TextKeysShareNodePrefixes) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 20000; i++) {
+        keys.push_back("customer/" + std::to_string(i % 4000 * 7919 % 4000));
+    }
+    keys.push_back("");
+    keys.push_back("customer");
+    keys.push_back("zebra");
+
+    bplusTree<textKeys> tree;
+    std::vector<std::pair<std::string, uint64_t>> entries;
+    for (uint64_t row = 0; row < keys.size(); row++) {
+        tree.insert(keys[row], row);
+        entries.emplace_back(keys[row], row);
+    }
+    std::sort(entries.begin(), entries.end());
+    EXPECT_EQ(tree.size(), keys.size());
+
+    struct Test { bound<std::string_view> low; bound<std::string_view> high; };
+    std::vector<Test> tests = {
+        {{}, {}},
+        {{false, true, "customer/123"}, {false, true, "customer/123"}},
+        {{false, false, "customer/1"}, {false, false, "customer/2"}},
+        {{false, true, "customer"}, {false, true, "customer/"}},
+        {{false, true, ""}, {false, true, ""}},
+        {{false, false, "customer/999"}, {}},
+        {{}, {false, false, "c"}},
+    };
+    for (const Test& t : tests) {
+        std::vector<uint64_t> want;
+        for (const auto& [key, row] : entries) {
+            bool aboveLow = t.low.unbounded || key > t.low.value || (t.low.inclusive && key == t.low.value);
+            bool belowHigh = t.high.unbounded || key < t.high.value || (t.high.inclusive && key == t.high.value);
+            if (aboveLow && belowHigh) {
+                want.push_back(row);
+            }
+        }
+        EXPECT_EQ(scanAll(tree, t.low, t.high), want) << t.low.value << " " << t.high.value;
+    }
+}
+
+TEST(StorageTest, IndexesFollowAppends) {
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE users (id INT, name TEXT);"
+                     "INSERT INTO users VALUES (1, 'ann');"
+                     "CREATE INDEX by_name ON users (name);"
+                     "INSERT INTO users VALUES (2, 'bob');"
+                     "INSERT INTO users VALUES (3, 'ann')"), "");
+    table* users = c.find("users");
+    users->columns()[0].appendInt(4);
+    users->columns()[1].appendText("ann");
+    ASSERT_EQ(users->commitAppends(), "");
+
+    const tableIndex* index = users->indexOn(1);
+    ASSERT_NE(index, nullptr);
+    EXPECT_EQ(index->size(), 4u);
+    keyRange ann;
+    ann.lowText = {false, true, "ann"};
+    ann.highText = {false, true, "ann"};
+    std::vector<uint64_t> rows;
+    EXPECT_TRUE(index->lookup(ann, 10, rows));
+    EXPECT_EQ(rows, (std::vector<uint64_t>{0, 2, 3}));
+    rows.clear();
+    EXPECT_FALSE(index->lookup(ann, 2, rows));
+
+    EXPECT_EQ(run(c, "CREATE INDEX by_name ON users (id)"), "Index by_name already exists on table users");
+    EXPECT_EQ(run(c, "CREATE INDEX x ON users (age)"), "Column age does not exist in table users");
+    EXPECT_EQ(run(c, "CREATE INDEX x ON nobody (id)"), "Table nobody does not exist");
+}
+
+// tablePath is a fresh path for the test called name
+static std::string tablePath(const std::string& name) {
+    auto path = std::filesystem::temp_directory_path() /
+        ("nicolassql_storage_" + std::to_string(::getpid()) + "_" + name);
+    std::filesystem::remove_all(path);
+    return path.string();
+}
+
+TEST(PageFileTest, MapsSavedTables) {
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE users (id INT, name TEXT);"
+                     "INSERT INTO users VALUES (1, 'ann');"
+                     "INSERT INTO users VALUES (22, 'it''s bob');"
+                     "CREATE TABLE empty (a INT, b TEXT);"
+                     "CREATE INDEX by_id ON users (id)"), "");
+    // enough rows that every chunk spans several pages
+    table* users = c.find("users");
+    for (int64_t i = 0; i < 20000; i++) {
+        users->columns()[0].appendInt(i);
+        users->columns()[1].appendText(std::to_string(i));
+    }
+    ASSERT_EQ(users->commitAppends(), "");
+
+    std::string directory = tablePath("catalog");
+    ASSERT_EQ(saveCatalog(c, directory, 42), "");
+    EXPECT_TRUE(std::filesystem::exists(directory + "/users.table"));
+    EXPECT_EQ(std::filesystem::file_size(directory + "/users.table") % pageSize, 0u);
+
+    catalog loaded;
+    ASSERT_EQ(loadCatalog(loaded, directory), "");
+    ASSERT_EQ(loaded.size(), 2u);
+    table* mapped = loaded.find("users");
+    ASSERT_NE(mapped, nullptr);
+    EXPECT_EQ(mapped->rows(), users->rows());
+    EXPECT_EQ(mapped->checkpointLsn(), 42u);
+    for (size_t i = 0; i < users->columns().size(); i++) {
+        const column& want = users->columns()[i];
+        const column& got = mapped->columns()[i];
+        EXPECT_EQ(got.name, want.name);
+        EXPECT_EQ(got.type, want.type);
+        EXPECT_EQ(got.ints, want.ints);
+        EXPECT_EQ(got.offsets, want.offsets);
+        EXPECT_EQ(got.chars, want.chars);
+    }
+    EXPECT_EQ(mapped->columns()[1].text(1), "it's bob");
+    EXPECT_EQ(loaded.find("empty")->rows(), 0u);
+    ASSERT_EQ(mapped->indexes().size(), 1u);
+    EXPECT_EQ(mapped->indexes()[0]->name(), "by_id");
+    EXPECT_EQ(mapped->indexes()[0]->size(), 0u);
+
+    // the loaded columns read the mapping until the first append copies them
+    column& ids = mapped->columns()[0];
+    EXPECT_TRUE(ids.ints.isView());
+    EXPECT_TRUE(mapped->columns()[1].chars.isView());
+    ASSERT_EQ(run(loaded, "INSERT INTO users VALUES (7, 'eve')"), "");
+    EXPECT_FALSE(ids.ints.isView());
+    EXPECT_EQ(ids.ints.back(), 7);
+    EXPECT_EQ(mapped->columns()[1].text(mapped->rows() - 1), "eve");
+    EXPECT_EQ(mapped->columns()[1].text(0), "ann");
+
+    // the index is built when first looked up, over the rows appended since
+    EXPECT_EQ(mapped->indexes()[0]->size(), 0u);
+    ASSERT_EQ(mapped->indexOn(0), mapped->indexes()[0].get());
+    EXPECT_EQ(mapped->indexes()[0]->size(), mapped->rows());
+    keyRange seven;
+    seven.low = {false, true, 7};
+    seven.high = {false, true, 7};
+    std::vector<uint64_t> found;
+    EXPECT_TRUE(mapped->indexOn(0)->lookup(seven, 10, found));
+    EXPECT_EQ(found, (std::vector<uint64_t>{9, mapped->rows() - 1}));
+
+    EXPECT_EQ(loadCatalog(loaded, directory), "Table empty already exists");
+    std::filesystem::remove_all(directory);
+}
+
+TEST(PageFileTest, RejectsDamagedFiles) {
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE t (a TEXT); INSERT INTO t VALUES ('abc')"), "");
+    std::string directory = tablePath("damaged");
+    std::filesystem::create_directories(directory);
+    std::string path = directory + "/t.table";
+    ASSERT_EQ(saveTable(*c.find("t"), path), "");
+    ASSERT_EQ(std::get<1>(loadTable(path)), "");
+
+    // a zone map covering more rows than the table holds
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(3 * pageSize);
+        uint64_t rows = 2;
+        file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    }
+    EXPECT_EQ(std::get<1>(loadTable(path)), "Table file " + path + " is damaged");
+    ASSERT_EQ(saveTable(*c.find("t"), path), "");
+
+    // a heap shorter than the offsets say
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(pageSize + sizeof(uint64_t));
+        uint64_t end = 4;
+        file.write(reinterpret_cast<const char*>(&end), sizeof(end));
+    }
+    EXPECT_EQ(std::get<1>(loadTable(path)), "Table file " + path + " is damaged");
+
+    std::filesystem::resize_file(path, pageSize - 1);
+    EXPECT_EQ(std::get<1>(loadTable(path)), "Table file " + path + " is too short");
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << std::string(pageSize, 'x');
+    }
+    EXPECT_EQ(std::get<1>(loadTable(path)), "Table file " + path + " is not a table file");
+    EXPECT_EQ(std::get<1>(loadTable(directory + "/missing.table")),
+        "Could not open table file " + directory + "/missing.table: No such file or directory");
+    std::filesystem::remove_all(directory);
+}
+
+TEST(StorageTest, SealsFullChunks) {
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE events (id INT, kind TEXT); CREATE INDEX by_kind ON events (kind)"), "");
+    table* events = c.find("events");
+    size_t rows = 2 * chunkRows + 100;
+    for (size_t i = 0; i < rows; i++) {
+        events->columns()[0].appendInt(static_cast<int64_t>(i));
+        events->columns()[1].appendText(i % 3 == 0 ? "click" : "view");
+    }
+    size_t rawBytes = events->bytes();
+    ASSERT_EQ(events->commitAppends(), "");
+
+    // whole chunks are sealed and only the rest stays in the buffers
+    const column& ids = events->columns()[0];
+    const column& kinds = events->columns()[1];
+    EXPECT_EQ(ids.sealedRows(), 2 * chunkRows);
+    EXPECT_EQ(kinds.sealedRows(), 2 * chunkRows);
+    EXPECT_EQ(ids.ints.size(), 100u);
+    EXPECT_EQ(kinds.offsets.size(), 101u);
+    EXPECT_EQ(ids.size(), rows);
+    EXPECT_EQ(kinds.size(), rows);
+    EXPECT_EQ(ids.intChunks[1].kind, encodingKind::frameKind);
+    EXPECT_EQ(kinds.textChunks[0].kind, encodingKind::dictionaryKind);
+    EXPECT_LT(events->bytes() * 10, rawBytes);
+    for (size_t i = 0; i < rows; i++) {
+        ASSERT_EQ(ids.intAt(i), static_cast<int64_t>(i));
+        ASSERT_EQ(kinds.text(i), i % 3 == 0 ? "click" : "view");
+    }
+    EXPECT_EQ(events->indexes()[0]->size(), rows);
+
+    // a failed append leaves the sealed chunks and the rest alone
+    ASSERT_EQ(run(c, "INSERT INTO events VALUES (1, 'a'), ('b', 'c')"), "Expected an INT for column id, got b");
+    EXPECT_EQ(ids.size(), rows);
+    EXPECT_EQ(kinds.size(), rows);
+
+    // appends fill the next chunk and seal it once it is whole
+    for (size_t i = 0; i < chunkRows; i++) {
+        events->columns()[0].appendInt(-1);
+        events->columns()[1].appendText("scroll");
+    }
+    ASSERT_EQ(events->commitAppends(), "");
+    EXPECT_EQ(ids.sealedRows(), 3 * chunkRows);
+    EXPECT_EQ(ids.intAt(rows - 1), static_cast<int64_t>(rows - 1));
+    EXPECT_EQ(ids.intAt(rows), -1);
+    EXPECT_EQ(kinds.text(3 * chunkRows + 99), "scroll");
+
+    // table files hold sealed chunks encoded, and loading maps them
+    std::string path = tablePath("sealed") + ".table";
+    ASSERT_EQ(saveTable(*events, path), "");
+    auto [loaded, err] = loadTable(path);
+    ASSERT_EQ(err, "");
+    ASSERT_EQ(loaded->rows(), events->rows());
+    const column& loadedIds = loaded->columns()[0];
+    const column& loadedKinds = loaded->columns()[1];
+    EXPECT_EQ(loadedIds.sealedRows(), 3 * chunkRows);
+    EXPECT_EQ(loadedKinds.sealedRows(), 3 * chunkRows);
+    EXPECT_EQ(loadedIds.intChunks[1].kind, encodingKind::frameKind);
+    EXPECT_EQ(loadedIds.intChunks[2].kind, encodingKind::runKind);
+    EXPECT_EQ(loadedKinds.textChunks[0].kind, encodingKind::dictionaryKind);
+    EXPECT_TRUE(loadedIds.intChunks[1].packed.isView());
+    EXPECT_TRUE(loadedKinds.textChunks[0].codes.packed.isView());
+    EXPECT_LT(std::filesystem::file_size(path), rawBytes / 2);
+    for (size_t i = 0; i < loaded->rows(); i += 997) {
+        ASSERT_EQ(loadedIds.intAt(i), ids.intAt(i));
+        ASSERT_EQ(loadedKinds.text(i), kinds.text(i));
+    }
+    EXPECT_EQ(loaded->indexOn(1)->size(), loaded->rows());
+
+    // appends to a loaded table copy only the rows after its sealed chunks
+    catalog reloaded;
+    auto [added, addErr] = reloaded.add(std::move(loaded));
+    ASSERT_EQ(addErr, "");
+    ASSERT_EQ(run(reloaded, "INSERT INTO events VALUES (7, 'tail')"), "");
+    EXPECT_EQ(added->rows(), rows + chunkRows + 1);
+    EXPECT_TRUE(loadedIds.intChunks[1].packed.isView());
+    EXPECT_FALSE(loadedIds.ints.isView());
+    EXPECT_EQ(loadedKinds.text(added->rows() - 1), "tail");
+    std::filesystem::remove(path);
+
+    // a sealed chunk of no encoding there is
+    std::string damaged = tablePath("sealed_damaged") + ".table";
+    ASSERT_EQ(saveTable(*events, damaged), "");
+    std::string header(pageSize, '\0');
+    {
+        std::ifstream in(damaged, std::ios::binary);
+        in.read(header.data(), pageSize);
+    }
+    auto [layout, layoutErr] = readLayout(header.data(), std::filesystem::file_size(damaged), damaged);
+    ASSERT_EQ(layoutErr, "");
+    ASSERT_EQ(layout.columns[0].sealedChunks, 3u);
+    {
+        std::fstream file(damaged, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(layout.columns[0].sealedPage * pageSize);
+        file.put(9);
+    }
+    EXPECT_EQ(std::get<1>(loadTable(damaged)), "Table file " + damaged + " is damaged");
+    std::filesystem::remove(damaged);
+}
+
+TEST(StorageTest, KeepsZoneMaps) {
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE events (at INT, kind TEXT)"), "");
+    table* events = c.find("events");
+    size_t rows = chunkRows + 10;
+    for (size_t i = 0; i < rows; i++) {
+        events->columns()[0].appendInt(static_cast<int64_t>(i) - 5);
+        events->columns()[1].appendText(i < chunkRows ? "m" + std::to_string(i % 7) : "z");
+    }
+    ASSERT_EQ(events->commitAppends(), "");
+
+    // one zone map per chunk, the last covering the rows it holds so far
+    const column& at = events->columns()[0];
+    const column& kinds = events->columns()[1];
+    ASSERT_EQ(at.intZones.size(), 2u);
+    ASSERT_EQ(kinds.textZones.size(), 2u);
+    EXPECT_EQ(at.zonedRows(), rows);
+    EXPECT_EQ(at.intZones[0].rows, chunkRows);
+    EXPECT_EQ(at.intZones[0].low, -5);
+    EXPECT_EQ(at.intZones[0].high, static_cast<int64_t>(chunkRows) - 6);
+    EXPECT_EQ(at.intZones[1].rows, 10u);
+    EXPECT_EQ(at.intZones[1].low, static_cast<int64_t>(chunkRows) - 5);
+    EXPECT_EQ(kinds.textZones[0].low, "m0");
+    EXPECT_EQ(kinds.textZones[0].high, "m6");
+    EXPECT_EQ(kinds.textZones[1].low, "z");
+
+    // appends widen the last zone map; failed ones leave it alone
+    ASSERT_EQ(run(c, "INSERT INTO events VALUES (100, 'a'), (7, 'b')"), "");
+    ASSERT_EQ(run(c, "INSERT INTO events VALUES (0, 'a'), ('x', 'b')"), "Expected an INT for column at, got x");
+    EXPECT_EQ(at.zonedRows(), rows + 2);
+    EXPECT_EQ(at.intZones[1].low, 7);
+    EXPECT_EQ(at.intZones[1].high, static_cast<int64_t>(rows) - 6);
+    EXPECT_EQ(kinds.textZones[1].low, "a");
+    EXPECT_EQ(kinds.textZones[1].high, "z");
+
+    // table files keep the zone maps, so loading reads no rows for them
+    std::string path = tablePath("zones") + ".table";
+    ASSERT_EQ(saveTable(*events, path), "");
+    auto [loaded, err] = loadTable(path);
+    ASSERT_EQ(err, "");
+    const column& loadedAt = loaded->columns()[0];
+    ASSERT_EQ(loadedAt.intZones.size(), 2u);
+    for (size_t i = 0; i < 2; i++) {
+        EXPECT_EQ(loadedAt.intZones[i].rows, at.intZones[i].rows);
+        EXPECT_EQ(loadedAt.intZones[i].low, at.intZones[i].low);
+        EXPECT_EQ(loadedAt.intZones[i].high, at.intZones[i].high);
+        EXPECT_EQ(loaded->columns()[1].textZones[i].high, kinds.textZones[i].high);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(StorageTest, CutsLongTextZoneBounds) {
+    std::string prefix(zonePrefixBytes - 1, 'k');
+    zoneMap<std::string> zone;
+    zone.add(std::string_view(prefix + "mz tail"));
+    zone.add(std::string_view(prefix + "m\xff tail"));
+
+    // the least value is cut to its prefix, the greatest is cut and raised
+    EXPECT_EQ(zone.low, prefix + "m");
+    EXPECT_EQ(zone.high, prefix + "n");
+    EXPECT_EQ(zone.rows, 2u);
+
+    // a greatest value whose prefix can not be raised is kept whole
+    std::string highest(zonePrefixBytes + 3, '\xff');
+    zone.add(std::string_view(highest));
+    EXPECT_EQ(zone.high, highest);
+
+    // scans still find long values by the cut bounds
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE notes (id INT, body TEXT)"), "");
+    table* notes = c.find("notes");
+    for (size_t i = 0; i < chunkRows + 1; i++) {
+        notes->columns()[0].appendInt(static_cast<int64_t>(i));
+        notes->columns()[1].appendText(prefix + (i == chunkRows ? "zz" : "mm") + std::to_string(i));
+    }
+    ASSERT_EQ(notes->commitAppends(), "");
+    const column& body = notes->columns()[1];
+    ASSERT_EQ(body.textZones.size(), 2u);
+    EXPECT_LE(body.textZones[0].high.size(), zonePrefixBytes);
+    EXPECT_LT(body.textZones[0].high, prefix + "zz");
+    EXPECT_GT(body.textZones[1].high, prefix + "zz" + std::to_string(chunkRows));
+}
+
+// pageFile is a fresh file of pages pages, each filled with its number
+static std::string pageFile(const std::string& name, size_t pages) {
+    std::string path = tablePath(name);
+    std::ofstream out(path, std::ios::binary);
+    for (size_t page = 0; page < pages; page++) {
+        out << std::string(pageSize, static_cast<char>('a' + page % 26));
+    }
+    return path;
+}
+
+// writeFile replaces the file at path with contents
+static void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+}
+
+TEST(CsvTest, CopiesRowsAcrossChunks) {
+    // quoted fields hold commas, line breaks and quotes, so cuts between
+    // chunks have to find real row boundaries
+    std::string csv;
+    std::vector<std::string> notes;
+    for (int i = 0; i < 5000; i++) {
+        std::string note = i % 3 == 0 ? "plain " + std::to_string(i)
+            : i % 3 == 1 ? "has, comma and \"quote\" " + std::to_string(i)
+            : "two\nlines\r\n" + std::to_string(i);
+        notes.push_back(note);
+        std::string quoted = "\"";
+        for (char ch : note) {
+            quoted += ch == '"' ? std::string("\"\"") : std::string(1, ch);
+        }
+        csv += std::to_string(i - 2500) + "," + (i % 3 == 0 ? note : quoted + "\"") + (i % 2 == 0 ? "\n" : "\r\n");
+    }
+    csv += "7,last row without a line break";
+    notes.push_back("last row without a line break");
+
+    std::string path = tablePath("rows.csv");
+    writeFile(path, csv);
+    for (size_t threads : {1, 3, 8}) {
+        catalog c;
+        ASSERT_EQ(run(c, "CREATE TABLE notes (id INT, note TEXT); INSERT INTO notes VALUES (99, 'first');"
+                         "CREATE INDEX by_id ON notes (id)"), "");
+        table* t = c.find("notes");
+        auto [rows, err] = copyFromCsv(*t, path, csvOptions{.threads = threads, .minChunkBytes = 4096});
+        ASSERT_EQ(err, "") << threads;
+        EXPECT_EQ(rows, notes.size());
+        ASSERT_EQ(t->rows(), notes.size() + 1);
+        EXPECT_EQ(t->indexOn(0)->size(), t->rows());
+        for (size_t i = 0; i < notes.size(); i++) {
+            ASSERT_EQ(t->columns()[1].text(i + 1), notes[i]) << "threads=" << threads << " row=" << i;
+            ASSERT_EQ(t->columns()[0].ints[i + 1], i + 1 == notes.size() ? 7 : static_cast<int64_t>(i) - 2500);
+        }
+    }
+
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE notes (id INT, note TEXT); COPY notes FROM '" + path + "'"), "");
+    EXPECT_EQ(c.find("notes")->rows(), notes.size());
+    std::filesystem::remove(path);
+}
+
+TEST(CsvTest, RejectsBadFilesWithoutAppending) {
+    catalog c;
+    ASSERT_EQ(run(c, "CREATE TABLE t (a INT, b TEXT); INSERT INTO t VALUES (1, 'one')"), "");
+    table* t = c.find("t");
+    std::string path = tablePath("bad.csv");
+
+    struct Test { std::string csv; std::string err; };
+    std::vector<Test> tests = {
+        {"1,a\n2,b,c\n", "Row 2 of CSV file " + path + ": expected 2 fields"},
+        {"1,a\n2\n", "Row 2 of CSV file " + path + ": expected 2 fields"},
+        {"1,a\nx,b\n", "Row 2 of CSV file " + path + ": expected an INT for column a, got x"},
+        {"1,\"a\n", "Row 1 of CSV file " + path + ": unterminated quoted field"},
+        {"1,\"a\"b\n", "Row 1 of CSV file " + path + ": expected 2 fields"},
+    };
+    for (const Test& test : tests) {
+        writeFile(path, test.csv);
+        EXPECT_EQ(std::get<1>(copyFromCsv(*t, path)), test.err) << test.csv;
+        EXPECT_EQ(t->rows(), 1u);
+        EXPECT_EQ(t->columns()[1].chars.size(), 3u);
+    }
+
+    writeFile(path, "");
+    EXPECT_EQ(copyFromCsv(*t, path), std::make_tuple(size_t{0}, std::string()));
+    std::filesystem::remove(path);
+    EXPECT_EQ(std::get<1>(copyFromCsv(*t, path)).rfind("Could not open CSV file " + path, 0), 0u);
+    EXPECT_EQ(run(c, "COPY nobody FROM 'x.csv'"), "Table nobody does not exist");
+}
+
+TEST(BufferPoolTest, PinsAndEvicts) {
+    for (auto policy : {evictionPolicy::clockPolicy, evictionPolicy::lruKPolicy}) {
+        std::string path = pageFile("pins", 8);
+        bufferPool pool(poolOptions{.frames = 3, .policy = policy});
+        auto [file, err] = pool.openFile(path);
+        ASSERT_EQ(err, "");
+
+        for (uint64_t page : {0, 1, 0, 2, 3, 4, 0}) {
+            auto [handle, pinErr] = pool.pin(file, page);
+            ASSERT_EQ(pinErr, "");
+            EXPECT_EQ(handle.data()[0], static_cast<char>('a' + page));
+            EXPECT_EQ(handle.data()[pageSize - 1], static_cast<char>('a' + page));
+        }
+        poolStats stats = pool.stats();
+        EXPECT_EQ(stats.hits + stats.misses, 7u);
+        EXPECT_GE(stats.hits, 1u);
+        EXPECT_GE(stats.evictions, 2u);
+
+        // pinned pages stay put, and a pool of only pinned pages is full
+        auto [a, aErr] = pool.pin(file, 5);
+        auto [b, bErr] = pool.pin(file, 6);
+        auto [c, cErr] = pool.pin(file, 7);
+        EXPECT_EQ(std::get<1>(pool.pin(file, 1)), "All 3 frames of the buffer pool are pinned");
+        EXPECT_EQ(a.data()[0], 'f');
+        b.release();
+        auto [d, dErr] = pool.pin(file, 1);
+        ASSERT_EQ(dErr, "");
+        EXPECT_EQ(d.data()[0], 'b');
+        EXPECT_EQ(a.data()[0], 'f');
+        EXPECT_EQ(c.data()[0], 'h');
+
+        // pages past the end read as zeros
+        d.release();
+        auto [past, pastErr] = pool.pin(file, 100);
+        ASSERT_EQ(pastErr, "");
+        EXPECT_EQ(past.data()[0], 0);
+        EXPECT_EQ(std::get<1>(pool.pin(file + 1, 0)), "Unknown file 1");
+        std::filesystem::remove(path);
+    }
+}
+
+TEST(BufferPoolTest, LruKKeepsHotPagesThroughScans) {
+    std::string path = pageFile("lruk", 64);
+    bufferPool pool(poolOptions{.frames = 8, .policy = evictionPolicy::lruKPolicy});
+    auto [file, err] = pool.openFile(path);
+    ASSERT_EQ(err, "");
+    for (int i = 0; i < 2; i++) {
+        pool.pin(file, 0);
+        pool.pin(file, 1);
+    }
+
+    // a scan touches every other page once, which makes them the victims
+    for (uint64_t page = 2; page < 64; page++) {
+        ASSERT_EQ(std::get<1>(pool.pin(file, page)), "");
+    }
+    poolStats before = pool.stats();
+    pool.pin(file, 0);
+    pool.pin(file, 1);
+    EXPECT_EQ(pool.stats().hits - before.hits, 2u);
+    std::filesystem::remove(path);
+}
+
+TEST(BufferPoolTest, WritesBackDirtyPages) {
+    std::string path = pageFile("dirty", 4);
+    {
+        bufferPool pool(poolOptions{.frames = 2, .writeBackInterval = std::chrono::milliseconds(0)});
+        auto [file, err] = pool.openFile(path);
+        ASSERT_EQ(err, "");
+        {
+            auto [handle, pinErr] = pool.pin(file, 0);
+            handle.mutableData()[0] = 'X';
+        }
+        // evicting the dirty page writes it back
+        pool.pin(file, 1);
+        pool.pin(file, 2);
+        pool.pin(file, 3);
+        EXPECT_EQ(pool.stats().writeBacks, 1u);
+        auto [again, againErr] = pool.pin(file, 0);
+        EXPECT_EQ(again.data()[0], 'X');
+        again.release();
+
+        auto [grown, grownErr] = pool.pin(file, 5);
+        grown.mutableData()[1] = 'Y';
+        grown.release();
+        ASSERT_EQ(pool.flush(), "");
+    }
+    std::ifstream in(path, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ASSERT_EQ(contents.size(), 6 * pageSize);
+    EXPECT_EQ(contents[0], 'X');
+    EXPECT_EQ(contents[1], 'a');
+    EXPECT_EQ(contents[5 * pageSize + 1], 'Y');
+
+    // the background writer cleans pages nobody evicts
+    {
+        bufferPool pool(poolOptions{.frames = 2, .writeBackInterval = std::chrono::milliseconds(1)});
+        auto [file, err] = pool.openFile(path);
+        ASSERT_EQ(err, "");
+        std::get<0>(pool.pin(file, 1)).mutableData()[0] = 'Z';
+        for (int i = 0; i < 1000 && pool.stats().writeBacks == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        EXPECT_EQ(pool.stats().writeBacks, 1u);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(BufferPoolTest, SharesPagesAcrossThreads) {
+    for (auto policy : {evictionPolicy::clockPolicy, evictionPolicy::lruKPolicy}) {
+        std::string path = pageFile("threads", 32);
+        bufferPool pool(poolOptions{.frames = 8, .policy = policy, .shards = 4});
+        auto [file, err] = pool.openFile(path);
+        ASSERT_EQ(err, "");
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < 2000; i++) {
+                    uint64_t page = static_cast<uint64_t>((i * 7 + t) % 32);
+                    auto [handle, pinErr] = pool.pin(file, page);
+                    ASSERT_EQ(pinErr, "");
+                    ASSERT_EQ(handle.data()[pageSize / 2], static_cast<char>('a' + page % 26));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        poolStats stats = pool.stats();
+        EXPECT_EQ(stats.hits + stats.misses, 8000u);
+        std::filesystem::remove(path);
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
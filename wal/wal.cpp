@@ -0,0 +1,604 @@
+#include "wal.h"
+#include "../storage/pagefile.h"
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wal {
+
+using namespace nicolassql;
+
+namespace {
+
+// headerBytes is the length and checksum in front of every record
+constexpr size_t headerBytes = 8;
+
+// the tags of INT and TEXT, for both column types and values
+constexpr uint8_t intTag = 0;
+constexpr uint8_t textTag = 1;
+
+constexpr std::array<uint32_t, 256> makeCrcTable() {
+	std::array<uint32_t, 256> table{};
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++) {
+			// 0x82f63b78 is the reflected Castagnoli polynomial
+			crc = (crc >> 1) ^ (crc & 1 ? 0x82f63b78u : 0);
+		}
+		table[i] = crc;
+	}
+	return table;
+}
+
+constexpr auto crcTable = makeCrcTable();
+
+void putVarint(std::string& out, uint64_t value) {
+	while (value >= 0x80) {
+		out += static_cast<char>(value | 0x80);
+		value >>= 7;
+	}
+	out += static_cast<char>(value);
+}
+
+// putZigzag puts value as a varint of its zigzag encoding, which keeps
+// values near zero short whatever their sign
+void putZigzag(std::string& out, int64_t value) {
+	putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void putBytes(std::string& out, std::string_view bytes) {
+	putVarint(out, bytes.size());
+	out.append(bytes);
+}
+
+void putU32(char* out, uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		out[i] = static_cast<char>(value >> (8 * i));
+	}
+}
+
+uint32_t getU32(const char* in) {
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++) {
+		value |= static_cast<uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+	}
+	return value;
+}
+
+// startRecord clears out and leaves room for the header in front of kind
+void startRecord(std::string& out, recordKind kind) {
+	out.assign(headerBytes, '\0');
+	out += static_cast<char>(kind);
+}
+
+void finishRecord(std::string& out) {
+	putU32(out.data(), static_cast<uint32_t>(out.size() - headerBytes));
+	putU32(out.data() + 4, checksum(out.data() + headerBytes, out.size() - headerBytes));
+}
+
+// payloadReader takes varints and byte strings off the front of a record
+// payload; a read past its end clears ok
+struct payloadReader {
+	const char* next;
+	const char* end;
+	bool ok = true;
+
+	uint64_t varint() {
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (next == end) {
+				break;
+			}
+			uint8_t byte = static_cast<uint8_t>(*next++);
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0) {
+				return value;
+			}
+		}
+		ok = false;
+		return 0;
+	}
+
+	uint8_t byte() {
+		if (next == end) {
+			ok = false;
+			return 0;
+		}
+		return static_cast<uint8_t>(*next++);
+	}
+
+	std::string_view bytes() {
+		uint64_t size = varint();
+		if (!ok || size > static_cast<uint64_t>(end - next)) {
+			ok = false;
+			return {};
+		}
+		std::string_view value(next, size);
+		next += size;
+		return value;
+	}
+};
+
+std::string systemError(const std::string& what, const std::string& path) {
+	return what + " " + path + ": " + std::strerror(errno);
+}
+
+std::string writeAll(int fd, const std::string& data) {
+	size_t written = 0;
+	while (written < data.size()) {
+		ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return std::string("Could not write log: ") + std::strerror(errno);
+		}
+		written += static_cast<size_t>(n);
+	}
+	return "";
+}
+
+// checkpointed reports whether the table the record in names was saved
+// with the change of the record, which ends at lsn. Every record names its
+// table first.
+bool checkpointed(payloadReader in, const storage::catalog& c, uint64_t lsn) {
+	storage::table* t = c.find(in.bytes());
+	return in.ok && t != nullptr && t->checkpointLsn() >= lsn;
+}
+
+std::string writeAndSync(int fd, const std::string& data) {
+	if (std::string err = writeAll(fd, data); err != "") {
+		return err;
+	}
+	if (::fdatasync(fd) != 0) {
+		return std::string("Could not sync log: ") + std::strerror(errno);
+	}
+	return "";
+}
+
+std::string syncDirectory(const std::string& path) {
+	std::string directory = std::filesystem::path(path).parent_path().string();
+	int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return systemError("Could not open directory", directory);
+	}
+	int rc = ::fsync(fd);
+	::close(fd);
+	return rc == 0 ? "" : systemError("Could not sync directory", directory);
+}
+
+// replayRecord rebuilds the statement of one record in storage and applies
+// it to c
+std::string replayRecord(recordKind kind, payloadReader& in, arena& storage, storage::catalog& c) {
+	static const token intType{.value = intKeyword, .kind = tokenKind::keywordKind, .id = internedId(keywords, intKeyword)};
+	static const token textType{.value = textKeyword, .kind = tokenKind::keywordKind, .id = internedId(keywords, textKeyword)};
+
+	switch (kind) {
+	case recordKind::createTableRecord: {
+		std::string_view name = in.bytes();
+		uint64_t count = in.varint();
+		auto cols = storage.make<ast::list<ast::columnDefinition>>(&storage);
+		for (uint64_t i = 0; i < count && in.ok; i++) {
+			std::string_view column = in.bytes();
+			uint8_t type = in.byte();
+			in.ok = in.ok && type <= textTag;
+			cols->push_back(storage.make<ast::columnDefinition>(ast::columnDefinition{
+				.name = token{.value = column, .kind = tokenKind::identifierKind},
+				.datatype = type == intTag ? intType : textType,
+			}));
+		}
+		if (!in.ok) {
+			return "malformed CREATE TABLE record";
+		}
+		ast::CreateTableStatement stmt{
+			.name = token{.value = name, .kind = tokenKind::identifierKind},
+			.cols = cols,
+		};
+		return std::get<1>(c.createTable(stmt));
+	}
+
+	case recordKind::insertRecord:
+	case recordKind::insertRowsRecord: {
+		std::string_view table = in.bytes();
+		uint64_t rows = kind == recordKind::insertRowsRecord ? in.varint() : 1;
+		uint64_t count = in.varint();
+		auto values = storage.make<ast::list<ast::expression>>(&storage);
+		for (uint64_t i = 0; i < count && in.ok; i++) {
+			// values are handed over typed, as the parser converts literals,
+			// so INT values are never printed only to be parsed again and
+			// TEXT values are appended as logged. An INT has no token.
+			ast::expression value{.literal = nullptr, .kind = ast::expressionKind::literalKind};
+			uint8_t tag = in.byte();
+			if (tag == intTag) {
+				uint64_t zigzag = in.varint();
+				value.type = ast::literalType::intLiteral;
+				value.intValue = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+			} else {
+				in.ok = in.ok && tag == textTag;
+				value.literal = storage.make<token>(token{.value = in.bytes(), .kind = tokenKind::stringKind});
+				value.type = ast::literalType::textLiteral;
+				value.text = value.literal->value;
+			}
+			values->push_back(storage.make<ast::expression>(value));
+		}
+		if (!in.ok) {
+			return "malformed INSERT record";
+		}
+		ast::InsertStatement stmt{
+			.table = token{.value = table, .kind = tokenKind::identifierKind},
+			.values = values,
+			.rows = rows,
+		};
+		return c.insert(stmt);
+	}
+
+	case recordKind::createIndexRecord: {
+		std::string_view table = in.bytes();
+		std::string_view name = in.bytes();
+		std::string_view column = in.bytes();
+		if (!in.ok) {
+			return "malformed CREATE INDEX record";
+		}
+		ast::CreateIndexStatement stmt{
+			.name = token{.value = name, .kind = tokenKind::identifierKind},
+			.table = token{.value = table, .kind = tokenKind::identifierKind},
+			.column = token{.value = column, .kind = tokenKind::identifierKind},
+		};
+		return std::get<1>(c.createIndex(stmt));
+	}
+
+	case recordKind::checkpointRecord:
+		// a checkpoint only ever starts a log, where open reads it
+		return "checkpoint record inside the replayed range";
+	}
+
+	return "unknown record kind " + std::to_string(static_cast<int>(kind));
+}
+
+// recordBuffer is reused by every append of a thread
+thread_local std::string recordBuffer;
+
+}
+
+uint32_t checksum(const char* data, size_t size) {
+	uint32_t crc = ~0u;
+	for (size_t i = 0; i < size; i++) {
+		crc = (crc >> 8) ^ crcTable[(crc ^ static_cast<unsigned char>(data[i])) & 0xff];
+	}
+	return ~crc;
+}
+
+writeAheadLog::writeAheadLog(int fd, std::string path, uint64_t end, uint64_t replayed, options opts)
+	: fd(fd), path(std::move(path)), opts(opts), replayed(replayed), pendingEnd(end), durableEnd(end) {}
+
+writeAheadLog::~writeAheadLog() {
+	// records appended but never committed are still written on a clean
+	// shutdown
+	std::unique_lock<std::mutex> lock(mu);
+	flushed.wait(lock, [&] { return !flushing; });
+	if (!pending.empty()) {
+		writeAndSync(fd, pending);
+	}
+	::close(fd);
+}
+
+std::tuple<std::unique_ptr<writeAheadLog>, std::string> writeAheadLog::open(const std::string& path,
+		storage::catalog& c, options opts) {
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return {nullptr, systemError("Could not open log", path)};
+	}
+
+	auto fail = [&](std::string err) {
+		::close(fd);
+		return std::make_tuple(std::unique_ptr<writeAheadLog>(), std::move(err));
+	};
+
+	struct stat info{};
+	if (::fstat(fd, &info) != 0) {
+		return fail(systemError("Could not stat log", path));
+	}
+	std::string contents(static_cast<size_t>(info.st_size), '\0');
+	for (size_t read = 0; read < contents.size(); ) {
+		ssize_t n = ::pread(fd, contents.data() + read, contents.size() - read, static_cast<off_t>(read));
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			return fail(systemError("Could not read log", path));
+		}
+		read += static_cast<size_t>(n);
+	}
+
+	uint64_t offset = 0;
+	uint64_t base = 0;
+	uint64_t records = 0;
+	arena storage;
+	while (offset + headerBytes < contents.size()) {
+		const char* header = contents.data() + offset;
+		uint32_t length = getU32(header);
+		if (length == 0 || length > contents.size() - offset - headerBytes ||
+				checksum(header + headerBytes, length) != getU32(header + 4)) {
+			break;
+		}
+
+		payloadReader in{.next = header + headerBytes + 1, .end = header + headerBytes + length};
+		auto kind = static_cast<recordKind>(header[headerBytes]);
+		uint64_t end = offset + headerBytes + length;
+		if (kind == recordKind::checkpointRecord && offset == 0) {
+			base = in.varint();
+			if (!in.ok) {
+				return fail("Could not replay log record at offset 0: malformed CHECKPOINT record");
+			}
+		} else if (!checkpointed(in, c, base + end)) {
+			if (std::string err = replayRecord(kind, in, storage, c); err != "") {
+				return fail("Could not replay log record at offset " + std::to_string(offset) + ": " + err);
+			}
+			storage.reset();
+			records++;
+		}
+		offset = end;
+	}
+
+	// whatever follows the last whole record is a write the crash cut short
+	if (offset != contents.size() && ::ftruncate(fd, static_cast<off_t>(offset)) != 0) {
+		return fail(systemError("Could not truncate log", path));
+	}
+	if (::lseek(fd, static_cast<off_t>(offset), SEEK_SET) < 0) {
+		return fail(systemError("Could not seek log", path));
+	}
+
+	return {std::unique_ptr<writeAheadLog>(new writeAheadLog(fd, path, base + offset, records, opts)), ""};
+}
+
+std::tuple<uint64_t, std::string> writeAheadLog::appendCreateTable(const ast::CreateTableStatement& stmt) {
+	std::string& record = recordBuffer;
+	startRecord(record, recordKind::createTableRecord);
+	putBytes(record, stmt.name.value);
+	putVarint(record, stmt.cols->size());
+	for (const ast::columnDefinition* def : *stmt.cols) {
+		putBytes(record, def->name.value);
+		if (def->datatype.value == intKeyword) {
+			record += static_cast<char>(intTag);
+		} else if (def->datatype.value == textKeyword) {
+			record += static_cast<char>(textTag);
+		} else {
+			return {0, "Can not log column type " + std::string(def->datatype.value)};
+		}
+	}
+	finishRecord(record);
+	return enqueue(record);
+}
+
+std::tuple<uint64_t, std::string> writeAheadLog::appendCreateIndex(const ast::CreateIndexStatement& stmt) {
+	std::string& record = recordBuffer;
+	startRecord(record, recordKind::createIndexRecord);
+	putBytes(record, stmt.table.value);
+	putBytes(record, stmt.name.value);
+	putBytes(record, stmt.column.value);
+	finishRecord(record);
+	return enqueue(record);
+}
+
+std::tuple<uint64_t, std::string> writeAheadLog::appendInsert(const ast::InsertStatement& stmt,
+		const std::vector<token>& parameters) {
+	std::string& record = recordBuffer;
+	startRecord(record, stmt.rows == 1 ? recordKind::insertRecord : recordKind::insertRowsRecord);
+	putBytes(record, stmt.table.value);
+	if (stmt.rows != 1) {
+		putVarint(record, stmt.rows);
+	}
+	putVarint(record, stmt.values->size());
+	for (const ast::expression* expr : *stmt.values) {
+		if (expr->kind == ast::expressionKind::binaryKind) {
+			return {0, "Only literal values can be logged"};
+		}
+		const token* value = expr->literal;
+		if (expr->kind == ast::expressionKind::placeholderKind) {
+			if (expr->placeholder == 0 || expr->placeholder > parameters.size()) {
+				return {0, "Missing parameter " + std::string(expr->literal->value)};
+			}
+			value = &parameters[expr->placeholder - 1];
+		}
+
+		// TEXT is logged as the value stored: a literal with its doubled
+		// quotes undone, a parameter as it was bound
+		if (value->kind == tokenKind::stringKind) {
+			record += static_cast<char>(textTag);
+			putBytes(record, expr->type == ast::literalType::textLiteral ? expr->text : value->value);
+			continue;
+		}
+
+		int64_t n = expr->intValue;
+		if (expr->type != ast::literalType::intLiteral) {
+			const char* end = value->value.data() + value->value.size();
+			auto [stop, ec] = std::from_chars(value->value.data(), end, n);
+			if (value->kind != tokenKind::numericKind || ec != std::errc() || stop != end) {
+				return {0, "Only INT and TEXT values can be logged, got " + std::string(value->value)};
+			}
+		}
+		record += static_cast<char>(intTag);
+		putZigzag(record, n);
+	}
+	finishRecord(record);
+	return enqueue(record);
+}
+
+std::tuple<uint64_t, std::string> writeAheadLog::appendCopy(const storage::table& t, size_t first) {
+	const std::vector<storage::column>& cols = t.columns();
+	// scratch for the columns of encoded chunks, which are decoded to read
+	std::vector<std::vector<int64_t>> ints(cols.size());
+	std::vector<std::vector<uint64_t>> offsets(cols.size());
+	std::vector<std::string> chars(cols.size());
+	std::vector<const int64_t*> intValues(cols.size());
+	std::vector<std::pair<const uint64_t*, const char*>> textValues(cols.size());
+
+	// a record holds the rows of one chunk, so no read spans a chunk end
+	std::string& record = recordBuffer;
+	uint64_t lsn = 0;
+	for (size_t start = first; start < t.rows();) {
+		size_t end = std::min(t.rows(), (start / storage::chunkRows + 1) * storage::chunkRows);
+		size_t rows = end - start;
+		for (size_t i = 0; i < cols.size(); i++) {
+			if (cols[i].type == storage::columnType::intType) {
+				ints[i].resize(rows);
+				intValues[i] = cols[i].readInts(start, rows, ints[i].data());
+			} else {
+				textValues[i] = cols[i].readText(start, rows, offsets[i], chars[i]);
+			}
+		}
+
+		startRecord(record, recordKind::insertRowsRecord);
+		putBytes(record, t.name());
+		putVarint(record, rows);
+		putVarint(record, rows * cols.size());
+		for (size_t row = 0; row < rows; row++) {
+			for (size_t i = 0; i < cols.size(); i++) {
+				if (cols[i].type == storage::columnType::intType) {
+					record += static_cast<char>(intTag);
+					putZigzag(record, intValues[i][row]);
+					continue;
+				}
+				auto [textOffsets, text] = textValues[i];
+				record += static_cast<char>(textTag);
+				putBytes(record, std::string_view(text + textOffsets[row], textOffsets[row + 1] - textOffsets[row]));
+			}
+		}
+		finishRecord(record);
+		auto [appended, err] = enqueue(record);
+		if (err != "") {
+			return {0, err};
+		}
+		lsn = appended;
+		start = end;
+	}
+	return {lsn, ""};
+}
+
+std::tuple<uint64_t, std::string> writeAheadLog::enqueue(const std::string& record) {
+	std::lock_guard<std::mutex> lock(mu);
+	if (!flushErr.empty()) {
+		return {0, flushErr};
+	}
+
+	if (!opts.groupCommit) {
+		// every record pays for its own sync
+		if (std::string err = writeAndSync(fd, record); err != "") {
+			flushErr = err;
+			return {0, err};
+		}
+		syncCount.fetch_add(1, std::memory_order_relaxed);
+		pendingEnd += record.size();
+		durableEnd = pendingEnd;
+		return {pendingEnd, ""};
+	}
+
+	if (pending.empty()) {
+		pendingSince = std::chrono::steady_clock::now();
+	}
+	pending += record;
+	pendingEnd += record.size();
+	if (pending.size() >= opts.maxGroupBytes) {
+		groupFull.notify_one();
+	}
+	return {pendingEnd, ""};
+}
+
+std::string writeAheadLog::commit(uint64_t lsn) {
+	std::unique_lock<std::mutex> lock(mu);
+	while (durableEnd < lsn && flushErr.empty()) {
+		if (flushing) {
+			flushed.wait(lock);
+			continue;
+		}
+
+		// this thread leads the next group: it gives other writers until
+		// the group is old or big enough to join, then syncs for all of them
+		flushing = true;
+		if (opts.maxGroupDelay.count() > 0) {
+			groupFull.wait_until(lock, pendingSince + opts.maxGroupDelay, [&] {
+				return pending.size() >= opts.maxGroupBytes;
+			});
+		}
+		flush(lock);
+	}
+	return flushErr;
+}
+
+std::string writeAheadLog::checkpoint(const storage::catalog& c, const std::string& directory) {
+	std::unique_lock<std::mutex> lock(mu);
+	flushed.wait(lock, [&] { return !flushing; });
+	if (!flushErr.empty()) {
+		return flushErr;
+	}
+	if (!pending.empty()) {
+		if (std::string err = writeAndSync(fd, pending); err != "") {
+			flushErr = err;
+			return err;
+		}
+		syncCount.fetch_add(1, std::memory_order_relaxed);
+		pending.clear();
+		durableEnd = pendingEnd;
+	}
+
+	// every table is saved at durableEnd before the log drops the records
+	// up to there. A crash in between leaves the old log, whose records the
+	// saved tables skip on replay.
+	if (std::string err = storage::saveCatalog(c, directory, durableEnd); err != "") {
+		return err;
+	}
+
+	std::string record;
+	startRecord(record, recordKind::checkpointRecord);
+	putVarint(record, durableEnd);
+	finishRecord(record);
+
+	std::string temporary = path + ".tmp";
+	int next = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (next < 0) {
+		return systemError("Could not create log", temporary);
+	}
+	std::string err = writeAndSync(next, record);
+	if (err == "" && ::rename(temporary.c_str(), path.c_str()) != 0) {
+		err = systemError("Could not rename log to", path);
+	}
+	if (err != "") {
+		::close(next);
+		::unlink(temporary.c_str());
+		return err;
+	}
+
+	::close(fd);
+	fd = next;
+	pendingEnd = durableEnd + record.size();
+	durableEnd = pendingEnd;
+	return syncDirectory(path);
+}
+
+std::string writeAheadLog::flush(std::unique_lock<std::mutex>& lock) {
+	writing.clear();
+	writing.swap(pending);
+	uint64_t end = pendingEnd;
+
+	// writers keep appending to pending while the group syncs
+	lock.unlock();
+	std::string err = writeAndSync(fd, writing);
+	lock.lock();
+
+	syncCount.fetch_add(1, std::memory_order_relaxed);
+	if (err != "") {
+		flushErr = err;
+	} else {
+		durableEnd = end;
+	}
+	flushing = false;
+	flushed.notify_all();
+	return err;
+}
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "../ast/ast.h"
+#include "../storage/storage.h"
+
+namespace wal {
+
+// A log file is a sequence of records, each
+//
+//	length u32 | checksum u32 | kind u8 | payload
+//
+// with length counting kind and payload and checksum being the CRC-32C of
+// them. Payloads are built from LEB128 varints and length-prefixed bytes:
+//
+//	CREATE TABLE: name, column count, then name and type (0 INT, 1 TEXT)
+//	              of each column
+//	INSERT:       table name, value count, then each value as tag 0 and a
+//	              zigzag varint for INT or tag 1 and the text as stored,
+//	              with no quotes escaped
+//	CHECKPOINT:   the log sequence number of offset 0 of the file
+//	CREATE INDEX: table name, index name, column name
+//	INSERT ROWS:  table name, row count, then the values of every row
+//	              back to back as in INSERT. COPY is logged as the rows it
+//	              appended, in INSERT ROWS records of at most chunkRows
+//	              rows.
+//
+// A record cut short by a crash fails its length or checksum; replay stops
+// there and the log continues from the last whole record. A checkpoint
+// record can only come first: it starts the log checkpoint rotates in, so
+// sequence numbers keep growing across checkpoints.
+
+enum class recordKind : uint8_t {
+	createTableRecord = 1,
+	insertRecord,
+	checkpointRecord,
+	createIndexRecord,
+	insertRowsRecord,
+};
+
+struct options {
+	// groupCommit lets one fsync cover the records of every writer waiting
+	// at the time. Without it each commit writes and syncs on its own.
+	bool groupCommit = true;
+	// a group is flushed once its first record has waited maxGroupDelay or
+	// it holds maxGroupBytes, whichever comes first. A zero delay still
+	// groups the records that arrive while the previous flush syncs.
+	std::chrono::microseconds maxGroupDelay{0};
+	size_t maxGroupBytes = 1 << 20;
+};
+
+// writeAheadLog appends the statements the catalog executed to a log file
+// so they survive a restart. Logging is two steps: append encodes a record
+// and returns its log sequence number, the end offset of the record in the
+// file plus the sequence number the file starts at, and commit blocks until
+// the log is durable up to it. Callers that
+// apply statements from several threads append while they still hold
+// whatever orders their changes, so the log replays in the same order,
+// and commit after letting go of it.
+class writeAheadLog {
+public:
+	~writeAheadLog();
+
+	writeAheadLog(const writeAheadLog&) = delete;
+	writeAheadLog& operator=(const writeAheadLog&) = delete;
+
+	// open replays the records of the log at path into c, creating the file
+	// if there is none, and returns the log ready to append after them.
+	// Tables c loaded from a checkpoint skip the records they already hold.
+	static std::tuple<std::unique_ptr<writeAheadLog>, std::string> open(const std::string& path,
+		storage::catalog& c, options opts = {});
+
+	std::tuple<uint64_t, std::string> appendCreateTable(const ast::CreateTableStatement& stmt);
+	std::tuple<uint64_t, std::string> appendCreateIndex(const ast::CreateIndexStatement& stmt);
+
+	// appendInsert logs stmt with its placeholders resolved from parameters,
+	// $1 being parameters[0]
+	std::tuple<uint64_t, std::string> appendInsert(const ast::InsertStatement& stmt,
+		const std::vector<nicolassql::token>& parameters = {});
+
+	// appendCopy logs the rows of t from row first on, those a COPY into t
+	// appended. Unlike the other appends it follows the change, as the rows
+	// are only known once the file is parsed; callers commit before they
+	// report the COPY done, as for any statement.
+	std::tuple<uint64_t, std::string> appendCopy(const storage::table& t, size_t first);
+
+	// commit returns once every record up to lsn is on disk
+	std::string commit(uint64_t lsn);
+
+	// checkpoint saves every table of c to directory as of the end of the
+	// log and starts the log over, so the next open only replays what came
+	// after. Appends wait for it; callers must not change c meanwhile.
+	std::string checkpoint(const storage::catalog& c, const std::string& directory);
+
+	// replayedRecords counts the records open applied, leaving out those a
+	// checkpoint already held
+	uint64_t replayedRecords() const { return replayed; }
+	uint64_t syncs() const { return syncCount.load(std::memory_order_relaxed); }
+
+private:
+	writeAheadLog(int fd, std::string path, uint64_t end, uint64_t replayed, options opts);
+
+	std::tuple<uint64_t, std::string> enqueue(const std::string& record);
+	std::string flush(std::unique_lock<std::mutex>& lock);
+
+	int fd;
+	std::string path;
+	options opts;
+	uint64_t replayed;
+	std::atomic<uint64_t> syncCount{0};
+
+	std::mutex mu;
+	// pending holds the records appended since the last flush took the
+	// buffer; pendingEnd is the lsn of the last of them
+	std::string pending;
+	// writing is the buffer a flush took, kept to reuse its capacity
+	std::string writing;
+	uint64_t pendingEnd;
+	uint64_t durableEnd;
+	bool flushing = false;
+	std::string flushErr;
+	std::chrono::steady_clock::time_point pendingSince;
+	std::condition_variable flushed;
+	std::condition_variable groupFull;
+};
+
+// checksum is the CRC-32C of data
+uint32_t checksum(const char* data, size_t size);
+
+}
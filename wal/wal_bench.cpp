@@ -0,0 +1,208 @@
+#include <benchmark/benchmark.h>
+#include "wal.h"
+#include "../execution/execution.h"
+#include "../parser/parser.h"
+#include "../parser/prepare.h"
+#include "../storage/pagefile.h"
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <unistd.h>
+
+using namespace wal;
+
+static std::unique_ptr<writeAheadLog> sharedLog;
+static std::unique_ptr<ast::Ast> insertAst;
+
+// BM_Commit has every benchmark thread append one INSERT and wait for it
+// to be durable, per iteration. The first argument turns group commit on,
+// the second is the group delay in microseconds.
+static void BM_Commit(benchmark::State& state) {
+    auto path = std::filesystem::temp_directory_path() / ("nicolassql_wal_bench_" + std::to_string(::getpid()));
+    if (state.thread_index() == 0) {
+        std::filesystem::remove(path);
+        storage::catalog c;
+        auto [log, err] = writeAheadLog::open(path.string(), c, options{
+            .groupCommit = state.range(0) != 0,
+            .maxGroupDelay = std::chrono::microseconds(state.range(1)),
+        });
+        if (!err.empty()) {
+            state.SkipWithError(err.c_str());
+        }
+        sharedLog = std::move(log);
+        insertAst = std::get<0>(parser::Parse("INSERT INTO events VALUES (123456, 'click', 'some note text')"));
+    }
+
+    for (auto _ : state) {
+        auto [lsn, err] = sharedLog->appendInsert(*insertAst->Statements[0]->InsertStatement);
+        if (err.empty()) {
+            err = sharedLog->commit(lsn);
+        }
+        if (!err.empty()) {
+            state.SkipWithError(err.c_str());
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) {
+        state.counters["syncs"] = static_cast<double>(sharedLog->syncs());
+        sharedLog.reset();
+        std::filesystem::remove(path);
+    }
+}
+
+static void commitArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"group", "delay_us"});
+    b->Args({0, 0});
+    b->Args({1, 0});
+    b->Args({1, 200});
+    b->ThreadRange(1, 16);
+    b->UseRealTime();
+}
+
+BENCHMARK(BM_Commit)->Apply(commitArgs);
+
+// fillEvents fills t, made by CREATE TABLE events, with rows
+// rows, through the storage API directly so setup stays tolerable at
+// billions of bytes
+static void fillEvents(storage::table& t, size_t rows) {
+    auto& cols = t.columns();
+    cols[0].ints.reserve(rows);
+    cols[1].offsets.reserve(rows + 1);
+    cols[1].chars.reserve(rows * 5);
+    cols[2].ints.reserve(rows);
+    cols[3].offsets.reserve(rows + 1);
+    cols[3].chars.reserve(rows * 11);
+
+    std::mt19937 rng(5);
+    for (size_t i = 0; i < rows; i++) {
+        cols[0].appendInt(static_cast<int64_t>(i));
+        cols[1].appendText(i % 3 == 0 ? "click" : "view");
+        cols[2].appendInt(rng() % 1000);
+        cols[3].appendText("note " + std::to_string(rng() % 1000000));
+    }
+    t.commitAppends();
+}
+
+// evict drops the pages of every file under path from the page cache, so
+// the next read comes from disk as after a reboot
+static void evict(const std::filesystem::path& path) {
+    auto drop = [](const std::filesystem::path& file) {
+        int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            ::fdatasync(fd);
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+    };
+    if (std::filesystem::is_directory(path)) {
+        for (const auto& entry : std::filesystem::directory_iterator(path)) {
+            drop(entry.path());
+        }
+    } else {
+        drop(path);
+    }
+}
+
+static const char* createEvents = "CREATE TABLE events (id INT, kind TEXT, score INT, note TEXT)";
+static const char* firstQuery = "SELECT id, note FROM events WHERE id = 4242";
+
+// BM_ColdStart measures the time from a restart to the answer of the first
+// query over an events table of range(0) rows. With range(1) 0 the table
+// comes back from a checkpoint: its files are mapped and the log after it
+// is empty. With 1 there is no checkpoint and the whole history of INSERTs
+// is replayed from the log. The page cache is dropped before each start.
+static void BM_ColdStart(benchmark::State& state) {
+    size_t rows = static_cast<size_t>(state.range(0));
+    bool replay = state.range(1) != 0;
+    auto root = std::filesystem::temp_directory_path() / ("nicolassql_coldstart_" + std::to_string(::getpid()));
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    std::string logFile = (root / "log").string();
+    std::string tables = (root / "tables").string();
+
+    auto [create, parseErr] = parser::Parse(std::string(createEvents) + "; " + firstQuery);
+    const ast::CreateTableStatement& createStmt = *create->Statements[0]->CreateTableStatement;
+    const ast::SelectStatement& query = *create->Statements[1]->SelectStatement;
+    {
+        storage::catalog c;
+        auto [log, err] = wal::writeAheadLog::open(logFile, c);
+        if (!err.empty()) {
+            state.SkipWithError(err.c_str());
+            return;
+        }
+        log->appendCreateTable(createStmt);
+        auto [t, createErr] = c.createTable(createStmt);
+        if (replay) {
+            auto [prepared, prepErr] = parser::prepare("INSERT INTO events VALUES ($1, $2, $3, $4)");
+            std::mt19937 rng(5);
+            uint64_t lsn = 0;
+            for (size_t i = 0; i < rows; i++) {
+                std::string id = std::to_string(i);
+                std::string score = std::to_string(rng() % 1000);
+                std::string note = "note " + std::to_string(rng() % 1000000);
+                auto [bound, bindErr] = parser::bind(prepared, {parser::numericParameter(id),
+                    parser::stringParameter(i % 3 == 0 ? "click" : "view"),
+                    parser::numericParameter(score), parser::stringParameter(note)});
+                lsn = std::get<0>(log->appendInsert(*bound.statement().InsertStatement, bound.parameters));
+            }
+            log->commit(lsn);
+        } else {
+            fillEvents(*t, rows);
+            if (std::string checkpointErr = log->checkpoint(c, tables); !checkpointErr.empty()) {
+                state.SkipWithError(checkpointErr.c_str());
+                return;
+            }
+        }
+    }
+    uint64_t diskBytes = 0;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+        diskBytes += entry.is_regular_file() ? entry.file_size() : 0;
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        evict(logFile);
+        evict(tables);
+        state.ResumeTiming();
+
+        storage::catalog c;
+        std::string err = storage::loadCatalog(c, tables);
+        std::unique_ptr<wal::writeAheadLog> log;
+        if (err.empty()) {
+            std::tie(log, err) = wal::writeAheadLog::open(logFile, c);
+        }
+        execution::resultSet result;
+        if (err.empty()) {
+            std::tie(result, err) = execution::executeSelect(query, c);
+        }
+        if (!err.empty() || result.rows != 1) {
+            state.SkipWithError(err.empty() ? "first query found no row" : err.c_str());
+            break;
+        }
+
+        state.PauseTiming();
+        log.reset();
+        c = storage::catalog();
+        state.ResumeTiming();
+    }
+    state.counters["disk_bytes"] = static_cast<double>(diskBytes);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+    std::filesystem::remove_all(root);
+}
+
+static void coldStartArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"rows", "replay"});
+    b->Args({1 << 20, 0});
+    b->Args({1 << 20, 1});
+    b->Args({1 << 26, 0});
+    b->Iterations(3);
+    b->Unit(benchmark::kMillisecond);
+    b->UseRealTime();
+}
+
+BENCHMARK(BM_ColdStart)->Apply(coldStartArgs);
+
+BENCHMARK_MAIN();
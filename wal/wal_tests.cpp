@@ -0,0 +1,374 @@
+#include <gtest/gtest.h>
+#include "wal.h"
+#include "../storage/pagefile.h"
+#include "../storage/btree.h"
+#include "../parser/parser.h"
+#include "../parser/prepare.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <unistd.h>
+
+using namespace wal;
+using namespace nicolassql;
+
+// logPath is a fresh log file for the test called name
+static std::string logPath(const std::string& name) {
+    auto path = std::filesystem::temp_directory_path() /
+        ("nicolassql_wal_" + std::to_string(::getpid()) + "_" + name);
+    std::filesystem::remove(path);
+    return path.string();
+}
+
+// execute applies the statements of script to c and logs each one
+static void execute(storage::catalog& c, writeAheadLog& log, const std::string& script) {
+    auto [a, err] = parser::Parse(script);
+    ASSERT_TRUE(err.empty()) << err;
+    for (auto* stmt : a->Statements) {
+        uint64_t lsn = 0;
+        std::string logErr;
+        if (stmt->Kind == ast::AstKind::CreateTableKind) {
+            ASSERT_EQ(std::get<1>(c.createTable(*stmt->CreateTableStatement)), "");
+            std::tie(lsn, logErr) = log.appendCreateTable(*stmt->CreateTableStatement);
+        } else if (stmt->Kind == ast::AstKind::CreateIndexKind) {
+            ASSERT_EQ(std::get<1>(c.createIndex(*stmt->CreateIndexStatement)), "");
+            std::tie(lsn, logErr) = log.appendCreateIndex(*stmt->CreateIndexStatement);
+        } else if (stmt->Kind == ast::AstKind::CopyKind) {
+            const storage::table* t = c.find(stmt->CopyStatement->table.value);
+            ASSERT_NE(t, nullptr);
+            size_t first = t->rows();
+            ASSERT_EQ(std::get<1>(c.copy(*stmt->CopyStatement)), "");
+            std::tie(lsn, logErr) = log.appendCopy(*t, first);
+        } else {
+            ASSERT_EQ(c.insert(*stmt->InsertStatement), "");
+            std::tie(lsn, logErr) = log.appendInsert(*stmt->InsertStatement);
+        }
+        ASSERT_EQ(logErr, "");
+        ASSERT_EQ(log.commit(lsn), "");
+    }
+}
+
+static void expectSameTable(const storage::table& want, const storage::table& got) {
+    ASSERT_EQ(want.rows(), got.rows());
+    ASSERT_EQ(want.columns().size(), got.columns().size());
+    for (size_t i = 0; i < want.columns().size(); i++) {
+        const storage::column& a = want.columns()[i];
+        const storage::column& b = got.columns()[i];
+        EXPECT_EQ(a.name, b.name);
+        EXPECT_EQ(a.type, b.type);
+        EXPECT_EQ(a.ints, b.ints) << a.name;
+        EXPECT_EQ(a.offsets, b.offsets) << a.name;
+        EXPECT_EQ(a.chars, b.chars) << a.name;
+    }
+}
+
+TEST(WalTest, ReplaysCreateTableAndInsert) {
+    std::string path = logPath("replay");
+    storage::catalog original;
+    {
+        auto [log, err] = writeAheadLog::open(path, original);
+        ASSERT_TRUE(err.empty()) << err;
+        EXPECT_EQ(log->replayedRecords(), 0u);
+        execute(original, *log, "CREATE TABLE users (id INT, name TEXT);"
+                                "INSERT INTO users VALUES (1, 'ann');"
+                                "INSERT INTO users VALUES (0, 'it''s');"
+                                "INSERT INTO users VALUES (9223372036854775807, '');"
+                                "CREATE TABLE empty (a TEXT)");
+
+        // placeholders are logged as the values they were bound to, which
+        // unlike literals can be negative
+        auto [prepared, prepErr] = parser::prepare("INSERT INTO users VALUES (?, ?)");
+        ASSERT_TRUE(prepErr.empty()) << prepErr;
+        uint64_t lsn = 0;
+        for (const char* name : {"bob", "O'Brien", "it''s"}) {
+            auto [bound, bindErr] = parser::bind(prepared, {parser::numericParameter("-9223372036854775808"),
+                parser::stringParameter(name)});
+            ASSERT_TRUE(bindErr.empty()) << bindErr;
+            ASSERT_EQ(original.insert(*bound.statement().InsertStatement, bound.parameters), "");
+            auto [appended, appendErr] = log->appendInsert(*bound.statement().InsertStatement, bound.parameters);
+            ASSERT_EQ(appendErr, "");
+            lsn = appended;
+        }
+        ASSERT_EQ(log->commit(lsn), "");
+        EXPECT_EQ(lsn, std::filesystem::file_size(path));
+    }
+
+    storage::catalog replayed;
+    auto [log, err] = writeAheadLog::open(path, replayed);
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(log->replayedRecords(), 8u);
+    ASSERT_EQ(replayed.size(), 2u);
+    expectSameTable(*original.find("users"), *replayed.find("users"));
+    expectSameTable(*original.find("empty"), *replayed.find("empty"));
+    EXPECT_EQ(replayed.find("users")->columns()[1].text(1), "it's");
+    // bound values come back as bound, quotes and all
+    EXPECT_EQ(replayed.find("users")->columns()[1].text(3), "bob");
+    EXPECT_EQ(replayed.find("users")->columns()[1].text(4), "O'Brien");
+    EXPECT_EQ(replayed.find("users")->columns()[1].text(5), "it''s");
+    std::filesystem::remove(path);
+}
+
+TEST(WalTest, ReplaysCopy) {
+    std::string path = logPath("copy");
+    std::string csv = logPath("copy.csv");
+    size_t rows = storage::chunkRows + 100;
+    {
+        std::ofstream out(csv);
+        for (size_t i = 0; i < rows; i++) {
+            out << i * 7 << "," << (i % 5 == 0 ? "\"it's, " + std::to_string(i) + "\"" : "row") << "\n";
+        }
+    }
+
+    storage::catalog original;
+    {
+        auto [log, err] = writeAheadLog::open(path, original);
+        ASSERT_TRUE(err.empty()) << err;
+        // the COPY lands after a row, so its records start inside a chunk
+        execute(original, *log, "CREATE TABLE t (a INT, b TEXT); INSERT INTO t VALUES (1, 'first');"
+                                "COPY t FROM '" + csv + "'");
+    }
+
+    storage::catalog replayed;
+    auto [log, err] = writeAheadLog::open(path, replayed);
+    ASSERT_TRUE(err.empty()) << err;
+    // one INSERT ROWS record per chunk the copied rows reach into
+    EXPECT_EQ(log->replayedRecords(), 4u);
+    const storage::table& want = *original.find("t");
+    const storage::table& got = *replayed.find("t");
+    ASSERT_EQ(got.rows(), rows + 1);
+    for (size_t row = 0; row < want.rows(); row++) {
+        ASSERT_EQ(got.columns()[0].intAt(row), want.columns()[0].intAt(row)) << row;
+        ASSERT_EQ(got.columns()[1].text(row), want.columns()[1].text(row)) << row;
+    }
+    EXPECT_EQ(got.columns()[1].text(6), "it's, 5");
+    std::filesystem::remove(path);
+    std::filesystem::remove(csv);
+}
+
+TEST(WalTest, DropsTornTailAndKeepsAppending) {
+    std::string path = logPath("torn");
+    {
+        storage::catalog c;
+        auto [log, err] = writeAheadLog::open(path, c);
+        ASSERT_TRUE(err.empty()) << err;
+        execute(c, *log, "CREATE TABLE t (a INT); INSERT INTO t VALUES (1); INSERT INTO t VALUES (2)");
+    }
+
+    // cut the last record short, as a crash in the middle of a write would
+    uintmax_t whole = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, whole - 3);
+    {
+        storage::catalog c;
+        auto [log, err] = writeAheadLog::open(path, c);
+        ASSERT_TRUE(err.empty()) << err;
+        EXPECT_EQ(log->replayedRecords(), 2u);
+        EXPECT_EQ(c.find("t")->rows(), 1u);
+        execute(c, *log, "INSERT INTO t VALUES (3)");
+    }
+
+    // garbage after the last record is dropped the same way
+    {
+        std::ofstream out(path, std::ios::app | std::ios::binary);
+        out.write("\x05\x00\x00\x00garbage", 11);
+    }
+    storage::catalog c;
+    auto [log, err] = writeAheadLog::open(path, c);
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(log->replayedRecords(), 3u);
+    EXPECT_EQ(c.find("t")->columns()[0].ints, (std::vector<int64_t>{1, 3}));
+    std::filesystem::remove(path);
+}
+
+TEST(WalTest, GroupCommitSharesSyncs) {
+    constexpr int writers = 8;
+    constexpr int commitsPerWriter = 25;
+
+    for (bool group : {true, false}) {
+        std::string path = logPath(group ? "group" : "nogroup");
+        storage::catalog c;
+        auto [log, err] = writeAheadLog::open(path, c, options{
+            .groupCommit = group,
+            .maxGroupDelay = std::chrono::microseconds(500),
+        });
+        ASSERT_TRUE(err.empty()) << err;
+        auto [a, parseErr] = parser::Parse("CREATE TABLE t (a INT, b TEXT); INSERT INTO t VALUES (7, 'seven')");
+        ASSERT_TRUE(parseErr.empty()) << parseErr;
+        log->commit(std::get<0>(log->appendCreateTable(*a->Statements[0]->CreateTableStatement)));
+        uint64_t syncsBefore = log->syncs();
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < writers; i++) {
+            threads.emplace_back([&] {
+                for (int j = 0; j < commitsPerWriter; j++) {
+                    auto [lsn, appendErr] = log->appendInsert(*a->Statements[1]->InsertStatement);
+                    EXPECT_EQ(appendErr, "");
+                    EXPECT_EQ(log->commit(lsn), "");
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        uint64_t syncs = log->syncs() - syncsBefore;
+        if (group) {
+            EXPECT_LT(syncs, static_cast<uint64_t>(writers * commitsPerWriter));
+        } else {
+            EXPECT_EQ(syncs, static_cast<uint64_t>(writers * commitsPerWriter));
+        }
+        log.reset();
+
+        storage::catalog replayed;
+        auto [reopened, reopenErr] = writeAheadLog::open(path, replayed);
+        ASSERT_TRUE(reopenErr.empty()) << reopenErr;
+        EXPECT_EQ(replayed.find("t")->rows(), static_cast<size_t>(writers * commitsPerWriter));
+        std::filesystem::remove(path);
+    }
+}
+
+TEST(WalTest, ReplaysCreateIndex) {
+    std::string path = logPath("index");
+    storage::catalog original;
+    {
+        auto [log, err] = writeAheadLog::open(path, original);
+        ASSERT_TRUE(err.empty()) << err;
+        execute(original, *log, "CREATE TABLE t (a INT, b TEXT); INSERT INTO t VALUES (1, 'one');"
+                                "CREATE INDEX by_b ON t (b); INSERT INTO t VALUES (2, 'two'), (3, 'three')");
+    }
+
+    storage::catalog replayed;
+    auto [log, err] = writeAheadLog::open(path, replayed);
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(log->replayedRecords(), 4u);
+    const storage::table* t = replayed.find("t");
+    ASSERT_EQ(t->indexes().size(), 1u);
+    EXPECT_EQ(t->indexes()[0]->name(), "by_b");
+    EXPECT_EQ(t->indexes()[0]->column(), 1u);
+    EXPECT_EQ(t->indexes()[0]->size(), 3u);
+    expectSameTable(*original.find("t"), *t);
+    log.reset();
+    std::filesystem::remove(path);
+}
+
+TEST(WalTest, CheckpointReplaysOnlyNewerRecords) {
+    std::string path = logPath("checkpoint");
+    std::string directory = logPath("checkpoint_tables");
+    storage::catalog original;
+    {
+        auto [log, err] = writeAheadLog::open(path, original);
+        ASSERT_TRUE(err.empty()) << err;
+        execute(original, *log, "CREATE TABLE t (a INT, b TEXT); INSERT INTO t VALUES (1, 'one')");
+        ASSERT_EQ(log->checkpoint(original, directory), "");
+        execute(original, *log, "INSERT INTO t VALUES (2, 'two'); CREATE TABLE u (c INT); INSERT INTO u VALUES (3)");
+    }
+
+    storage::catalog restarted;
+    ASSERT_EQ(storage::loadCatalog(restarted, directory), "");
+    EXPECT_EQ(restarted.find("t")->rows(), 1u);
+    auto [log, err] = writeAheadLog::open(path, restarted);
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(log->replayedRecords(), 3u);
+    expectSameTable(*original.find("t"), *restarted.find("t"));
+    expectSameTable(*original.find("u"), *restarted.find("u"));
+
+    // sequence numbers keep growing past the checkpoint
+    auto [a, parseErr] = parser::Parse("INSERT INTO u VALUES (4)");
+    ASSERT_TRUE(parseErr.empty()) << parseErr;
+    auto [lsn, appendErr] = log->appendInsert(*a->Statements[0]->InsertStatement);
+    ASSERT_EQ(appendErr, "");
+    EXPECT_GT(lsn, std::filesystem::file_size(path));
+    log.reset();
+    std::filesystem::remove(path);
+    std::filesystem::remove_all(directory);
+}
+
+TEST(WalTest, CheckpointedTablesSkipOldRecords) {
+    // a crash after saving the tables but before starting the log over
+    // leaves records the tables already hold
+    std::string path = logPath("crashed_checkpoint");
+    std::string directory = logPath("crashed_checkpoint_tables");
+    storage::catalog original;
+    uint64_t end = 0;
+    {
+        auto [log, err] = writeAheadLog::open(path, original);
+        ASSERT_TRUE(err.empty()) << err;
+        execute(original, *log, "CREATE TABLE t (a INT); INSERT INTO t VALUES (1); INSERT INTO t VALUES (2)");
+        end = std::filesystem::file_size(path);
+        ASSERT_EQ(storage::saveCatalog(original, directory, end), "");
+        execute(original, *log, "INSERT INTO t VALUES (3)");
+    }
+
+    storage::catalog restarted;
+    ASSERT_EQ(storage::loadCatalog(restarted, directory), "");
+    auto [log, err] = writeAheadLog::open(path, restarted);
+    ASSERT_TRUE(err.empty()) << err;
+    EXPECT_EQ(log->replayedRecords(), 1u);
+    EXPECT_EQ(restarted.find("t")->columns()[0].ints, (std::vector<int64_t>{1, 2, 3}));
+    log.reset();
+    std::filesystem::remove(path);
+    std::filesystem::remove_all(directory);
+}
+
+TEST(WalTest, ReportsErrors) {
+    std::string path = logPath("errors");
+    storage::catalog c;
+    auto [log, err] = writeAheadLog::open(path, c);
+    ASSERT_TRUE(err.empty()) << err;
+
+    auto [a, parseErr] = parser::Parse("INSERT INTO t VALUES (1 = 1); INSERT INTO t VALUES ($1); INSERT INTO t VALUES (1.5)");
+    ASSERT_TRUE(parseErr.empty()) << parseErr;
+    EXPECT_EQ(std::get<1>(log->appendInsert(*a->Statements[0]->InsertStatement)), "Only literal values can be logged");
+    EXPECT_EQ(std::get<1>(log->appendInsert(*a->Statements[1]->InsertStatement)), "Missing parameter $1");
+    EXPECT_EQ(std::get<1>(log->appendInsert(*a->Statements[2]->InsertStatement)),
+        "Only INT and TEXT values can be logged, got 1.5");
+    log.reset();
+
+    // a whole record the catalog rejects stops the replay
+    {
+        storage::catalog other;
+        auto [writer, writerErr] = writeAheadLog::open(path, other);
+        ASSERT_TRUE(writerErr.empty()) << writerErr;
+        auto [insert, insertErr] = parser::Parse("INSERT INTO missing VALUES (1)");
+        writer->commit(std::get<0>(writer->appendInsert(*insert->Statements[0]->InsertStatement)));
+    }
+    storage::catalog replayed;
+    EXPECT_EQ(std::get<1>(writeAheadLog::open(path, replayed)),
+        "Could not replay log record at offset 0: Table missing does not exist");
+    EXPECT_EQ(std::get<1>(writeAheadLog::open("/nonexistent/dir/log", replayed)),
+        "Could not open log /nonexistent/dir/log: No such file or directory");
+
+    // a checkpoint record belongs at the start of the log only
+    std::string directory = logPath("errors_tables");
+    {
+        storage::catalog empty;
+        std::filesystem::remove(path);
+        auto [writer, writerErr] = writeAheadLog::open(path, empty);
+        ASSERT_TRUE(writerErr.empty()) << writerErr;
+        ASSERT_EQ(writer->checkpoint(empty, directory), "");
+    }
+    std::string checkpoint;
+    {
+        std::ifstream in(path, std::ios::binary);
+        checkpoint.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out << checkpoint;
+    }
+    storage::catalog doubled;
+    EXPECT_EQ(std::get<1>(writeAheadLog::open(path, doubled)), "Could not replay log record at offset " +
+        std::to_string(checkpoint.size()) + ": checkpoint record inside the replayed range");
+    std::filesystem::remove(path);
+    std::filesystem::remove_all(directory);
+}
+
+TEST(WalTest, ChecksumIsCrc32c) {
+    // the check value of CRC-32C
+    EXPECT_EQ(checksum("123456789", 9), 0xe3069283u);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}